@@ -0,0 +1,123 @@
+#include "AdmissionControl.h"
+#include "Driver.h"
+#include "OdbcFunctions.h"
+#include "Settings.h"
+
+#include <array>
+#include <string_view>
+
+namespace
+{
+// calls doing the work of a statement, the ones that pile up inside a driver serializing internally
+constexpr std::array<std::string_view, 20> kAdmittedFunctionNames = {
+    "SQLBulkOperations",
+    "SQLColumnPrivilegesW",
+    "SQLColumnsW",
+    "SQLExecDirectW",
+    "SQLExecute",
+    "SQLExtendedFetch",
+    "SQLFetch",
+    "SQLFetchScroll",
+    "SQLGetData",
+    "SQLMoreResults",
+    "SQLParamData",
+    "SQLPrepareW",
+    "SQLPrimaryKeysW",
+    "SQLProcedureColumnsW",
+    "SQLProceduresW",
+    "SQLPutData",
+    "SQLSetPos",
+    "SQLSpecialColumnsW",
+    "SQLStatisticsW",
+    "SQLTablesW",
+};
+
+constexpr auto kAdmittedFunctions = []
+{
+   std::array<bool, kOdbcFunctionCount> admitted{};
+   for (auto name : kAdmittedFunctionNames)
+   {
+      admitted[FindOdbcFunction(name).value()] = true;
+   }
+   return admitted;
+}();
+
+std::unique_ptr<FairSemaphore> CreateAdmission(std::string_view setting)
+{
+   auto limit = GetSettingInt(setting, 0);
+   return limit > 0 ? std::make_unique<FairSemaphore>(static_cast<size_t>(limit)) : nullptr;
+}
+} // namespace
+
+std::unique_ptr<FairSemaphore> CreateDriverAdmission()
+{
+   return CreateAdmission("DRIVER_CONCURRENCY");
+}
+
+std::unique_ptr<FairSemaphore> CreateConnectionAdmission()
+{
+   return CreateAdmission("CONNECTION_CONCURRENCY");
+}
+
+Admission::Admission(size_t function, const Route &route)
+{
+   if (function >= kOdbcFunctionCount || !kAdmittedFunctions[function])
+   {
+      return;
+   }
+
+   if (route.record)
+   {
+      auto &connection = route.record->type == SQL_HANDLE_DBC || !route.record->parent ? *route.record : *route.record->parent;
+      m_connection = connection.admission.get();
+   }
+   m_driver = route.driver != nullptr ? route.driver->Admission() : nullptr;
+   if (m_connection == nullptr && m_driver == nullptr)
+   {
+      return;
+   }
+
+   // always in the same order, a call never holds a driver permit while waiting for its connection
+   auto start = std::chrono::steady_clock::now();
+   if (m_connection != nullptr)
+   {
+      m_queued |= m_connection->Acquire();
+   }
+   if (m_driver != nullptr)
+   {
+      m_queued |= m_driver->Acquire();
+   }
+   if (m_queued)
+   {
+      m_waited = std::chrono::steady_clock::now() - start;
+   }
+}
+
+Admission::~Admission()
+{
+   Release();
+}
+
+void Admission::Release()
+{
+   if (m_driver != nullptr)
+   {
+      m_driver->Release();
+      m_driver = nullptr;
+   }
+   if (m_connection != nullptr)
+   {
+      m_connection->Release();
+      m_connection = nullptr;
+   }
+}
+
+bool Admission::Queued() const
+{
+   return m_queued;
+}
+
+std::chrono::nanoseconds Admission::Waited() const
+{
+   return m_waited;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "FairSemaphore.h"
+#include "Routing.h"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
+// limit of the concurrent execute and fetch class calls, per driver (ODBCDETOUR_DRIVER_CONCURRENCY) and per connection
+// (ODBCDETOUR_CONNECTION_CONCURRENCY). Calls over the limit queue in FIFO order, both limits are off by default.
+std::unique_ptr<FairSemaphore> CreateDriverAdmission();
+std::unique_ptr<FairSemaphore> CreateConnectionAdmission();
+
+// permits held by one call, taken from its connection then from its driver
+class Admission
+{
+ public:
+   Admission(size_t function, const Route &route);
+   ~Admission();
+
+   Admission(const Admission &) = delete;
+   Admission &operator=(const Admission &) = delete;
+
+   void Release();
+
+   bool Queued() const;
+   // time spent waiting for the permits
+   std::chrono::nanoseconds Waited() const;
+
+ private:
+   FairSemaphore *m_connection = nullptr;
+   FairSemaphore *m_driver = nullptr;
+   bool m_queued = false;
+   std::chrono::nanoseconds m_waited{0};
+};
@@ -0,0 +1,770 @@
+#include "BlockFetch.h"
+#include "Clock.h"
+#include "Driver.h"
+#include "Logging.h"
+#include "PostedDiagnostics.h"
+#include "Settings.h"
+#include "Statement.h"
+#include "StringConversion.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <print>
+#include <unordered_map>
+
+namespace
+{
+// block sizes are powers of two up to 2^kMaxExponent rows
+constexpr int kMaxExponent = 14;
+// weight of the last full block in the rows per second of a size
+constexpr double kSmoothing = 0.2;
+// every so many block fetched results a neighbour of the best size is measured again, the driver or data may change
+constexpr uint64_t kProbeInterval = 16;
+constexpr size_t kMaxStatementText = 120;
+constexpr size_t kReportedStatements = 20;
+constexpr SQLSMALLINT kMaxBlockDiagnostics = 64;
+
+// statement attributes by which the application drives the rowset itself
+constexpr std::array<SQLINTEGER, 11> kRowAttributes = {
+    SQL_ATTR_ROW_ARRAY_SIZE, SQL_ATTR_ROW_BIND_TYPE, SQL_ATTR_ROW_BIND_OFFSET_PTR, SQL_ATTR_ROW_STATUS_PTR,
+    SQL_ATTR_ROWS_FETCHED_PTR, SQL_ATTR_CURSOR_TYPE, SQL_ATTR_CURSOR_SCROLLABLE, SQL_ATTR_CONCURRENCY,
+    SQL_ATTR_USE_BOOKMARKS, SQL_ATTR_RETRIEVE_DATA, SQL_ATTR_APP_ROW_DESC};
+// the implicit row descriptor was changed through the descriptor functions
+constexpr uint32_t kDescriptorChanged = 1u << kRowAttributes.size();
+
+struct SizeSample
+{
+   uint64_t blocks = 0;
+   double rowsPerSecond = 0;
+};
+
+struct FetchProfile
+{
+   std::string statement;
+   uint64_t results = 0;
+   uint64_t blockResults = 0;
+   uint64_t fetches = 0;
+   uint64_t rows = 0;
+   std::chrono::nanoseconds fetchTime{0};
+   SQLULEN rowBytes = 0;
+   SQLULEN applicationRowArraySize = 1;
+   uint64_t maxResultRows = 0;
+   // rows per second of full blocks by exponent of the block size
+   std::array<SizeSample, kMaxExponent + 1> sizes;
+   int chosen = -1;
+};
+
+std::mutex profileLock;
+std::unordered_map<uint64_t, FetchProfile> profiles;
+
+// must be called with profileLock held
+FetchProfile &GetProfile(const BlockFetch &state)
+{
+   auto &profile = profiles[state.fingerprint];
+   if (profile.statement.empty())
+   {
+      profile.statement = state.statement;
+   }
+   return profile;
+}
+
+double Seconds(std::chrono::nanoseconds duration)
+{
+   return std::chrono::duration<double>(duration).count();
+}
+
+// size of a value of the C type, the buffer length for variable length types. 0 when the detour does not block fetch
+// the type, ex: SQL_C_DEFAULT whose size depends on the column
+SQLLEN ElementSize(const BoundColumn &column)
+{
+   return IsVariableCType(column.targetType) ? column.bufferLength : FixedCTypeSize(column.targetType);
+}
+
+// bit of a row attribute set to a value other than its default, 0 for other attributes
+uint32_t ApplicationAttributeBit(SQLINTEGER attribute)
+{
+   auto it = std::ranges::find(kRowAttributes, attribute);
+   return it != kRowAttributes.end() ? 1u << (it - kRowAttributes.begin()) : 0;
+}
+
+bool IsDefaultValue(SQLINTEGER attribute, SQLPOINTER value)
+{
+   auto number = reinterpret_cast<SQLULEN>(value);
+   switch (attribute)
+   {
+   case SQL_ATTR_ROW_ARRAY_SIZE:
+      return number <= 1;
+   case SQL_ATTR_ROW_BIND_TYPE:
+      return number == SQL_BIND_BY_COLUMN;
+   case SQL_ATTR_CURSOR_TYPE:
+      return number == SQL_CURSOR_FORWARD_ONLY;
+   case SQL_ATTR_CURSOR_SCROLLABLE:
+      return number == SQL_NONSCROLLABLE;
+   case SQL_ATTR_CONCURRENCY:
+      return number == SQL_CONCUR_READ_ONLY;
+   case SQL_ATTR_USE_BOOKMARKS:
+      return number == SQL_UB_OFF;
+   case SQL_ATTR_RETRIEVE_DATA:
+      return number == SQL_RD_ON;
+   default:
+      // pointers and descriptors
+      return value == nullptr;
+   }
+}
+
+// block size for a result of the statement, 1 when it should not be block fetched. Must be called with profileLock held
+SQLULEN ChooseBlockSize(FetchProfile &profile)
+{
+   static const auto budget = std::max<long long>(1, GetSettingInt("BLOCK_FETCH_KB", 1024)) * 1024;
+   static const int initial = std::min(kMaxExponent, static_cast<int>(std::bit_width(static_cast<unsigned long long>(std::max<long long>(2, GetSettingInt("BLOCK_FETCH_ROWS", 64))))) - 1);
+
+   auto budgetRows = std::max<SQLULEN>(1, static_cast<SQLULEN>(budget) / std::max<SQLULEN>(1, profile.rowBytes));
+   int limit = std::min(kMaxExponent, static_cast<int>(std::bit_width(budgetRows)) - 1);
+   if (profile.results > 0)
+   {
+      // a block larger than the largest result only wastes memory, one holding it entirely is enough
+      limit = std::min(limit, static_cast<int>(std::bit_width(std::max<uint64_t>(profile.maxResultRows, 1) - 1)));
+   }
+   if (limit < 1)
+   {
+      return 1;
+   }
+
+   int best = -1;
+   for (int exponent = 1; exponent <= limit; ++exponent)
+   {
+      if (profile.sizes[exponent].blocks > 0 && (best < 0 || profile.sizes[exponent].rowsPerSecond > profile.sizes[best].rowsPerSecond))
+      {
+         best = exponent;
+      }
+   }
+
+   int chosen = best;
+   if (best < 0)
+   {
+      chosen = std::min(initial, limit);
+   }
+   else if (best < limit && profile.sizes[best + 1].blocks == 0)
+   {
+      chosen = best + 1;
+   }
+   else if (best > 1 && profile.sizes[best - 1].blocks == 0)
+   {
+      chosen = best - 1;
+   }
+   else if (profile.blockResults % kProbeInterval == 0)
+   {
+      chosen = std::clamp(profile.blockResults / kProbeInterval % 2 == 0 ? best + 1 : best - 1, 1, limit);
+   }
+   profile.chosen = chosen;
+   ++profile.blockResults;
+   return SQLULEN{1} << chosen;
+}
+
+// counted in the state of the statement, the profile lock is only taken when the result ends. Must be called with the
+// state lock held
+void RecordFetch(BlockFetch &state, std::chrono::nanoseconds duration, bool fullBlock)
+{
+   ++state.resultFetches;
+   state.resultFetchTime += duration;
+   if (fullBlock)
+   {
+      ++state.resultFullBlocks;
+      state.resultFullBlockTime += duration;
+   }
+}
+
+// the fetches of the result are added to the profile of its fingerprint. Must be called with the state lock held,
+// before Restore
+void EndResult(BlockFetch &state)
+{
+   if (!state.resultOpen)
+   {
+      return;
+   }
+   state.resultOpen = false;
+   std::lock_guard lock(profileLock);
+   auto &profile = GetProfile(state);
+   ++profile.results;
+   profile.maxResultRows = std::max(profile.maxResultRows, state.resultRows);
+   profile.fetches += state.resultFetches;
+   profile.rows += state.resultRows;
+   profile.fetchTime += state.resultFetchTime;
+   if (!state.engaged)
+   {
+      profile.applicationRowArraySize = state.applicationRowArraySize;
+      if (profile.rowBytes == 0)
+      {
+         profile.rowBytes = state.resultRowBytes;
+      }
+   }
+   else if (state.resultFullBlocks > 0 && state.resultFullBlockTime.count() > 0)
+   {
+      // the full blocks of a result weigh as one sample
+      auto &sample = profile.sizes[std::countr_zero(state.blockSize)];
+      auto rowsPerSecond = static_cast<double>(state.resultFullBlocks * state.blockSize) / Seconds(state.resultFullBlockTime);
+      sample.rowsPerSecond = sample.blocks == 0 ? rowsPerSecond : sample.rowsPerSecond + kSmoothing * (rowsPerSecond - sample.rowsPerSecond);
+      sample.blocks += state.resultFullBlocks;
+   }
+}
+
+// driver bindings and row attributes back to the application ones. Must be called with the state lock held
+void Restore(const Route &route, BlockFetch &state)
+{
+   if (!state.engaged)
+   {
+      return;
+   }
+   state.engaged = false;
+
+   auto setStmtAttr = route.driver->Get<OdbcFunctionId::SQLSetStmtAttrW>();
+   auto bindCol = route.driver->Get<OdbcFunctionId::SQLBindCol>();
+   setStmtAttr(route.handle, SQL_ATTR_ROW_ARRAY_SIZE, reinterpret_cast<SQLPOINTER>(SQLULEN{1}), 0);
+   setStmtAttr(route.handle, SQL_ATTR_ROWS_FETCHED_PTR, nullptr, 0);
+   setStmtAttr(route.handle, SQL_ATTR_ROW_STATUS_PTR, nullptr, 0);
+   // read again, the application may have rebound columns meanwhile
+   auto bound = GetStatementColumns(*route.record);
+   for (auto &column : state.columns)
+   {
+      if (auto it = bound.find(column.number); it != bound.end())
+      {
+         bindCol(route.handle, column.number, it->second.targetType, it->second.value, it->second.bufferLength, it->second.strLenOrInd);
+      }
+      else
+      {
+         bindCol(route.handle, column.number, SQL_C_DEFAULT, nullptr, 0, nullptr);
+      }
+   }
+
+   state.columns = {};
+   state.rowStatus = {};
+   state.rowsFetched = 0;
+   state.nextRow = 0;
+   state.rowDiagnostics = {};
+}
+
+// bind the columns of the result to arrays, when every column is bound by the application. Must be called with the
+// state lock held
+void Engage(const Route &route, BlockFetch &state)
+{
+   auto numResultCols = route.driver->Get<OdbcFunctionId::SQLNumResultCols>();
+   auto setStmtAttr = route.driver->Get<OdbcFunctionId::SQLSetStmtAttrW>();
+   auto bindCol = route.driver->Get<OdbcFunctionId::SQLBindCol>();
+   SQLSMALLINT count = 0;
+   if (numResultCols == nullptr || setStmtAttr == nullptr || bindCol == nullptr || !SQL_SUCCEEDED(numResultCols(route.handle, &count)) || count <= 0)
+   {
+      return;
+   }
+
+   auto bound = GetStatementColumns(*route.record);
+   if (bound.contains(0))
+   {
+      // bookmarks
+      return;
+   }
+   std::vector<BlockColumn> columns;
+   SQLULEN rowBytes = 0;
+   for (SQLUSMALLINT number = 1; number <= static_cast<SQLUSMALLINT>(count); ++number)
+   {
+      auto it = bound.find(number);
+      if (it == bound.end() || it->second.value == nullptr)
+      {
+         // read with SQLGetData
+         return;
+      }
+      auto size = ElementSize(it->second);
+      if (size <= 0)
+      {
+         return;
+      }
+      columns.push_back(BlockColumn{number, it->second.targetType, size, it->second.value, it->second.strLenOrInd, {}, {}});
+      rowBytes += static_cast<SQLULEN>(size) + sizeof(SQLLEN);
+   }
+
+   SQLULEN blockSize = 1;
+   {
+      std::lock_guard lock(profileLock);
+      auto &profile = GetProfile(state);
+      profile.rowBytes = rowBytes;
+      blockSize = ChooseBlockSize(profile);
+   }
+   if (blockSize < 2)
+   {
+      return;
+   }
+
+   for (auto &column : columns)
+   {
+      column.values.resize(blockSize * static_cast<size_t>(column.elementSize));
+      column.indicators.resize(blockSize);
+   }
+   state.columns = std::move(columns);
+   state.rowStatus.assign(blockSize, SQL_ROW_NOROW);
+   state.blockSize = blockSize;
+   state.rowsFetched = 0;
+   state.nextRow = 0;
+   // from here Restore undoes what the driver accepted
+   state.engaged = true;
+
+   bool accepted = SQL_SUCCEEDED(setStmtAttr(route.handle, SQL_ATTR_ROW_ARRAY_SIZE, reinterpret_cast<SQLPOINTER>(blockSize), 0)) &&
+                   SQL_SUCCEEDED(setStmtAttr(route.handle, SQL_ATTR_ROWS_FETCHED_PTR, &state.rowsFetched, 0)) &&
+                   SQL_SUCCEEDED(setStmtAttr(route.handle, SQL_ATTR_ROW_STATUS_PTR, state.rowStatus.data(), 0));
+   for (auto &column : state.columns)
+   {
+      accepted = accepted && SQL_SUCCEEDED(bindCol(route.handle, column.number, column.targetType, column.values.data(), column.elementSize, column.indicators.data()));
+   }
+   if (!accepted)
+   {
+      std::print(LOG, "Block fetch refused by the driver on {}", route.record->handle);
+      Restore(route, state);
+   }
+}
+
+// driver diagnostics of a block by the row they belong to, the ones without a row number go to its first row. Must be
+// called with the state lock held
+void ReadBlockDiagnostics(const Route &route, BlockFetch &state)
+{
+   auto getDiagRec = route.driver->Get<OdbcFunctionId::SQLGetDiagRecW>();
+   auto getDiagField = route.driver->Get<OdbcFunctionId::SQLGetDiagFieldW>();
+   if (getDiagRec == nullptr || getDiagField == nullptr)
+   {
+      return;
+   }
+   for (SQLSMALLINT record = 1; record <= kMaxBlockDiagnostics; ++record)
+   {
+      SQLWCHAR sqlState[6]{};
+      SQLINTEGER nativeError = 0;
+      SQLWCHAR message[SQL_MAX_MESSAGE_LENGTH]{};
+      SQLSMALLINT messageLength = 0;
+      if (!SQL_SUCCEEDED(getDiagRec(SQL_HANDLE_STMT, route.handle, record, sqlState, &nativeError, message, static_cast<SQLSMALLINT>(std::size(message)), &messageLength)))
+      {
+         break;
+      }
+      SQLLEN rowNumber = SQL_ROW_NUMBER_UNKNOWN;
+      getDiagField(SQL_HANDLE_STMT, route.handle, record, SQL_DIAG_ROW_NUMBER, &rowNumber, SQL_IS_INTEGER, nullptr);
+      auto row = rowNumber >= 1 && static_cast<SQLULEN>(rowNumber) <= state.rowsFetched ? static_cast<SQLULEN>(rowNumber) - 1 : 0;
+      auto rowStatus = state.rowStatus[row];
+      state.rowDiagnostics.emplace_back(row, PostedDiagnostic{reinterpret_cast<const wchar_t *>(sqlState), nativeError,
+                                                              std::wstring(reinterpret_cast<const wchar_t *>(message), std::clamp<SQLSMALLINT>(messageLength, 0, static_cast<SQLSMALLINT>(std::size(message)) - 1)),
+                                                              rowStatus == SQL_ROW_ERROR ? SQLRETURN{SQL_ERROR} : SQLRETURN{SQL_SUCCESS_WITH_INFO}});
+   }
+}
+
+// must be called with the state lock held
+SQLRETURN FetchBlock(const Route &route, BlockFetch &state, const std::function<SQLRETURN()> &fetch)
+{
+   state.rowsFetched = 0;
+   state.nextRow = 0;
+   state.rowDiagnostics.clear();
+   auto start = CycleClock::now();
+   auto result = fetch();
+   auto duration = CycleClock::now() - start;
+   if (result == SQL_STILL_EXECUTING)
+   {
+      return result;
+   }
+
+   if (SQL_SUCCEEDED(result) && state.rowsFetched == 0)
+   {
+      result = SQL_NO_DATA;
+   }
+   RecordFetch(state, duration, state.rowsFetched == state.blockSize);
+   if (!SQL_SUCCEEDED(result))
+   {
+      // end of the result or error, the following fetches go to the driver
+      EndResult(state);
+      Restore(route, state);
+      return result;
+   }
+   state.resultRows += state.rowsFetched;
+   if (result == SQL_SUCCESS_WITH_INFO)
+   {
+      // rows in error or with warnings, their diagnostics are served when they are copied
+      ReadBlockDiagnostics(route, state);
+   }
+   return result;
+}
+
+// copy the next row of the block to the application buffers, must be called with the state lock held
+SQLRETURN CopyRow(HandleRecord &statement, BlockFetch &state)
+{
+   auto row = state.nextRow++;
+   // the driver diagnostics are the ones of the whole block, only the records of the row are served
+   HideDriverDiagnostics(statement);
+   auto postRowDiagnostics = [&]
+   {
+      for (auto &[number, diagnostic] : state.rowDiagnostics)
+      {
+         if (number == row)
+         {
+            AppendDriverDiagnostic(statement, diagnostic);
+         }
+      }
+   };
+   if (state.rowStatus[row] == SQL_ROW_ERROR)
+   {
+      if (std::ranges::find(state.rowDiagnostics, row, [](const auto &entry)
+                            { return entry.first; }) == state.rowDiagnostics.end())
+      {
+         PostDiagnostic(statement, SQL_ERROR, L"HY000", std::format(L"Error in row {} of the block fetched by the detour, the driver gave no diagnostic", row + 1));
+      }
+      postRowDiagnostics();
+      return SQL_ERROR;
+   }
+
+   SQLRETURN result = state.rowStatus[row] == SQL_ROW_SUCCESS_WITH_INFO ? SQL_SUCCESS_WITH_INFO : SQL_SUCCESS;
+   for (auto &column : state.columns)
+   {
+      auto indicator = column.indicators[row];
+      if (indicator == SQL_NULL_DATA && column.strLenOrInd == nullptr)
+      {
+         PostDiagnostic(statement, SQL_ERROR, L"22002", L"Indicator variable required but not supplied");
+         result = SQL_ERROR;
+         continue;
+      }
+      if (column.value != nullptr && indicator != SQL_NULL_DATA)
+      {
+         std::memcpy(column.value, column.values.data() + row * static_cast<size_t>(column.elementSize), static_cast<size_t>(column.elementSize));
+      }
+      if (column.strLenOrInd != nullptr)
+      {
+         *column.strLenOrInd = indicator;
+      }
+   }
+   postRowDiagnostics();
+   return result;
+}
+
+BlockFetch &GetBlockFetch(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   if (!statement.blockFetch)
+   {
+      statement.blockFetch = std::make_unique<BlockFetch>();
+   }
+   return *statement.blockFetch;
+}
+
+BlockFetch *FindBlockFetch(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   return statement.blockFetch.get();
+}
+
+// estimate when the columns are not bound, must be called with the state lock held
+SQLULEN DescribedRowBytes(const BlockFetch &state)
+{
+   SQLULEN rowBytes = 0;
+   for (auto &[number, size] : state.describedSizes)
+   {
+      rowBytes += size;
+   }
+   return rowBytes;
+}
+} // namespace
+
+bool BlockFetchEnabled()
+{
+   static const bool enabled = GetSettingBool("BLOCK_FETCH", false);
+   return enabled;
+}
+
+bool FetchProfilingEnabled()
+{
+   static const bool enabled = BlockFetchEnabled() || GetSettingBool("FETCH_PROFILE", false);
+   return enabled;
+}
+
+SQLRETURN FetchRow(const Route &route, const std::function<SQLRETURN()> &fetch)
+{
+   if (!route.record || route.driver == nullptr || !FetchProfilingEnabled())
+   {
+      return fetch();
+   }
+
+   auto &state = GetBlockFetch(*route.record);
+   std::lock_guard lock(state.lock);
+   if (!state.decided)
+   {
+      state.decided = true;
+      state.resultOpen = true;
+      state.resultRows = 0;
+      state.resultFetches = 0;
+      state.resultFetchTime = {};
+      state.resultFullBlocks = 0;
+      state.resultFullBlockTime = {};
+      state.resultRowBytes = 0;
+      state.fingerprint = route.record->sqlFingerprint.load(std::memory_order_relaxed);
+      state.statement = GetStatementText(*route.record).substr(0, kMaxStatementText);
+      if (BlockFetchEnabled() && state.applicationAttributes == 0)
+      {
+         Engage(route, state);
+      }
+      if (!state.engaged)
+      {
+         auto columns = GetStatementColumns(*route.record);
+         for (auto &[number, column] : columns)
+         {
+            state.resultRowBytes += static_cast<SQLULEN>(std::max<SQLLEN>(ElementSize(column), 0)) + sizeof(SQLLEN);
+         }
+         if (state.resultRowBytes == 0)
+         {
+            state.resultRowBytes = DescribedRowBytes(state);
+         }
+      }
+   }
+
+   if (state.engaged)
+   {
+      if (state.nextRow >= state.rowsFetched)
+      {
+         if (auto result = FetchBlock(route, state, fetch); !SQL_SUCCEEDED(result))
+         {
+            return result;
+         }
+      }
+      return CopyRow(*route.record, state);
+   }
+
+   auto start = CycleClock::now();
+   auto result = fetch();
+   auto duration = CycleClock::now() - start;
+   if (result == SQL_STILL_EXECUTING)
+   {
+      return result;
+   }
+   if (SQL_SUCCEEDED(result))
+   {
+      state.resultRows += state.applicationRowsFetched != nullptr ? *state.applicationRowsFetched : state.applicationRowArraySize;
+   }
+   RecordFetch(state, duration, false);
+   if (result == SQL_NO_DATA)
+   {
+      EndResult(state);
+   }
+   return result;
+}
+
+SQLRETURN BindColumn(const Route &route, SQLUSMALLINT number, const BoundColumn &column, const std::function<SQLRETURN()> &bind)
+{
+   if (route.record && FetchProfilingEnabled())
+   {
+      if (auto state = FindBlockFetch(*route.record); state != nullptr)
+      {
+         std::lock_guard lock(state->lock);
+         if (state->engaged)
+         {
+            auto it = std::ranges::find(state->columns, number, &BlockColumn::number);
+            if (it != state->columns.end())
+            {
+               if (column.value != nullptr && (column.targetType != it->targetType || ElementSize(column) != it->elementSize))
+               {
+                  ClearPostedDiagnostics(*route.record);
+                  PostDiagnostic(*route.record, SQL_ERROR, L"HY010", L"Column rebound with another type or length while the detour block fetches the result");
+                  return SQL_ERROR;
+               }
+               it->value = column.value;
+               it->strLenOrInd = column.strLenOrInd;
+            }
+            ClearPostedDiagnostics(*route.record);
+            BindStatementColumn(*route.record, number, column);
+            return SQL_SUCCESS;
+         }
+      }
+   }
+
+   auto result = bind();
+   if (SQL_SUCCEEDED(result) && route.record)
+   {
+      BindStatementColumn(*route.record, number, column);
+   }
+   return result;
+}
+
+std::optional<SQLRETURN> SetFetchAttribute(const Route &route, SQLINTEGER attribute, SQLPOINTER value)
+{
+   auto bit = ApplicationAttributeBit(attribute);
+   if (bit == 0 || !route.record || !FetchProfilingEnabled())
+   {
+      return std::nullopt;
+   }
+
+   auto &state = GetBlockFetch(*route.record);
+   std::lock_guard lock(state.lock);
+   if (state.engaged)
+   {
+      ClearPostedDiagnostics(*route.record);
+      PostDiagnostic(*route.record, SQL_ERROR, L"HY011", L"Attribute cannot be set now, the detour block fetches the result");
+      return SQL_ERROR;
+   }
+   if (IsDefaultValue(attribute, value))
+   {
+      state.applicationAttributes &= ~bit;
+   }
+   else
+   {
+      state.applicationAttributes |= bit;
+   }
+   if (attribute == SQL_ATTR_ROW_ARRAY_SIZE)
+   {
+      state.applicationRowArraySize = std::max<SQLULEN>(1, reinterpret_cast<SQLULEN>(value));
+   }
+   else if (attribute == SQL_ATTR_ROWS_FETCHED_PTR)
+   {
+      state.applicationRowsFetched = static_cast<SQLULEN *>(value);
+   }
+   return std::nullopt;
+}
+
+std::optional<SQLRETURN> GetFetchAttribute(const Route &route, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER *length)
+{
+   if (!route.record || value == nullptr || !FetchProfilingEnabled() ||
+       (attribute != SQL_ATTR_ROW_ARRAY_SIZE && attribute != SQL_ATTR_ROWS_FETCHED_PTR && attribute != SQL_ATTR_ROW_STATUS_PTR))
+   {
+      return std::nullopt;
+   }
+   auto state = FindBlockFetch(*route.record);
+   if (state == nullptr)
+   {
+      return std::nullopt;
+   }
+
+   std::lock_guard lock(state->lock);
+   if (!state->engaged)
+   {
+      return std::nullopt;
+   }
+   // the application never set them, or the result would not be block fetched
+   if (attribute == SQL_ATTR_ROW_ARRAY_SIZE)
+   {
+      *static_cast<SQLULEN *>(value) = 1;
+   }
+   else
+   {
+      *static_cast<SQLPOINTER *>(value) = nullptr;
+   }
+   if (length != nullptr)
+   {
+      *length = sizeof(SQLULEN);
+   }
+   ClearPostedDiagnostics(*route.record);
+   return SQL_SUCCESS;
+}
+
+void RecordDescriptorChange(const Route &descriptor)
+{
+   if (!descriptor.record || !FetchProfilingEnabled() || !descriptor.record->parent || descriptor.record->parent->type != SQL_HANDLE_STMT)
+   {
+      return;
+   }
+   auto &state = GetBlockFetch(*descriptor.record->parent);
+   std::lock_guard lock(state.lock);
+   state.applicationAttributes |= kDescriptorChanged;
+}
+
+bool IsBlockFetching(const Route &route)
+{
+   if (!route.record || !BlockFetchEnabled())
+   {
+      return false;
+   }
+   auto state = FindBlockFetch(*route.record);
+   if (state == nullptr)
+   {
+      return false;
+   }
+   std::lock_guard lock(state->lock);
+   return state->engaged;
+}
+
+void RecordDescribedColumn(const Route &route, SQLUSMALLINT number, SQLULEN columnSize)
+{
+   if (!route.record || !FetchProfilingEnabled())
+   {
+      return;
+   }
+   auto &state = GetBlockFetch(*route.record);
+   std::lock_guard lock(state.lock);
+   state.describedSizes.insert_or_assign(number, columnSize);
+}
+
+void EndBlockFetch(const Route &route)
+{
+   if (!route.record || route.driver == nullptr || !FetchProfilingEnabled())
+   {
+      return;
+   }
+   auto state = FindBlockFetch(*route.record);
+   if (state == nullptr)
+   {
+      return;
+   }
+   std::lock_guard lock(state->lock);
+   EndResult(*state);
+   Restore(route, *state);
+   state->decided = false;
+}
+
+void EndStatementFetches(HandleRecord &statement)
+{
+   if (!FetchProfilingEnabled())
+   {
+      return;
+   }
+   auto state = FindBlockFetch(statement);
+   if (state == nullptr)
+   {
+      return;
+   }
+   std::lock_guard lock(state->lock);
+   EndResult(*state);
+}
+
+void LogFetchProfile()
+{
+   if (!FetchProfilingEnabled())
+   {
+      return;
+   }
+
+   std::lock_guard lock(profileLock);
+   std::vector<std::pair<uint64_t, const FetchProfile *>> sorted;
+   for (auto &[fingerprint, profile] : profiles)
+   {
+      sorted.emplace_back(fingerprint, &profile);
+   }
+   std::ranges::sort(sorted, [](auto &a, auto &b)
+                     { return a.second->rows > b.second->rows; });
+   if (sorted.size() > kReportedStatements)
+   {
+      sorted.resize(kReportedStatements);
+   }
+
+   std::string report = std::format("Fetch profile of {} statement(s), by rows fetched", profiles.size());
+   for (auto &[fingerprint, profile] : sorted)
+   {
+      auto seconds = Seconds(profile->fetchTime);
+      report += std::format("\n   {:016x} {} rows in {} driver fetches, {:.1f} rows per fetch, {:.0f} rows/s, ~{} bytes per row, rowset {}",
+                            fingerprint, profile->rows, profile->fetches,
+                            profile->fetches > 0 ? static_cast<double>(profile->rows) / static_cast<double>(profile->fetches) : 0.0,
+                            seconds > 0 ? static_cast<double>(profile->rows) / seconds : 0.0, profile->rowBytes, profile->applicationRowArraySize);
+      if (profile->chosen >= 0)
+      {
+         report += std::format(", block {} (", SQLULEN{1} << profile->chosen);
+         for (int exponent = 1; exponent <= kMaxExponent; ++exponent)
+         {
+            if (profile->sizes[exponent].blocks > 0)
+            {
+               report += std::format(" {}: {:.0f} rows/s", 1 << exponent, profile->sizes[exponent].rowsPerSecond);
+            }
+         }
+         report += " )";
+      }
+      report += std::format(": {}", profile->statement);
+   }
+   std::print(LOG, "{}", report);
+}
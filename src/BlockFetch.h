@@ -0,0 +1,111 @@
+#pragma once
+#include "Platform.h"
+#include "Routing.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// block fetching driven by the detour, enabled with ODBCDETOUR_BLOCK_FETCH=1
+//
+// applications fetching one row at a time into bound columns pay a driver call per row. For such results the detour
+// binds the columns to its own arrays, fetches the rows by blocks and copies them one by one into the application
+// buffers. The block size is tuned for each statement fingerprint: full blocks are timed and the size moves between
+// powers of two toward the best rows per second, within ODBCDETOUR_BLOCK_FETCH_KB of buffers per statement (1024 by
+// default) and never above the largest result seen. Results the application fetches by rowsets, with a scrollable
+// cursor or through SQLGetData are left alone.
+//
+// ODBCDETOUR_FETCH_PROFILE=1 only measures: rows per driver fetch, fetch latency and row width per fingerprint. The
+// profile, with the block sizes chosen, is logged when the last environment is freed.
+bool BlockFetchEnabled();
+bool FetchProfilingEnabled();
+
+// column of a block fetched result and the application buffers its values are copied to
+struct BlockColumn
+{
+   SQLUSMALLINT number;
+   SQLSMALLINT targetType;
+   // stride of values, the buffer length for variable length types
+   SQLLEN elementSize;
+   SQLPOINTER value;
+   SQLLEN *strLenOrInd;
+   std::vector<std::byte> values;
+   std::vector<SQLLEN> indicators;
+};
+
+// fetch state of a statement, see HandleRecord::blockFetch
+struct BlockFetch
+{
+   // serializes the fetch calls of the statement, taken before the record stateLock
+   std::mutex lock;
+
+   // row attributes the application set to a value other than their default, one bit each
+   uint32_t applicationAttributes = 0;
+   SQLULEN applicationRowArraySize = 1;
+   SQLULEN *applicationRowsFetched = nullptr;
+   // SQLDescribeColW column sizes, estimate of the row width when the columns are not bound
+   std::map<SQLUSMALLINT, SQLULEN> describedSizes;
+
+   // cleared when a new result is produced, the first fetch decides whether the detour block fetches it
+   bool decided = false;
+   bool resultOpen = false;
+   uint64_t fingerprint = 0;
+   std::string statement;
+   uint64_t resultRows = 0;
+   // profile of the current result, added to the one of the fingerprint when the result ends
+   uint64_t resultFetches = 0;
+   std::chrono::nanoseconds resultFetchTime{0};
+   uint64_t resultFullBlocks = 0;
+   std::chrono::nanoseconds resultFullBlockTime{0};
+   // row width estimate of a result fetched by the application itself
+   SQLULEN resultRowBytes = 0;
+
+   // driver bound to the arrays below while engaged
+   bool engaged = false;
+   SQLULEN blockSize = 0;
+   std::vector<BlockColumn> columns;
+   std::vector<SQLUSMALLINT> rowStatus;
+   // written by the driver through SQL_ATTR_ROWS_FETCHED_PTR
+   SQLULEN rowsFetched = 0;
+   SQLULEN nextRow = 0;
+   // driver diagnostics of the last block by row, posted when the row is copied
+   std::vector<std::pair<SQLULEN, PostedDiagnostic>> rowDiagnostics;
+};
+
+// SQLFetch and SQLFetchScroll(SQL_FETCH_NEXT), fetch forwards the call to the driver
+SQLRETURN FetchRow(const Route &route, const std::function<SQLRETURN()> &fetch);
+
+// SQLBindCol, bind forwards the call to the driver. While a result is block fetched the binding is only recorded for
+// the copies and replayed on the driver when the result ends, a bound column must then keep its type and length.
+SQLRETURN BindColumn(const Route &route, SQLUSMALLINT number, const BoundColumn &column, const std::function<SQLRETURN()> &bind);
+
+// SQLSetStmtAttrW, nullopt when the call must be forwarded. Row attributes are refused while a result is block fetched,
+// the driver attributes belong to the detour until the result ends
+std::optional<SQLRETURN> SetFetchAttribute(const Route &route, SQLINTEGER attribute, SQLPOINTER value);
+
+// SQLGetStmtAttrW, the application values of the row attributes while a result is block fetched
+std::optional<SQLRETURN> GetFetchAttribute(const Route &route, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER *length);
+
+// SQLSetDescFieldW and SQLSetDescRec on the implicit row descriptor of a statement, the application binds by itself
+void RecordDescriptorChange(const Route &descriptor);
+
+// true while a result is block fetched, SQLGetData is then refused
+bool IsBlockFetching(const Route &route);
+
+void RecordDescribedColumn(const Route &route, SQLUSMALLINT number, SQLULEN columnSize);
+
+// the current result ends, the driver bindings and row attributes are restored. Called before a call producing or
+// closing a result, ex: SQLExecute, SQLMoreResults, SQLCloseCursor
+void EndBlockFetch(const Route &route);
+
+// SQLFreeHandle of a statement, its open result is added to the fetch profile. The driver handle is gone, nothing is
+// restored
+void EndStatementFetches(HandleRecord &statement);
+
+void LogFetchProfile();
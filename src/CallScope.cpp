@@ -0,0 +1,61 @@
+#include "CallScope.h"
+#include "DiagnosticStats.h"
+#include "Metrics.h"
+#include "OdbcFunctions.h"
+#include "SlowCalls.h"
+#include "SpanExport.h"
+#include "TraceEvents.h"
+#include "TransactionProfiler.h"
+
+CallScope::CallScope(OdbcFunctionId function, const Route &route)
+    : m_function(OdbcFunctionName(function)), m_index(OdbcFunctionIndex(function)), m_route(route),
+      m_admission(m_index, route), m_start(CycleClock::now())
+{
+   if (MetricsEnabled())
+   {
+      RecordCallStart(m_index);
+   }
+   if (ContentionAnalysisEnabled())
+   {
+      m_contention = BeginContentionSample(m_index, m_route);
+   }
+}
+
+void CallScope::Complete(SQLRETURN result)
+{
+   auto end = CycleClock::now();
+   m_admission.Release();
+   if (MetricsEnabled())
+   {
+      if (m_admission.Queued())
+      {
+         RecordQueueWait(m_index, m_admission.Waited());
+      }
+      RecordCallEnd(m_index, end - m_start, result);
+   }
+   // sampled when the call started, the analysis may have been turned off since
+   if (m_contention.level != 0)
+   {
+      EndContentionSample(m_index, m_route, m_contention, end - m_start, m_admission.Waited());
+   }
+   if (auto threshold = SlowCallThreshold(); threshold.count() > 0 && end - m_start >= threshold)
+   {
+      CaptureSlowCall(m_function, m_route.record.get(), end - m_start, result);
+   }
+   if (DiagnosticHarvestingEnabled())
+   {
+      HarvestDiagnostics(m_function, m_route, result);
+   }
+   if (TransactionProfilingEnabled())
+   {
+      RecordTransactionStatement(m_index, m_route, end - m_start, result);
+   }
+   if (TraceEventsEnabled())
+   {
+      RecordTraceEvent(m_function, m_route.record.get(), m_start, end, result);
+   }
+   if (SpanExportEnabled())
+   {
+      RecordSpanCall(m_index, m_route, m_start, end, result);
+   }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "AdmissionControl.h"
+#include "Clock.h"
+#include "ContentionAnalyzer.h"
+#include "OdbcFunctions.h"
+#include "Platform.h"
+#include "Routing.h"
+
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+
+// instrumentation of one call forwarded to the driver, measured from construction to Complete
+//
+// the call first waits for its admission permits, the wait is reported apart from the time spent in the driver
+class CallScope
+{
+ public:
+   CallScope(OdbcFunctionId function, const Route &route);
+
+   CallScope(const CallScope &) = delete;
+   CallScope &operator=(const CallScope &) = delete;
+
+   void Complete(SQLRETURN result);
+
+ private:
+   std::string_view m_function;
+   // index in kOdbcFunctionNames
+   size_t m_index;
+   const Route &m_route;
+   // initialized before m_start, the driver time starts once admitted
+   Admission m_admission;
+   CycleClock::time_point m_start;
+   ContentionSample m_contention;
+};
@@ -0,0 +1,89 @@
+#include "Clock.h"
+
+#include <array>
+#include <format>
+
+namespace
+{
+// length of the measure of the counter frequency, its error is about 100 ns of QueryPerformanceCounter over it
+constexpr int kCalibrationDivisor = 200;
+
+// "YYYY-MM-DD HH:MM:SS." followed by the microseconds
+constexpr size_t kSecondLength = 20;
+constexpr size_t kFractionDigits = 6;
+
+struct TimestampCache
+{
+   // second formatted in text, as readings of the clock
+   CycleClock::time_point secondStart = CycleClock::time_point::max();
+   CycleClock::time_point secondEnd = CycleClock::time_point::min();
+   std::array<char, kSecondLength + kFractionDigits> text{};
+};
+
+thread_local TimestampCache timestampCache;
+
+void FormatSecond(TimestampCache &cache, CycleClock::time_point time)
+{
+   using namespace std::chrono;
+   // the wall clock time of the reading, from a pair of readings taken together
+   auto wall = system_clock::now() + (time - CycleClock::now());
+   auto second = floor<seconds>(wall);
+   cache.secondStart = time - duration_cast<CycleClock::duration>(wall - second);
+   cache.secondEnd = cache.secondStart + seconds(1);
+   auto local = current_zone()->to_local(second);
+   std::format_to_n(cache.text.data(), kSecondLength, "{:%Y-%m-%d %H:%M:%S}.", local);
+}
+} // namespace
+
+CycleCalibration CycleCalibration::Calibrate() noexcept
+{
+   LARGE_INTEGER frequency;
+   QueryPerformanceFrequency(&frequency);
+   CycleCalibration performanceCounter{false, ReadCycleTicks(false), 1e9 / static_cast<double>(frequency.QuadPart)};
+
+   // bit 8 of edx in the extended leaf 0x80000007
+   int registers[4];
+   __cpuid(registers, 0x80000000);
+   if (static_cast<unsigned>(registers[0]) < 0x80000007)
+   {
+      return performanceCounter;
+   }
+   __cpuid(registers, 0x80000007);
+   if ((registers[3] & (1 << 8)) == 0)
+   {
+      return performanceCounter;
+   }
+
+   LARGE_INTEGER start;
+   LARGE_INTEGER end;
+   QueryPerformanceCounter(&start);
+   auto startTicks = __rdtsc();
+   do
+   {
+      YieldProcessor();
+      QueryPerformanceCounter(&end);
+   } while (end.QuadPart - start.QuadPart < frequency.QuadPart / kCalibrationDivisor);
+   auto endTicks = __rdtsc();
+   if (endTicks <= startTicks)
+   {
+      return performanceCounter;
+   }
+   auto nanos = static_cast<double>(end.QuadPart - start.QuadPart) * 1e9 / static_cast<double>(frequency.QuadPart);
+   return {true, startTicks, nanos / static_cast<double>(endTicks - startTicks)};
+}
+
+std::string_view FormatLogTimestamp(CycleClock::time_point time)
+{
+   auto &cache = timestampCache;
+   if (time < cache.secondStart || time >= cache.secondEnd)
+   {
+      FormatSecond(cache, time);
+   }
+   auto micros = std::chrono::duration_cast<std::chrono::microseconds>(time - cache.secondStart).count();
+   for (size_t i = cache.text.size(); i > kSecondLength; --i)
+   {
+      cache.text[i - 1] = static_cast<char>('0' + micros % 10);
+      micros /= 10;
+   }
+   return {cache.text.data(), cache.text.size()};
+}
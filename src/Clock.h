@@ -0,0 +1,65 @@
+#pragma once
+#include "Platform.h"
+
+#include <chrono>
+#include <cstdint>
+#include <intrin.h>
+#include <string_view>
+
+// monotonic clock reading the time stamp counter of the processor, a few nanoseconds per reading where steady_clock
+// goes through QueryPerformanceCounter. Used to time the calls and the log lines, the readings are only converted to
+// wall clock time when written
+struct CycleClock
+{
+   using rep = int64_t;
+   using period = std::nano;
+   using duration = std::chrono::nanoseconds;
+   using time_point = std::chrono::time_point<CycleClock>;
+   static constexpr bool is_steady = true;
+
+   static time_point now() noexcept;
+};
+
+// scale of the counter, measured once against QueryPerformanceCounter on the first reading. Processors without an
+// invariant time stamp counter, ex: some virtual machines, read QueryPerformanceCounter instead
+struct CycleCalibration
+{
+   // the time stamp counter runs at a constant rate on every core and through power states
+   bool invariantCounter;
+   // reading of the calibration, CycleClock starts there
+   uint64_t originTicks;
+   double nanosPerTick;
+
+   static const CycleCalibration &Get() noexcept
+   {
+      static const CycleCalibration calibration = Calibrate();
+      return calibration;
+   }
+
+ private:
+   static CycleCalibration Calibrate() noexcept;
+};
+
+inline uint64_t ReadCycleTicks(bool invariantCounter) noexcept
+{
+   if (invariantCounter)
+   {
+      return __rdtsc();
+   }
+   LARGE_INTEGER counter;
+   QueryPerformanceCounter(&counter);
+   return static_cast<uint64_t>(counter.QuadPart);
+}
+
+inline CycleClock::time_point CycleClock::now() noexcept
+{
+   const auto &calibration = CycleCalibration::Get();
+   auto ticks = ReadCycleTicks(calibration.invariantCounter) - calibration.originTicks;
+   return time_point(duration(static_cast<rep>(static_cast<double>(ticks) * calibration.nanosPerTick)));
+}
+
+// "YYYY-MM-DD HH:MM:SS.ffffff" local time of a reading, valid until the next call on the thread
+//
+// the date and time are formatted once per second and thread, the system clock is read again then so the counter
+// never drifts from it by more than its calibration error over one second
+std::string_view FormatLogTimestamp(CycleClock::time_point time);
@@ -0,0 +1,75 @@
+#include "ConnectionString.h"
+
+#include <algorithm>
+#include <cwctype>
+
+namespace
+{
+std::wstring_view Trim(std::wstring_view str)
+{
+   while (!str.empty() && std::iswspace(str.front()))
+   {
+      str.remove_prefix(1);
+   }
+   while (!str.empty() && std::iswspace(str.back()))
+   {
+      str.remove_suffix(1);
+   }
+   return str;
+}
+
+bool EqualsNoCase(std::wstring_view lhs, std::wstring_view rhs)
+{
+   return std::ranges::equal(lhs, rhs, [](wchar_t a, wchar_t b)
+                             { return std::towupper(a) == std::towupper(b); });
+}
+} // namespace
+
+std::optional<std::wstring> GetConnectionAttribute(std::wstring_view connectionString, std::wstring_view key)
+{
+   size_t pos = 0;
+   while (pos < connectionString.size())
+   {
+      auto equal = connectionString.find(L'=', pos);
+      if (equal == std::wstring_view::npos)
+      {
+         break;
+      }
+      auto name = Trim(connectionString.substr(pos, equal - pos));
+
+      // value is either {braced} and may contain ';' or runs up to the next ';'
+      auto valueStart = equal + 1;
+      while (valueStart < connectionString.size() && std::iswspace(connectionString[valueStart]))
+      {
+         ++valueStart;
+      }
+      std::wstring_view value;
+      size_t next = 0;
+      if (valueStart < connectionString.size() && connectionString[valueStart] == L'{')
+      {
+         auto close = connectionString.find(L'}', valueStart + 1);
+         if (close == std::wstring_view::npos)
+         {
+            close = connectionString.size();
+         }
+         value = connectionString.substr(valueStart + 1, close - valueStart - 1);
+         next = connectionString.find(L';', close);
+      }
+      else
+      {
+         next = connectionString.find(L';', valueStart);
+         value = Trim(connectionString.substr(valueStart, next == std::wstring_view::npos ? std::wstring_view::npos : next - valueStart));
+      }
+
+      if (EqualsNoCase(name, key))
+      {
+         return std::wstring(value);
+      }
+      if (next == std::wstring_view::npos)
+      {
+         break;
+      }
+      pos = next + 1;
+   }
+   return std::nullopt;
+}
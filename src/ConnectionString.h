@@ -0,0 +1,8 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+
+// value of an attribute in a connection string: "DSN=name;DBQ={c:\a;b.accdb}"
+// keys are case insensitive and braces around a value are removed
+std::optional<std::wstring> GetConnectionAttribute(std::wstring_view connectionString, std::wstring_view key);
@@ -0,0 +1,287 @@
+#include "ContentionAnalyzer.h"
+#include "Driver.h"
+#include "Logging.h"
+#include "OdbcFunctions.h"
+#include "Settings.h"
+#include "StringConversion.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <format>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <shared_mutex>
+#include <string>
+
+namespace
+{
+// concurrency levels 1, 2, 3-4, 5-8, 9-16, 17-32, 33+
+constexpr size_t kLevelBuckets = 7;
+constexpr std::array<const char *, kLevelBuckets> kLevelNames = {"1", "2", "3-4", "5-8", "9-16", "17-32", "33+"};
+// samples needed before a bucket is used in a verdict
+constexpr uint64_t kMinSamples = 20;
+
+size_t LevelBucket(uint32_t level)
+{
+   return std::min<size_t>(std::bit_width(std::max<uint32_t>(level, 1) - 1), kLevelBuckets - 1);
+}
+
+struct LevelStats
+{
+   uint64_t calls = 0;
+   uint64_t levelSum = 0;
+   uint64_t totalNanoseconds = 0;
+};
+
+struct FunctionContention
+{
+   uint64_t calls = 0;
+   // calls that ran while another call was in the driver
+   uint64_t overlapped = 0;
+   std::array<LevelStats, kLevelBuckets> levels{};
+};
+
+struct DriverContention
+{
+   // copied, the driver may be unloaded when the report is written
+   std::string path;
+   std::atomic<uint32_t> inFlight{0};
+   std::atomic<uint64_t> startCount{0};
+
+   // protected by lock, the analysis is opt-in and the critical sections only update counters
+   std::mutex lock;
+   uint32_t maxInFlight = 0;
+   uint64_t totalCallNanoseconds = 0;
+   uint64_t totalWaitNanoseconds = 0;
+   std::chrono::steady_clock::time_point firstStart{};
+   std::chrono::steady_clock::time_point lastEnd{};
+   std::array<FunctionContention, kOdbcFunctionCount> functions{};
+   // calls in flight per connection and per handle, entries are removed when they drop to 0
+   std::map<SQLHANDLE, uint32_t> connections;
+   std::map<SQLHANDLE, uint32_t> handles;
+   uint32_t maxPerConnection = 0;
+   // calls started on a handle already used by another thread
+   uint64_t sharedHandleCalls = 0;
+};
+
+std::shared_mutex driversLock;
+// by driver address, a driver loaded again after being unloaded may reuse an entry
+std::map<const Driver *, std::unique_ptr<DriverContention>> drivers;
+
+std::atomic<uint32_t> threadCount{0};
+
+DriverContention &GetDriverContention(const Driver *driver)
+{
+   {
+      std::shared_lock lock(driversLock);
+      if (auto it = drivers.find(driver); it != drivers.end())
+      {
+         return *it->second;
+      }
+   }
+   std::unique_lock lock(driversLock);
+   auto &entry = drivers[driver];
+   if (!entry)
+   {
+      entry = std::make_unique<DriverContention>();
+      entry->path = ToUtf8(driver->Path());
+   }
+   return *entry;
+}
+
+SQLHANDLE ConnectionOf(const Route &route)
+{
+   if (!route.record)
+   {
+      return SQL_NULL_HANDLE;
+   }
+   if (route.record->type == SQL_HANDLE_DBC || !route.record->parent)
+   {
+      return route.record->handle;
+   }
+   return route.record->parent->handle;
+}
+
+double Milliseconds(uint64_t nanoseconds)
+{
+   return static_cast<double>(nanoseconds) / 1e6;
+}
+
+std::string FunctionReport(std::string_view name, const FunctionContention &function)
+{
+   auto &single = function.levels[0];
+   std::string report = std::format("\n      {}: {} calls, {} overlapped, latency by concurrency", name, function.calls, function.overlapped);
+   for (size_t bucket = 0; bucket < kLevelBuckets; ++bucket)
+   {
+      auto &level = function.levels[bucket];
+      if (level.calls > 0)
+      {
+         report += std::format(" {}: {:.3f} ms ({})", kLevelNames[bucket], Milliseconds(level.totalNanoseconds) / static_cast<double>(level.calls), level.calls);
+      }
+   }
+
+   // parallelism reached at level k: k calls served in the time of 1 would be perfect scaling
+   if (single.calls < kMinSamples || single.totalNanoseconds == 0)
+   {
+      return report;
+   }
+   auto singleLatency = static_cast<double>(single.totalNanoseconds) / static_cast<double>(single.calls);
+   double parallelism = 1.0;
+   double growth = 1.0;
+   bool concurrentSamples = false;
+   for (size_t bucket = 1; bucket < kLevelBuckets; ++bucket)
+   {
+      auto &level = function.levels[bucket];
+      if (level.calls < kMinSamples || level.totalNanoseconds == 0)
+      {
+         continue;
+      }
+      concurrentSamples = true;
+      auto latency = static_cast<double>(level.totalNanoseconds) / static_cast<double>(level.calls);
+      auto meanLevel = static_cast<double>(level.levelSum) / static_cast<double>(level.calls);
+      parallelism = std::max(parallelism, meanLevel * singleLatency / latency);
+      growth = latency / singleLatency;
+   }
+   if (concurrentSamples)
+   {
+      report += std::format(", latency growth x{:.1f}, effective parallelism {:.2f}{}", growth, parallelism, parallelism < 1.5 ? " -> serialized" : "");
+   }
+   return report;
+}
+} // namespace
+
+bool ContentionAnalysisEnabled()
+{
+   return CurrentSettings().contention;
+}
+
+ContentionSample BeginContentionSample(size_t function, const Route &route)
+{
+   thread_local bool counted = false;
+   if (!counted)
+   {
+      counted = true;
+      threadCount.fetch_add(1, std::memory_order_relaxed);
+   }
+   if (route.driver == nullptr || function >= kOdbcFunctionCount)
+   {
+      return {};
+   }
+
+   auto &driver = GetDriverContention(route.driver);
+   ContentionSample sample;
+   sample.startCount = driver.startCount.fetch_add(1, std::memory_order_relaxed) + 1;
+   sample.level = driver.inFlight.fetch_add(1, std::memory_order_relaxed) + 1;
+
+   std::lock_guard lock(driver.lock);
+   if (driver.firstStart == std::chrono::steady_clock::time_point{})
+   {
+      driver.firstStart = std::chrono::steady_clock::now();
+   }
+   driver.maxInFlight = std::max(driver.maxInFlight, sample.level);
+   if (auto connection = ConnectionOf(route); connection != SQL_NULL_HANDLE)
+   {
+      driver.maxPerConnection = std::max(driver.maxPerConnection, ++driver.connections[connection]);
+   }
+   if (route.record)
+   {
+      driver.sharedHandleCalls += ++driver.handles[route.record->handle] > 1 ? 1 : 0;
+   }
+   return sample;
+}
+
+void EndContentionSample(size_t function, const Route &route, const ContentionSample &sample, std::chrono::nanoseconds duration,
+                         std::chrono::nanoseconds queueWait)
+{
+   if (sample.level == 0)
+   {
+      return;
+   }
+
+   auto &driver = GetDriverContention(route.driver);
+   driver.inFlight.fetch_sub(1, std::memory_order_relaxed);
+   bool overlapped = sample.level > 1 || driver.startCount.load(std::memory_order_relaxed) != sample.startCount;
+
+   auto nanoseconds = static_cast<uint64_t>(std::max<long long>(0, duration.count()));
+   std::lock_guard lock(driver.lock);
+   driver.lastEnd = std::chrono::steady_clock::now();
+   driver.totalCallNanoseconds += nanoseconds;
+   driver.totalWaitNanoseconds += static_cast<uint64_t>(std::max<long long>(0, queueWait.count()));
+
+   auto &stats = driver.functions[function];
+   ++stats.calls;
+   stats.overlapped += overlapped ? 1 : 0;
+   auto &level = stats.levels[LevelBucket(sample.level)];
+   ++level.calls;
+   level.levelSum += sample.level;
+   level.totalNanoseconds += nanoseconds;
+
+   auto leave = [](std::map<SQLHANDLE, uint32_t> &inFlight, SQLHANDLE handle)
+   {
+      if (auto it = inFlight.find(handle); it != inFlight.end() && --it->second == 0)
+      {
+         inFlight.erase(it);
+      }
+   };
+   if (auto connection = ConnectionOf(route); connection != SQL_NULL_HANDLE)
+   {
+      leave(driver.connections, connection);
+   }
+   if (route.record)
+   {
+      leave(driver.handles, route.record->handle);
+   }
+}
+
+void LogContentionReport()
+{
+   if (!ContentionAnalysisEnabled())
+   {
+      return;
+   }
+
+   std::string report = std::format("Contention report, {} application threads", threadCount.load(std::memory_order_relaxed));
+   std::shared_lock driversGuard(driversLock);
+   for (auto &[key, driverStats] : drivers)
+   {
+      auto &driver = *driverStats;
+      std::lock_guard lock(driver.lock);
+      auto observed = std::chrono::duration_cast<std::chrono::nanoseconds>(driver.lastEnd - driver.firstStart).count();
+      if (observed <= 0)
+      {
+         continue;
+      }
+
+      report += std::format("\n   driver {}: observed {:.3f} s, average in flight {:.2f}, average waiting for admission {:.2f}, max in flight {}",
+                            driver.path, static_cast<double>(observed) / 1e9,
+                            static_cast<double>(driver.totalCallNanoseconds) / static_cast<double>(observed),
+                            static_cast<double>(driver.totalWaitNanoseconds) / static_cast<double>(observed), driver.maxInFlight);
+
+      std::string neverOverlapping;
+      for (size_t i = 0; i < kOdbcFunctionCount; ++i)
+      {
+         auto &function = driver.functions[i];
+         if (function.calls == 0)
+         {
+            continue;
+         }
+         report += FunctionReport(kOdbcFunctionNames[i], function);
+         if (function.overlapped == 0 && function.calls >= kMinSamples && driver.maxInFlight > 1)
+         {
+            neverOverlapping += std::format(" {} ({})", kOdbcFunctionNames[i], function.calls);
+         }
+      }
+      if (!neverOverlapping.empty())
+      {
+         report += "\n      never overlapping another call:" + neverOverlapping;
+      }
+
+      report += std::format("\n      max concurrent calls on one connection {}, {} call(s) on a handle already in use by another thread",
+                            driver.maxPerConnection, driver.sharedHandleCalls);
+   }
+   std::print(LOG, "{}", report);
+}
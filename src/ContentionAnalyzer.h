@@ -0,0 +1,30 @@
+#pragma once
+#include "Platform.h"
+#include "Routing.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// evidence of serialization inside the driver, enabled with ODBCDETOUR_CONTENTION=1
+//
+// calls are counted per driver, function, connection and handle together with the number of calls in flight in the
+// driver when they started. The report compares the latency of each function at increasing concurrency: a latency
+// growing as fast as the concurrency means the driver runs the calls one at a time, adding threads or connections can
+// not help. Averages over time use Little's law: total call time divided by the observed wall time.
+bool ContentionAnalysisEnabled();
+
+struct ContentionSample
+{
+   // calls in flight in the driver when the call started, itself included
+   uint32_t level = 0;
+   // calls started in the driver before this one, a different value at the end means another call overlapped
+   uint64_t startCount = 0;
+};
+
+ContentionSample BeginContentionSample(size_t function, const Route &route);
+void EndContentionSample(size_t function, const Route &route, const ContentionSample &sample, std::chrono::nanoseconds duration,
+                         std::chrono::nanoseconds queueWait);
+
+// write the report to the log
+void LogContentionReport();
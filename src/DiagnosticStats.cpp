@@ -0,0 +1,155 @@
+#include "DiagnosticStats.h"
+#include "Driver.h"
+#include "Logging.h"
+#include "Settings.h"
+#include "StringConversion.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <format>
+#include <map>
+#include <mutex>
+#include <print>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+// records read after one call, drivers may post one per row of a block fetch
+constexpr SQLSMALLINT kMaxRecordsPerCall = 64;
+
+struct DiagnosticKey
+{
+   std::string sqlState;
+   SQLINTEGER nativeError;
+   std::string messageTemplate;
+
+   auto operator<=>(const DiagnosticKey &) const = default;
+};
+
+struct DiagnosticCount
+{
+   uint64_t count = 0;
+   std::chrono::system_clock::time_point firstSeen;
+   std::chrono::system_clock::time_point lastSeen;
+   // function of the last occurrence and one message before templating
+   std::string function;
+   std::string example;
+};
+
+std::mutex statsLock;
+std::map<DiagnosticKey, DiagnosticCount> stats;
+
+// replace the parts of a message that change between occurrences: numbers and quoted values
+std::string MessageTemplate(std::string_view message)
+{
+   std::string result;
+   for (size_t i = 0; i < message.size();)
+   {
+      auto c = message[i];
+      if (c == '\'' || c == '"')
+      {
+         auto end = message.find(c, i + 1);
+         if (end != std::string_view::npos)
+         {
+            result += c;
+            result += '?';
+            result += c;
+            i = end + 1;
+            continue;
+         }
+      }
+      if (std::isdigit(static_cast<unsigned char>(c)))
+      {
+         result += '#';
+         while (i < message.size() && std::isdigit(static_cast<unsigned char>(message[i])))
+         {
+            ++i;
+         }
+         continue;
+      }
+      result += c;
+      ++i;
+   }
+   return result;
+}
+} // namespace
+
+bool DiagnosticHarvestingEnabled()
+{
+   return CurrentSettings().diagnostics;
+}
+
+void HarvestDiagnostics(std::string_view function, const Route &route, SQLRETURN result)
+{
+   if (result != SQL_ERROR && result != SQL_SUCCESS_WITH_INFO)
+   {
+      return;
+   }
+   // the handle is gone after a free, and reading diagnostics must not be harvested itself
+   if (route.driver == nullptr || !route.record || function.starts_with("SQLFree") || function.starts_with("SQLGetDiag"))
+   {
+      return;
+   }
+   auto getDiagRec = route.driver->Get<OdbcFunctionId::SQLGetDiagRecW>();
+   if (getDiagRec == nullptr)
+   {
+      return;
+   }
+
+   auto now = std::chrono::system_clock::now();
+   for (SQLSMALLINT record = 1; record <= kMaxRecordsPerCall; ++record)
+   {
+      SQLWCHAR sqlState[6]{};
+      SQLINTEGER nativeError = 0;
+      SQLWCHAR message[SQL_MAX_MESSAGE_LENGTH]{};
+      SQLSMALLINT messageLength = 0;
+      auto rc = getDiagRec(route.record->type, route.handle, record, sqlState, &nativeError, message, static_cast<SQLSMALLINT>(std::size(message)), &messageLength);
+      if (!SQL_SUCCEEDED(rc))
+      {
+         break;
+      }
+
+      auto text = ReadString(reinterpret_cast<const wchar_t *>(message), std::min<int>(messageLength, static_cast<int>(std::size(message)) - 1));
+      DiagnosticKey key{ReadString(reinterpret_cast<const wchar_t *>(sqlState), SQL_NTS), nativeError, MessageTemplate(text)};
+
+      std::lock_guard lock(statsLock);
+      auto [it, inserted] = stats.try_emplace(std::move(key));
+      auto &count = it->second;
+      if (inserted)
+      {
+         count.firstSeen = now;
+         count.example = text;
+         std::print(LOG, "New diagnostic {} ({}) from {}: {}", it->first.sqlState, nativeError, function, text);
+      }
+      ++count.count;
+      count.lastSeen = now;
+      count.function = function;
+   }
+}
+
+void LogDiagnosticStats()
+{
+   std::vector<std::pair<DiagnosticKey, DiagnosticCount>> sorted;
+   {
+      std::lock_guard lock(statsLock);
+      sorted.assign(stats.begin(), stats.end());
+   }
+   if (sorted.empty())
+   {
+      return;
+   }
+   std::ranges::sort(sorted, [](auto &a, auto &b)
+                     { return a.second.count > b.second.count; });
+
+   std::string report = "Diagnostics by SQLSTATE, native error and message:";
+   for (auto &[key, count] : sorted)
+   {
+      report += std::format("\n   {} x{} native {} first {:%F %T} last {:%F %T} last in {}: {}", key.sqlState, count.count, key.nativeError,
+                            std::chrono::floor<std::chrono::milliseconds>(count.firstSeen), std::chrono::floor<std::chrono::milliseconds>(count.lastSeen),
+                            count.function, key.messageTemplate);
+   }
+   std::print(LOG, "{}", report);
+}
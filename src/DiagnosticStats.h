@@ -0,0 +1,17 @@
+#pragma once
+#include "Platform.h"
+#include "Routing.h"
+
+#include <string_view>
+
+// harvesting of the diagnostic records posted by the driver, enabled with ODBCDETOUR_DIAGNOSTICS=1
+//
+// after a call returning SQL_ERROR or SQL_SUCCESS_WITH_INFO the records are read from the driver directly. Reading
+// diagnostics does not clear them, the application still sees all of them. Records are counted by SQLSTATE, native
+// error and message template (numbers and quoted values removed), so a warning repeated on every row is one entry.
+bool DiagnosticHarvestingEnabled();
+
+void HarvestDiagnostics(std::string_view function, const Route &route, SQLRETURN result);
+
+// write the aggregated counters to the log, most frequent first
+void LogDiagnosticStats();
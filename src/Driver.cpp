@@ -0,0 +1,195 @@
+#include "Driver.h"
+#include "AdmissionControl.h"
+#include "ConnectionString.h"
+#include "Logging.h"
+#include "Settings.h"
+#include "StringConversion.h"
+
+#include <cwctype>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <print>
+
+namespace
+{
+// used without TargetDriver attribute nor TARGET_DRIVER setting
+constexpr auto defaultTargetDriver = LR"(C:\Program Files\Microsoft Office\root\VFS\ProgramFilesCommonX64\Microsoft Shared\Office16\ACEODBC.DLL)";
+
+struct LoadedDriver
+{
+   std::unique_ptr<Driver> driver;
+   int refCount = 0;
+};
+
+// serialize loading and unloading, the forwarding path never takes it
+std::mutex lifecycleLock;
+// loaded drivers by upper case path, protected by lifecycleLock
+std::map<std::wstring, LoadedDriver> loadedDrivers;
+
+std::mutex dsnCacheLock;
+// TargetDriver attribute of each data source already looked up, by upper case DSN, empty when it has none
+std::map<std::wstring, std::wstring> dsnTargets;
+
+std::wstring ToUpper(std::wstring_view str)
+{
+   std::wstring result(str);
+   for (auto &c : result)
+   {
+      c = static_cast<wchar_t>(std::towupper(c));
+   }
+   return result;
+}
+
+std::wstring ReadProfileString(const std::wstring &section, const wchar_t *key, const wchar_t *file)
+{
+   wchar_t buffer[MAX_PATH * 2]{};
+   auto len = SQLGetPrivateProfileStringW(section.c_str(), key, L"", buffer, static_cast<int>(std::size(buffer)), file);
+   return std::wstring(buffer, len > 0 ? len : 0);
+}
+
+// TargetDriver may name a registered driver instead of a dll
+std::wstring ToDriverPath(const std::wstring &target)
+{
+   if (target.find(L'\\') != std::wstring::npos || target.find(L'/') != std::wstring::npos || ToUpper(target).ends_with(L".DLL"))
+   {
+      return target;
+   }
+   if (auto path = ReadProfileString(target, L"Driver", L"ODBCINST.INI"); !path.empty())
+   {
+      return path;
+   }
+   return target;
+}
+
+// TARGET_DRIVER is read on every lookup, a change applies to the next connections
+std::wstring DefaultTargetDriver()
+{
+   if (auto target = GetSetting("TARGET_DRIVER"); target)
+   {
+      return ToDriverPath(FromUtf8(*target));
+   }
+   return defaultTargetDriver;
+}
+} // namespace
+
+Driver::Driver(HMODULE module, std::wstring path)
+    : m_module(module), m_path(std::move(path)), m_admission(CreateDriverAdmission())
+{
+   for (size_t i = 0; i < kOdbcFunctionCount; ++i)
+   {
+      auto name = kOdbcFunctionNames[i];
+      // names are literals from kOdbcFunctionNames, they are null terminated
+      if (auto proc = GetProcAddress(m_module, name.data()); proc == nullptr)
+      {
+         std::print(LOG, "Failed to load function: {}", name);
+      }
+      else
+      {
+         m_functions[i] = proc;
+      }
+   }
+}
+
+Driver::~Driver()
+{
+   FreeLibrary(m_module);
+}
+
+FARPROC Driver::Find(OdbcFunctionId function) const
+{
+   return m_functions[OdbcFunctionIndex(function)];
+}
+
+const std::wstring &Driver::Path() const
+{
+   return m_path;
+}
+
+FairSemaphore *Driver::Admission() const
+{
+   return m_admission.get();
+}
+
+std::wstring ResolveTargetDriver(std::wstring_view dsn, std::wstring_view connectionString)
+{
+   if (auto target = GetConnectionAttribute(connectionString, L"TargetDriver"); target && !target->empty())
+   {
+      return ToDriverPath(*target);
+   }
+
+   std::wstring dataSource(dsn);
+   if (dataSource.empty())
+   {
+      dataSource = GetConnectionAttribute(connectionString, L"DSN").value_or(L"");
+   }
+   if (dataSource.empty())
+   {
+      return DefaultTargetDriver();
+   }
+
+   std::wstring path;
+   {
+      std::lock_guard lock(dsnCacheLock);
+      auto key = ToUpper(dataSource);
+      if (auto it = dsnTargets.find(key); it != dsnTargets.end())
+      {
+         path = it->second;
+      }
+      else
+      {
+         auto target = ReadProfileString(dataSource, L"TargetDriver", L"ODBC.INI");
+         path = target.empty() ? std::wstring() : ToDriverPath(target);
+         dsnTargets.emplace(key, path);
+      }
+   }
+   return path.empty() ? DefaultTargetDriver() : path;
+}
+
+const Driver *AcquireDriver(const std::wstring &path)
+{
+   std::lock_guard lock(lifecycleLock);
+
+   auto &entry = loadedDrivers[ToUpper(path)];
+   // not first time loading the dll
+   if (entry.refCount > 0)
+   {
+      ++entry.refCount;
+      return entry.driver.get();
+   }
+
+   auto hModule = LoadLibrary(path.c_str());
+   if (hModule == nullptr)
+   {
+      std::print(LOG, "Failed to load {}", ToUtf8(path));
+      loadedDrivers.erase(ToUpper(path));
+      return nullptr;
+   }
+
+   entry.driver = std::make_unique<Driver>(hModule, path);
+   entry.refCount = 1;
+   return entry.driver.get();
+}
+
+void ReleaseDriver(const Driver *driver)
+{
+   if (driver == nullptr)
+   {
+      return;
+   }
+
+   std::lock_guard lock(lifecycleLock);
+
+   auto it = loadedDrivers.find(ToUpper(driver->Path()));
+   if (it == loadedDrivers.end() || it->second.refCount == 0)
+   {
+      return;
+   }
+   if (--it->second.refCount > 0)
+   {
+      return;
+   }
+
+   // no environment is left on this driver, so no handle can still be used to call into it
+   loadedDrivers.erase(it);
+}
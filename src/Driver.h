@@ -0,0 +1,67 @@
+#pragma once
+#include "FairSemaphore.h"
+#include "OdbcFunctions.h"
+#include "Platform.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// signature of an odbc function, taken from its declaration in the odbc headers
+template <OdbcFunctionId Id>
+struct OdbcSignature;
+
+#define ODBC_SIGNATURE(NAME)                  \
+   template <>                                \
+   struct OdbcSignature<OdbcFunctionId::NAME> \
+   {                                          \
+      using Proc = decltype(&::NAME);         \
+   };
+ODBC_FUNCTIONS(ODBC_SIGNATURE)
+#undef ODBC_SIGNATURE
+
+// a loaded target driver and the entry points resolved from it
+//
+// a Driver is immutable once published, threads forwarding calls read it without any synchronization
+class Driver
+{
+ public:
+   Driver(HMODULE module, std::wstring path);
+   ~Driver();
+
+   Driver(const Driver &) = delete;
+   Driver &operator=(const Driver &) = delete;
+
+   // entry point of the driver, null when the driver does not export it
+   FARPROC Find(OdbcFunctionId function) const;
+
+   // same, typed after the declaration of the function in the odbc headers
+   template <OdbcFunctionId Id>
+   typename OdbcSignature<Id>::Proc Get() const
+   {
+      return reinterpret_cast<typename OdbcSignature<Id>::Proc>(Find(Id));
+   }
+
+   const std::wstring &Path() const;
+
+   // limit of the concurrent calls into the driver, null when unlimited
+   FairSemaphore *Admission() const;
+
+ private:
+   HMODULE m_module;
+   std::wstring m_path;
+   std::array<FARPROC, kOdbcFunctionCount> m_functions{};
+   std::unique_ptr<FairSemaphore> m_admission;
+};
+
+// path of the driver to load for a data source
+//
+// the TargetDriver attribute is looked up in the connection string first, then in the DSN entry of ODBC.INI, it may be
+// a dll path or the name of a driver registered in ODBCINST.INI. DSN entries are read once and cached.
+std::wstring ResolveTargetDriver(std::wstring_view dsn, std::wstring_view connectionString);
+
+// load a target driver, several drivers can be loaded side by side. Each acquire must be balanced by a release, the
+// last release unloads the driver. Returns null if the driver could not be loaded.
+const Driver *AcquireDriver(const std::wstring &path);
+void ReleaseDriver(const Driver *driver);
@@ -0,0 +1,37 @@
+#include "FairSemaphore.h"
+
+FairSemaphore::FairSemaphore(size_t permits)
+    : m_available(permits)
+{
+}
+
+bool FairSemaphore::Acquire()
+{
+   std::unique_lock lock(m_lock);
+   if (m_waiters.empty() && m_available > 0)
+   {
+      --m_available;
+      return false;
+   }
+
+   Waiter waiter;
+   m_waiters.push_back(&waiter);
+   waiter.wakeUp.wait(lock, [&waiter] { return waiter.granted; });
+   return true;
+}
+
+void FairSemaphore::Release()
+{
+   std::lock_guard lock(m_lock);
+   if (m_waiters.empty())
+   {
+      ++m_available;
+      return;
+   }
+
+   // hand the permit over, the waiter is removed here so it may return as soon as it is woken up
+   auto waiter = m_waiters.front();
+   m_waiters.pop_front();
+   waiter->granted = true;
+   waiter->wakeUp.notify_one();
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// counting semaphore granting permits in arrival order
+//
+// a released permit is handed to the oldest waiter instead of going back to the pool, so a thread arriving while
+// others wait can not overtake them. Each waiter sleeps on its own condition variable, a release wakes one thread.
+class FairSemaphore
+{
+ public:
+   explicit FairSemaphore(size_t permits);
+
+   FairSemaphore(const FairSemaphore &) = delete;
+   FairSemaphore &operator=(const FairSemaphore &) = delete;
+
+   // returns true when the caller had to wait
+   bool Acquire();
+   void Release();
+
+ private:
+   struct Waiter
+   {
+      std::condition_variable wakeUp;
+      bool granted = false;
+   };
+
+   std::mutex m_lock;
+   size_t m_available;
+   std::deque<Waiter *> m_waiters;
+};
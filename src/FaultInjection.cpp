@@ -0,0 +1,300 @@
+#include "FaultInjection.h"
+#include "Logging.h"
+#include "PostedDiagnostics.h"
+#include "Settings.h"
+#include "StringConversion.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <print>
+#include <random>
+#include <ranges>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+enum class DelayKind
+{
+   None,
+   Fixed,
+   Uniform,
+   Exponential,
+   LogNormal,
+   Pareto,
+};
+
+enum class Outcome
+{
+   Proceed,
+   Error,
+   StillExecuting,
+};
+
+struct FaultRule
+{
+   std::vector<std::string> functions;
+   std::optional<uintptr_t> handle;
+   std::optional<uint64_t> fingerprint;
+   double rate = 1.0;
+   DelayKind delay = DelayKind::None;
+   // parameters of the delay distribution, in ms
+   double a = 0;
+   double b = 0;
+   Outcome outcome = Outcome::Proceed;
+   std::wstring sqlState;
+};
+
+std::vector<std::string_view> Split(std::string_view str, char separator)
+{
+   std::vector<std::string_view> result;
+   for (auto part : std::views::split(str, separator))
+   {
+      std::string_view item(part.begin(), part.end());
+      while (!item.empty() && item.front() == ' ')
+      {
+         item.remove_prefix(1);
+      }
+      while (!item.empty() && item.back() == ' ')
+      {
+         item.remove_suffix(1);
+      }
+      if (!item.empty())
+      {
+         result.push_back(item);
+      }
+   }
+   return result;
+}
+
+// the whole field must be a number, finite for floating point values
+template <typename T>
+bool Parse(std::string_view str, T &value, int base = 10)
+{
+   auto end = str.data() + str.size();
+   if constexpr (std::is_floating_point_v<T>)
+   {
+      auto [last, error] = std::from_chars(str.data(), end, value);
+      return error == std::errc{} && last == end && std::isfinite(value);
+   }
+   else
+   {
+      if (base == 16 && (str.starts_with("0x") || str.starts_with("0X")))
+      {
+         str.remove_prefix(2);
+      }
+      auto [last, error] = std::from_chars(str.data(), end, value, base);
+      return error == std::errc{} && last == end;
+   }
+}
+
+bool ParseDelay(std::string_view str, FaultRule &rule)
+{
+   auto parts = Split(str, ':');
+   if (parts.size() == 1)
+   {
+      rule.delay = DelayKind::Fixed;
+      return Parse(parts[0], rule.a) && rule.a >= 0;
+   }
+   auto kind = parts[0];
+   bool twoParameters = kind == "uniform" || kind == "lognormal" || kind == "pareto";
+   if (parts.size() != (twoParameters ? 3u : 2u) || !Parse(parts[1], rule.a) || (twoParameters && !Parse(parts[2], rule.b)))
+   {
+      return false;
+   }
+   // parameters the distributions are defined for: a median, mean or scale above 0, a shape or sigma above 0
+   if (kind == "uniform")
+      rule.delay = DelayKind::Uniform;
+   else if (kind == "exp")
+      rule.delay = DelayKind::Exponential;
+   else if (kind == "lognormal")
+      rule.delay = DelayKind::LogNormal;
+   else if (kind == "pareto")
+      rule.delay = DelayKind::Pareto;
+   else
+      return false;
+   if (rule.delay == DelayKind::Uniform)
+   {
+      return rule.a >= 0 && rule.a <= rule.b;
+   }
+   return rule.a > 0 && (!twoParameters || rule.b > 0);
+}
+
+std::optional<FaultRule> ParseRule(std::string_view text)
+{
+   FaultRule rule;
+   for (auto field : Split(text, ','))
+   {
+      auto equal = field.find('=');
+      auto key = field.substr(0, equal);
+      auto value = equal == std::string_view::npos ? std::string_view{} : field.substr(equal + 1);
+
+      bool valid = true;
+      if (key == "function")
+      {
+         for (auto name : Split(value, '|'))
+         {
+            rule.functions.emplace_back(name);
+         }
+      }
+      else if (key == "handle")
+      {
+         valid = Parse(value, rule.handle.emplace(), 16);
+      }
+      else if (key == "fingerprint")
+      {
+         valid = Parse(value, rule.fingerprint.emplace(), 16);
+      }
+      else if (key == "rate")
+      {
+         valid = Parse(value, rule.rate) && rule.rate >= 0 && rule.rate <= 1;
+      }
+      else if (key == "delay")
+      {
+         valid = ParseDelay(value, rule);
+      }
+      else if (key == "error")
+      {
+         rule.outcome = Outcome::Error;
+         rule.sqlState = FromUtf8(value.empty() ? "HY000" : value);
+         valid = rule.sqlState.size() == 5;
+      }
+      else if (key == "still_executing")
+      {
+         rule.outcome = Outcome::StillExecuting;
+      }
+      else
+      {
+         valid = false;
+      }
+
+      if (!valid)
+      {
+         std::print(LOG, "Invalid fault injection field: {}", field);
+         return std::nullopt;
+      }
+   }
+   return rule;
+}
+
+std::vector<FaultRule> ParseRules(std::optional<std::string_view> setting)
+{
+   std::vector<FaultRule> rules;
+   if (setting)
+   {
+      for (auto text : Split(*setting, ';'))
+      {
+         if (auto rule = ParseRule(text); rule)
+         {
+            rules.push_back(std::move(*rule));
+         }
+      }
+      std::print(LOG, "Fault injection: {} rule(s)", rules.size());
+   }
+   return rules;
+}
+
+const std::vector<FaultRule> &GetRules()
+{
+   static ParsedSetting<std::vector<FaultRule>> rules("FAULTS", ParseRules);
+   return rules.Get();
+}
+
+std::mt19937_64 &Generator()
+{
+   // each thread gets its own sequence, derived from the seed in the order threads first inject
+   static const auto seed = static_cast<uint64_t>(GetSettingInt("FAULTS_SEED", static_cast<long long>(std::random_device{}())));
+   static std::atomic<uint64_t> nextStream{0};
+   thread_local std::mt19937_64 generator(seed + 0x9E3779B97F4A7C15ull * nextStream.fetch_add(1));
+   return generator;
+}
+
+double DrawDelay(const FaultRule &rule, std::mt19937_64 &generator)
+{
+   switch (rule.delay)
+   {
+   case DelayKind::Fixed:
+      return rule.a;
+   case DelayKind::Uniform:
+      return std::uniform_real_distribution<double>(rule.a, rule.b)(generator);
+   case DelayKind::Exponential:
+      return std::exponential_distribution<double>(1.0 / rule.a)(generator);
+   case DelayKind::LogNormal:
+      // a is the median
+      return std::lognormal_distribution<double>(std::log(rule.a), rule.b)(generator);
+   case DelayKind::Pareto:
+   {
+      auto u = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+      return rule.a / std::pow(1.0 - u, 1.0 / rule.b);
+   }
+   default:
+      return 0;
+   }
+}
+
+bool Matches(const FaultRule &rule, std::string_view function, const Route &route)
+{
+   if (!rule.functions.empty() && std::ranges::find(rule.functions, function) == rule.functions.end())
+   {
+      return false;
+   }
+   if (rule.handle)
+   {
+      auto handle = reinterpret_cast<uintptr_t>(route.record ? route.record->handle : route.handle);
+      auto parent = route.record && route.record->parent ? reinterpret_cast<uintptr_t>(route.record->parent->handle) : 0;
+      if (*rule.handle != handle && *rule.handle != parent)
+      {
+         return false;
+      }
+   }
+   if (rule.fingerprint && (!route.record || route.record->sqlFingerprint.load(std::memory_order_acquire) != *rule.fingerprint))
+   {
+      return false;
+   }
+   return true;
+}
+} // namespace
+
+bool FaultInjectionEnabled()
+{
+   return !GetRules().empty();
+}
+
+std::optional<SQLRETURN> InjectFault(std::string_view function, const Route &route)
+{
+   auto &generator = Generator();
+   for (auto &rule : GetRules())
+   {
+      if (!Matches(rule, function, route))
+      {
+         continue;
+      }
+      if (rule.rate < 1.0 && std::uniform_real_distribution<double>(0.0, 1.0)(generator) >= rule.rate)
+      {
+         continue;
+      }
+
+      if (rule.delay != DelayKind::None)
+      {
+         std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(DrawDelay(rule, generator)));
+      }
+      switch (rule.outcome)
+      {
+      case Outcome::Error:
+         if (route.record)
+         {
+            PostDiagnostic(*route.record, SQL_ERROR, rule.sqlState, L"Injected fault");
+         }
+         return SQL_ERROR;
+      case Outcome::StillExecuting:
+         return SQL_STILL_EXECUTING;
+      default:
+         return std::nullopt;
+      }
+   }
+   return std::nullopt;
+}
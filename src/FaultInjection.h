@@ -0,0 +1,22 @@
+#pragma once
+#include "Platform.h"
+#include "Routing.h"
+
+#include <optional>
+#include <string_view>
+
+// latency and fault injection around the calls forwarded to the driver, configured by ODBCDETOUR_FAULTS
+//
+// rules are separated by ';', the fields of a rule by ',':
+//    function=SQLExecute|SQLFetch   functions the rule applies to, all when absent
+//    handle=0x1234                  application handle, or the connection of a statement
+//    fingerprint=9a3f...            fingerprint of the statement text, see SqlFingerprint.h
+//    rate=0.05                      probability that a matching call is hit, 1 by default
+//    delay=20 | uniform:5:50 | exp:20 | lognormal:20:0.5 | pareto:5:1.5    added latency in ms
+//    error=08S01                    return SQL_ERROR with this SQLSTATE without calling the driver
+//    still_executing                return SQL_STILL_EXECUTING without calling the driver
+// the first matching rule hit by its rate applies. ODBCDETOUR_FAULTS_SEED makes the random draws repeatable.
+bool FaultInjectionEnabled();
+
+// apply the delay of the matching rule, returns the result to use instead of calling the driver
+std::optional<SQLRETURN> InjectFault(std::string_view function, const Route &route);
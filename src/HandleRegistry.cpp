@@ -0,0 +1,207 @@
+#include "HandleRegistry.h"
+#include "BlockFetch.h"
+#include "FairSemaphore.h"
+#include "HandleTracker.h"
+#include "ResultCache.h"
+#include "SpanExport.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+namespace
+{
+// handles are heap pointers: drop the alignment bits and mix the rest so consecutive allocations spread over shards
+size_t ShardIndex(SQLHANDLE handle, size_t shardCount)
+{
+   auto value = reinterpret_cast<uintptr_t>(handle) >> 4;
+   value *= 0x9E3779B97F4A7C15ull;
+   return static_cast<size_t>(value >> (64 - std::countr_zero(shardCount)));
+}
+} // namespace
+
+HandleRecord::HandleRecord(SQLSMALLINT type, SQLHANDLE handle, std::shared_ptr<HandleRecord> parent)
+    : type(type), handle(handle != SQL_NULL_HANDLE ? handle : static_cast<SQLHANDLE>(this)), parent(std::move(parent))
+{
+   if (handle != SQL_NULL_HANDLE)
+   {
+      driverHandle = handle;
+      if (this->parent)
+      {
+         driver = this->parent->driver.load(std::memory_order_acquire);
+      }
+   }
+}
+
+HandleRecord::~HandleRecord() = default;
+
+HandleRegistry::Shard &HandleRegistry::GetShard(SQLHANDLE handle)
+{
+   return m_shards[ShardIndex(handle, kShardCount)];
+}
+
+const HandleRegistry::Shard &HandleRegistry::GetShard(SQLHANDLE handle) const
+{
+   return m_shards[ShardIndex(handle, kShardCount)];
+}
+
+HandleRecordPtr HandleRegistry::Insert(HandleRecordPtr record)
+{
+   // the child is listed before it can be found, an Unregister of the parent either refuses it or removes it too
+   std::unique_lock<std::mutex> parentLock;
+   if (record->parent)
+   {
+      parentLock = std::unique_lock(record->parent->childrenLock);
+      if (record->parent->removed)
+      {
+         return {};
+      }
+      record->parent->children.push_back(record->handle);
+   }
+
+   HandleRecordPtr replaced;
+   {
+      auto &shard = GetShard(record->handle);
+      std::unique_lock lock(shard.lock);
+      // a driver may reuse the address of a handle freed behind our back, the new one wins
+      auto [it, inserted] = shard.records.try_emplace(record->handle, record);
+      if (!inserted)
+      {
+         replaced = std::exchange(it->second, record);
+      }
+   }
+   if (parentLock.owns_lock())
+   {
+      parentLock.unlock();
+   }
+   if (replaced && replaced->parent)
+   {
+      // the freed handle is no longer a child of its parent, the first entry is the old one when the parent is the same
+      std::lock_guard lock(replaced->parent->childrenLock);
+      if (auto it = std::ranges::find(replaced->parent->children, record->handle); it != replaced->parent->children.end())
+      {
+         replaced->parent->children.erase(it);
+      }
+   }
+   if (HandleTrackerEnabled())
+   {
+      if (replaced)
+      {
+         TrackHandleFreed(replaced->type);
+      }
+      TrackHandleAllocated(record->type);
+   }
+   return record;
+}
+
+HandleRecordPtr HandleRegistry::Register(SQLSMALLINT type, SQLHANDLE handle, SQLHANDLE parent)
+{
+   auto parentRecord = parent != SQL_NULL_HANDLE ? Find(parent) : HandleRecordPtr{};
+   return Insert(std::make_shared<HandleRecord>(type, handle, std::move(parentRecord)));
+}
+
+HandleRecordPtr HandleRegistry::RegisterOwned(SQLSMALLINT type, SQLHANDLE parent)
+{
+   auto parentRecord = parent != SQL_NULL_HANDLE ? Find(parent) : HandleRecordPtr{};
+   return Insert(std::make_shared<HandleRecord>(type, SQL_NULL_HANDLE, std::move(parentRecord)));
+}
+
+HandleRecordPtr HandleRegistry::Remove(SQLHANDLE handle)
+{
+   HandleRecordPtr record;
+   auto &shard = GetShard(handle);
+   std::unique_lock lock(shard.lock);
+   if (auto it = shard.records.find(handle); it != shard.records.end())
+   {
+      record = std::move(it->second);
+      shard.records.erase(it);
+   }
+   if (record && HandleTrackerEnabled())
+   {
+      TrackHandleFreed(record->type);
+   }
+   return record;
+}
+
+void HandleRegistry::Unregister(SQLHANDLE handle)
+{
+   auto record = Remove(handle);
+   if (!record)
+   {
+      return;
+   }
+
+   if (record->parent)
+   {
+      std::lock_guard lock(record->parent->childrenLock);
+      std::erase(record->parent->children, handle);
+   }
+
+   // freeing a handle implicitly frees everything allocated from it
+   std::vector<SQLHANDLE> children;
+   {
+      std::lock_guard lock(record->childrenLock);
+      record->removed = true;
+      children.swap(record->children);
+   }
+   for (auto child : children)
+   {
+      // the address may have been reused by a handle of another parent
+      if (auto childRecord = Find(child); childRecord && childRecord->parent == record)
+      {
+         Unregister(child);
+      }
+   }
+}
+
+void HandleRegistry::UnregisterChildren(SQLHANDLE handle, SQLSMALLINT childType)
+{
+   auto record = Find(handle);
+   if (!record)
+   {
+      return;
+   }
+
+   std::vector<SQLHANDLE> children;
+   {
+      std::lock_guard lock(record->childrenLock);
+      children = record->children;
+   }
+   for (auto child : children)
+   {
+      if (auto childRecord = Find(child); childRecord && childRecord->parent == record && childRecord->type == childType)
+      {
+         Unregister(child);
+      }
+   }
+}
+
+HandleRecordPtr HandleRegistry::Find(SQLHANDLE handle) const
+{
+   auto &shard = GetShard(handle);
+   std::shared_lock lock(shard.lock);
+   if (auto it = shard.records.find(handle); it != shard.records.end())
+   {
+      return it->second;
+   }
+   return {};
+}
+
+void HandleRegistry::ForEach(const std::function<void(const HandleRecord &)> &callback) const
+{
+   for (auto &shard : m_shards)
+   {
+      std::shared_lock lock(shard.lock);
+      for (auto &[handle, record] : shard.records)
+      {
+         callback(*record);
+      }
+   }
+}
+
+HandleRegistry &GetHandleRegistry()
+{
+   static HandleRegistry registry;
+   return registry;
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include "Platform.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// size used to keep records and shards on their own cache line, this avoids false sharing between threads
+// working on different handles
+constexpr size_t kCacheLineSize = 64;
+
+class Driver;
+class FairSemaphore;
+struct BlockFetch;
+struct ResultCacheState;
+struct SpanState;
+
+// attribute set on an environment or a connection before it is bound to a driver
+struct PendingAttribute
+{
+   SQLINTEGER attribute;
+   SQLPOINTER value;
+   SQLINTEGER length;
+   // copy of string values, value points into it
+   std::vector<wchar_t> buffer;
+};
+
+// parameter bound by the application with SQLBindParameter, the buffers belong to the application
+struct BoundParameter
+{
+   SQLSMALLINT inputOutputType;
+   SQLSMALLINT valueType;
+   SQLSMALLINT parameterType;
+   SQLULEN columnSize;
+   SQLSMALLINT decimalDigits;
+   SQLPOINTER value;
+   SQLLEN bufferLength;
+   SQLLEN *strLenOrInd;
+};
+
+// column bound by the application with SQLBindCol, the buffers belong to the application
+struct BoundColumn
+{
+   SQLSMALLINT targetType;
+   SQLPOINTER value;
+   SQLLEN bufferLength;
+   SQLLEN *strLenOrInd;
+};
+
+// diagnostic record returned by the detour itself instead of the driver, ex: an injected fault
+struct PostedDiagnostic
+{
+   std::wstring sqlState;
+   SQLINTEGER nativeError;
+   std::wstring message;
+   SQLRETURN returnCode;
+};
+
+// state kept by the detour for every handle handed out by the driver
+struct alignas(kCacheLineSize) HandleRecord
+{
+   HandleRecord(SQLSMALLINT type, SQLHANDLE handle, std::shared_ptr<HandleRecord> parent);
+   ~HandleRecord();
+
+   const SQLSMALLINT type;
+   // handle seen by the application
+   const SQLHANDLE handle;
+   // environment for a connection, connection for a statement or descriptor
+   const std::shared_ptr<HandleRecord> parent;
+   // registration of the handle, the age reported by the handle tracker
+   const std::chrono::steady_clock::time_point created = std::chrono::steady_clock::now();
+
+   // fingerprint of sqlText, 0 when no statement was prepared, see SqlFingerprint.h
+   std::atomic<uint64_t> sqlFingerprint{0};
+   // statement or connection: SQL_ATTR_QUERY_TIMEOUT in seconds, -1 when never set
+   std::atomic<long long> queryTimeout{-1};
+   // set while the detour answers the diagnostics of the handle from postedDiagnostics, lets the forwarding path skip
+   // the lock
+   std::atomic<bool> hasPostedDiagnostics{false};
+   // connection: identity of the database it is connected to for the result cache, 0 when unknown
+   std::atomic<uint64_t> database{0};
+   // connection: a statement wrote in its open transaction, the result cache is bypassed until it ends
+   std::atomic<bool> uncommittedWrites{false};
+
+   // driver the handle is routed to, environments may use several drivers and keep it null
+   std::atomic<const Driver *> driver{nullptr};
+   // handle passed to the driver, environments and connections are owned by the detour and differ from handle
+   std::atomic<SQLHANDLE> driverHandle{SQL_NULL_HANDLE};
+
+   // connection: limit of its concurrent calls, set before the driver is published and kept across reconnects
+   std::unique_ptr<FairSemaphore> admission;
+
+   // protects the state below, only contended by threads sharing the handle
+   std::mutex stateLock;
+   // environment: one driver environment per target driver used by its connections
+   std::vector<std::pair<const Driver *, SQLHENV>> driverEnvironments;
+   // environment and connection: attributes to replay on the driver handle
+   std::vector<PendingAttribute> pendingAttributes;
+   // statement: text of the last statement prepared or executed directly, and the parameters bound to it
+   std::string sqlText;
+   std::map<SQLUSMALLINT, BoundParameter> parameters;
+   // statement: parameters described through the APD instead, changed with SQLSetDescFieldW, SQLSetDescRec or
+   // SQLCopyDesc or replaced by an explicitly allocated descriptor. Their values are unknown to the detour
+   bool parameterDescriptorChanged = false;
+   bool explicitParameterDescriptor = false;
+   // statement: SQL_ATTR_PARAM_BIND_OFFSET_PTR and SQL_ATTR_PARAMSET_SIZE set by the application
+   SQLULEN *parameterBindOffset = nullptr;
+   SQLULEN parameterSets = 1;
+   // statement: columns bound to the application buffers
+   std::map<SQLUSMALLINT, BoundColumn> columns;
+   // statement: fetch state, created on the first fetch when block fetching or fetch profiling is enabled
+   std::unique_ptr<BlockFetch> blockFetch;
+   // statement: result cache state, created on the first execution when the result cache is enabled
+   std::unique_ptr<ResultCacheState> resultCache;
+   // statement and connection: spans being built, created on the first call when span export is enabled
+   std::unique_ptr<SpanState> spans;
+   // diagnostics of the last call on the handle when it was answered by the detour
+   std::vector<PostedDiagnostic> postedDiagnostics;
+
+   // handles allocated from this one: connections of an environment, statements and descriptors of a connection
+   std::mutex childrenLock;
+   std::vector<SQLHANDLE> children;
+   // set under childrenLock when the handle is unregistered, no child is added afterwards
+   bool removed = false;
+};
+
+using HandleRecordPtr = std::shared_ptr<HandleRecord>;
+
+// concurrent map of all live handles, keyed by the handle seen by the application
+//
+// the map is split in shards each protected by its own reader/writer lock, so lookups of different handles
+// from different threads do not contend on a global lock.
+class HandleRegistry
+{
+ public:
+   // add a handle allocated by the driver, it is routed to the driver of its parent. Null when the parent is being
+   // freed
+   HandleRecordPtr Register(SQLSMALLINT type, SQLHANDLE handle, SQLHANDLE parent);
+
+   // add a handle owned by the detour, the record address is used as handle. Parent may be null for environments. Null
+   // when the parent is being freed
+   HandleRecordPtr RegisterOwned(SQLSMALLINT type, SQLHANDLE parent);
+
+   // remove a freed handle and every handle allocated from it
+   void Unregister(SQLHANDLE handle);
+
+   // remove the children of a handle, ex: statements implicitly freed by SQLDisconnect
+   void UnregisterChildren(SQLHANDLE handle, SQLSMALLINT childType);
+
+   HandleRecordPtr Find(SQLHANDLE handle) const;
+
+   // walk all records, the callback must not call back into the registry
+   void ForEach(const std::function<void(const HandleRecord &)> &callback) const;
+
+ private:
+   static constexpr size_t kShardCount = 64;
+
+   struct alignas(kCacheLineSize) Shard
+   {
+      mutable std::shared_mutex lock;
+      std::unordered_map<SQLHANDLE, HandleRecordPtr> records;
+   };
+
+   Shard &GetShard(SQLHANDLE handle);
+   const Shard &GetShard(SQLHANDLE handle) const;
+   HandleRecordPtr Remove(SQLHANDLE handle);
+   HandleRecordPtr Insert(HandleRecordPtr record);
+
+   std::array<Shard, kShardCount> m_shards;
+};
+
+HandleRegistry &GetHandleRegistry();
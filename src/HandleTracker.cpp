@@ -0,0 +1,283 @@
+#include "HandleTracker.h"
+#include "HandleRegistry.h"
+#include "Logging.h"
+#include "Settings.h"
+#include "Statement.h"
+
+#include <psapi.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <print>
+#include <ranges>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr size_t kHandleTypes = SQL_HANDLE_DESC - SQL_HANDLE_ENV + 1;
+constexpr std::string_view kTypeNames[kHandleTypes] = {"env", "dbc", "stmt", "desc"};
+
+// upper bounds of the age buckets, the last bucket has none
+constexpr std::chrono::seconds kAgeBounds[] = {std::chrono::seconds(1), std::chrono::seconds(10), std::chrono::minutes(1), std::chrono::minutes(10), std::chrono::hours(1)};
+constexpr std::string_view kAgeNames[] = {"<1s", "<10s", "<1m", "<10m", "<1h", ">=1h"};
+constexpr size_t kAgeBuckets = std::size(kAgeNames);
+
+// old handles and connections listed by a snapshot, the rest is counted
+constexpr size_t kListedHandles = 20;
+constexpr size_t kListedConnections = 5;
+
+struct alignas(kCacheLineSize) TypeCounters
+{
+   std::atomic<uint64_t> allocated{0};
+   std::atomic<uint64_t> freed{0};
+   std::atomic<int64_t> live{0};
+   std::atomic<int64_t> peak{0};
+};
+
+std::array<TypeCounters, kHandleTypes> counters;
+
+bool TypeIndex(SQLSMALLINT type, size_t &index)
+{
+   index = static_cast<size_t>(type - SQL_HANDLE_ENV);
+   return type >= SQL_HANDLE_ENV && type <= SQL_HANDLE_DESC;
+}
+
+size_t AgeBucket(std::chrono::steady_clock::duration age)
+{
+   return static_cast<size_t>(std::ranges::upper_bound(kAgeBounds, age) - std::begin(kAgeBounds));
+}
+
+// handle seen by a snapshot, copied out of the registry so the records are locked without holding its shards
+struct LiveHandle
+{
+   SQLHANDLE handle;
+   SQLSMALLINT type;
+   SQLHANDLE parent;
+   std::chrono::steady_clock::time_point created;
+};
+
+class HandleTracker
+{
+ public:
+   HandleTracker(std::chrono::seconds interval, std::chrono::seconds maxAge)
+       : m_interval(interval), m_maxAge(maxAge)
+   {
+      m_thread = std::jthread([this](std::stop_token stop)
+                              { Run(stop); });
+   }
+
+   ~HandleTracker()
+   {
+      m_thread.request_stop();
+      m_thread.join();
+   }
+
+ private:
+   void Run(std::stop_token stop)
+   {
+      std::mutex mutex;
+      std::condition_variable_any wakeUp;
+      std::unique_lock lock(mutex);
+      while (!stop.stop_requested())
+      {
+         // woken up early only by a stop request
+         wakeUp.wait_for(lock, stop, m_interval, [] { return false; });
+         if (!stop.stop_requested())
+         {
+            Snapshot();
+         }
+      }
+   }
+
+   void Snapshot()
+   {
+      std::vector<LiveHandle> handles;
+      GetHandleRegistry().ForEach([&](const HandleRecord &record)
+                                  { handles.push_back({record.handle, record.type, record.parent ? record.parent->handle : SQL_NULL_HANDLE, record.created}); });
+
+      auto now = std::chrono::steady_clock::now();
+      std::array<std::array<uint64_t, kAgeBuckets>, kHandleTypes> ages{};
+      std::array<uint64_t, kHandleTypes> live{};
+      // bound bytes and statements of each connection
+      std::map<SQLHANDLE, std::pair<size_t, size_t>> bound;
+      size_t boundBytes = 0;
+      std::vector<std::string> old;
+      size_t oldCount = 0;
+      std::map<SQLHANDLE, std::chrono::steady_clock::time_point> reported;
+
+      for (auto &handle : handles)
+      {
+         size_t type = 0;
+         if (!TypeIndex(handle.type, type))
+         {
+            continue;
+         }
+         ++live[type];
+         auto age = now - handle.created;
+         ++ages[type][AgeBucket(age)];
+
+         auto record = handle.type == SQL_HANDLE_STMT ? GetHandleRegistry().Find(handle.handle) : HandleRecordPtr{};
+         if (record)
+         {
+            auto bytes = BoundBufferBytes(*record);
+            auto &connection = bound[handle.parent];
+            connection.first += bytes;
+            ++connection.second;
+            boundBytes += bytes;
+         }
+
+         if (age < m_maxAge)
+         {
+            continue;
+         }
+         // an address reused by a new handle is reported again
+         reported.emplace(handle.handle, handle.created);
+         if (auto previous = m_reported.find(handle.handle); previous != m_reported.end() && previous->second == handle.created)
+         {
+            continue;
+         }
+         if (++oldCount > kListedHandles)
+         {
+            continue;
+         }
+         auto line = std::format("Handle {} ({}) alive for {} s", handle.handle, kTypeNames[type], std::chrono::duration_cast<std::chrono::seconds>(age).count());
+         if (record)
+         {
+            auto text = GetStatementText(*record);
+            std::format_to(std::back_inserter(line), ", last statement: {}", text.empty() ? "none" : text);
+         }
+         old.push_back(std::move(line));
+      }
+      // handles freed since the last snapshot are forgotten
+      m_reported = std::move(reported);
+
+      PROCESS_MEMORY_COUNTERS_EX memory{};
+      memory.cb = sizeof(memory);
+      GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS *>(&memory), sizeof(memory));
+      std::print(LOG, "Handle snapshot: {} env, {} dbc, {} stmt, {} desc live, {} bytes bound on {} connections, {:.1f} MB private, {:.1f} MB working set", live[0], live[1], live[2],
+                 live[3], boundBytes, bound.size(), static_cast<double>(memory.PrivateUsage) / (1 << 20), static_cast<double>(memory.WorkingSetSize) / (1 << 20));
+
+      for (size_t type = 0; type < kHandleTypes; ++type)
+      {
+         if (live[type] == 0)
+         {
+            continue;
+         }
+         std::string line;
+         for (size_t bucket = 0; bucket < kAgeBuckets; ++bucket)
+         {
+            std::format_to(std::back_inserter(line), " {} {}", kAgeNames[bucket], ages[type][bucket]);
+         }
+         std::print(LOG, "   {} ages:{}", kTypeNames[type], line);
+      }
+
+      // connections holding the most bound bytes
+      std::vector<std::pair<SQLHANDLE, std::pair<size_t, size_t>>> connections(bound.begin(), bound.end());
+      std::ranges::sort(connections, [](auto &left, auto &right)
+                        { return left.second.first > right.second.first; });
+      for (auto &[connection, usage] : connections | std::views::take(kListedConnections))
+      {
+         std::print(LOG, "   connection {}: {} bytes bound on {} statements", connection, usage.first, usage.second);
+      }
+
+      for (auto &line : old)
+      {
+         std::print(LOG, "{}", line);
+      }
+      if (oldCount > kListedHandles)
+      {
+         std::print(LOG, "{} more handles alive for more than {} s", oldCount - kListedHandles, m_maxAge.count());
+      }
+   }
+
+   std::chrono::seconds m_interval;
+   std::chrono::seconds m_maxAge;
+   // old handles already logged, with their creation to tell a reused address
+   std::map<SQLHANDLE, std::chrono::steady_clock::time_point> m_reported;
+   std::jthread m_thread;
+};
+
+std::mutex trackerLock;
+// intentionally leaked if the application exits without freeing its environments, see the metrics publisher
+HandleTracker *tracker = nullptr;
+} // namespace
+
+bool HandleTrackerEnabled()
+{
+   static const bool enabled = GetSettingBool("HANDLE_TRACKER", false);
+   return enabled;
+}
+
+void TrackHandleAllocated(SQLSMALLINT type)
+{
+   size_t index = 0;
+   if (!TypeIndex(type, index))
+   {
+      return;
+   }
+   auto &counter = counters[index];
+   counter.allocated.fetch_add(1, std::memory_order_relaxed);
+   auto live = counter.live.fetch_add(1, std::memory_order_relaxed) + 1;
+   auto peak = counter.peak.load(std::memory_order_relaxed);
+   while (live > peak && !counter.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+   {
+   }
+}
+
+void TrackHandleFreed(SQLSMALLINT type)
+{
+   size_t index = 0;
+   if (!TypeIndex(type, index))
+   {
+      return;
+   }
+   counters[index].freed.fetch_add(1, std::memory_order_relaxed);
+   counters[index].live.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void StartHandleTracker()
+{
+   if (!HandleTrackerEnabled())
+   {
+      return;
+   }
+   std::lock_guard lock(trackerLock);
+   if (tracker == nullptr)
+   {
+      auto interval = std::chrono::seconds(std::max<long long>(1, GetSettingInt("HANDLE_SNAPSHOT_S", 60)));
+      auto maxAge = std::chrono::seconds(std::max<long long>(1, GetSettingInt("HANDLE_MAX_AGE_S", 600)));
+      tracker = new HandleTracker(interval, maxAge);
+   }
+}
+
+void StopHandleTracker()
+{
+   std::lock_guard lock(trackerLock);
+   delete tracker;
+   tracker = nullptr;
+}
+
+void LogHandleReport()
+{
+   if (!HandleTrackerEnabled())
+   {
+      return;
+   }
+   for (size_t type = 0; type < kHandleTypes; ++type)
+   {
+      auto &counter = counters[type];
+      std::print(LOG, "Handles {}: {} allocated, {} freed, {} live, peak {}", kTypeNames[type], counter.allocated.load(std::memory_order_relaxed),
+                 counter.freed.load(std::memory_order_relaxed), counter.live.load(std::memory_order_relaxed), counter.peak.load(std::memory_order_relaxed));
+   }
+}
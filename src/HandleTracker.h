@@ -0,0 +1,20 @@
+#pragma once
+#include "Platform.h"
+
+// handle leak and footprint tracking, enabled with ODBCDETOUR_HANDLE_TRACKER=1
+//
+// the handles allocated and freed are counted by type. Every ODBCDETOUR_HANDLE_SNAPSHOT_S seconds (60 by default) a
+// snapshot is logged: live handles by type and age, bytes of the application buffers bound on the statements of each
+// connection and the memory of the process. Handles alive for more than ODBCDETOUR_HANDLE_MAX_AGE_S seconds (600) are
+// logged once, statements with the last text executed on them.
+bool HandleTrackerEnabled();
+
+// called by the registry, a handle replaced by a reused address is freed
+void TrackHandleAllocated(SQLSMALLINT type);
+void TrackHandleFreed(SQLSMALLINT type);
+
+void StartHandleTracker();
+void StopHandleTracker();
+
+// handles allocated, freed and the peak of live ones by type
+void LogHandleReport();
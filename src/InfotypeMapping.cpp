@@ -3,8 +3,11 @@
 #include <sql.h>
 #include <sqlext.h>
 // clang-format on
+#include "SqlInfoType.h"
 
-#include <vector>
+#include <algorithm>
+#include <array>
+#include <iterator>
 
 // macro to get string representation of a define
 #define MAP_INFO(NAME, argType) {NAME, #NAME, argType}
@@ -25,7 +28,15 @@ struct InfotypeInfo
 };
 namespace
 {
-std::vector<InfotypeInfo> infotypes = {
+// sorted by info type at compile time, the names are binary searched
+template <size_t N>
+consteval std::array<InfotypeInfo, N> Sorted(std::array<InfotypeInfo, N> infos)
+{
+   std::ranges::sort(infos, {}, &InfotypeInfo::infotype);
+   return infos;
+}
+
+constexpr auto infotypes = Sorted(std::to_array<InfotypeInfo>({
     MAP_INFO(SQL_MAX_DRIVER_CONNECTIONS, ParamType::String),
     MAP_INFO(SQL_MAX_CONCURRENT_ACTIVITIES, ParamType::String),
     MAP_INFO(SQL_DATA_SOURCE_NAME, ParamType::String),
@@ -211,7 +222,7 @@ std::vector<InfotypeInfo> infotypes = {
     MAP_INFO(SQL_ASYNC_DBC_FUNCTIONS, ParamType::String),
     MAP_INFO(SQL_DRIVER_AWARE_POOLING_SUPPORTED, ParamType::String),
     MAP_INFO(SQL_ASYNC_NOTIFICATION, ParamType::String),
-};
+}));
 
 }
 InfotypeInfo GetInfoType(SQLUSMALLINT infotype)
@@ -224,4 +235,11 @@ InfotypeInfo GetInfoType(SQLUSMALLINT infotype)
       }
    }
    return InfotypeInfo{infotype, "Unknown", ParamType::Unknown};
-}
\ No newline at end of file
+}
+
+std::string_view InfotypeName(long long infoType)
+{
+   auto it = std::ranges::lower_bound(infotypes, infoType, {}, [](const InfotypeInfo &info)
+                                      { return static_cast<long long>(info.infotype); });
+   return it != std::end(infotypes) && static_cast<long long>(it->infotype) == infoType ? it->name : std::string_view{};
+}
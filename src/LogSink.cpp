@@ -0,0 +1,389 @@
+#include "LogSink.h"
+#include "Settings.h"
+
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#ifdef ODBCDETOUR_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace
+{
+// longest time written lines may stay in the writer buffers
+constexpr std::chrono::seconds kFlushInterval{1};
+// fast level, log text compresses well even there
+constexpr int kCompressionLevel = 1;
+
+uint64_t MaxFileBytes()
+{
+   static const uint64_t bytes = static_cast<uint64_t>(std::max<long long>(0, GetSettingInt("LOG_MAX_MB", 0))) * 1024 * 1024;
+   return bytes;
+}
+
+std::chrono::minutes RotationInterval()
+{
+   static const std::chrono::minutes interval{std::max<long long>(0, GetSettingInt("LOG_ROTATE_MINUTES", 0))};
+   return interval;
+}
+
+size_t KeptSegments()
+{
+   static const size_t keep = static_cast<size_t>(std::max<long long>(0, GetSettingInt("LOG_KEEP", 10)));
+   return keep;
+}
+
+size_t MaxQueuedBytes()
+{
+   static const size_t bytes = static_cast<size_t>(std::max<long long>(1, GetSettingInt("LOG_QUEUE_MB", 16))) * 1024 * 1024;
+   return bytes;
+}
+
+bool CompressionRequested()
+{
+   static const bool compress = GetSettingBool("LOG_COMPRESS", false);
+   return compress;
+}
+
+bool IsRotated()
+{
+   return MaxFileBytes() > 0 || RotationInterval().count() > 0;
+}
+} // namespace
+
+// zstd stream of the current file, one frame per file
+class LogSink::Compressor
+{
+ public:
+#ifdef ODBCDETOUR_HAVE_ZSTD
+   Compressor()
+       : m_context(ZSTD_createCCtx()), m_buffer(ZSTD_CStreamOutSize())
+   {
+      ZSTD_CCtx_setParameter(m_context, ZSTD_c_compressionLevel, kCompressionLevel);
+   }
+   ~Compressor()
+   {
+      ZSTD_freeCCtx(m_context);
+   }
+
+   // compressed bytes written
+   uint64_t Write(FILE *file, std::string_view data, ZSTD_EndDirective directive)
+   {
+      uint64_t written = 0;
+      ZSTD_inBuffer in{data.data(), data.size(), 0};
+      size_t remaining = 0;
+      do
+      {
+         ZSTD_outBuffer out{m_buffer.data(), m_buffer.size(), 0};
+         remaining = ZSTD_compressStream2(m_context, &out, &in, directive);
+         if (ZSTD_isError(remaining))
+         {
+            return written;
+         }
+         fwrite(m_buffer.data(), 1, out.pos, file);
+         written += out.pos;
+      } while (directive == ZSTD_e_continue ? in.pos < in.size : remaining != 0);
+      return written;
+   }
+
+   uint64_t Append(FILE *file, std::string_view data)
+   {
+      return Write(file, data, ZSTD_e_continue);
+   }
+   uint64_t Flush(FILE *file)
+   {
+      return Write(file, {}, ZSTD_e_flush);
+   }
+   uint64_t End(FILE *file)
+   {
+      return Write(file, {}, ZSTD_e_end);
+   }
+
+   static constexpr bool kAvailable = true;
+
+ private:
+   ZSTD_CCtx *m_context;
+   std::vector<char> m_buffer;
+#else
+   uint64_t Append(FILE *, std::string_view)
+   {
+      return 0;
+   }
+   uint64_t Flush(FILE *)
+   {
+      return 0;
+   }
+   uint64_t End(FILE *)
+   {
+      return 0;
+   }
+
+   static constexpr bool kAvailable = false;
+#endif
+};
+
+LogSink::LogSink(std::filesystem::path path, bool append)
+    : m_path(std::move(path)), m_append(append)
+{
+}
+
+// the writer thread may still use the sink, sinks live as long as the process
+LogSink::~LogSink() = default;
+
+void LogSink::Write(std::string line)
+{
+   if (m_path.empty())
+   {
+      return;
+   }
+   line += '\n';
+
+   std::lock_guard lock(m_queueLock);
+   if (!m_started)
+   {
+      m_started = true;
+      // intentionally leaked, the thread writes until the process exits
+      new std::jthread([this]
+                       { Run(); });
+   }
+   if (m_queuedBytes + line.size() > MaxQueuedBytes())
+   {
+      ++m_dropped;
+      return;
+   }
+   m_queuedBytes += line.size();
+   m_queue.push_back(std::move(line));
+   m_wakeUp.notify_one();
+}
+
+void LogSink::Run()
+{
+   {
+      std::lock_guard file(m_fileLock);
+      Open();
+   }
+
+   std::vector<std::string> batch;
+   while (true)
+   {
+      uint64_t dropped = 0;
+      {
+         std::unique_lock lock(m_queueLock);
+         m_wakeUp.wait_for(lock, kFlushInterval, [this]
+                           { return !m_queue.empty(); });
+         batch.swap(m_queue);
+         m_queuedBytes = 0;
+         dropped = std::exchange(m_dropped, 0);
+      }
+
+      bool idle = batch.empty();
+      std::lock_guard file(m_fileLock);
+      if (m_closed)
+      {
+         return;
+      }
+      if (dropped > 0)
+      {
+         WriteFile(std::format("{} log lines dropped, the log writer fell behind\n", dropped));
+      }
+      for (auto &line : batch)
+      {
+         WriteFile(line);
+         if (MaxFileBytes() > 0 && m_fileBytes >= MaxFileBytes())
+         {
+            Rotate();
+         }
+      }
+      batch.clear();
+      if (m_unflushed && (idle || std::chrono::steady_clock::now() - m_lastFlush >= kFlushInterval))
+      {
+         Flush();
+      }
+      if (RotationInterval().count() > 0 && std::chrono::system_clock::now() - m_opened >= RotationInterval())
+      {
+         Rotate();
+      }
+   }
+}
+
+void LogSink::Close()
+{
+   // the writer thread is killed without unlocking when the process exits while it writes
+   std::unique_lock file(m_fileLock, std::chrono::seconds(2));
+   if (!file.owns_lock() || m_closed)
+   {
+      return;
+   }
+   std::vector<std::string> batch;
+   {
+      std::lock_guard lock(m_queueLock);
+      batch.swap(m_queue);
+      m_queuedBytes = 0;
+   }
+   if (m_file == nullptr && !batch.empty())
+   {
+      Open();
+   }
+   for (auto &line : batch)
+   {
+      WriteFile(line);
+   }
+   CloseFile();
+   m_closed = true;
+}
+
+void LogSink::Open()
+{
+   std::error_code error;
+   if (IsRotated() && std::filesystem::file_size(ActivePath(), error) > 0 && !error)
+   {
+      // the file of a previous run is kept as a segment
+      RenameActive();
+      RemoveOldSegments();
+   }
+   OpenFile();
+}
+
+std::filesystem::path LogSink::ActivePath() const
+{
+   auto path = m_path;
+   if (CompressionRequested() && Compressor::kAvailable)
+   {
+      path += ".zst";
+   }
+   return path;
+}
+
+void LogSink::OpenFile()
+{
+   bool compress = CompressionRequested() && Compressor::kAvailable;
+   auto path = ActivePath();
+   std::error_code error;
+   auto size = std::filesystem::file_size(path, error);
+   bool append = m_append || IsRotated();
+   if (fopen_s(&m_file, path.string().c_str(), compress ? (append ? "ab" : "wb") : (append ? "a" : "w")) != 0)
+   {
+      m_file = nullptr;
+      return;
+   }
+   m_fileBytes = append && !error ? size : 0;
+   m_opened = std::chrono::system_clock::now();
+   m_lastFlush = std::chrono::steady_clock::now();
+   if (compress)
+   {
+      m_compressor = std::make_unique<Compressor>();
+   }
+   else if (CompressionRequested())
+   {
+      WriteFile("ODBCDETOUR_LOG_COMPRESS ignored, the detour was built without zstd\n");
+   }
+}
+
+void LogSink::WriteFile(std::string_view data)
+{
+   if (m_file == nullptr)
+   {
+      return;
+   }
+   if (m_compressor)
+   {
+      m_fileBytes += m_compressor->Append(m_file, data);
+   }
+   else
+   {
+      fwrite(data.data(), 1, data.size(), m_file);
+      m_fileBytes += data.size();
+   }
+   m_unflushed = true;
+}
+
+void LogSink::Flush()
+{
+   if (m_file == nullptr)
+   {
+      return;
+   }
+   if (m_compressor)
+   {
+      m_fileBytes += m_compressor->Flush(m_file);
+   }
+   fflush(m_file);
+   m_lastFlush = std::chrono::steady_clock::now();
+   m_unflushed = false;
+}
+
+void LogSink::CloseFile()
+{
+   if (m_file == nullptr)
+   {
+      return;
+   }
+   if (m_compressor)
+   {
+      m_compressor->End(m_file);
+      m_compressor.reset();
+   }
+   fclose(m_file);
+   m_file = nullptr;
+   m_unflushed = false;
+}
+
+void LogSink::Rotate()
+{
+   CloseFile();
+   RenameActive();
+   RemoveOldSegments();
+   OpenFile();
+}
+
+void LogSink::RenameActive()
+{
+   auto extension = m_path.extension().string();
+   if (CompressionRequested() && Compressor::kAvailable)
+   {
+      extension += ".zst";
+   }
+
+   auto now = std::chrono::current_zone()->to_local(std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()));
+   auto stem = m_path.stem().string() + std::format(".{:%Y%m%d-%H%M%S}", now);
+   auto segment = m_path.parent_path() / (stem + extension);
+   std::error_code error;
+   for (int i = 1; std::filesystem::exists(segment, error); ++i)
+   {
+      // rotated twice in the same second
+      segment = m_path.parent_path() / std::format("{}-{}{}", stem, i, extension);
+   }
+   std::filesystem::rename(ActivePath(), segment, error);
+}
+
+void LogSink::RemoveOldSegments()
+{
+   auto prefix = m_path.stem().string() + ".";
+   auto extension = m_path.extension().string();
+   std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> segments;
+   std::error_code error;
+   for (auto &entry : std::filesystem::directory_iterator(m_path.parent_path(), error))
+   {
+      auto name = entry.path().filename().string();
+      // <stem>.<yyyymmdd-hhmmss>[-n]<extension>[.zst]
+      if (name.size() > prefix.size() && name.starts_with(prefix) && std::isdigit(static_cast<unsigned char>(name[prefix.size()])) &&
+          (name.ends_with(extension) || name.ends_with(extension + ".zst")))
+      {
+         segments.emplace_back(entry.last_write_time(error), entry.path());
+      }
+   }
+   if (segments.size() <= KeptSegments())
+   {
+      return;
+   }
+   // oldest first, a segment is last written when it is rotated
+   std::ranges::sort(segments);
+   for (size_t i = 0; i < segments.size() - KeptSegments(); ++i)
+   {
+      std::filesystem::remove(segments[i].second, error);
+   }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// log file written by a background thread, application threads only queue complete lines
+//
+// the file is rotated once it reaches ODBCDETOUR_LOG_MAX_MB and every ODBCDETOUR_LOG_ROTATE_MINUTES, 0 (the default)
+// disables either. A rotated file is renamed with the time it was rotated, ex: JadaOdbcDetour2.20261018-142530.txt, and
+// only the ODBCDETOUR_LOG_KEEP (10 by default) most recent ones are kept. With ODBCDETOUR_LOG_COMPRESS=1 files are
+// written as zstd streams, .txt.zst, flushed about every second so a file being written can be read up to there. Lines
+// are dropped, and their count logged, while more than ODBCDETOUR_LOG_QUEUE_MB (16 by default) wait for the writer.
+class LogSink
+{
+ public:
+   // an empty path discards every line. The file is appended to or, when it is not rotated, truncated when opened
+   LogSink(std::filesystem::path path, bool append);
+   ~LogSink();
+
+   LogSink(const LogSink &) = delete;
+   LogSink &operator=(const LogSink &) = delete;
+
+   // queue a line, ended by a new line
+   void Write(std::string line);
+
+   // write the queued lines and close the file, later lines are discarded. Called when the process exits, the writer
+   // thread may already be gone
+   void Close();
+
+ private:
+   class Compressor;
+
+   void Run();
+   std::filesystem::path ActivePath() const;
+   // must be called with m_fileLock held
+   void Open();
+   void OpenFile();
+   void WriteFile(std::string_view data);
+   void Flush();
+   void CloseFile();
+   void Rotate();
+   void RenameActive();
+   void RemoveOldSegments();
+
+   const std::filesystem::path m_path;
+   const bool m_append;
+
+   std::mutex m_queueLock;
+   std::condition_variable m_wakeUp;
+   std::vector<std::string> m_queue;
+   size_t m_queuedBytes = 0;
+   uint64_t m_dropped = 0;
+   bool m_started = false;
+
+   // owned by the writer thread, and by Close once the process exits
+   std::timed_mutex m_fileLock;
+   bool m_closed = false;
+   FILE *m_file = nullptr;
+   std::unique_ptr<Compressor> m_compressor;
+   uint64_t m_fileBytes = 0;
+   std::chrono::system_clock::time_point m_opened;
+   std::chrono::steady_clock::time_point m_lastFlush;
+   bool m_unflushed = false;
+};
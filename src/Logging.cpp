@@ -1,8 +1,12 @@
 #include "logging.h"
+#include "Clock.h"
+#include "LogSink.h"
+#include "Settings.h"
+#include "StringConversion.h"
 
-#include <chrono>
+#include <algorithm>
 #include <format>
-#include <fstream>
+#include <mutex>
 #include <optional>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -12,52 +16,6 @@
 
 namespace
 {
-// compile time log function to get the number of digits in fraction of a second ex: ms, us, ns
-template <typename T>
-constexpr std::enable_if_t<std::is_integral_v<T>, size_t> intlen(T param)
-{
-   size_t result{1U};
-
-   while (T{} != (param /= T{10}))
-      ++result;
-   return result;
-}
-
-auto GetTimeFract_a = [](const std::chrono::system_clock::time_point &now)
-{
-   using namespace std::chrono;
-   auto fract = duration_cast<std::chrono::microseconds>(now.time_since_epoch());
-   fract -= duration_cast<std::chrono::seconds>(now.time_since_epoch());
-   return fract;
-};
-
-std::string GetTimeFract(const std::chrono::system_clock::time_point &now)
-{
-   auto fract = GetTimeFract_a(now);
-   return std::format("{:0{}d}", fract.count(), intlen(decltype(fract)::duration::period::den) - 1);
-}
-
-// Function to get current date and  time in nanoseconds using std::chrono
-std::string GetCurrentTimestamp()
-{
-   const auto now = std::chrono::system_clock::now();
-
-   auto micro = GetTimeFract(now);
-   auto ltime = std::chrono::current_zone()->to_local(now);
-
-   return std::format("{:%Y-%m-%d %X}.{}: ", ltime, micro);
-}
-
-FILE *traceFile = nullptr;
-
-void CloselogFile()
-{
-   if (traceFile != nullptr)
-   {
-      fclose(traceFile);
-   }
-}
-
 std::optional<std::string> GetHomePath()
 {
    std::optional<std::string> result;
@@ -74,93 +32,105 @@ std::optional<std::string> GetHomePath()
    return result;
 }
 
-FILE *InitTrace()
+// log file named by the setting, else in the home directory, empty when there is none and the lines are discarded
+std::filesystem::path LogPath(std::string_view setting, const char *name)
 {
-   if (traceFile != nullptr)
+   if (auto path = GetSetting(setting); path)
    {
-      return traceFile;
+      return std::filesystem::path(FromUtf8(*path));
    }
-
-   FILE *log = nullptr;
-   // get null device name
-   std::string path = R"(.\NUL)";
    if (auto homepath = GetHomePath(); homepath.has_value())
    {
-      path = homepath.value();
-      path += R"(\JadaOdbcDetour.txt)";
+      return homepath.value() + R"(\)" + name;
    }
-   if (fopen_s(&log, path.c_str(), "a") != 0)
-   {
-      return stderr;
-   }
-   traceFile = log;
-   atexit(CloselogFile);
-   return traceFile;
+   return {};
 }
 
-} // namespace
+// sinks are never destroyed, their writer thread runs until the process exits
+LogSink *traceSink = nullptr;
+LogSink *logSink = nullptr;
 
-void Trace(const char *fmt, ...)
+void CloseLogFiles()
 {
-   static FILE *log = InitTrace();
-   if (log == nullptr)
+   if (traceSink != nullptr)
    {
-      return;
+      traceSink->Close();
+   }
+   if (logSink != nullptr)
+   {
+      logSink->Close();
    }
-   auto now = GetCurrentTimestamp();
-   fprintf(log, "%s", now.c_str());
-   va_list args;
-   va_start(args, fmt);
-   vfprintf(log, fmt, args);
-   va_end(args);
-   fprintf(log, "\n");
-   fflush(log);
 }
 
-OstreamProxy::OstreamProxy(std::ofstream &out)
-    : m_out(out)
+void InitSinks()
 {
+   static std::once_flag once;
+   std::call_once(once, []
+                  {
+                     // the trace is appended to, the log starts again with every process
+                     traceSink = new LogSink(LogPath("TRACE_FILE", "JadaOdbcDetour.txt"), true);
+                     logSink = new LogSink(LogPath("LOG_FILE", "JadaOdbcDetour2.txt"), false);
+                     atexit(CloseLogFiles); });
 }
-OstreamProxy::~OstreamProxy()
-{
-   m_out << std::endl;
-   m_out.flush();
-}
 
-OstreamProxy::operator std::ofstream &()
+thread_local std::ostringstream threadLine;
+thread_local bool threadLineUsed = false;
+// " <thread id>,  " following the timestamp of the lines of the thread
+thread_local const std::string threadId = std::format(" {:05d},  ", GetCurrentThreadId());
+
+} // namespace
+
+void Trace(const char *fmt, ...)
 {
-   auto now = GetCurrentTimestamp();
-   m_out.write(now.c_str(), now.size());
-   auto threadid = std::format(" {:05d},  ", GetCurrentThreadId());
-   m_out.write(threadid.c_str(), threadid.size());
-   return m_out;
+   InitSinks();
+   va_list args;
+   va_start(args, fmt);
+   va_list sizing;
+   va_copy(sizing, args);
+   auto size = vsnprintf(nullptr, 0, fmt, sizing);
+   va_end(sizing);
+
+   std::string line(FormatLogTimestamp(CycleClock::now()));
+   line += ": ";
+   auto prefix = line.size();
+   line.resize(prefix + static_cast<size_t>(std::max(size, 0)) + 1);
+   vsnprintf(line.data() + prefix, line.size() - prefix, fmt, args);
+   va_end(args);
+   // vsnprintf terminator
+   line.pop_back();
+   traceSink->Write(std::move(line));
 }
 
-std::ofstream *logFile = nullptr;
-void CloseLogFile()
+OstreamProxy::OstreamProxy(LogSink &sink)
+    : m_sink(sink), m_nested(threadLineUsed ? std::make_unique<std::ostringstream>() : nullptr), m_line(m_nested ? *m_nested : threadLine)
 {
-   if (logFile != nullptr)
+   if (!m_nested)
    {
-      logFile->close();
-      logFile = nullptr;
+      threadLineUsed = true;
    }
 }
 
-std::ofstream &log()
+OstreamProxy::~OstreamProxy()
 {
-   if (logFile != nullptr)
+   m_sink.Write(std::move(m_line).str());
+   m_line.str({});
+   if (!m_nested)
    {
-      return *logFile;
+      threadLineUsed = false;
    }
+}
 
-   if (auto homepath = GetHomePath(); homepath.has_value())
-   {
-      std::string path = homepath.value() + R"(\JadaOdbcDetour2.txt)";
-      static std::ofstream out(path.c_str(), std::ios::ate | std::ios::out);
-      atexit(CloseLogFile);
-      return out;
-   }
-   // could not open log file, return NUL device
-   static std::ofstream nul(R"(.\NUL)", std::ios::ate | std::ios::out);
-   return nul;
+OstreamProxy::operator std::ostream &()
+{
+   auto now = FormatLogTimestamp(CycleClock::now());
+   m_line.write(now.data(), now.size());
+   m_line.write(": ", 2);
+   m_line.write(threadId.data(), threadId.size());
+   return m_line;
+}
+
+LogSink &log()
+{
+   InitSinks();
+   return *logSink;
 }
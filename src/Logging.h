@@ -1,17 +1,25 @@
-#include <fstream>
+#pragma once
+#include <memory>
+#include <sstream>
 
-// create a class proxy for an ostream that will flush the buffer after usage
+class LogSink;
+
+// proxy collecting one line of the log, the line is queued to the log writer when the proxy is destroyed
 class OstreamProxy
 {
  public:
-   OstreamProxy(std::ofstream &out);
+   OstreamProxy(LogSink &sink);
    ~OstreamProxy();
-   operator std::ofstream &();
+   operator std::ostream &();
 
  private:
-   std::ofstream &m_out;
+   LogSink &m_sink;
+   // buffer of the thread, or an own one when a line is logged while formatting another
+   std::unique_ptr<std::ostringstream> m_nested;
+   std::ostringstream &m_line;
 };
 
-std::ofstream &log();
+// JadaOdbcDetour2.txt in the home directory, see LogSink.h for its rotation
+LogSink &log();
 
 #define LOG OstreamProxy(log())
@@ -0,0 +1,290 @@
+#include "Metrics.h"
+#include "HandleRegistry.h"
+#include "Logging.h"
+#include "MetricsSegment.h"
+#include "Settings.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <print>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// bucket b counts the calls that took [2^(b-1), 2^b) nanoseconds
+constexpr size_t kLatencyBuckets = 48;
+
+using Histogram = std::array<uint64_t, kLatencyBuckets>;
+
+struct FunctionCounters
+{
+   std::atomic<uint64_t> calls{0};
+   std::atomic<uint64_t> errors{0};
+   // calls in flight are the ones started and not counted in calls yet
+   std::atomic<uint64_t> started{0};
+   std::atomic<uint64_t> totalNanoseconds{0};
+   std::atomic<uint64_t> queued{0};
+   std::atomic<uint64_t> queueWaitNanoseconds{0};
+   std::array<std::atomic<uint64_t>, kLatencyBuckets> latency{};
+};
+
+// counters of one thread, written by it alone and read by the publisher. A block outlives its thread, the next thread
+// started takes it over and its counts keep adding up
+struct alignas(kCacheLineSize) ThreadCounters
+{
+   std::array<FunctionCounters, kOdbcFunctionCount> functions;
+   // protected by blocksLock
+   bool owned = false;
+};
+
+std::mutex blocksLock;
+// never freed, there are as many as threads ever ran calls at the same time
+std::vector<ThreadCounters *> blocks;
+
+ThreadCounters *AcquireBlock()
+{
+   std::lock_guard lock(blocksLock);
+   auto it = std::ranges::find(blocks, false, &ThreadCounters::owned);
+   auto block = it != blocks.end() ? *it : blocks.emplace_back(new ThreadCounters());
+   block->owned = true;
+   return block;
+}
+
+struct ThreadBlock
+{
+   ThreadCounters *counters = AcquireBlock();
+
+   ~ThreadBlock()
+   {
+      std::lock_guard lock(blocksLock);
+      counters->owned = false;
+   }
+};
+
+thread_local ThreadBlock threadBlock;
+
+// the only writer of the counter, a plain load and store instead of a locked read-modify-write
+void Add(std::atomic<uint64_t> &counter, uint64_t value)
+{
+   counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+size_t LatencyBucket(uint64_t nanoseconds)
+{
+   return std::min<size_t>(std::bit_width(nanoseconds), kLatencyBuckets - 1);
+}
+
+// latency below which the given fraction of the calls fall, interpolated inside the bucket
+uint64_t Percentile(const Histogram &histogram, uint64_t count, double fraction)
+{
+   if (count == 0)
+   {
+      return 0;
+   }
+
+   auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(count))));
+   uint64_t seen = 0;
+   for (size_t bucket = 0; bucket < kLatencyBuckets; ++bucket)
+   {
+      if (seen + histogram[bucket] >= rank && histogram[bucket] != 0)
+      {
+         uint64_t low = bucket == 0 ? 0 : 1ull << (bucket - 1);
+         uint64_t high = 1ull << bucket;
+         return low + (high - low) * (rank - seen) / histogram[bucket];
+      }
+      seen += histogram[bucket];
+   }
+   return 0;
+}
+
+class MetricsPublisher
+{
+ public:
+   MetricsPublisher(HANDLE mapping, MetricsSegment *segment, std::chrono::milliseconds interval)
+       : m_mapping(mapping), m_segment(segment), m_interval(interval)
+   {
+      m_segment->magic = kMetricsMagic;
+      m_segment->version = kMetricsVersion;
+      m_snapshot.intervalMilliseconds = static_cast<uint64_t>(interval.count());
+      m_snapshot.functionCount = static_cast<uint32_t>(kOdbcFunctionCount);
+      for (size_t i = 0; i < kOdbcFunctionCount; ++i)
+      {
+         auto name = kOdbcFunctionNames[i];
+         name.copy(m_snapshot.functions[i].name, sizeof(m_snapshot.functions[i].name) - 1);
+      }
+      m_thread = std::jthread([this](std::stop_token stop)
+                              { Run(stop); });
+   }
+
+   ~MetricsPublisher()
+   {
+      m_thread.request_stop();
+      m_thread.join();
+      UnmapViewOfFile(m_segment);
+      CloseHandle(m_mapping);
+   }
+
+ private:
+   void Run(std::stop_token stop)
+   {
+      std::mutex mutex;
+      std::condition_variable_any wakeUp;
+      std::unique_lock lock(mutex);
+      while (!stop.stop_requested())
+      {
+         // woken up early only by a stop request
+         wakeUp.wait_for(lock, stop, m_interval, [] { return false; });
+         if (!stop.stop_requested())
+         {
+            Publish();
+         }
+      }
+   }
+
+   void Publish()
+   {
+      std::vector<ThreadCounters *> threads;
+      {
+         std::lock_guard lock(blocksLock);
+         threads = blocks;
+      }
+      for (size_t i = 0; i < kOdbcFunctionCount; ++i)
+      {
+         auto &target = m_snapshot.functions[i];
+         uint64_t started = 0;
+         Histogram totals{};
+         target.calls = target.errors = target.totalNanoseconds = target.queued = target.queueWaitNanoseconds = 0;
+         for (auto thread : threads)
+         {
+            auto &source = thread->functions[i];
+            // calls before started, a call ending meanwhile is not counted as ended before it started
+            target.calls += source.calls.load(std::memory_order_relaxed);
+            started += source.started.load(std::memory_order_relaxed);
+            target.errors += source.errors.load(std::memory_order_relaxed);
+            target.totalNanoseconds += source.totalNanoseconds.load(std::memory_order_relaxed);
+            target.queued += source.queued.load(std::memory_order_relaxed);
+            target.queueWaitNanoseconds += source.queueWaitNanoseconds.load(std::memory_order_relaxed);
+            for (size_t bucket = 0; bucket < kLatencyBuckets; ++bucket)
+            {
+               totals[bucket] += source.latency[bucket].load(std::memory_order_relaxed);
+            }
+         }
+         target.inFlight = started > target.calls ? started - target.calls : 0;
+
+         // percentiles of the last interval only, a lifetime histogram hides recent regressions
+         Histogram interval{};
+         uint64_t count = 0;
+         for (size_t bucket = 0; bucket < kLatencyBuckets; ++bucket)
+         {
+            auto total = totals[bucket];
+            interval[bucket] = total - m_previous[i][bucket];
+            m_previous[i][bucket] = total;
+            count += interval[bucket];
+         }
+         target.p50Nanoseconds = Percentile(interval, count, 0.50);
+         target.p95Nanoseconds = Percentile(interval, count, 0.95);
+         target.p99Nanoseconds = Percentile(interval, count, 0.99);
+      }
+
+      std::ranges::fill(m_snapshot.openHandles, 0);
+      GetHandleRegistry().ForEach([this](const HandleRecord &record)
+                                  {
+                                     if (record.type >= SQL_HANDLE_ENV && record.type <= SQL_HANDLE_DESC)
+                                     {
+                                        ++m_snapshot.openHandles[record.type - SQL_HANDLE_ENV];
+                                     } });
+
+      ++m_snapshot.publishCount;
+      m_snapshot.timestampMilliseconds = GetTickCount64();
+      WriteMetrics(*m_segment, m_snapshot);
+   }
+
+   HANDLE m_mapping;
+   MetricsSegment *m_segment;
+   std::chrono::milliseconds m_interval;
+   MetricsSnapshot m_snapshot{};
+   std::array<Histogram, kOdbcFunctionCount> m_previous{};
+   std::jthread m_thread;
+};
+
+std::mutex publisherLock;
+// intentionally leaked if the application exits without freeing its environments, joining the thread while the
+// loader lock is held would dead lock
+MetricsPublisher *publisher = nullptr;
+} // namespace
+
+bool MetricsEnabled()
+{
+   static const bool enabled = GetSettingBool("METRICS", false);
+   return enabled;
+}
+
+void RecordCallStart(size_t function)
+{
+   Add(threadBlock.counters->functions[function].started, 1);
+}
+
+void RecordCallEnd(size_t function, std::chrono::nanoseconds duration, SQLRETURN result)
+{
+   auto &counter = threadBlock.counters->functions[function];
+   auto nanoseconds = static_cast<uint64_t>(std::max<long long>(0, duration.count()));
+   Add(counter.calls, 1);
+   Add(counter.totalNanoseconds, nanoseconds);
+   Add(counter.latency[LatencyBucket(nanoseconds)], 1);
+   if (result == SQL_ERROR || result == SQL_INVALID_HANDLE)
+   {
+      Add(counter.errors, 1);
+   }
+}
+
+void RecordQueueWait(size_t function, std::chrono::nanoseconds wait)
+{
+   auto &counter = threadBlock.counters->functions[function];
+   Add(counter.queued, 1);
+   Add(counter.queueWaitNanoseconds, static_cast<uint64_t>(std::max<long long>(0, wait.count())));
+}
+
+void StartMetricsPublisher()
+{
+   if (!MetricsEnabled())
+   {
+      return;
+   }
+
+   std::lock_guard lock(publisherLock);
+   if (publisher != nullptr)
+   {
+      return;
+   }
+
+   auto name = MetricsSegmentName(GetCurrentProcessId());
+   auto mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(MetricsSegment), name.c_str());
+   if (mapping == nullptr)
+   {
+      std::print(LOG, "Failed to create the metrics segment: {}", GetLastError());
+      return;
+   }
+   auto segment = static_cast<MetricsSegment *>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(MetricsSegment)));
+   if (segment == nullptr)
+   {
+      std::print(LOG, "Failed to map the metrics segment: {}", GetLastError());
+      CloseHandle(mapping);
+      return;
+   }
+
+   auto interval = std::chrono::milliseconds(std::max<long long>(100, GetSettingInt("METRICS_INTERVAL_MS", 1000)));
+   publisher = new MetricsPublisher(mapping, segment, interval);
+}
+
+void StopMetricsPublisher()
+{
+   std::lock_guard lock(publisherLock);
+   delete publisher;
+   publisher = nullptr;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "Platform.h"
+
+#include <chrono>
+#include <cstddef>
+
+// live counters of the forwarded calls, by index in kOdbcFunctionNames
+//
+// enabled with ODBCDETOUR_METRICS=1. Each thread updates counters of its own, a publisher thread sums them into a
+// shared memory segment (see MetricsSegment.h) that odbcdetour-top reads.
+bool MetricsEnabled();
+
+void RecordCallStart(size_t function);
+void RecordCallEnd(size_t function, std::chrono::nanoseconds duration, SQLRETURN result);
+// time a call waited for admission before reaching the driver
+void RecordQueueWait(size_t function, std::chrono::nanoseconds wait);
+
+void StartMetricsPublisher();
+void StopMetricsPublisher();
@@ -0,0 +1,90 @@
+#pragma once
+#include "OdbcFunctions.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <string>
+
+// layout of the shared memory segment where the detour publishes its live counters, shared with odbcdetour-top
+//
+// the segment is written by a single publisher thread and guarded by a sequence lock: the sequence is odd while a
+// snapshot is being written, readers copy the snapshot and retry when the sequence moved during the copy.
+constexpr uint32_t kMetricsMagic = 0x4D54444F; // "ODTM"
+constexpr uint32_t kMetricsVersion = 2;
+
+struct MetricsFunction
+{
+   char name[32];
+   // totals since the driver was loaded
+   uint64_t calls;
+   uint64_t errors;
+   uint64_t inFlight;
+   uint64_t totalNanoseconds;
+   // calls that waited for admission and their total wait, not included in the latency
+   uint64_t queued;
+   uint64_t queueWaitNanoseconds;
+   // latency of the calls completed during the last publish interval
+   uint64_t p50Nanoseconds;
+   uint64_t p95Nanoseconds;
+   uint64_t p99Nanoseconds;
+};
+
+struct MetricsSnapshot
+{
+   uint64_t publishCount;
+   uint64_t intervalMilliseconds;
+   // GetTickCount64 when the snapshot was taken
+   uint64_t timestampMilliseconds;
+   // live handles by type: environment, connection, statement, descriptor
+   uint64_t openHandles[4];
+   uint32_t functionCount;
+   MetricsFunction functions[kOdbcFunctionCount];
+};
+
+struct MetricsSegment
+{
+   uint32_t magic;
+   uint32_t version;
+   std::atomic<uint64_t> sequence;
+   MetricsSnapshot snapshot;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the sequence is shared between processes");
+
+// name of the segment of a process
+inline std::wstring MetricsSegmentName(unsigned long processId)
+{
+   return std::format(L"Local\\OdbcDetour.Metrics.{}", processId);
+}
+
+// only called by the publisher thread
+inline void WriteMetrics(MetricsSegment &segment, const MetricsSnapshot &snapshot)
+{
+   auto sequence = segment.sequence.load(std::memory_order_relaxed);
+   segment.sequence.store(sequence + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+   std::memcpy(&segment.snapshot, &snapshot, sizeof(snapshot));
+   segment.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// false if no consistent snapshot could be read, the publisher kept writing
+inline bool ReadMetrics(const MetricsSegment &segment, MetricsSnapshot &snapshot)
+{
+   for (int attempt = 0; attempt < 100; ++attempt)
+   {
+      auto before = segment.sequence.load(std::memory_order_acquire);
+      if (before & 1)
+      {
+         continue;
+      }
+      std::memcpy(&snapshot, &segment.snapshot, sizeof(snapshot));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (segment.sequence.load(std::memory_order_relaxed) == before)
+      {
+         return true;
+      }
+   }
+   return false;
+}
@@ -6,17 +6,40 @@
  #include <odbcinst.h>
 // clang-format on
 
+#include "BlockFetch.h"
+#include "CallScope.h"
+#include "Clock.h"
+#include "Driver.h"
+#include "FaultInjection.h"
+#include "HandleRegistry.h"
 #include "Logging.h"
+#include "OdbcEntry.h"
+#include "OdbcFormatters.h"
+#include "OdbcFunctions.h"
+#include "PostedDiagnostics.h"
+#include "QueryWatchdog.h"
+#include "ResultCache.h"
+#include "Routing.h"
+#include "Services.h"
+#include "SpanExport.h"
+#include "SqlRewrite.h"
 #include "SqlInfoType.h"
+#include "Statement.h"
+#include "StringConversion.h"
+#include "TraceEvents.h"
+#include "TransactionProfiler.h"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdio>
-#include <map>
+#include <format>
 #include <optional>
 #include <print>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
@@ -27,734 +50,1006 @@
 
 // when function takes a SQLPOINTER the buffer size will always be in byte(octet) even if the parameter is a buffer to wchar_t!
 //
+// every entry point is instrumented the same way by Enter, see OdbcEntry.h, and forwards to the driver with
+// FowardToOdbcDll: the function is a compile time id of ODBC_FUNCTIONS, its signature the one of the odbc headers.
 namespace
 {
 
-std::map<std::string, FARPROC> odbc_functions;
-
-template <typename ProcType>
-std::optional<ProcType> findProc(const std::string &FuncName)
+// template function which find a function and then call it with all params by fowarding them
+template <OdbcFunctionId Id, typename... Args>
+auto FowardToOdbcDll(const Route &route, Args... args)
 {
-   std::optional<ProcType> result;
-   if (auto it = odbc_functions.find(FuncName); it != odbc_functions.end())
+   using ProcType = typename OdbcSignature<Id>::Proc;
+   using Result = std::invoke_result_t<ProcType, Args...>;
+   if (route.driver != nullptr)
    {
-      result.emplace(reinterpret_cast<ProcType>(it->second));
-      return result;
+      if (auto proc = route.driver->Find(Id); proc != nullptr)
+      {
+         // diagnostics posted by the detour only describe the previous call on the handle
+         if constexpr (Id != OdbcFunctionId::SQLGetDiagRecW && Id != OdbcFunctionId::SQLGetDiagFieldW)
+         {
+            if (route.record && route.record->hasPostedDiagnostics.load(std::memory_order_relaxed))
+            {
+               ClearPostedDiagnostics(*route.record);
+            }
+         }
+
+         CallScope scope(Id, route);
+         if (FaultInjectionEnabled())
+         {
+            if (auto injected = InjectFault(OdbcFunctionName(Id), route); injected)
+            {
+               if constexpr (!std::is_same_v<Result, BOOL>)
+               {
+                  scope.Complete(*injected);
+                  return Result{*injected};
+               }
+            }
+         }
+         auto result = reinterpret_cast<ProcType>(proc)(args...);
+         if constexpr (std::is_same_v<Result, BOOL>)
+            scope.Complete(result ? SQL_SUCCESS : SQL_ERROR);
+         else
+            scope.Complete(result);
+         return result;
+      }
    }
+   if constexpr (std::is_same_v<Result, BOOL>)
+      return Result{FALSE};
    else
-   {
-      return result;
-   }
+      return Result{SQL_ERROR};
 }
 
-// function to load odbc functions
-static bool LoadODBCFunctions(HMODULE hModule)
-{
-   // list of odbc functions to load
-   auto functionsToLoad = {
-       "ConfigDriverW",
-       "ConfigDSN",
-       "ConfigDSNW",
-       "SQLAllocConnect",
-       "SQLAllocEnv",
-       "SQLAllocHandle",
-       "SQLAllocStmt",
-       "SQLBindCol",
-       "SQLBindParameter",
-       "SQLBrowseConnectW",
-       "SQLBulkOperations",
-       "SQLCancel",
-       "SQLCancelHandle",
-       "SQLCloseCursor",
-       "SQLColAttributeW",
-       "SQLColumnPrivilegesW",
-       "SQLColumnsW",
-       "SQLCompleteAsync",
-       "SQLConnectW",
-       "SQLCopyDesc",
-       "SQLDescribeColW",
-       "SQLDescribeParam",
-       "SQLDisconnect",
-       "SQLDriverConnectW",
-       "SQLEndTran",
-       "SQLExecDirectW",
-       "SQLExecute",
-       "SQLExtendedFetch",
-       "SQLFetch",
-       "SQLFetchScroll",
-       "SQLFreeConnect",
-       "SQLFreeEnv",
-       "SQLFreeHandle",
-       "SQLFreeStmt",
-       "SQLGetConnectAttrW",
-       "SQLGetCursorNameW",
-       "SQLGetData",
-       "SQLGetDescFieldW",
-       "SQLGetDescRecW",
-       "SQLGetDiagFieldW",
-       "SQLGetDiagRecW",
-       "SQLGetEnvAttr",
-       "SQLGetFunctions",
-       "SQLGetInfoW",
-       "SQLGetStmtAttrW",
-       "SQLGetTypeInfoW",
-       "SQLMoreResults",
-       "SQLNativeSqlW",
-       "SQLNumParams",
-       "SQLNumResultCols",
-       "SQLParamData",
-       "SQLPrepareW",
-       "SQLPrimaryKeysW",
-       "SQLProcedureColumnsW",
-       "SQLProceduresW",
-       "SQLPutData",
-       "SQLRowCount",
-       "SQLSetConnectAttrW",
-       "SQLSetCursorNameW",
-       "SQLSetDescFieldW",
-       "SQLSetDescRec",
-       "SQLSetEnvAttr",
-       "SQLSetPos",
-       "SQLSetScrollOptions",
-       "SQLSetStmtAttrW",
-       "SQLSpecialColumnsW",
-       "SQLStatisticsW",
-       "SQLTablePrivilegesW",
-       "SQLTablesW"};
-
-   for (auto name : functionsToLoad)
-   {
-      if (auto proc = GetProcAddress(hModule, name); proc == nullptr)
-      {
-         std::print(LOG, "Failed to load function: {}", name);
-      }
-      else
-      {
-         odbc_functions[name] = proc;
-      }
-   }
-   return true;
+// forward to the driver of the handle, the first argument or the second after its type
+template <OdbcFunctionId Id, typename... Args>
+SQLRETURN FowardRouted(SQLHANDLE handle, Args... args)
+{
+   auto route = RouteHandle(handle);
+   return FowardToOdbcDll<Id>(route, route.handle, args...);
+}
+
+template <OdbcFunctionId Id, typename... Args>
+SQLRETURN FowardRouted(SQLSMALLINT handleType, SQLHANDLE handle, Args... args)
+{
+   auto route = RouteHandle(handle);
+   return FowardToOdbcDll<Id>(route, handleType, route.handle, args...);
 }
 
-static HMODULE proxiedDll = nullptr;
-int proxyDllRefCount = 0;
+// entry point without any behaviour of the detour
+template <OdbcFunctionId Id, typename... Args>
+SQLRETURN FowardEntry(Args... args)
+{
+   auto entry = Enter<Id>(args...);
+   return entry.Run([&]
+                    { return FowardRouted<Id>(args...); });
+}
 
-static bool InitializeLibrary()
+// replace the statement passed to the driver when a rewrite rule applies, buffer holds the rewritten text
+void ApplySqlRewrite(std::string &text, std::wstring &buffer, SQLTCHAR *&statement, SQLINTEGER &length)
 {
-   // not first time loading the dll
-   if (proxiedDll != nullptr)
+   if (auto rewritten = RewriteSql(text); rewritten)
    {
-      proxyDllRefCount++;
-      return true;
+      buffer = FromUtf8(*rewritten);
+      statement = reinterpret_cast<SQLTCHAR *>(buffer.data());
+      length = SQL_NTS;
+      text = std::move(*rewritten);
    }
+}
 
-#pragma message("Using hardcoded path to load the dll")
-   auto dllName = LR"(C:\Program Files\Microsoft Office\root\VFS\ProgramFilesCommonX64\Microsoft Shared\Office16\ACEODBC.DLL)";
-   // auto dllName = LR"(C:\Users\wonix\dev\JadaOdbc_gsl\build\x64\src\Debug\JadaOdbc.dll)";
-
-   auto hModule = LoadLibrary(dllName);
-
-   if (hModule == nullptr)
+// SQLEndTran of a connection, also for each connection of an environment
+SQLRETURN EndConnectionTransaction(SQLHDBC connection, SQLSMALLINT completionType)
+{
+   auto route = RouteHandle(connection);
+   auto start = CycleClock::now();
+   auto result = FowardToOdbcDll<OdbcFunctionId::SQLEndTran>(route, SQL_HANDLE_DBC, route.handle, completionType);
+   if (TransactionProfilingEnabled())
+   {
+      EndTransaction(connection, completionType, CycleClock::now() - start, result);
+   }
+   if (SpanExportEnabled())
    {
-      // std::print(LOG, "Failed to load {}", dllName);
-      return false;
+      EndSpanTransaction(route, completionType, CycleClock::now(), result);
    }
-   if (LoadODBCFunctions(hModule) == false)
+   if (route.record)
    {
-      FreeLibrary(hModule);
-      return false;
+      EndCachedTransaction(*route.record);
    }
-   proxyDllRefCount = 1;
-   proxiedDll = hModule;
-   return true;
+   return result;
 }
 
-void UninitializeLibrary()
+// execution of a statement whose cached result cannot answer the application, timed and watched like the application's
+SQLRETURN ExecuteAgain(const Route &route, std::wstring &directText)
 {
-   if (proxiedDll == nullptr)
+   QueryWatch watch(route);
+   if (directText.empty())
    {
-      return;
+      return watch.Complete(FowardToOdbcDll<OdbcFunctionId::SQLExecute>(route, route.handle));
    }
+   return watch.Complete(FowardToOdbcDll<OdbcFunctionId::SQLExecDirectW>(route, route.handle, reinterpret_cast<SQLTCHAR *>(directText.data()),
+                                                                         static_cast<SQLINTEGER>(directText.size())));
+}
 
-   if (!FreeLibrary(proxiedDll))
+// SQLAllocHandle, also behind the ODBC 2 allocation functions that are instrumented themselves
+SQLRETURN AllocateHandle(SQLSMALLINT handleType, SQLHANDLE inputHandle, SQLHANDLE *outputHandle)
+{
+   if (outputHandle == nullptr)
    {
-      return;
+      return SQL_ERROR;
    }
-
-   if (--proxyDllRefCount)
+   if (handleType == SQL_HANDLE_ENV)
+   {
+      *outputHandle = GetHandleRegistry().RegisterOwned(SQL_HANDLE_ENV, SQL_NULL_HANDLE)->handle;
+      AcquireServices();
+      return SQL_SUCCESS;
+   }
+   if (handleType == SQL_HANDLE_DBC)
+   {
+      if (!GetHandleRegistry().Find(inputHandle))
+      {
+         return SQL_INVALID_HANDLE;
+      }
+      // the environment is being freed by another thread
+      auto record = GetHandleRegistry().RegisterOwned(SQL_HANDLE_DBC, inputHandle);
+      if (!record)
+      {
+         return SQL_INVALID_HANDLE;
+      }
+      *outputHandle = record->handle;
+      return SQL_SUCCESS;
+   }
+   auto route = RouteHandle(inputHandle);
+   auto result = FowardToOdbcDll<OdbcFunctionId::SQLAllocHandle>(route, handleType, route.handle, outputHandle);
+   if (SQL_SUCCEEDED(result) && !GetHandleRegistry().Register(handleType, *outputHandle, inputHandle))
    {
-      proxiedDll = nullptr;
+      // the driver frees the handle with its parent
+      *outputHandle = SQL_NULL_HANDLE;
+      return SQL_INVALID_HANDLE;
    }
+   return result;
 }
 
-// template function which find a function and then call it with all params by fowarding them
-template <typename ProcType, typename... Args>
-auto FowardToOdbcDll(const std::string &FuncName, Args... args)
+// state of a handle the driver freed, SQLFreeHandle or SQLFreeStmt(SQL_DROP)
+void UnregisterFreedHandle(SQLSMALLINT handleType, SQLHANDLE handle)
 {
-
-   if (auto proc = findProc<ProcType>(FuncName); proc)
+   if (handleType == SQL_HANDLE_STMT && FetchProfilingEnabled())
+   {
+      if (auto record = GetHandleRegistry().Find(handle); record)
+      {
+         EndStatementFetches(*record);
+      }
+   }
+   GetHandleRegistry().Unregister(handle);
+   // also once the profiling was turned off, the connection may have been seen before
+   if (handleType == SQL_HANDLE_DBC)
    {
-      return (*proc)(args...);
+      ForgetConnectionTransactions(handle);
+   }
+   if (handleType == SQL_HANDLE_ENV)
+   {
+      ReleaseServices();
    }
-   ProcType proc;
-   decltype(proc(args...)) result{};
-   if constexpr (std::is_same_v<decltype(result), BOOL>)
-      return decltype(result){FALSE};
-   else
-      return decltype(result){SQL_ERROR};
 }
 
-template <typename ProcType, typename... Args>
-class FowardTraceODBC
+// SQLFreeHandle, also behind the ODBC 2 free functions
+SQLRETURN FreeHandle(SQLSMALLINT handleType, SQLHANDLE handle)
 {
- public:
-   FowardTraceODBC(const std::string &FuncName, Args... args)
+   SQLRETURN result = SQL_SUCCESS;
+   if (handleType == SQL_HANDLE_ENV || handleType == SQL_HANDLE_DBC)
+   {
+      auto record = GetHandleRegistry().Find(handle);
+      if (!record)
+      {
+         return SQL_INVALID_HANDLE;
+      }
+      result = handleType == SQL_HANDLE_ENV ? FreeDriverEnvironments(*record) : FreeDriverConnection(*record);
+   }
+   else
+   {
+      result = FowardRouted<OdbcFunctionId::SQLFreeHandle>(handleType, handle);
+   }
+   if (SQL_SUCCEEDED(result))
    {
-      std::print(LOG, R"(FowardTraceODBC({}, {}))", FuncName, args...);
+      UnregisterFreedHandle(handleType, handle);
    }
-};
+   return result;
+}
 } // namespace
 
-// SQLGetInfoW
-// SQLSetConnectAttrW
-// SQLSetConnectAttrW
-
+// environments and connections are owned by the detour: the target driver is only known once the connection string
+// or the DSN is, the driver handles are allocated when the connection is bound in SQLConnectW or SQLDriverConnectW
 SQLRETURN SQL_API SQLAllocConnect(SQLHENV environment_handle, SQLHDBC *connection_handle)
 {
-   std::print(LOG, R"(SQLAllocConnect({}, {}))", environment_handle, *connection_handle);
-   using SQLAllocConnectPtr = SQLRETURN(SQL_API *)(SQLHENV, SQLHDBC *);
-   return FowardToOdbcDll<SQLAllocConnectPtr>(__FUNCTION__, environment_handle, connection_handle);
+   auto entry = Enter<OdbcFunctionId::SQLAllocConnect>(environment_handle, connection_handle);
+   return entry.Run([&]
+                    { return AllocateHandle(SQL_HANDLE_DBC, environment_handle, connection_handle); });
 }
 
 SQLRETURN SQL_API SQLFreeConnect(SQLHDBC connection_handle)
 {
-   std::print(LOG, R"(SQLFreeConnect({}))", connection_handle);
-   using SQLFreeConnectPtr = SQLRETURN(SQL_API *)(SQLHDBC);
-   return FowardToOdbcDll<SQLFreeConnectPtr>(__FUNCTION__, connection_handle);
+   auto entry = Enter<OdbcFunctionId::SQLFreeConnect>(connection_handle);
+   return entry.Run([&]
+                    { return FreeHandle(SQL_HANDLE_DBC, connection_handle); });
 }
 
 SQLRETURN SQL_API SQLAllocEnv(SQLHENV *environment_handle)
 {
-   std::print(LOG, R"(SQLAllocEnv({}))", *environment_handle);
-   if (InitializeLibrary() == false)
-   {
-      return SQL_ERROR;
-   }
-   using SQLAllocEnvPtr = SQLRETURN(SQL_API *)(SQLHENV *);
-   return FowardToOdbcDll<SQLAllocEnvPtr>(__FUNCTION__, environment_handle);
+   auto entry = Enter<OdbcFunctionId::SQLAllocEnv>(environment_handle);
+   return entry.Run([&]
+                    { return AllocateHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, environment_handle); });
 }
 
 SQLRETURN SQL_API SQLFreeEnv(SQLHENV environment_handle)
 {
-   std::print(LOG, R"(SQLFreeEnv({}))", environment_handle);
-   using SQLFreeEnvPtr = SQLRETURN(SQL_API *)(SQLHENV);
-   auto result = FowardToOdbcDll<SQLFreeEnvPtr>(__FUNCTION__, environment_handle);
-   UninitializeLibrary();
-   return result;
+   auto entry = Enter<OdbcFunctionId::SQLFreeEnv>(environment_handle);
+   return entry.Run([&]
+                    { return FreeHandle(SQL_HANDLE_ENV, environment_handle); });
 }
 
 SQLRETURN SQL_API SQLAllocHandle(SQLSMALLINT handleType, SQLHANDLE inputHandle, SQLHANDLE *outputHandle)
 {
-   std::print(LOG, R"(SQLAllocHandle({}, {}, {}))", handleType, inputHandle, *outputHandle);
-
-   if (handleType == SQL_HANDLE_ENV)
-   {
-      if (InitializeLibrary() == false)
-      {
-         return SQL_ERROR;
-      }
-   }
-   using SQLAllocHandlePtr = SQLRETURN(SQL_API *)(SQLSMALLINT, SQLHANDLE, SQLHANDLE *);
-   auto result = FowardToOdbcDll<SQLAllocHandlePtr>(__FUNCTION__, handleType, inputHandle, outputHandle);
-   std::print(LOG, R"(SQLAllocHandle({}, {}, {}) -> {})", handleType, inputHandle, *outputHandle, result);
-   return result;
+   auto entry = Enter<OdbcFunctionId::SQLAllocHandle>(handleType, inputHandle, outputHandle);
+   return entry.Run([&]
+                    { return AllocateHandle(handleType, inputHandle, outputHandle); });
 }
 
 SQLRETURN SQL_API SQLFreeHandle(SQLSMALLINT handleType, SQLHANDLE handle)
 {
-   std::print(LOG, R"(SQLFreeHandle({}, {}))", handleType, handle);
-
-   using SQLFreeHandlePtr = SQLRETURN(SQL_API *)(SQLSMALLINT, SQLHANDLE);
-   auto result = FowardToOdbcDll<SQLFreeHandlePtr>(__FUNCTION__, handleType, handle);
-   if (handleType == SQL_HANDLE_ENV)
-   {
-      UninitializeLibrary();
-   }
-   return result;
+   auto entry = Enter<OdbcFunctionId::SQLFreeHandle>(handleType, handle);
+   return entry.Run([&]
+                    { return FreeHandle(handleType, handle); });
 }
 
 SQLRETURN SQL_API SQLAllocStmt(SQLHDBC connection_handle, SQLHSTMT *statement_handle)
 {
-   std::print(LOG, R"(SQLAllocStmt({}, {}))", connection_handle, *statement_handle);
-   using SQLAllocStmtPtr = SQLRETURN(SQL_API *)(SQLHDBC, SQLHSTMT *);
-   return FowardToOdbcDll<SQLAllocStmtPtr>(__FUNCTION__, connection_handle, statement_handle);
+   auto entry = Enter<OdbcFunctionId::SQLAllocStmt>(connection_handle, statement_handle);
+   return entry.Run([&]
+                    { return AllocateHandle(SQL_HANDLE_STMT, connection_handle, statement_handle); });
 }
 
 SQLRETURN SQL_API SQLFreeStmt(HSTMT statement_handle, SQLUSMALLINT option)
 {
-   std::print(LOG, R"(SQLFreeStmt({}, {}))", statement_handle, option);
-
-   using SQLFreeStmtPtr = SQLRETURN(SQL_API *)(HSTMT, SQLUSMALLINT);
-   return FowardToOdbcDll<SQLFreeStmtPtr>(__FUNCTION__, statement_handle, option);
-}
-
-template <typename Dest, typename Src>
-auto narrow_cast(Src v) -> Dest
-{
-   return static_cast<Dest>(v);
-}
-
-std::string ToUtf8(std::wstring_view wstr)
-{
-   std::string result;
-   if (wstr.size() != 0)
-   {
-      // assume conversion will have same number of characters
-      result.resize(wstr.size());
-      do
-      {
-         int size = WideCharToMultiByte(CP_UTF8, 0, wstr.data(), narrow_cast<int>(wstr.size()), result.data(), narrow_cast<int>(result.size()), nullptr, nullptr);
-         result.resize(size);
-         if (size <= wstr.size())
-         {
-            break;
-         }
-
-         result.resize(size);
-      } while (true);
-   }
-   return result;
-}
-
-std::string ReadString(const wchar_t *str, int size)
-{
-   if (str == nullptr || size == 0)
-   {
-      return "NULL";
-   }
-   // must be done after testing for SQL_NTS, as SQL_NTS is -3
-   if (size < 0 && size != SQL_NTS)
-   {
-      return "NULL";
-   }
-
-   std::wstring input;
-   if (size == SQL_NTS)
-   {
-      input = std::wstring(str);
-   }
-   else
-   {
-      input = std::wstring{str, static_cast<size_t>(size)};
-   }
-   return ToUtf8(input);
+   auto entry = Enter<OdbcFunctionId::SQLFreeStmt>(statement_handle, option);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(statement_handle);
+                       if (option == SQL_CLOSE || option == SQL_UNBIND)
+                       {
+                          EndBlockFetch(route);
+                       }
+                       if (option == SQL_CLOSE)
+                       {
+                          if (auto served = CloseCached(route, SQL_SUCCESS); served)
+                          {
+                             return *served;
+                          }
+                       }
+                       auto result = FowardToOdbcDll<OdbcFunctionId::SQLFreeStmt>(route, route.handle, option);
+                       if (option == SQL_DROP && SQL_SUCCEEDED(result))
+                       {
+                          UnregisterFreedHandle(SQL_HANDLE_STMT, statement_handle);
+                       }
+                       else if (option == SQL_RESET_PARAMS && SQL_SUCCEEDED(result) && route.record)
+                       {
+                          ResetStatementParameters(*route.record);
+                       }
+                       else if (option == SQL_UNBIND && SQL_SUCCEEDED(result) && route.record)
+                       {
+                          ResetStatementColumns(*route.record);
+                       }
+                       return result; });
 }
 
 SQLRETURN SQL_API SQLGetInfoW(SQLHDBC hdbc, SQLUSMALLINT infoType, SQLPOINTER outValue, SQLSMALLINT outValueMaxLength, SQLSMALLINT *outValueLength1)
 {
-   auto attrName = GetInfotypeName(infoType);
-
-   std::print(LOG, R"(SQLGetInfoW({}, {}, {}, {}, {}))", hdbc, attrName, outValue, outValueMaxLength, (void *)outValueLength1);
-
-   using SQLGetInfoWPtr = SQLRETURN(SQL_API *)(SQLHDBC, SQLUSMALLINT, SQLPOINTER, SQLSMALLINT, SQLSMALLINT *);
-   auto result = FowardToOdbcDll<SQLGetInfoWPtr>(__FUNCTION__, hdbc, infoType, outValue, outValueMaxLength, outValueLength1);
-   auto value = GetInfotypeValueAsString(infoType, outValue, outValueLength1);
-   std::print(LOG, R"({}({}, {}, "{}") -> {})", __FUNCTION__, hdbc, attrName, value, result);
-
-   return result;
+   auto entry = Enter<OdbcFunctionId::SQLGetInfoW>(hdbc, InfoType{infoType}, outValue, outValueMaxLength, outValueLength1);
+   return entry.Run([&]
+                    {
+                       if (TraceEventsEnabled())
+                       {
+                          AnnotateCall("infoType", std::format("{}", InfoType{infoType}));
+                       }
+                       auto result = FowardRouted<OdbcFunctionId::SQLGetInfoW>(hdbc, infoType, outValue, outValueMaxLength, outValueLength1);
+                       if (SQL_SUCCEEDED(result) && outValue != nullptr)
+                       {
+                          entry.Describe(std::format(R"("{}")", GetInfotypeValueAsString(infoType, outValue, outValueLength1)));
+                       }
+                       return result; });
 }
 
 SQLRETURN SQL_API SQLSetEnvAttr(SQLHENV hEnv, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER valueLen)
 {
-   std::print(LOG, R"(SQLSetEnvAttr({}, {}, {}, {}))", hEnv, attribute, value, valueLen);
-
-   using SQLSetEnvAttrPtr = SQLRETURN(SQL_API *)(SQLHENV, SQLINTEGER, SQLPOINTER, SQLINTEGER);
-   auto result = FowardToOdbcDll<SQLSetEnvAttrPtr>(__FUNCTION__, hEnv, attribute, value, valueLen);
-   std::print(LOG, R"(SQLSetEnvAttr({}, {}, {}, {}) -> {})", hEnv, attribute, value, valueLen, result);
-   return result;
+   auto entry = Enter<OdbcFunctionId::SQLSetEnvAttr>(hEnv, EnvAttribute{attribute}, value, valueLen);
+   // an environment may span several drivers
+   return entry.Run([&]
+                    { return SetEnvironmentAttribute(hEnv, attribute, value, valueLen); });
 }
 
 //
 SQLRETURN SQL_API SQLSetConnectAttrW(SQLHDBC hDbc, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER valueLen)
 {
-   std::print(LOG, R"(SQLSetConnectAttrW({}, {}, {}, {}))", hDbc, attribute, value, valueLen);
-   using SQLSetConnectAttrWPtr = SQLRETURN(SQL_API *)(SQLHDBC, SQLINTEGER, SQLPOINTER, SQLINTEGER);
-   return FowardToOdbcDll<SQLSetConnectAttrWPtr>(__FUNCTION__, hDbc, attribute, value, valueLen);
+   auto entry = Enter<OdbcFunctionId::SQLSetConnectAttrW>(hDbc, ConnectAttribute{attribute}, value, valueLen);
+   return entry.Run([&]() -> SQLRETURN
+                    {
+                       auto route = RouteHandle(hDbc);
+                       if (route.driver == nullptr)
+                       {
+                          // not connected yet, the attribute is replayed once the driver connection is allocated
+                          auto result = SetPendingAttribute(hDbc, attribute, value, valueLen);
+                          if (attribute == SQL_ATTR_AUTOCOMMIT && SQL_SUCCEEDED(result) && TransactionProfilingEnabled())
+                          {
+                             SetAutocommit(hDbc, reinterpret_cast<SQLULEN>(value) != SQL_AUTOCOMMIT_OFF);
+                          }
+                          if (attribute == SQL_ATTR_QUERY_TIMEOUT)
+                          {
+                             return CompleteQueryTimeout(route, reinterpret_cast<SQLULEN>(value), result);
+                          }
+                          return result;
+                       }
+                       auto result = FowardToOdbcDll<OdbcFunctionId::SQLSetConnectAttrW>(route, route.handle, attribute, value, valueLen);
+                       if (attribute == SQL_ATTR_AUTOCOMMIT && SQL_SUCCEEDED(result) && TransactionProfilingEnabled())
+                       {
+                          SetAutocommit(hDbc, reinterpret_cast<SQLULEN>(value) != SQL_AUTOCOMMIT_OFF);
+                       }
+                       if (attribute == SQL_ATTR_CURRENT_CATALOG && SQL_SUCCEEDED(result) && route.record && ResultCacheEnabled())
+                       {
+                          ForgetDatabase(*route.record);
+                       }
+                       if (attribute == SQL_ATTR_AUTOCOMMIT && reinterpret_cast<SQLULEN>(value) != SQL_AUTOCOMMIT_OFF && SQL_SUCCEEDED(result) && route.record)
+                       {
+                          // switching autocommit on commits the open transaction
+                          EndCachedTransaction(*route.record);
+                       }
+                       if (attribute == SQL_ATTR_QUERY_TIMEOUT)
+                       {
+                          // the watchdog enforces the timeout the driver does not support
+                          return CompleteQueryTimeout(route, reinterpret_cast<SQLULEN>(value), result);
+                       }
+                       return result; });
 }
 
 SQLRETURN SQL_API SQLSetStmtAttrW(SQLHSTMT hStmt, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER valueLen)
 {
-   std::print(LOG, R"(SQLSetStmtAttrW({}, {}, {}, {}))", hStmt, attribute, value, valueLen);
-   using SQLSetStmtAttrWPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLINTEGER, SQLPOINTER, SQLINTEGER);
-   return FowardToOdbcDll<SQLSetStmtAttrWPtr>(__FUNCTION__, hStmt, attribute, value, valueLen);
+   auto entry = Enter<OdbcFunctionId::SQLSetStmtAttrW>(hStmt, StmtAttribute{attribute}, value, valueLen);
+   return entry.Run([&]() -> SQLRETURN
+                    {
+                       auto route = RouteHandle(hStmt);
+                       if (auto refused = SetFetchAttribute(route, attribute, value); refused)
+                       {
+                          return *refused;
+                       }
+                       auto result = FowardToOdbcDll<OdbcFunctionId::SQLSetStmtAttrW>(route, route.handle, attribute, value, valueLen);
+                       if (SQL_SUCCEEDED(result) && route.record)
+                       {
+                          if (attribute == SQL_ATTR_APP_PARAM_DESC)
+                          {
+                             SetParameterDescriptor(*route.record, static_cast<SQLHDESC>(value));
+                          }
+                          SetParameterBindingAttribute(*route.record, attribute, value);
+                       }
+                       if (attribute == SQL_ATTR_QUERY_TIMEOUT)
+                       {
+                          // the watchdog enforces the timeout the driver does not support
+                          return CompleteQueryTimeout(route, reinterpret_cast<SQLULEN>(value), result);
+                       }
+                       return result; });
 }
 
 SQLRETURN SQL_API SQLGetEnvAttr(SQLHSTMT hEnv, SQLINTEGER attribute, SQLPOINTER outValue, SQLINTEGER outValueMaxLength, SQLINTEGER *outValueLength)
 {
-   std::print(LOG, R"(SQLGetEnvAttr({}, {}, {}, {}, {}))", hEnv, attribute, outValue, outValueMaxLength, *outValueLength);
-   using SQLGetEnvAttrPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLINTEGER, SQLPOINTER, SQLINTEGER, SQLINTEGER *);
-   return FowardToOdbcDll<SQLGetEnvAttrPtr>(__FUNCTION__, hEnv, attribute, outValue, outValueMaxLength, outValueLength);
+   auto entry = Enter<OdbcFunctionId::SQLGetEnvAttr>(hEnv, EnvAttribute{attribute}, outValue, outValueMaxLength, outValueLength);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(hEnv);
+                       if (route.driver == nullptr)
+                       {
+                          return GetPendingAttribute(hEnv, attribute, outValue, outValueMaxLength, outValueLength);
+                       }
+                       return FowardToOdbcDll<OdbcFunctionId::SQLGetEnvAttr>(route, route.handle, attribute, outValue, outValueMaxLength, outValueLength); });
 }
 
 SQLRETURN SQL_API SQLGetConnectAttrW(SQLHSTMT hDbc, SQLINTEGER attribute, SQLPOINTER outValue, SQLINTEGER outValueMaxLength, SQLINTEGER *outValueLength)
 {
-   std::print(LOG, R"(SQLGetConnectAttrW({}, {}, {}, {}, {}))", hDbc, attribute, outValue, outValueMaxLength, *outValueLength);
-   using SQLGetConnectAttrWPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLINTEGER, SQLPOINTER, SQLINTEGER, SQLINTEGER *);
-   return FowardToOdbcDll<SQLGetConnectAttrWPtr>(__FUNCTION__, hDbc, attribute, outValue, outValueMaxLength, outValueLength);
+   auto entry = Enter<OdbcFunctionId::SQLGetConnectAttrW>(hDbc, ConnectAttribute{attribute}, outValue, outValueMaxLength, outValueLength);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(hDbc);
+                       if (route.driver == nullptr)
+                       {
+                          return GetPendingAttribute(hDbc, attribute, outValue, outValueMaxLength, outValueLength);
+                       }
+                       return FowardToOdbcDll<OdbcFunctionId::SQLGetConnectAttrW>(route, route.handle, attribute, outValue, outValueMaxLength, outValueLength); });
 }
 SQLRETURN SQL_API SQLGetStmtAttrW(SQLHSTMT hStmt, SQLINTEGER attribute, SQLPOINTER outValue, SQLINTEGER outValueMaxLength, SQLINTEGER *outValueLength)
 {
-   // std::print(LOG, R"(SQLGetStmtAttrW({}, {}, {}, {}, {}))", hStmt, attribute, outValue, outValueMaxLength, *outValueLength);
-   using SQLGetStmtAttrWPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLINTEGER, SQLPOINTER, SQLINTEGER, SQLINTEGER *);
-   return FowardToOdbcDll<SQLGetStmtAttrWPtr>(__FUNCTION__, hStmt, attribute, outValue, outValueMaxLength, outValueLength);
+   auto entry = Enter<OdbcFunctionId::SQLGetStmtAttrW>(hStmt, StmtAttribute{attribute}, outValue, outValueMaxLength, outValueLength);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(hStmt);
+                       if (auto answered = GetFetchAttribute(route, attribute, outValue, outValueLength); answered)
+                       {
+                          return *answered;
+                       }
+                       auto result = FowardToOdbcDll<OdbcFunctionId::SQLGetStmtAttrW>(route, route.handle, attribute, outValue, outValueMaxLength, outValueLength);
+                       if (SQL_SUCCEEDED(result) && outValue != nullptr)
+                       {
+                          switch (attribute)
+                          {
+                          case SQL_ATTR_APP_ROW_DESC:
+                          case SQL_ATTR_APP_PARAM_DESC:
+                          case SQL_ATTR_IMP_ROW_DESC:
+                          case SQL_ATTR_IMP_PARAM_DESC:
+                             RegisterDescriptor(hStmt, *static_cast<SQLHDESC *>(outValue));
+                             break;
+                          default:
+                             break;
+                          }
+                       }
+                       return result; });
 }
 
 SQLRETURN SQL_API SQLConnectW(SQLHDBC ConnectionHandle, SQLTCHAR *serverName, SQLSMALLINT serverLength, SQLTCHAR *UserName, SQLSMALLINT NameLength2, SQLTCHAR *Authentication, SQLSMALLINT NameLength3)
 {
-   // std::print(LOG, R"(SQLConnectW({}, {}, {}, {}, {}, {}))", ConnectionHandle, serverName, serverLength, UserName, NameLength2, Authentication, NameLength3);
-   using SQLConnectWPtr = SQLRETURN(SQL_API *)(SQLHDBC, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT);
-   return FowardToOdbcDll<SQLConnectWPtr>(__FUNCTION__, ConnectionHandle, serverName, serverLength, UserName, NameLength2, Authentication, NameLength3);
+   auto entry = Enter<OdbcFunctionId::SQLConnectW>(ConnectionHandle, WideText{serverName, serverLength}, serverLength, UserName, NameLength2, Authentication, NameLength3);
+   return entry.Run([&]
+                    {
+                       if (auto bound = BindConnection(ConnectionHandle, ReadWideString(serverName, serverLength), L""); !SQL_SUCCEEDED(bound))
+                       {
+                          return bound;
+                       }
+                       return FowardRouted<OdbcFunctionId::SQLConnectW>(ConnectionHandle, serverName, serverLength, UserName, NameLength2, Authentication, NameLength3); });
 }
 
 SQLRETURN SQL_API SQLDriverConnectW(SQLHDBC ConnectionHandle, SQLHWND WindowHandle, SQLTCHAR *InConnectionString, SQLSMALLINT StringLength1, SQLTCHAR *OutConnectionString, SQLSMALLINT BufferLength, SQLSMALLINT *StringLength2Ptr, SQLUSMALLINT DriverCompletion)
 {
-   // std::print(LOG, R"(SQLDriverConnectW({}, {}, {}, {}, {}, {}, {}, {}))", ConnectionHandle, WindowHandle, InConnectionString, StringLength1, OutConnectionString, BufferLength, StringLength2Ptr, DriverCompletion);
-   using SQLDriverConnectWPtr = SQLRETURN(SQL_API *)(SQLHDBC, SQLHWND, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLSMALLINT *, SQLUSMALLINT);
-   return FowardToOdbcDll<SQLDriverConnectWPtr>(__FUNCTION__, ConnectionHandle, WindowHandle, InConnectionString, StringLength1, OutConnectionString, BufferLength, StringLength2Ptr, DriverCompletion);
+   // the connection string may hold a password, it is not logged
+   auto entry = Enter<OdbcFunctionId::SQLDriverConnectW>(ConnectionHandle, WindowHandle, InConnectionString, StringLength1, OutConnectionString, BufferLength, StringLength2Ptr, DriverCompletion);
+   return entry.Run([&]
+                    {
+                       auto connectionString = ReadWideString(InConnectionString, StringLength1);
+                       if (auto bound = BindConnection(ConnectionHandle, L"", connectionString); !SQL_SUCCEEDED(bound))
+                       {
+                          return bound;
+                       }
+                       SetSpanContext(ConnectionHandle, connectionString);
+                       return FowardRouted<OdbcFunctionId::SQLDriverConnectW>(ConnectionHandle, WindowHandle, InConnectionString, StringLength1, OutConnectionString, BufferLength, StringLength2Ptr, DriverCompletion); });
 }
 
 SQLRETURN SQL_API SQLPrepareW(HSTMT statement_handle, SQLTCHAR *statement_text, SQLINTEGER statement_text_size)
 {
-   // std::print(LOG, R"(SQLPrepareW({}, {}, {}))", statement_handle, statement_text, statement_text_size);
-   using SQLPrepareWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLTCHAR *, SQLINTEGER);
-   return FowardToOdbcDll<SQLPrepareWPtr>(__FUNCTION__, statement_handle, statement_text, statement_text_size);
+   auto entry = Enter<OdbcFunctionId::SQLPrepareW>(statement_handle, statement_text, statement_text_size);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(statement_handle);
+                       auto text = ReadString(reinterpret_cast<const wchar_t *>(statement_text), statement_text_size);
+                       std::wstring rewritten;
+                       if (SqlRewriteEnabled())
+                       {
+                          ApplySqlRewrite(text, rewritten, statement_text, statement_text_size);
+                       }
+                       if (TraceEventsEnabled())
+                       {
+                          AnnotateCall("sql", text);
+                       }
+                       if (route.record)
+                       {
+                          SetStatementText(*route.record, std::move(text));
+                       }
+                       CloseCached(route, SQL_SUCCESS);
+                       return FowardToOdbcDll<OdbcFunctionId::SQLPrepareW>(route, route.handle, statement_text, statement_text_size); });
 }
 
 SQLRETURN SQL_API SQLExecute(HSTMT statement_handle)
 {
-   std::print(LOG, R"(SQLExecute({}))", statement_handle);
-   using SQLExecutePtr = SQLRETURN(SQL_API *)(HSTMT);
-   return FowardToOdbcDll<SQLExecutePtr>(__FUNCTION__, statement_handle);
+   auto entry = Enter<OdbcFunctionId::SQLExecute>(statement_handle);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(statement_handle);
+                       EndBlockFetch(route);
+                       return ExecuteCached(route, {}, [&]
+                                            {
+                                               QueryWatch watch(route);
+                                               return watch.Complete(FowardToOdbcDll<OdbcFunctionId::SQLExecute>(route, route.handle)); }); });
 }
 
 SQLRETURN SQL_API SQLExecDirectW(HSTMT statement_handle, SQLTCHAR *statement_text, SQLINTEGER statement_text_size)
 {
-   // std::print(LOG, R"(SQLExecDirectW({}, {}, {}))", statement_handle, statement_text, statement_text_size);
-   using SQLExecDirectWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLTCHAR *, SQLINTEGER);
-   return FowardToOdbcDll<SQLExecDirectWPtr>(__FUNCTION__, statement_handle, statement_text, statement_text_size);
+   auto entry = Enter<OdbcFunctionId::SQLExecDirectW>(statement_handle, statement_text, statement_text_size);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(statement_handle);
+                       auto text = ReadString(reinterpret_cast<const wchar_t *>(statement_text), statement_text_size);
+                       std::wstring rewritten;
+                       if (SqlRewriteEnabled())
+                       {
+                          ApplySqlRewrite(text, rewritten, statement_text, statement_text_size);
+                       }
+                       if (TraceEventsEnabled())
+                       {
+                          AnnotateCall("sql", text);
+                       }
+                       if (route.record)
+                       {
+                          SetStatementText(*route.record, std::move(text));
+                       }
+                       EndBlockFetch(route);
+                       // kept to execute the statement again when a cached result cannot be served
+                       auto directText = ResultCacheEnabled() ? ReadWideString(reinterpret_cast<const wchar_t *>(statement_text), statement_text_size) : std::wstring();
+                       return ExecuteCached(route, directText, [&]
+                                            {
+                                               QueryWatch watch(route);
+                                               return watch.Complete(FowardToOdbcDll<OdbcFunctionId::SQLExecDirectW>(route, route.handle, statement_text, statement_text_size)); }); });
 }
 
 SQLRETURN SQL_API SQLNumResultCols(SQLHSTMT StatementHandle, SQLSMALLINT *ColumnCountPtr)
 {
-   std::print(LOG, R"(SQLNumResultCols({}, {}))", StatementHandle, *ColumnCountPtr);
-   using SQLNumResultColsPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLSMALLINT *);
-   return FowardToOdbcDll<SQLNumResultColsPtr>(__FUNCTION__, StatementHandle, ColumnCountPtr);
+   auto entry = Enter<OdbcFunctionId::SQLNumResultCols>(StatementHandle, ColumnCountPtr);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(StatementHandle);
+                       if (auto served = NumResultColsCached(route, ColumnCountPtr); served)
+                       {
+                          return *served;
+                       }
+                       return FowardToOdbcDll<OdbcFunctionId::SQLNumResultCols>(route, route.handle, ColumnCountPtr); });
 }
 
 SQLRETURN SQL_API SQLColAttributeW(SQLHSTMT statement_handle, SQLUSMALLINT column_number, SQLUSMALLINT field_identifier, SQLPOINTER out_string_value, SQLSMALLINT out_string_value_max_size, SQLSMALLINT *out_string_value_size, SQLLEN *out_num_value)
 {
-   std::print(LOG, R"(SQLColAttributeW({}, {}, {}, {}, {}, {}, {}))", statement_handle, column_number, field_identifier, out_string_value, out_string_value_max_size, *out_string_value_size, *out_num_value);
-   using SQLColAttributeWPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLUSMALLINT, SQLUSMALLINT, SQLPOINTER, SQLSMALLINT, SQLSMALLINT *, SQLLEN *);
-   return FowardToOdbcDll<SQLColAttributeWPtr>(__FUNCTION__, statement_handle, column_number, field_identifier, out_string_value, out_string_value_max_size, out_string_value_size, out_num_value);
+   auto entry = Enter<OdbcFunctionId::SQLColAttributeW>(statement_handle, column_number, ColumnAttribute{field_identifier}, out_string_value, out_string_value_max_size, out_string_value_size, out_num_value);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(statement_handle);
+                       if (auto served = ColAttributeCached(route, column_number, field_identifier, out_string_value, out_string_value_max_size, out_string_value_size, out_num_value, ExecuteAgain); served)
+                       {
+                          return *served;
+                       }
+                       return FowardToOdbcDll<OdbcFunctionId::SQLColAttributeW>(route, route.handle, column_number, field_identifier, out_string_value, out_string_value_max_size, out_string_value_size, out_num_value); });
 }
 
 SQLRETURN SQL_API SQLDescribeColW(HSTMT statement_handle, SQLUSMALLINT column_number, SQLTCHAR *out_column_name, SQLSMALLINT out_column_name_max_size, SQLSMALLINT *out_column_name_size, SQLSMALLINT *out_type, SQLULEN *out_column_size, SQLSMALLINT *out_decimal_digits, SQLSMALLINT *out_is_nullable)
 {
-   //   std::print(LOG, R"(SQLDescribeColW({}, {}, {}, {}, {}, {}, {}, {}, {}))", statement_handle, column_number, out_column_name, out_column_name_max_size, out_column_name_size, out_type, out_column_size, out_decimal_digits, out_is_nullable);
-   using SQLDescribeColWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLUSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLSMALLINT *, SQLSMALLINT *, SQLULEN *, SQLSMALLINT *, SQLSMALLINT *);
-   return FowardToOdbcDll<SQLDescribeColWPtr>(__FUNCTION__, statement_handle, column_number, out_column_name, out_column_name_max_size, out_column_name_size, out_type, out_column_size, out_decimal_digits, out_is_nullable);
+   auto entry = Enter<OdbcFunctionId::SQLDescribeColW>(statement_handle, column_number, out_column_name, out_column_name_max_size, out_column_name_size, out_type, out_column_size, out_decimal_digits, out_is_nullable);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(statement_handle);
+                       if (auto served = DescribeColCached(route, column_number, out_column_name, out_column_name_max_size, out_column_name_size, out_type, out_column_size, out_decimal_digits, out_is_nullable); served)
+                       {
+                          return *served;
+                       }
+                       auto result = FowardToOdbcDll<OdbcFunctionId::SQLDescribeColW>(route, route.handle, column_number, out_column_name, out_column_name_max_size, out_column_name_size, out_type, out_column_size, out_decimal_digits, out_is_nullable);
+                       if (SQL_SUCCEEDED(result) && out_column_size != nullptr)
+                       {
+                          RecordDescribedColumn(route, column_number, *out_column_size);
+                       }
+                       return result; });
 }
 SQLRETURN SQL_API SQLFetch(SQLHSTMT StatementHandle)
 {
-   std::print(LOG, R"(SQLFetch({}))", StatementHandle);
-   using SQLFetchPtr = SQLRETURN(SQL_API *)(SQLHSTMT);
-   return FowardToOdbcDll<SQLFetchPtr>(__FUNCTION__, StatementHandle);
+   auto entry = Enter<OdbcFunctionId::SQLFetch>(StatementHandle);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(StatementHandle);
+                       return FetchCached(route, [&]
+                                          { return FetchRow(route, [&]
+                                                            {
+                                                               QueryWatch watch(route);
+                                                               return watch.Complete(FowardToOdbcDll<OdbcFunctionId::SQLFetch>(route, route.handle)); }); },
+                                          ExecuteAgain); });
 }
 SQLRETURN SQL_API SQLFetchScroll(SQLHSTMT StatementHandle, SQLSMALLINT FetchOrientation, SQLLEN FetchOffset)
 {
-   std::print(LOG, R"(SQLFetchScroll({}, {}, {}))", StatementHandle, FetchOrientation, FetchOffset);
-   using SQLFetchScrollPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLSMALLINT, SQLLEN);
-   return FowardToOdbcDll<SQLFetchScrollPtr>(__FUNCTION__, StatementHandle, FetchOrientation, FetchOffset);
+   auto entry = Enter<OdbcFunctionId::SQLFetchScroll>(StatementHandle, FetchOrientation, FetchOffset);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(StatementHandle);
+                       auto fetch = [&]
+                       {
+                          QueryWatch watch(route);
+                          return watch.Complete(FowardToOdbcDll<OdbcFunctionId::SQLFetchScroll>(route, route.handle, FetchOrientation, FetchOffset));
+                       };
+                       if (FetchOrientation != SQL_FETCH_NEXT)
+                       {
+                          if (auto failed = ScrollCached(route, ExecuteAgain); failed)
+                          {
+                             return *failed;
+                          }
+                          return fetch();
+                       }
+                       return FetchCached(route, [&]
+                                          { return FetchRow(route, fetch); }, ExecuteAgain); });
 }
 SQLRETURN SQL_API SQLGetData(SQLHSTMT StatementHandle, SQLUSMALLINT Col_or_Param_Num, SQLSMALLINT TargetType, SQLPOINTER TargetValuePtr, SQLLEN BufferLength, SQLLEN *StrLen_or_IndPtr)
 {
-   std::print(LOG, R"(SQLGetData({}, {}, {}, {}, {}, {}))", StatementHandle, Col_or_Param_Num, TargetType, TargetValuePtr, BufferLength, *StrLen_or_IndPtr);
-   using SQLGetDataPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT, SQLPOINTER, SQLLEN, SQLLEN *);
-   return FowardToOdbcDll<SQLGetDataPtr>(__FUNCTION__, StatementHandle, Col_or_Param_Num, TargetType, TargetValuePtr, BufferLength, StrLen_or_IndPtr);
+   auto entry = Enter<OdbcFunctionId::SQLGetData>(StatementHandle, Col_or_Param_Num, CType{TargetType}, TargetValuePtr, BufferLength, StrLen_or_IndPtr);
+   return entry.Run([&]() -> SQLRETURN
+                    {
+                       auto route = RouteHandle(StatementHandle);
+                       if (IsBlockFetching(route))
+                       {
+                          // every column is bound, like a driver without SQL_GD_BOUND
+                          ClearPostedDiagnostics(*route.record);
+                          PostDiagnostic(*route.record, SQL_ERROR, L"07009", L"Invalid descriptor index, the column is bound");
+                          return SQL_ERROR;
+                       }
+                       return GetDataCached(route, Col_or_Param_Num, TargetType, TargetValuePtr, BufferLength, StrLen_or_IndPtr, [&]
+                                            { return FowardToOdbcDll<OdbcFunctionId::SQLGetData>(route, route.handle, Col_or_Param_Num, TargetType, TargetValuePtr, BufferLength, StrLen_or_IndPtr); }); });
 }
 SQLRETURN SQL_API SQLBindCol(SQLHSTMT StatementHandle, SQLUSMALLINT ColumnNumber, SQLSMALLINT TargetType, SQLPOINTER TargetValuePtr, SQLLEN BufferLength, SQLLEN *StrLen_or_Ind)
 {
-   std::print(LOG, R"(SQLBindCol({}, {}, {}, {}, {}, {}))", StatementHandle, ColumnNumber, TargetType, TargetValuePtr, BufferLength, *StrLen_or_Ind);
-   using SQLBindColPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT, SQLPOINTER, SQLLEN, SQLLEN *);
-   return FowardToOdbcDll<SQLBindColPtr>(__FUNCTION__, StatementHandle, ColumnNumber, TargetType, TargetValuePtr, BufferLength, StrLen_or_Ind);
+   auto entry = Enter<OdbcFunctionId::SQLBindCol>(StatementHandle, ColumnNumber, CType{TargetType}, TargetValuePtr, BufferLength, StrLen_or_Ind);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(StatementHandle);
+                       return BindColumn(route, ColumnNumber, {TargetType, TargetValuePtr, BufferLength, StrLen_or_Ind}, [&]
+                                         { return FowardToOdbcDll<OdbcFunctionId::SQLBindCol>(route, route.handle, ColumnNumber, TargetType, TargetValuePtr, BufferLength, StrLen_or_Ind); }); });
 }
 SQLRETURN SQL_API SQLRowCount(HSTMT statement_handle, SQLLEN *out_row_count)
 {
-   std::print(LOG, R"(SQLRowCount({}, {}))", statement_handle, *out_row_count);
-   using SQLRowCountPtr = SQLRETURN(SQL_API *)(HSTMT, SQLLEN *);
-   return FowardToOdbcDll<SQLRowCountPtr>(__FUNCTION__, statement_handle, out_row_count);
+   auto entry = Enter<OdbcFunctionId::SQLRowCount>(statement_handle, out_row_count);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(statement_handle);
+                       if (auto served = RowCountCached(route, out_row_count); served)
+                       {
+                          return *served;
+                       }
+                       auto result = FowardToOdbcDll<OdbcFunctionId::SQLRowCount>(route, route.handle, out_row_count);
+                       if (SQL_SUCCEEDED(result) && out_row_count != nullptr && TransactionProfilingEnabled())
+                       {
+                          RecordRowCount(route, *out_row_count);
+                       }
+                       return result; });
 }
 SQLRETURN SQL_API SQLMoreResults(HSTMT statement_handle)
 {
-   std::print(LOG, R"(SQLMoreResults({}))", statement_handle);
-   using SQLMoreResultsPtr = SQLRETURN(SQL_API *)(HSTMT);
-   return FowardToOdbcDll<SQLMoreResultsPtr>(__FUNCTION__, statement_handle);
+   auto entry = Enter<OdbcFunctionId::SQLMoreResults>(statement_handle);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(statement_handle);
+                       EndBlockFetch(route);
+                       if (auto served = CloseCached(route, SQL_NO_DATA); served)
+                       {
+                          // a cached result is a single SELECT
+                          return *served;
+                       }
+                       return FowardToOdbcDll<OdbcFunctionId::SQLMoreResults>(route, route.handle); });
 }
 SQLRETURN SQL_API SQLDisconnect(HDBC connection_handle)
 {
-   std::print(LOG, R"(SQLDisconnect({}))", connection_handle);
-   using SQLDisconnectPtr = SQLRETURN(SQL_API *)(HDBC);
-   return FowardToOdbcDll<SQLDisconnectPtr>(__FUNCTION__, connection_handle);
+   auto entry = Enter<OdbcFunctionId::SQLDisconnect>(connection_handle);
+   return entry.Run([&]
+                    {
+                       auto result = FowardRouted<OdbcFunctionId::SQLDisconnect>(connection_handle);
+                       if (SQL_SUCCEEDED(result))
+                       {
+                          if (TransactionProfilingEnabled())
+                          {
+                             AbandonTransaction(connection_handle);
+                          }
+                          // disconnecting frees all statements and explicitly allocated descriptors of the connection
+                          GetHandleRegistry().UnregisterChildren(connection_handle, SQL_HANDLE_STMT);
+                          GetHandleRegistry().UnregisterChildren(connection_handle, SQL_HANDLE_DESC);
+                       }
+                       return result; });
 }
 
 SQLRETURN SQL_API SQLGetDiagRecW(SQLSMALLINT handleType, SQLHANDLE handle, SQLSMALLINT record_number, SQLTCHAR *out_sqlstate, SQLINTEGER *out_native_error_code, SQLTCHAR *out_message, SQLSMALLINT out_message_max_size, SQLSMALLINT *out_message_size)
 {
-   // std::print(LOG, R"(SQLGetDiagRecW({}, {}, {}, {}, {}, {}, {}, {}))", handleType, handle, record_number, out_sqlstate, out_native_error_code, out_message, out_message_max_size, out_message_size);
-   using SQLGetDiagRecWPtr = SQLRETURN(SQL_API *)(SQLSMALLINT, SQLHANDLE, SQLSMALLINT, SQLTCHAR *, SQLINTEGER *, SQLTCHAR *, SQLSMALLINT, SQLSMALLINT *);
-   return FowardToOdbcDll<SQLGetDiagRecWPtr>(__FUNCTION__, handleType, handle, record_number, out_sqlstate, out_native_error_code, out_message, out_message_max_size, out_message_size);
+   auto entry = Enter<OdbcFunctionId::SQLGetDiagRecW>(handleType, handle, record_number, out_sqlstate, out_native_error_code, out_message, out_message_max_size, out_message_size);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(handle);
+                       std::optional<SQLRETURN> posted;
+                       if (route.record)
+                       {
+                          posted = GetPostedDiagRec(*route.record, record_number, out_sqlstate, out_native_error_code, out_message, out_message_max_size, out_message_size);
+                       }
+                       auto result = posted ? *posted : FowardToOdbcDll<OdbcFunctionId::SQLGetDiagRecW>(route, handleType, route.handle, record_number, out_sqlstate, out_native_error_code, out_message, out_message_max_size, out_message_size);
+                       if (SQL_SUCCEEDED(result))
+                       {
+                          entry.Describe(std::format(R"({} "{}")", ReadString(out_sqlstate, SQL_NTS),
+                                                     ReadString(out_message, out_message_size != nullptr ? std::min<int>(*out_message_size, out_message_max_size - 1) : SQL_NTS)));
+                       }
+                       return result; });
 }
 SQLRETURN SQL_API SQLGetDiagFieldW(SQLSMALLINT handleType, SQLHANDLE handle, SQLSMALLINT record_number, SQLSMALLINT field_id, SQLPOINTER out_message, SQLSMALLINT out_message_max_size, SQLSMALLINT *out_message_size)
 {
-   // std::print(LOG, R"(SQLGetDiagFieldW({}, {}, {}, {}, {}, {}, {}))", handleType, handle, record_number, field_id, out_message, out_message_max_size, out_message_size);
-   using SQLGetDiagFieldWPtr = SQLRETURN(SQL_API *)(SQLSMALLINT, SQLHANDLE, SQLSMALLINT, SQLSMALLINT, SQLPOINTER, SQLSMALLINT, SQLSMALLINT *);
-   return FowardToOdbcDll<SQLGetDiagFieldWPtr>(__FUNCTION__, handleType, handle, record_number, field_id, out_message, out_message_max_size, out_message_size);
+   auto entry = Enter<OdbcFunctionId::SQLGetDiagFieldW>(handleType, handle, record_number, field_id, out_message, out_message_max_size, out_message_size);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(handle);
+                       if (route.record)
+                       {
+                          if (auto posted = GetPostedDiagField(*route.record, record_number, field_id, out_message, out_message_max_size, out_message_size); posted)
+                          {
+                             return *posted;
+                          }
+                       }
+                       return FowardToOdbcDll<OdbcFunctionId::SQLGetDiagFieldW>(route, handleType, route.handle, record_number, field_id, out_message, out_message_max_size, out_message_size); });
 }
 
 SQLRETURN SQL_API SQLTablesW(SQLHSTMT StatementHandle, SQLTCHAR *CatalogName, SQLSMALLINT NameLength1, SQLTCHAR *SchemaName, SQLSMALLINT NameLength2, SQLTCHAR *TableName, SQLSMALLINT NameLength3, SQLTCHAR *TableType, SQLSMALLINT NameLength4)
 {
-   std::print(LOG, R"({}({}, "{}" "{}", "{}", "{}"))", __FUNCTION__, StatementHandle, ReadString(CatalogName, NameLength1), ReadString(SchemaName, NameLength2), ReadString(TableName, NameLength3), ReadString(TableType, NameLength4));
-   using SQLTablesWPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT);
-   return FowardToOdbcDll<SQLTablesWPtr>(__FUNCTION__, StatementHandle, CatalogName, NameLength1, SchemaName, NameLength2, TableName, NameLength3, TableType, NameLength4);
+   auto entry = Enter<OdbcFunctionId::SQLTablesW>(StatementHandle, WideText{CatalogName, NameLength1}, NameLength1, WideText{SchemaName, NameLength2}, NameLength2, WideText{TableName, NameLength3}, NameLength3, WideText{TableType, NameLength4}, NameLength4);
+   return entry.Run([&]
+                    { return FowardRouted<OdbcFunctionId::SQLTablesW>(StatementHandle, CatalogName, NameLength1, SchemaName, NameLength2, TableName, NameLength3, TableType, NameLength4); });
 }
 
 SQLRETURN SQL_API SQLColumnsW(SQLHSTMT StatementHandle, SQLTCHAR *CatalogName, SQLSMALLINT NameLength1, SQLTCHAR *SchemaName, SQLSMALLINT NameLength2, SQLTCHAR *TableName, SQLSMALLINT NameLength3, SQLTCHAR *ColumnName, SQLSMALLINT NameLength4)
 {
-   std::print(LOG, R"({}({}, "{}" "{}", "{}", "{}"))", __FUNCTION__, StatementHandle, ReadString(CatalogName, NameLength1), ReadString(SchemaName, NameLength2), ReadString(TableName, NameLength3), ReadString(ColumnName, NameLength4));
-   using SQLColumnsWPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT);
-   return FowardToOdbcDll<SQLColumnsWPtr>(__FUNCTION__, StatementHandle, CatalogName, NameLength1, SchemaName, NameLength2, TableName, NameLength3, ColumnName, NameLength4);
+   auto entry = Enter<OdbcFunctionId::SQLColumnsW>(StatementHandle, WideText{CatalogName, NameLength1}, NameLength1, WideText{SchemaName, NameLength2}, NameLength2, WideText{TableName, NameLength3}, NameLength3, WideText{ColumnName, NameLength4}, NameLength4);
+   return entry.Run([&]
+                    { return FowardRouted<OdbcFunctionId::SQLColumnsW>(StatementHandle, CatalogName, NameLength1, SchemaName, NameLength2, TableName, NameLength3, ColumnName, NameLength4); });
 }
 SQLRETURN SQL_API SQLGetTypeInfoW(SQLHSTMT statement_handle, SQLSMALLINT type)
 {
-   std::print(LOG, R"(SQLGetTypeInfoW({}, {}))", statement_handle, type);
-   using SQLGetTypeInfoWPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLSMALLINT);
-   return FowardToOdbcDll<SQLGetTypeInfoWPtr>(__FUNCTION__, statement_handle, type);
+   auto entry = Enter<OdbcFunctionId::SQLGetTypeInfoW>(statement_handle, SqlType{type});
+   return entry.Run([&]
+                    { return FowardRouted<OdbcFunctionId::SQLGetTypeInfoW>(statement_handle, type); });
 }
 
 SQLRETURN SQL_API SQLNumParams(SQLHSTMT StatementHandle, SQLSMALLINT *ParameterCountPtr)
 {
-   std::print(LOG, R"(SQLNumParams({}, {}))", StatementHandle, *ParameterCountPtr);
-   using SQLNumParamsPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLSMALLINT *);
-   return FowardToOdbcDll<SQLNumParamsPtr>(__FUNCTION__, StatementHandle, ParameterCountPtr);
+   return FowardEntry<OdbcFunctionId::SQLNumParams>(StatementHandle, ParameterCountPtr);
 }
 
 SQLRETURN SQL_API SQLNativeSqlW(HDBC connection_handle, SQLTCHAR *queryStr, SQLINTEGER query_length, SQLTCHAR *out_query, SQLINTEGER out_query_max_length, SQLINTEGER *out_query_length)
 {
-   // std::print(LOG, R"(SQLNativeSqlW({}, "{}", {}, "{}", {}, {}))", connection_handle, queryStr, query_length, out_query, out_query_max_length, out_query_length);
-   using SQLNativeSqlWPtr = SQLRETURN(SQL_API *)(HDBC, SQLTCHAR *, SQLINTEGER, SQLTCHAR *, SQLINTEGER, SQLINTEGER *);
-   return FowardToOdbcDll<SQLNativeSqlWPtr>(__FUNCTION__, connection_handle, queryStr, query_length, out_query, out_query_max_length, out_query_length);
+   return FowardEntry<OdbcFunctionId::SQLNativeSqlW>(connection_handle, queryStr, query_length, out_query, out_query_max_length, out_query_length);
 }
 
 SQLRETURN SQL_API SQLCloseCursor(HSTMT statement_handle)
 {
-   std::print(LOG, R"(SQLCloseCursor({}))", statement_handle);
-   using SQLCloseCursorPtr = SQLRETURN(SQL_API *)(HSTMT);
-   return FowardToOdbcDll<SQLCloseCursorPtr>(__FUNCTION__, statement_handle);
+   auto entry = Enter<OdbcFunctionId::SQLCloseCursor>(statement_handle);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(statement_handle);
+                       EndBlockFetch(route);
+                       if (auto served = CloseCached(route, SQL_SUCCESS); served)
+                       {
+                          return *served;
+                       }
+                       return FowardToOdbcDll<OdbcFunctionId::SQLCloseCursor>(route, route.handle); });
 }
 SQLRETURN SQL_API SQLBrowseConnectW(HDBC connection_handle, SQLTCHAR *szConnStrIn, SQLSMALLINT cbConnStrIn, SQLTCHAR *szConnStrOut, SQLSMALLINT cbConnStrOutMax, SQLSMALLINT *pcbConnStrOut)
 {
-   // std::print(LOG, R"(SQLBrowseConnectW({}, "{}", {}, "{}", {}, {}))", connection_handle, szConnStrIn, cbConnStrIn, szConnStrOut, cbConnStrOutMax, pcbConnStrOut);
-   using SQLBrowseConnectWPtr = SQLRETURN(SQL_API *)(HDBC, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLSMALLINT *);
-   return FowardToOdbcDll<SQLBrowseConnectWPtr>(__FUNCTION__, connection_handle, szConnStrIn, cbConnStrIn, szConnStrOut, cbConnStrOutMax, pcbConnStrOut);
+   // the connection string may hold a password, it is not logged
+   auto entry = Enter<OdbcFunctionId::SQLBrowseConnectW>(connection_handle, szConnStrIn, cbConnStrIn, szConnStrOut, cbConnStrOutMax, pcbConnStrOut);
+   return entry.Run([&]
+                    {
+                       auto connectionString = ReadWideString(szConnStrIn, cbConnStrIn);
+                       if (auto bound = BindConnection(connection_handle, L"", connectionString); !SQL_SUCCEEDED(bound))
+                       {
+                          return bound;
+                       }
+                       SetSpanContext(connection_handle, connectionString);
+                       return FowardRouted<OdbcFunctionId::SQLBrowseConnectW>(connection_handle, szConnStrIn, cbConnStrIn, szConnStrOut, cbConnStrOutMax, pcbConnStrOut); });
 }
 SQLRETURN SQL_API SQLCancel(SQLHSTMT StatementHandle)
 {
-   std::print(LOG, R"(SQLCancel({}))", StatementHandle);
-   using SQLCancelPtr = SQLRETURN(SQL_API *)(SQLHSTMT);
-   return FowardToOdbcDll<SQLCancelPtr>(__FUNCTION__, StatementHandle);
+   return FowardEntry<OdbcFunctionId::SQLCancel>(StatementHandle);
 }
 SQLRETURN SQL_API SQLGetCursorNameW(HSTMT StatementHandle, SQLTCHAR *CursorName, SQLSMALLINT BufferLength, SQLSMALLINT *NameLength)
 {
-   // std::print(LOG, R"(SQLGetCursorNameW({}, "{}", {}, {}))", StatementHandle, CursorName, BufferLength, NameLength);
-   using SQLGetCursorNameWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLSMALLINT *);
-   return FowardToOdbcDll<SQLGetCursorNameWPtr>(__FUNCTION__, StatementHandle, CursorName, BufferLength, NameLength);
+   return FowardEntry<OdbcFunctionId::SQLGetCursorNameW>(StatementHandle, CursorName, BufferLength, NameLength);
 }
 SQLRETURN SQL_API SQLGetFunctions(HDBC connection_handle, SQLUSMALLINT FunctionId, SQLUSMALLINT *Supported)
 {
-   // std::print(LOG, R"(SQLGetFunctions({}, {}, {}))", connection_handle, FunctionId, Supported);
-   using SQLGetFunctionsPtr = SQLRETURN(SQL_API *)(HDBC, SQLUSMALLINT, SQLUSMALLINT *);
-   return FowardToOdbcDll<SQLGetFunctionsPtr>(__FUNCTION__, connection_handle, FunctionId, Supported);
+   return FowardEntry<OdbcFunctionId::SQLGetFunctions>(connection_handle, FunctionId, Supported);
 }
 SQLRETURN SQL_API SQLParamData(HSTMT StatementHandle, PTR *Value)
 {
-   // std::print(LOG, R"(SQLParamData({}, {}))", StatementHandle, Value);
-   using SQLParamDataPtr = SQLRETURN(SQL_API *)(HSTMT, PTR *);
-   return FowardToOdbcDll<SQLParamDataPtr>(__FUNCTION__, StatementHandle, Value);
+   return FowardEntry<OdbcFunctionId::SQLParamData>(StatementHandle, Value);
 }
 SQLRETURN SQL_API SQLPutData(HSTMT StatementHandle, PTR Data, SQLLEN StrLen_or_Ind)
 {
-   std::print(LOG, R"(SQLPutData({}, {}, {}))", StatementHandle, Data, StrLen_or_Ind);
-   using SQLPutDataPtr = SQLRETURN(SQL_API *)(HSTMT, PTR, SQLLEN);
-   return FowardToOdbcDll<SQLPutDataPtr>(__FUNCTION__, StatementHandle, Data, StrLen_or_Ind);
+   return FowardEntry<OdbcFunctionId::SQLPutData>(StatementHandle, Data, StrLen_or_Ind);
 }
 SQLRETURN SQL_API SQLSetCursorNameW(HSTMT StatementHandle, SQLTCHAR *CursorName, SQLSMALLINT NameLength)
 {
-   // std::print(LOG, R"(SQLSetCursorNameW({}, "{}", {}))", StatementHandle, CursorName, NameLength);
-   using SQLSetCursorNameWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLTCHAR *, SQLSMALLINT);
-   return FowardToOdbcDll<SQLSetCursorNameWPtr>(__FUNCTION__, StatementHandle, CursorName, NameLength);
+   return FowardEntry<OdbcFunctionId::SQLSetCursorNameW>(StatementHandle, CursorName, NameLength);
 }
 
 SQLRETURN SQL_API SQLSpecialColumnsW(HSTMT StatementHandle, SQLUSMALLINT IdentifierType, SQLTCHAR *CatalogName, SQLSMALLINT NameLength1, SQLTCHAR *SchemaName, SQLSMALLINT NameLength2, SQLTCHAR *TableName, SQLSMALLINT NameLength3, SQLUSMALLINT Scope, SQLUSMALLINT Nullable)
 {
-   // std::print(LOG, R"(SQLSpecialColumnsW({}, {}, "{}", {}, "{}", {}, "{}", {}, {}, {}))", StatementHandle, IdentifierType, CatalogName, NameLength1, SchemaName, NameLength2, TableName, NameLength3, Scope, Nullable);
-   using SQLSpecialColumnsWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLUSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLUSMALLINT, SQLUSMALLINT);
-   return FowardToOdbcDll<SQLSpecialColumnsWPtr>(__FUNCTION__, StatementHandle, IdentifierType, CatalogName, NameLength1, SchemaName, NameLength2, TableName, NameLength3, Scope, Nullable);
+   return FowardEntry<OdbcFunctionId::SQLSpecialColumnsW>(StatementHandle, IdentifierType, CatalogName, NameLength1, SchemaName, NameLength2, TableName, NameLength3, Scope, Nullable);
 }
 
 SQLRETURN SQL_API SQLStatisticsW(HSTMT StatementHandle, SQLTCHAR *CatalogName, SQLSMALLINT NameLength1, SQLTCHAR *SchemaName, SQLSMALLINT NameLength2, SQLTCHAR *TableName, SQLSMALLINT NameLength3, SQLUSMALLINT Unique, SQLUSMALLINT Reserved)
 {
-   // std::print(LOG, R"(SQLStatisticsW({}, "{}", {}, "{}", {}, "{}", {}, {}, {}))", StatementHandle, CatalogName, NameLength1, SchemaName, NameLength2, TableName, NameLength3, Unique, Reserved);
-   using SQLStatisticsWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLUSMALLINT, SQLUSMALLINT);
-   return FowardToOdbcDll<SQLStatisticsWPtr>(__FUNCTION__, StatementHandle, CatalogName, NameLength1, SchemaName, NameLength2, TableName, NameLength3, Unique, Reserved);
+   return FowardEntry<OdbcFunctionId::SQLStatisticsW>(StatementHandle, CatalogName, NameLength1, SchemaName, NameLength2, TableName, NameLength3, Unique, Reserved);
 }
 SQLRETURN SQL_API SQLColumnPrivilegesW(HSTMT hstmt, SQLTCHAR *szCatalogName, SQLSMALLINT cbCatalogName, SQLTCHAR *szSchemaName, SQLSMALLINT cbSchemaName, SQLTCHAR *szTableName, SQLSMALLINT cbTableName, SQLTCHAR *szColumnName, SQLSMALLINT cbColumnName)
 {
-   // std::print(LOG, R"(SQLColumnPrivilegesW({}, "{}", {}, "{}", {}, "{}", {}, "{}", {}))", hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szTableName, cbTableName, szColumnName, cbColumnName);
-   using SQLColumnPrivilegesWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT);
-   return FowardToOdbcDll<SQLColumnPrivilegesWPtr>(__FUNCTION__, hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szTableName, cbTableName, szColumnName, cbColumnName);
+   return FowardEntry<OdbcFunctionId::SQLColumnPrivilegesW>(hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szTableName, cbTableName, szColumnName, cbColumnName);
 }
 
 SQLRETURN SQL_API SQLDescribeParam(SQLHSTMT StatementHandle, SQLUSMALLINT ParameterNumber, SQLSMALLINT *DataTypePtr, SQLULEN *ParameterSizePtr, SQLSMALLINT *DecimalDigitsPtr, SQLSMALLINT *NullablePtr)
 {
-   std::print(LOG, R"(SQLDescribeParam({}, {}, {}, {}, {}, {}))", StatementHandle, ParameterNumber, *DataTypePtr, *ParameterSizePtr, *DecimalDigitsPtr, *NullablePtr);
-   using SQLDescribeParamPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT *, SQLULEN *, SQLSMALLINT *, SQLSMALLINT *);
-   return FowardToOdbcDll<SQLDescribeParamPtr>(__FUNCTION__, StatementHandle, ParameterNumber, DataTypePtr, ParameterSizePtr, DecimalDigitsPtr, NullablePtr);
+   return FowardEntry<OdbcFunctionId::SQLDescribeParam>(StatementHandle, ParameterNumber, DataTypePtr, ParameterSizePtr, DecimalDigitsPtr, NullablePtr);
 }
 SQLRETURN SQL_API SQLExtendedFetch(SQLHSTMT StatementHandle, SQLUSMALLINT FetchOrientation, SQLLEN FetchOffset, SQLULEN *RowCountPtr, SQLUSMALLINT *RowStatusArray)
 {
-   std::print(LOG, R"(SQLExtendedFetch({}, {}, {}, {}, {}))", StatementHandle, FetchOrientation, FetchOffset, *RowCountPtr, *RowStatusArray);
-   using SQLExtendedFetchPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLUSMALLINT, SQLLEN, SQLULEN *, SQLUSMALLINT *);
-   return FowardToOdbcDll<SQLExtendedFetchPtr>(__FUNCTION__, StatementHandle, FetchOrientation, FetchOffset, RowCountPtr, RowStatusArray);
+   return FowardEntry<OdbcFunctionId::SQLExtendedFetch>(StatementHandle, FetchOrientation, FetchOffset, RowCountPtr, RowStatusArray);
 }
 SQLRETURN SQL_API SQLPrimaryKeysW(HSTMT hstmt, SQLTCHAR *szCatalogName, SQLSMALLINT cbCatalogName, SQLTCHAR *szSchemaName, SQLSMALLINT cbSchemaName, SQLTCHAR *szTableName, SQLSMALLINT cbTableName)
 {
-   // std::print(LOG, R"(SQLPrimaryKeysW({}, "{}", {}, "{}", {}, "{}", {}))", hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szTableName, cbTableName);
-   using SQLPrimaryKeysWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT);
-   return FowardToOdbcDll<SQLPrimaryKeysWPtr>(__FUNCTION__, hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szTableName, cbTableName);
+   return FowardEntry<OdbcFunctionId::SQLPrimaryKeysW>(hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szTableName, cbTableName);
 }
 
 SQLRETURN SQL_API SQLProcedureColumnsW(HSTMT hstmt, SQLTCHAR *szCatalogName, SQLSMALLINT cbCatalogName, SQLTCHAR *szSchemaName, SQLSMALLINT cbSchemaName, SQLTCHAR *szProcName, SQLSMALLINT cbProcName, SQLTCHAR *szColumnName, SQLSMALLINT cbColumnName)
 {
-   // std::print(LOG, R"(SQLProcedureColumnsW({}, "{}", {}, "{}", {}, "{}", {}, "{}", {}))", hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szProcName, cbProcName, szColumnName, cbColumnName);
-   using SQLProcedureColumnsWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT);
-   return FowardToOdbcDll<SQLProcedureColumnsWPtr>(__FUNCTION__, hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szProcName, cbProcName, szColumnName, cbColumnName);
+   return FowardEntry<OdbcFunctionId::SQLProcedureColumnsW>(hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szProcName, cbProcName, szColumnName, cbColumnName);
 }
 SQLRETURN SQL_API SQLProceduresW(HSTMT hstmt, SQLTCHAR *szCatalogName, SQLSMALLINT cbCatalogName, SQLTCHAR *szSchemaName, SQLSMALLINT cbSchemaName, SQLTCHAR *szProcName, SQLSMALLINT cbProcName)
 {
-   // std::print(LOG, R"(SQLProceduresW({}, "{}", {}, "{}", {}, "{}", {}))", hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szProcName, cbProcName);
-   using SQLProceduresWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT);
-   return FowardToOdbcDll<SQLProceduresWPtr>(__FUNCTION__, hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szProcName, cbProcName);
+   return FowardEntry<OdbcFunctionId::SQLProceduresW>(hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szProcName, cbProcName);
 }
 
 SQLRETURN SQL_API SQLSetPos(HSTMT hstmt, SQLSETPOSIROW irow, SQLUSMALLINT fOption, SQLUSMALLINT fLock)
 {
-   std::print(LOG, R"(SQLSetPos({}, {}, {}, {}))", hstmt, irow, fOption, fLock);
-   using SQLSetPosPtr = SQLRETURN(SQL_API *)(HSTMT, SQLSETPOSIROW, SQLUSMALLINT, SQLUSMALLINT);
-   return FowardToOdbcDll<SQLSetPosPtr>(__FUNCTION__, hstmt, irow, fOption, fLock);
+   auto entry = Enter<OdbcFunctionId::SQLSetPos>(hstmt, irow, fOption, fLock);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(hstmt);
+                       auto result = FowardToOdbcDll<OdbcFunctionId::SQLSetPos>(route, route.handle, irow, fOption, fLock);
+                       // SQL_UPDATE, SQL_DELETE, SQL_ADD and the driver specific options may change data. An operation on the
+                       // whole rowset can fail after changing its first rows, data at execution completes the change later
+                       auto changed = SQL_SUCCEEDED(result) || result == SQL_NEED_DATA || (result == SQL_ERROR && irow == 0);
+                       if (fOption != SQL_POSITION && fOption != SQL_REFRESH && changed)
+                       {
+                          InvalidateCachedResults(route);
+                       }
+                       return result; });
 }
 
 SQLRETURN SQL_API SQLTablePrivilegesW(HSTMT hstmt, SQLTCHAR *szCatalogName, SQLSMALLINT cbCatalogName, SQLTCHAR *szSchemaName, SQLSMALLINT cbSchemaName, SQLTCHAR *szTableName, SQLSMALLINT cbTableName)
 {
-   // std::print(LOG, R"(SQLTablePrivilegesW({}, "{}", {}, "{}", {}, "{}", {}))", hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szTableName, cbTableName);
-   using SQLTablePrivilegesWPtr = SQLRETURN(SQL_API *)(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT);
-   return FowardToOdbcDll<SQLTablePrivilegesWPtr>(__FUNCTION__, hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szTableName, cbTableName);
+   return FowardEntry<OdbcFunctionId::SQLTablePrivilegesW>(hstmt, szCatalogName, cbCatalogName, szSchemaName, cbSchemaName, szTableName, cbTableName);
 }
 SQLRETURN SQL_API SQLBindParameter(SQLHSTMT StatementHandle, SQLUSMALLINT ParameterNumber, SQLSMALLINT InputOutputType, SQLSMALLINT ValueType, SQLSMALLINT ParameterType, SQLULEN ColumnSize, SQLSMALLINT DecimalDigits, SQLPOINTER ParameterValuePtr, SQLLEN BufferLength, SQLLEN *StrLen_or_IndPtr)
 {
-   std::print(LOG, R"(SQLBindParameter({}, {}, {}, {}, {}, {}, {}, {}, {}, {}))", StatementHandle, ParameterNumber, InputOutputType, ValueType, ParameterType, ColumnSize, DecimalDigits, ParameterValuePtr, BufferLength, *StrLen_or_IndPtr);
-   using SQLBindParameterPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT, SQLSMALLINT, SQLSMALLINT, SQLULEN, SQLSMALLINT, SQLPOINTER, SQLLEN, SQLLEN *);
-   return FowardToOdbcDll<SQLBindParameterPtr>(__FUNCTION__, StatementHandle, ParameterNumber, InputOutputType, ValueType, ParameterType, ColumnSize, DecimalDigits, ParameterValuePtr, BufferLength, StrLen_or_IndPtr);
+   auto entry = Enter<OdbcFunctionId::SQLBindParameter>(StatementHandle, ParameterNumber, InputOutputType, CType{ValueType}, SqlType{ParameterType}, ColumnSize, DecimalDigits, ParameterValuePtr, BufferLength, StrLen_or_IndPtr);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(StatementHandle);
+                       auto result = FowardToOdbcDll<OdbcFunctionId::SQLBindParameter>(route, route.handle, ParameterNumber, InputOutputType, ValueType, ParameterType, ColumnSize, DecimalDigits, ParameterValuePtr, BufferLength, StrLen_or_IndPtr);
+                       if (SQL_SUCCEEDED(result) && route.record)
+                       {
+                          BindStatementParameter(*route.record, ParameterNumber, {InputOutputType, ValueType, ParameterType, ColumnSize, DecimalDigits, ParameterValuePtr, BufferLength, StrLen_or_IndPtr});
+                       }
+                       return result; });
 }
 SQLRETURN SQL_API SQLBulkOperations(SQLHSTMT StatementHandle, SQLSMALLINT Operation)
 {
-   std::print(LOG, R"(SQLBulkOperations({}, {}))", StatementHandle, Operation);
-   using SQLBulkOperationsPtr = SQLRETURN(SQL_API *)(SQLHSTMT, SQLSMALLINT);
-   return FowardToOdbcDll<SQLBulkOperationsPtr>(__FUNCTION__, StatementHandle, Operation);
+   auto entry = Enter<OdbcFunctionId::SQLBulkOperations>(StatementHandle, Operation);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(StatementHandle);
+                       auto result = FowardToOdbcDll<OdbcFunctionId::SQLBulkOperations>(route, route.handle, Operation);
+                       InvalidateCachedResults(route);
+                       return result; });
 }
 
 SQLRETURN SQL_API SQLCancelHandle(SQLSMALLINT HandleType, SQLHANDLE Handle)
 {
-   std::print(LOG, R"(SQLCancelHandle({}, {}))", HandleType, Handle);
-   using SQLCancelHandlePtr = SQLRETURN(SQL_API *)(SQLSMALLINT, SQLHANDLE);
-   return FowardToOdbcDll<SQLCancelHandlePtr>(__FUNCTION__, HandleType, Handle);
+   return FowardEntry<OdbcFunctionId::SQLCancelHandle>(HandleType, Handle);
 }
 
 SQLRETURN SQL_API SQLCompleteAsync(SQLSMALLINT HandleType, SQLHANDLE Handle, RETCODE *AsyncRetCodePtr)
 {
-   std::print(LOG, R"(SQLCompleteAsync({}, {}, {}))", HandleType, Handle, *AsyncRetCodePtr);
-   using SQLCompleteAsyncPtr = SQLRETURN(SQL_API *)(SQLSMALLINT, SQLHANDLE, RETCODE *);
-   return FowardToOdbcDll<SQLCompleteAsyncPtr>(__FUNCTION__, HandleType, Handle, AsyncRetCodePtr);
+   return FowardEntry<OdbcFunctionId::SQLCompleteAsync>(HandleType, Handle, AsyncRetCodePtr);
 }
 SQLRETURN SQL_API SQLEndTran(SQLSMALLINT HandleType, SQLHANDLE Handle, SQLSMALLINT CompletionType)
 {
-   std::print(LOG, R"(SQLEndTran({}, {}, {}))", HandleType, Handle, CompletionType);
-   using SQLEndTranPtr = SQLRETURN(SQL_API *)(SQLSMALLINT, SQLHANDLE, SQLSMALLINT);
-   return FowardToOdbcDll<SQLEndTranPtr>(__FUNCTION__, HandleType, Handle, CompletionType);
+   auto entry = Enter<OdbcFunctionId::SQLEndTran>(HandleType, Handle, CompletionType);
+   return entry.Run([&]
+                    {
+                       if (HandleType == SQL_HANDLE_ENV)
+                       {
+                          // the connections of an environment may be served by different drivers
+                          return EndEnvironmentTransactions(Handle, CompletionType, EndConnectionTransaction);
+                       }
+                       if (HandleType == SQL_HANDLE_DBC)
+                       {
+                          return EndConnectionTransaction(Handle, CompletionType);
+                       }
+                       return FowardRouted<OdbcFunctionId::SQLEndTran>(HandleType, Handle, CompletionType); });
 }
 SQLRETURN SQL_API SQLGetDescFieldW(SQLHDESC DescriptorHandle, SQLSMALLINT RecNumber, SQLSMALLINT FieldIdentifier, SQLPOINTER ValuePtr, SQLINTEGER BufferLength, SQLINTEGER *StringLengthPtr)
 {
-   std::print(LOG, R"(SQLGetDescFieldW({}, {}, {}, {}, {}, {}))", DescriptorHandle, RecNumber, FieldIdentifier, ValuePtr, BufferLength, *StringLengthPtr);
-   using SQLGetDescFieldWPtr = SQLRETURN(SQL_API *)(SQLHDESC, SQLSMALLINT, SQLSMALLINT, SQLPOINTER, SQLINTEGER, SQLINTEGER *);
-   return FowardToOdbcDll<SQLGetDescFieldWPtr>(__FUNCTION__, DescriptorHandle, RecNumber, FieldIdentifier, ValuePtr, BufferLength, StringLengthPtr);
+   auto entry = Enter<OdbcFunctionId::SQLGetDescFieldW>(DescriptorHandle, RecNumber, DescField{FieldIdentifier}, ValuePtr, BufferLength, StringLengthPtr);
+   return entry.Run([&]
+                    { return FowardRouted<OdbcFunctionId::SQLGetDescFieldW>(DescriptorHandle, RecNumber, FieldIdentifier, ValuePtr, BufferLength, StringLengthPtr); });
 }
 SQLRETURN SQL_API SQLGetDescRecW(SQLHDESC DescriptorHandle, SQLSMALLINT RecNumber, SQLTCHAR *Name, SQLSMALLINT BufferLength, SQLSMALLINT *StringLengthPtr, SQLSMALLINT *TypePtr, SQLSMALLINT *SubTypePtr, SQLLEN *LengthPtr, SQLSMALLINT *PrecisionPtr, SQLSMALLINT *ScalePtr, SQLSMALLINT *NullablePtr)
 {
-   // std::print(LOG, R"(SQLGetDescRecW({}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}))", DescriptorHandle, RecNumber, Name, BufferLength, StringLengthPtr, TypePtr, SubTypePtr, LengthPtr, PrecisionPtr, ScalePtr, NullablePtr);
-   using SQLGetDescRecWPtr = SQLRETURN(SQL_API *)(SQLHDESC, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLSMALLINT *, SQLSMALLINT *, SQLSMALLINT *, SQLLEN *, SQLSMALLINT *, SQLSMALLINT *, SQLSMALLINT *);
-   return FowardToOdbcDll<SQLGetDescRecWPtr>(__FUNCTION__, DescriptorHandle, RecNumber, Name, BufferLength, StringLengthPtr, TypePtr, SubTypePtr, LengthPtr, PrecisionPtr, ScalePtr, NullablePtr);
+   return FowardEntry<OdbcFunctionId::SQLGetDescRecW>(DescriptorHandle, RecNumber, Name, BufferLength, StringLengthPtr, TypePtr, SubTypePtr, LengthPtr, PrecisionPtr, ScalePtr, NullablePtr);
 }
 SQLRETURN SQL_API SQLSetDescFieldW(SQLHDESC DescriptorHandle, SQLSMALLINT RecNumber, SQLSMALLINT FieldIdentifier, SQLPOINTER ValuePtr, SQLINTEGER BufferLength)
 {
-   std::print(LOG, R"(SQLSetDescFieldW({}, {}, {}, {}, {}))", DescriptorHandle, RecNumber, FieldIdentifier, ValuePtr, BufferLength);
-   using SQLSetDescFieldWPtr = SQLRETURN(SQL_API *)(SQLHDESC, SQLSMALLINT, SQLSMALLINT, SQLPOINTER, SQLINTEGER);
-   return FowardToOdbcDll<SQLSetDescFieldWPtr>(__FUNCTION__, DescriptorHandle, RecNumber, FieldIdentifier, ValuePtr, BufferLength);
+   auto entry = Enter<OdbcFunctionId::SQLSetDescFieldW>(DescriptorHandle, RecNumber, DescField{FieldIdentifier}, ValuePtr, BufferLength);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(DescriptorHandle);
+                       RecordDescriptorChange(route);
+                       RecordCachedDescriptorChange(route);
+                       return FowardToOdbcDll<OdbcFunctionId::SQLSetDescFieldW>(route, route.handle, RecNumber, FieldIdentifier, ValuePtr, BufferLength); });
 }
 SQLRETURN SQL_API SQLSetDescRec(SQLHDESC DescriptorHandle, SQLSMALLINT RecNumber, SQLSMALLINT Type, SQLSMALLINT SubType, SQLLEN Length, SQLSMALLINT Precision, SQLSMALLINT Scale, SQLPOINTER DataPtr, SQLLEN *StringLengthPtr, SQLLEN *IndicatorPtr)
 {
-   std::print(LOG, R"(SQLSetDescRec({}, {}, {}, {}, {}, {}, {}, {}, {}, {}))", DescriptorHandle, RecNumber, Type, SubType, Length, Precision, Scale, DataPtr, *StringLengthPtr, *IndicatorPtr);
-   using SQLSetDescRecPtr = SQLRETURN(SQL_API *)(SQLHDESC, SQLSMALLINT, SQLSMALLINT, SQLSMALLINT, SQLLEN, SQLSMALLINT, SQLSMALLINT, SQLPOINTER, SQLLEN *, SQLLEN *);
-   return FowardToOdbcDll<SQLSetDescRecPtr>(__FUNCTION__, DescriptorHandle, RecNumber, Type, SubType, Length, Precision, Scale, DataPtr, StringLengthPtr, IndicatorPtr);
+   auto entry = Enter<OdbcFunctionId::SQLSetDescRec>(DescriptorHandle, RecNumber, SqlType{Type}, SubType, Length, Precision, Scale, DataPtr, StringLengthPtr, IndicatorPtr);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(DescriptorHandle);
+                       RecordDescriptorChange(route);
+                       RecordCachedDescriptorChange(route);
+                       return FowardToOdbcDll<OdbcFunctionId::SQLSetDescRec>(route, route.handle, RecNumber, Type, SubType, Length, Precision, Scale, DataPtr, StringLengthPtr, IndicatorPtr); });
 }
 SQLRETURN SQL_API SQLCopyDesc(SQLHDESC SourceDescHandle, SQLHDESC TargetDescHandle)
 {
-   std::print(LOG, R"(SQLCopyDesc({}, {}))", SourceDescHandle, TargetDescHandle);
-   using SQLCopyDescPtr = SQLRETURN(SQL_API *)(SQLHDESC, SQLHDESC);
-   return FowardToOdbcDll<SQLCopyDescPtr>(__FUNCTION__, SourceDescHandle, TargetDescHandle);
+   auto entry = Enter<OdbcFunctionId::SQLCopyDesc>(SourceDescHandle, TargetDescHandle);
+   return entry.Run([&]
+                    {
+                       auto route = RouteHandle(SourceDescHandle);
+                       auto target = RouteHandle(TargetDescHandle);
+                       RecordDescriptorChange(target);
+                       RecordCachedDescriptorChange(target);
+                       return FowardToOdbcDll<OdbcFunctionId::SQLCopyDesc>(route, route.handle, TargetDescHandle); });
+}
+
+namespace
+{
+// installer attributes are a list of null terminated "key=value" strings ended by an empty string
+template <typename Char>
+std::wstring ToConnectionString(const Char *attributes)
+{
+   std::wstring result;
+   for (auto attribute = attributes; attribute != nullptr && *attribute != 0; attribute += std::char_traits<Char>::length(attribute) + 1)
+   {
+      for (auto c = attribute; *c != 0; ++c)
+      {
+         result += static_cast<wchar_t>(*c);
+      }
+      result += L';';
+   }
+   return result;
+}
+
+// installer call forwarded to the target driver, loaded for the duration of the call
+template <OdbcFunctionId Id, typename... Args>
+BOOL FowardInstallerCall(const std::wstring &connectionString, Args... args)
+{
+   auto driver = AcquireDriver(ResolveTargetDriver(L"", connectionString));
+   auto result = FowardToOdbcDll<Id>(Route{driver, SQL_NULL_HANDLE, {}}, args...);
+   ReleaseDriver(driver);
+   return result;
 }
+} // namespace
 
+// installer functions are called without any handle, the target driver is loaded for the duration of the call
 BOOL INSTAPI ConfigDSNW(HWND hwnd, WORD fRequest, LPCWSTR lpszDriver, LPCWSTR lpszAttributes)
 {
-   //   std::print(LOG, R"(ConfigDSNW({}, {}, "{}", "{}"))", (void *)hwnd, fRequest, lpszDriver, lpszAttributes);
-   using ConfigDSNWPtr = BOOL(INSTAPI *)(HWND, WORD, LPCWSTR, LPCWSTR);
-   return FowardToOdbcDll<ConfigDSNWPtr>(__FUNCTION__, hwnd, fRequest, lpszDriver, lpszAttributes);
+   auto entry = Enter<OdbcFunctionId::ConfigDSNW>(hwnd, fRequest, WideText{lpszDriver, SQL_NTS}, lpszAttributes);
+   return entry.Run([&]
+                    { return FowardInstallerCall<OdbcFunctionId::ConfigDSNW>(ToConnectionString(lpszAttributes), hwnd, fRequest, lpszDriver, lpszAttributes); });
 }
 
 BOOL INSTAPI ConfigDSN(HWND hwnd, WORD fRequest, LPCSTR lpszDriver, LPCSTR lpszAttributes)
 {
-   std::print(LOG, R"(ConfigDSN({}, {}, "{}", "{}"))", (void *)hwnd, fRequest, lpszDriver, lpszAttributes);
-   using ConfigDSNPtr = BOOL(INSTAPI *)(HWND, WORD, LPCSTR, LPCSTR);
-   return FowardToOdbcDll<ConfigDSNPtr>(__FUNCTION__, hwnd, fRequest, lpszDriver, lpszAttributes);
+   auto entry = Enter<OdbcFunctionId::ConfigDSN>(hwnd, fRequest, std::string_view(lpszDriver != nullptr ? lpszDriver : ""), lpszAttributes);
+   return entry.Run([&]
+                    { return FowardInstallerCall<OdbcFunctionId::ConfigDSN>(ToConnectionString(lpszAttributes), hwnd, fRequest, lpszDriver, lpszAttributes); });
 }
 
 BOOL INSTAPI ConfigDriverW(HWND hwnd, WORD fRequest, LPCWSTR lpszDriver, LPCWSTR lpszArgs, LPWSTR lpszMsg, WORD cbMsgMax, WORD *pcbMsgOut)
 {
-   //   std::print(LOG, R"(ConfigDriverW({}, {}, "{}", "{}", "{}", {}, {}))", (void *)hwnd, fRequest, lpszDriver, lpszArgs, lpszMsg, cbMsgMax, pcbMsgOut);
-   using ConfigDriverWPtr = BOOL(INSTAPI *)(HWND, WORD, LPCWSTR, LPCWSTR, LPWSTR, WORD, WORD *);
-   return FowardToOdbcDll<ConfigDriverWPtr>(__FUNCTION__, hwnd, fRequest, lpszDriver, lpszArgs, lpszMsg, cbMsgMax, pcbMsgOut);
+   auto entry = Enter<OdbcFunctionId::ConfigDriverW>(hwnd, fRequest, WideText{lpszDriver, SQL_NTS}, WideText{lpszArgs, SQL_NTS}, lpszMsg, cbMsgMax, pcbMsgOut);
+   return entry.Run([&]
+                    { return FowardInstallerCall<OdbcFunctionId::ConfigDriverW>(L"", hwnd, fRequest, lpszDriver, lpszArgs, lpszMsg, cbMsgMax, pcbMsgOut); });
 }
 
 SQLRETURN SQL_API SQLSetScrollOptions(HSTMT hstmt, SQLUSMALLINT fConcurrency, SQLLEN crowKeyset, SQLUSMALLINT crowRowset)
 {
-   std::print(LOG, R"(SQLSetScrollOptions({}, {}, {}, {}))", hstmt, fConcurrency, crowKeyset, crowRowset);
-   using SQLSetScrollOptionsPtr = SQLRETURN(SQL_API *)(HSTMT, SQLUSMALLINT, SQLLEN, SQLUSMALLINT);
-   return FowardToOdbcDll<SQLSetScrollOptionsPtr>(__FUNCTION__, hstmt, fConcurrency, crowKeyset, crowRowset);
+   return FowardEntry<OdbcFunctionId::SQLSetScrollOptions>(hstmt, fConcurrency, crowKeyset, crowRowset);
 }
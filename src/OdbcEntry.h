@@ -0,0 +1,170 @@
+#pragma once
+#include "Clock.h"
+#include "Logging.h"
+#include "OdbcFormatters.h"
+#include "OdbcFunctions.h"
+#include "Platform.h"
+#include "Settings.h"
+#include "StringConversion.h"
+#include "TraceEvents.h"
+
+#include <chrono>
+#include <format>
+#include <iterator>
+#include <print>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+template <typename T>
+constexpr bool kIsCharacter = std::is_same_v<T, char> || std::is_same_v<T, signed char> || std::is_same_v<T, unsigned char> || std::is_same_v<T, wchar_t> ||
+                              std::is_same_v<T, char8_t> || std::is_same_v<T, char16_t> || std::is_same_v<T, char32_t>;
+
+// pointer a single value is written through, ex: SQLLEN *StrLen_or_IndPtr or SQLHANDLE *OutputHandlePtr. Strings and
+// SQLPOINTER buffers are not, their length is another argument
+template <typename T>
+constexpr bool kIsOutputPointer = false;
+template <typename T>
+constexpr bool kIsOutputPointer<T *> = !std::is_const_v<T> && (std::is_same_v<T, void *> || (std::is_arithmetic_v<T> && !kIsCharacter<T>));
+
+// functions keeping their pointers to write them later, the values behind are not written by the call
+constexpr bool DefersOutputPointers(OdbcFunctionId id)
+{
+   return id == OdbcFunctionId::SQLBindCol || id == OdbcFunctionId::SQLBindParameter || id == OdbcFunctionId::SQLSetDescRec;
+}
+
+// string argument logged as text, converted to UTF-8 only when the line is written. Length in characters or SQL_NTS
+struct WideText
+{
+   const wchar_t *text;
+   int length;
+};
+
+// pointers are never read before the driver wrote them, null ones are logged as null
+template <typename T>
+void AppendArgument(std::string &line, const T &argument, bool written)
+{
+   if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>)
+   {
+      std::format_to(std::back_inserter(line), R"("{}")", argument);
+   }
+   else if constexpr (std::is_same_v<T, WideText>)
+   {
+      if (argument.text == nullptr)
+      {
+         line += "null";
+      }
+      else
+      {
+         std::format_to(std::back_inserter(line), R"("{}")", ReadString(argument.text, argument.length));
+      }
+   }
+   else if constexpr (std::is_pointer_v<T>)
+   {
+      if (argument == nullptr)
+      {
+         line += "null";
+      }
+      else if constexpr (kIsOutputPointer<T>)
+      {
+         if (written)
+         {
+            std::format_to(std::back_inserter(line), "{}", *argument);
+         }
+         else
+         {
+            std::format_to(std::back_inserter(line), "{}", static_cast<const void *>(argument));
+         }
+      }
+      else
+      {
+         std::format_to(std::back_inserter(line), "{}", static_cast<const void *>(argument));
+      }
+   }
+   else
+   {
+      std::format_to(std::back_inserter(line), "{}", argument);
+   }
+}
+
+// instrumentation of an exported entry point, identical for every function: the arguments are logged on entry, and
+// again on exit with the values written through the output pointers, the return code and the time spent in the detour
+//
+// the arguments are the ones to log, enums may be passed by name ex: StmtAttribute{attribute}. Created by Enter.
+// Functions left out of TRACE_FUNCTIONS when the call starts are not logged, see Settings.h
+template <OdbcFunctionId Id, typename... Arguments>
+class OdbcEntry
+{
+ public:
+   explicit OdbcEntry(Arguments... arguments)
+       : m_traced(CurrentSettings().tracedFunctions[OdbcFunctionIndex(Id)]), m_arguments(std::move(arguments)...)
+   {
+      if (m_traced)
+      {
+         std::print(LOG, "{}", Call(false));
+         m_start = CycleClock::now();
+      }
+   }
+
+   OdbcEntry(const OdbcEntry &) = delete;
+   OdbcEntry &operator=(const OdbcEntry &) = delete;
+
+   // run the body of the entry point, its result is logged and returned
+   template <typename Body>
+   auto Run(Body body)
+   {
+      auto result = body();
+      if (TraceEventsEnabled())
+      {
+         // annotations only describe a call of this entry point
+         DiscardCallAnnotations();
+      }
+      if (!m_traced)
+      {
+         return result;
+      }
+      auto elapsed = std::chrono::duration<double, std::milli>(CycleClock::now() - m_start).count();
+      if constexpr (std::is_same_v<decltype(result), BOOL>)
+      {
+         std::print(LOG, "{} -> {} in {:.3f} ms{}", Call(result != FALSE), result != FALSE ? "TRUE" : "FALSE", elapsed, m_detail);
+      }
+      else
+      {
+         std::print(LOG, "{} -> {} in {:.3f} ms{}", Call(SQL_SUCCEEDED(result)), ReturnCode{result}, elapsed, m_detail);
+      }
+      return result;
+   }
+
+   // appended to the exit line, ex: the value returned by SQLGetInfoW
+   void Describe(std::string detail)
+   {
+      m_detail = " " + detail;
+   }
+
+ private:
+   std::string Call(bool succeeded) const
+   {
+      std::string line(OdbcFunctionName(Id));
+      line += '(';
+      std::apply([&](const auto &...argument)
+                 {
+                    size_t index = 0;
+                    ((line += index++ == 0 ? "" : ", ", AppendArgument(line, argument, succeeded && !DefersOutputPointers(Id))), ...); },
+                 m_arguments);
+      line += ')';
+      return line;
+   }
+
+   bool m_traced;
+   std::tuple<Arguments...> m_arguments;
+   CycleClock::time_point m_start;
+   std::string m_detail;
+};
+
+template <OdbcFunctionId Id, typename... Arguments>
+OdbcEntry<Id, Arguments...> Enter(Arguments... arguments)
+{
+   return OdbcEntry<Id, Arguments...>(std::move(arguments)...);
+}
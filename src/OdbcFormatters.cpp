@@ -0,0 +1,314 @@
+#include "OdbcFormatters.h"
+#include "SqlInfoType.h"
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+struct OdbcName
+{
+   long long value;
+   std::string_view name;
+};
+
+// macro to get string representation of a define
+#define ODBC_NAME(NAME) OdbcName{NAME, #NAME}
+
+// tables are sorted by value at compile time and binary searched
+template <size_t N>
+consteval std::array<OdbcName, N> Sorted(std::array<OdbcName, N> names)
+{
+   std::ranges::sort(names, {}, &OdbcName::value);
+   return names;
+}
+
+template <size_t N>
+std::string_view Find(const std::array<OdbcName, N> &names, long long value)
+{
+   auto it = std::ranges::lower_bound(names, value, {}, &OdbcName::value);
+   return it != names.end() && it->value == value ? it->name : std::string_view{};
+}
+
+// clang-format off
+constexpr auto kReturnCodes = Sorted(std::to_array<OdbcName>({
+    ODBC_NAME(SQL_SUCCESS),
+    ODBC_NAME(SQL_SUCCESS_WITH_INFO),
+    ODBC_NAME(SQL_ERROR),
+    ODBC_NAME(SQL_INVALID_HANDLE),
+    ODBC_NAME(SQL_NO_DATA),
+    ODBC_NAME(SQL_NEED_DATA),
+    ODBC_NAME(SQL_STILL_EXECUTING),
+    ODBC_NAME(SQL_PARAM_DATA_AVAILABLE),
+}));
+
+constexpr auto kEnvAttributes = Sorted(std::to_array<OdbcName>({
+    ODBC_NAME(SQL_ATTR_ODBC_VERSION),
+    ODBC_NAME(SQL_ATTR_CONNECTION_POOLING),
+    ODBC_NAME(SQL_ATTR_CP_MATCH),
+    ODBC_NAME(SQL_ATTR_OUTPUT_NTS),
+}));
+
+constexpr auto kConnectAttributes = Sorted(std::to_array<OdbcName>({
+    ODBC_NAME(SQL_ATTR_QUERY_TIMEOUT),
+    ODBC_NAME(SQL_ATTR_ASYNC_ENABLE),
+    ODBC_NAME(SQL_ATTR_ACCESS_MODE),
+    ODBC_NAME(SQL_ATTR_AUTOCOMMIT),
+    ODBC_NAME(SQL_ATTR_LOGIN_TIMEOUT),
+    ODBC_NAME(SQL_ATTR_TRACE),
+    ODBC_NAME(SQL_ATTR_TRACEFILE),
+    ODBC_NAME(SQL_ATTR_TRANSLATE_LIB),
+    ODBC_NAME(SQL_ATTR_TRANSLATE_OPTION),
+    ODBC_NAME(SQL_ATTR_TXN_ISOLATION),
+    ODBC_NAME(SQL_ATTR_CURRENT_CATALOG),
+    ODBC_NAME(SQL_ATTR_ODBC_CURSORS),
+    ODBC_NAME(SQL_ATTR_QUIET_MODE),
+    ODBC_NAME(SQL_ATTR_PACKET_SIZE),
+    ODBC_NAME(SQL_ATTR_CONNECTION_TIMEOUT),
+    ODBC_NAME(SQL_ATTR_DISCONNECT_BEHAVIOR),
+    ODBC_NAME(SQL_ATTR_ANSI_APP),
+    ODBC_NAME(SQL_ATTR_RESET_CONNECTION),
+    ODBC_NAME(SQL_ATTR_ASYNC_DBC_FUNCTIONS_ENABLE),
+    ODBC_NAME(SQL_ATTR_ENLIST_IN_DTC),
+    ODBC_NAME(SQL_ATTR_ENLIST_IN_XA),
+    ODBC_NAME(SQL_ATTR_CONNECTION_DEAD),
+    ODBC_NAME(SQL_ATTR_AUTO_IPD),
+    ODBC_NAME(SQL_ATTR_METADATA_ID),
+}));
+
+constexpr auto kStmtAttributes = Sorted(std::to_array<OdbcName>({
+    ODBC_NAME(SQL_ATTR_CURSOR_SENSITIVITY),
+    ODBC_NAME(SQL_ATTR_CURSOR_SCROLLABLE),
+    ODBC_NAME(SQL_ATTR_QUERY_TIMEOUT),
+    ODBC_NAME(SQL_ATTR_MAX_ROWS),
+    ODBC_NAME(SQL_ATTR_NOSCAN),
+    ODBC_NAME(SQL_ATTR_MAX_LENGTH),
+    ODBC_NAME(SQL_ATTR_ASYNC_ENABLE),
+    ODBC_NAME(SQL_ATTR_ROW_BIND_TYPE),
+    ODBC_NAME(SQL_ATTR_CURSOR_TYPE),
+    ODBC_NAME(SQL_ATTR_CONCURRENCY),
+    ODBC_NAME(SQL_ATTR_KEYSET_SIZE),
+    ODBC_NAME(SQL_ROWSET_SIZE),
+    ODBC_NAME(SQL_ATTR_SIMULATE_CURSOR),
+    ODBC_NAME(SQL_ATTR_RETRIEVE_DATA),
+    ODBC_NAME(SQL_ATTR_USE_BOOKMARKS),
+    ODBC_NAME(SQL_GET_BOOKMARK),
+    ODBC_NAME(SQL_ATTR_ROW_NUMBER),
+    ODBC_NAME(SQL_ATTR_ENABLE_AUTO_IPD),
+    ODBC_NAME(SQL_ATTR_FETCH_BOOKMARK_PTR),
+    ODBC_NAME(SQL_ATTR_PARAM_BIND_OFFSET_PTR),
+    ODBC_NAME(SQL_ATTR_PARAM_BIND_TYPE),
+    ODBC_NAME(SQL_ATTR_PARAM_OPERATION_PTR),
+    ODBC_NAME(SQL_ATTR_PARAM_STATUS_PTR),
+    ODBC_NAME(SQL_ATTR_PARAMS_PROCESSED_PTR),
+    ODBC_NAME(SQL_ATTR_PARAMSET_SIZE),
+    ODBC_NAME(SQL_ATTR_ROW_BIND_OFFSET_PTR),
+    ODBC_NAME(SQL_ATTR_ROW_OPERATION_PTR),
+    ODBC_NAME(SQL_ATTR_ROW_STATUS_PTR),
+    ODBC_NAME(SQL_ATTR_ROWS_FETCHED_PTR),
+    ODBC_NAME(SQL_ATTR_ROW_ARRAY_SIZE),
+    ODBC_NAME(SQL_ATTR_APP_ROW_DESC),
+    ODBC_NAME(SQL_ATTR_APP_PARAM_DESC),
+    ODBC_NAME(SQL_ATTR_IMP_ROW_DESC),
+    ODBC_NAME(SQL_ATTR_IMP_PARAM_DESC),
+    ODBC_NAME(SQL_ATTR_METADATA_ID),
+}));
+
+constexpr auto kDescFields = Sorted(std::to_array<OdbcName>({
+    ODBC_NAME(SQL_DESC_CONCISE_TYPE),
+    ODBC_NAME(SQL_DESC_DISPLAY_SIZE),
+    ODBC_NAME(SQL_DESC_UNSIGNED),
+    ODBC_NAME(SQL_DESC_FIXED_PREC_SCALE),
+    ODBC_NAME(SQL_DESC_UPDATABLE),
+    ODBC_NAME(SQL_DESC_AUTO_UNIQUE_VALUE),
+    ODBC_NAME(SQL_DESC_CASE_SENSITIVE),
+    ODBC_NAME(SQL_DESC_SEARCHABLE),
+    ODBC_NAME(SQL_DESC_TYPE_NAME),
+    ODBC_NAME(SQL_DESC_TABLE_NAME),
+    ODBC_NAME(SQL_DESC_SCHEMA_NAME),
+    ODBC_NAME(SQL_DESC_CATALOG_NAME),
+    ODBC_NAME(SQL_DESC_LABEL),
+    ODBC_NAME(SQL_DESC_ARRAY_SIZE),
+    ODBC_NAME(SQL_DESC_ARRAY_STATUS_PTR),
+    ODBC_NAME(SQL_DESC_BASE_COLUMN_NAME),
+    ODBC_NAME(SQL_DESC_BASE_TABLE_NAME),
+    ODBC_NAME(SQL_DESC_BIND_OFFSET_PTR),
+    ODBC_NAME(SQL_DESC_BIND_TYPE),
+    ODBC_NAME(SQL_DESC_DATETIME_INTERVAL_PRECISION),
+    ODBC_NAME(SQL_DESC_LITERAL_PREFIX),
+    ODBC_NAME(SQL_DESC_LITERAL_SUFFIX),
+    ODBC_NAME(SQL_DESC_LOCAL_TYPE_NAME),
+    ODBC_NAME(SQL_DESC_MAXIMUM_SCALE),
+    ODBC_NAME(SQL_DESC_MINIMUM_SCALE),
+    ODBC_NAME(SQL_DESC_NUM_PREC_RADIX),
+    ODBC_NAME(SQL_DESC_PARAMETER_TYPE),
+    ODBC_NAME(SQL_DESC_ROWS_PROCESSED_PTR),
+    ODBC_NAME(SQL_DESC_ROWVER),
+    ODBC_NAME(SQL_DESC_COUNT),
+    ODBC_NAME(SQL_DESC_TYPE),
+    ODBC_NAME(SQL_DESC_LENGTH),
+    ODBC_NAME(SQL_DESC_OCTET_LENGTH_PTR),
+    ODBC_NAME(SQL_DESC_PRECISION),
+    ODBC_NAME(SQL_DESC_SCALE),
+    ODBC_NAME(SQL_DESC_DATETIME_INTERVAL_CODE),
+    ODBC_NAME(SQL_DESC_NULLABLE),
+    ODBC_NAME(SQL_DESC_INDICATOR_PTR),
+    ODBC_NAME(SQL_DESC_DATA_PTR),
+    ODBC_NAME(SQL_DESC_NAME),
+    ODBC_NAME(SQL_DESC_UNNAMED),
+    ODBC_NAME(SQL_DESC_OCTET_LENGTH),
+    ODBC_NAME(SQL_DESC_ALLOC_TYPE),
+}));
+
+// the descriptor fields of a column, with the ODBC 2 identifiers that have no SQL_DESC_ equivalent
+constexpr auto kColumnAttributes = Sorted(std::to_array<OdbcName>({
+    ODBC_NAME(SQL_COLUMN_COUNT),
+    ODBC_NAME(SQL_COLUMN_NAME),
+    ODBC_NAME(SQL_DESC_CONCISE_TYPE),
+    ODBC_NAME(SQL_COLUMN_LENGTH),
+    ODBC_NAME(SQL_COLUMN_PRECISION),
+    ODBC_NAME(SQL_COLUMN_SCALE),
+    ODBC_NAME(SQL_DESC_DISPLAY_SIZE),
+    ODBC_NAME(SQL_COLUMN_NULLABLE),
+    ODBC_NAME(SQL_DESC_UNSIGNED),
+    ODBC_NAME(SQL_DESC_FIXED_PREC_SCALE),
+    ODBC_NAME(SQL_DESC_UPDATABLE),
+    ODBC_NAME(SQL_DESC_AUTO_UNIQUE_VALUE),
+    ODBC_NAME(SQL_DESC_CASE_SENSITIVE),
+    ODBC_NAME(SQL_DESC_SEARCHABLE),
+    ODBC_NAME(SQL_DESC_TYPE_NAME),
+    ODBC_NAME(SQL_DESC_TABLE_NAME),
+    ODBC_NAME(SQL_DESC_SCHEMA_NAME),
+    ODBC_NAME(SQL_DESC_CATALOG_NAME),
+    ODBC_NAME(SQL_DESC_LABEL),
+    ODBC_NAME(SQL_DESC_BASE_COLUMN_NAME),
+    ODBC_NAME(SQL_DESC_BASE_TABLE_NAME),
+    ODBC_NAME(SQL_DESC_LITERAL_PREFIX),
+    ODBC_NAME(SQL_DESC_LITERAL_SUFFIX),
+    ODBC_NAME(SQL_DESC_LOCAL_TYPE_NAME),
+    ODBC_NAME(SQL_DESC_NUM_PREC_RADIX),
+    ODBC_NAME(SQL_DESC_COUNT),
+    ODBC_NAME(SQL_DESC_TYPE),
+    ODBC_NAME(SQL_DESC_LENGTH),
+    ODBC_NAME(SQL_DESC_PRECISION),
+    ODBC_NAME(SQL_DESC_SCALE),
+    ODBC_NAME(SQL_DESC_NULLABLE),
+    ODBC_NAME(SQL_DESC_NAME),
+    ODBC_NAME(SQL_DESC_UNNAMED),
+    ODBC_NAME(SQL_DESC_OCTET_LENGTH),
+}));
+
+constexpr auto kCTypes = Sorted(std::to_array<OdbcName>({
+    ODBC_NAME(SQL_APD_TYPE),
+    ODBC_NAME(SQL_ARD_TYPE),
+    ODBC_NAME(SQL_C_UTINYINT),
+    ODBC_NAME(SQL_C_UBIGINT),
+    ODBC_NAME(SQL_C_STINYINT),
+    ODBC_NAME(SQL_C_SBIGINT),
+    ODBC_NAME(SQL_C_ULONG),
+    ODBC_NAME(SQL_C_USHORT),
+    ODBC_NAME(SQL_C_SLONG),
+    ODBC_NAME(SQL_C_SSHORT),
+    ODBC_NAME(SQL_C_GUID),
+    ODBC_NAME(SQL_C_WCHAR),
+    ODBC_NAME(SQL_C_BIT),
+    ODBC_NAME(SQL_C_TINYINT),
+    ODBC_NAME(SQL_C_BINARY),
+    ODBC_NAME(SQL_C_CHAR),
+    ODBC_NAME(SQL_C_NUMERIC),
+    ODBC_NAME(SQL_C_LONG),
+    ODBC_NAME(SQL_C_SHORT),
+    ODBC_NAME(SQL_C_FLOAT),
+    ODBC_NAME(SQL_C_DOUBLE),
+    ODBC_NAME(SQL_C_DATE),
+    ODBC_NAME(SQL_C_TIME),
+    ODBC_NAME(SQL_C_TIMESTAMP),
+    ODBC_NAME(SQL_C_TYPE_DATE),
+    ODBC_NAME(SQL_C_TYPE_TIME),
+    ODBC_NAME(SQL_C_TYPE_TIMESTAMP),
+    ODBC_NAME(SQL_C_DEFAULT),
+    ODBC_NAME(SQL_C_INTERVAL_YEAR),
+    ODBC_NAME(SQL_C_INTERVAL_MONTH),
+    ODBC_NAME(SQL_C_INTERVAL_DAY),
+    ODBC_NAME(SQL_C_INTERVAL_HOUR),
+    ODBC_NAME(SQL_C_INTERVAL_MINUTE),
+    ODBC_NAME(SQL_C_INTERVAL_SECOND),
+    ODBC_NAME(SQL_C_INTERVAL_YEAR_TO_MONTH),
+    ODBC_NAME(SQL_C_INTERVAL_DAY_TO_HOUR),
+    ODBC_NAME(SQL_C_INTERVAL_DAY_TO_MINUTE),
+    ODBC_NAME(SQL_C_INTERVAL_DAY_TO_SECOND),
+    ODBC_NAME(SQL_C_INTERVAL_HOUR_TO_MINUTE),
+    ODBC_NAME(SQL_C_INTERVAL_HOUR_TO_SECOND),
+    ODBC_NAME(SQL_C_INTERVAL_MINUTE_TO_SECOND),
+}));
+
+constexpr auto kSqlTypes = Sorted(std::to_array<OdbcName>({
+    ODBC_NAME(SQL_GUID),
+    ODBC_NAME(SQL_WLONGVARCHAR),
+    ODBC_NAME(SQL_WVARCHAR),
+    ODBC_NAME(SQL_WCHAR),
+    ODBC_NAME(SQL_BIT),
+    ODBC_NAME(SQL_TINYINT),
+    ODBC_NAME(SQL_BIGINT),
+    ODBC_NAME(SQL_LONGVARBINARY),
+    ODBC_NAME(SQL_VARBINARY),
+    ODBC_NAME(SQL_BINARY),
+    ODBC_NAME(SQL_LONGVARCHAR),
+    ODBC_NAME(SQL_UNKNOWN_TYPE),
+    ODBC_NAME(SQL_CHAR),
+    ODBC_NAME(SQL_NUMERIC),
+    ODBC_NAME(SQL_DECIMAL),
+    ODBC_NAME(SQL_INTEGER),
+    ODBC_NAME(SQL_SMALLINT),
+    ODBC_NAME(SQL_FLOAT),
+    ODBC_NAME(SQL_REAL),
+    ODBC_NAME(SQL_DOUBLE),
+    ODBC_NAME(SQL_DATE),
+    ODBC_NAME(SQL_TIME),
+    ODBC_NAME(SQL_TIMESTAMP),
+    ODBC_NAME(SQL_VARCHAR),
+    ODBC_NAME(SQL_TYPE_DATE),
+    ODBC_NAME(SQL_TYPE_TIME),
+    ODBC_NAME(SQL_TYPE_TIMESTAMP),
+    ODBC_NAME(SQL_INTERVAL_YEAR),
+    ODBC_NAME(SQL_INTERVAL_MONTH),
+    ODBC_NAME(SQL_INTERVAL_DAY),
+    ODBC_NAME(SQL_INTERVAL_HOUR),
+    ODBC_NAME(SQL_INTERVAL_MINUTE),
+    ODBC_NAME(SQL_INTERVAL_SECOND),
+    ODBC_NAME(SQL_INTERVAL_YEAR_TO_MONTH),
+    ODBC_NAME(SQL_INTERVAL_DAY_TO_HOUR),
+    ODBC_NAME(SQL_INTERVAL_DAY_TO_MINUTE),
+    ODBC_NAME(SQL_INTERVAL_DAY_TO_SECOND),
+    ODBC_NAME(SQL_INTERVAL_HOUR_TO_MINUTE),
+    ODBC_NAME(SQL_INTERVAL_HOUR_TO_SECOND),
+    ODBC_NAME(SQL_INTERVAL_MINUTE_TO_SECOND),
+}));
+// clang-format on
+} // namespace
+
+std::string_view OdbcValueName(OdbcDomain domain, long long value)
+{
+   switch (domain)
+   {
+   case OdbcDomain::ReturnCode:
+      return Find(kReturnCodes, value);
+   case OdbcDomain::EnvAttribute:
+      return Find(kEnvAttributes, value);
+   case OdbcDomain::ConnectAttribute:
+      return Find(kConnectAttributes, value);
+   case OdbcDomain::StmtAttribute:
+      return Find(kStmtAttributes, value);
+   case OdbcDomain::DescField:
+      return Find(kDescFields, value);
+   case OdbcDomain::ColumnAttribute:
+      return Find(kColumnAttributes, value);
+   case OdbcDomain::CType:
+      return Find(kCTypes, value);
+   case OdbcDomain::SqlType:
+      return Find(kSqlTypes, value);
+   case OdbcDomain::InfoType:
+      return InfotypeName(value);
+   }
+   return {};
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "Platform.h"
+
+#include <format>
+#include <string_view>
+
+// enum domains of the ODBC api whose values are logged by name
+enum class OdbcDomain
+{
+   ReturnCode,
+   EnvAttribute,
+   ConnectAttribute,
+   StmtAttribute,
+   DescField,
+   ColumnAttribute,
+   CType,
+   SqlType,
+   InfoType,
+};
+
+// name of a value of a domain, ex: SQL_ATTR_QUERY_TIMEOUT, empty when unknown. The names are compile time tables
+// searched without allocating.
+std::string_view OdbcValueName(OdbcDomain domain, long long value);
+
+// integer argument formatted as the name of its value, ex: std::print(LOG, "{}", StmtAttribute{attribute})
+template <OdbcDomain Domain>
+struct OdbcValue
+{
+   long long value;
+};
+
+using ReturnCode = OdbcValue<OdbcDomain::ReturnCode>;
+using EnvAttribute = OdbcValue<OdbcDomain::EnvAttribute>;
+using ConnectAttribute = OdbcValue<OdbcDomain::ConnectAttribute>;
+using StmtAttribute = OdbcValue<OdbcDomain::StmtAttribute>;
+using DescField = OdbcValue<OdbcDomain::DescField>;
+using ColumnAttribute = OdbcValue<OdbcDomain::ColumnAttribute>;
+using CType = OdbcValue<OdbcDomain::CType>;
+using SqlType = OdbcValue<OdbcDomain::SqlType>;
+using InfoType = OdbcValue<OdbcDomain::InfoType>;
+
+// written straight to the output, values without a name as their number ex: driver specific attributes
+template <OdbcDomain Domain>
+struct std::formatter<OdbcValue<Domain>> : std::formatter<std::string_view>
+{
+   template <typename FormatContext>
+   auto format(OdbcValue<Domain> value, FormatContext &context) const
+   {
+      if (auto name = OdbcValueName(Domain, value.value); !name.empty())
+      {
+         return std::formatter<std::string_view>::format(name, context);
+      }
+      return std::format_to(context.out(), "{}", value.value);
+   }
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+// clang-format off
+// odbc functions forwarded to the target driver, the single list every table indexed by function is generated from.
+// Must be kept sorted as the lookup by name is a binary search
+#define ODBC_FUNCTIONS(X) \
+   X(ConfigDSN) \
+   X(ConfigDSNW) \
+   X(ConfigDriverW) \
+   X(SQLAllocConnect) \
+   X(SQLAllocEnv) \
+   X(SQLAllocHandle) \
+   X(SQLAllocStmt) \
+   X(SQLBindCol) \
+   X(SQLBindParameter) \
+   X(SQLBrowseConnectW) \
+   X(SQLBulkOperations) \
+   X(SQLCancel) \
+   X(SQLCancelHandle) \
+   X(SQLCloseCursor) \
+   X(SQLColAttributeW) \
+   X(SQLColumnPrivilegesW) \
+   X(SQLColumnsW) \
+   X(SQLCompleteAsync) \
+   X(SQLConnectW) \
+   X(SQLCopyDesc) \
+   X(SQLDescribeColW) \
+   X(SQLDescribeParam) \
+   X(SQLDisconnect) \
+   X(SQLDriverConnectW) \
+   X(SQLEndTran) \
+   X(SQLExecDirectW) \
+   X(SQLExecute) \
+   X(SQLExtendedFetch) \
+   X(SQLFetch) \
+   X(SQLFetchScroll) \
+   X(SQLFreeConnect) \
+   X(SQLFreeEnv) \
+   X(SQLFreeHandle) \
+   X(SQLFreeStmt) \
+   X(SQLGetConnectAttrW) \
+   X(SQLGetCursorNameW) \
+   X(SQLGetData) \
+   X(SQLGetDescFieldW) \
+   X(SQLGetDescRecW) \
+   X(SQLGetDiagFieldW) \
+   X(SQLGetDiagRecW) \
+   X(SQLGetEnvAttr) \
+   X(SQLGetFunctions) \
+   X(SQLGetInfoW) \
+   X(SQLGetStmtAttrW) \
+   X(SQLGetTypeInfoW) \
+   X(SQLMoreResults) \
+   X(SQLNativeSqlW) \
+   X(SQLNumParams) \
+   X(SQLNumResultCols) \
+   X(SQLParamData) \
+   X(SQLPrepareW) \
+   X(SQLPrimaryKeysW) \
+   X(SQLProcedureColumnsW) \
+   X(SQLProceduresW) \
+   X(SQLPutData) \
+   X(SQLRowCount) \
+   X(SQLSetConnectAttrW) \
+   X(SQLSetCursorNameW) \
+   X(SQLSetDescFieldW) \
+   X(SQLSetDescRec) \
+   X(SQLSetEnvAttr) \
+   X(SQLSetPos) \
+   X(SQLSetScrollOptions) \
+   X(SQLSetStmtAttrW) \
+   X(SQLSpecialColumnsW) \
+   X(SQLStatisticsW) \
+   X(SQLTablePrivilegesW) \
+   X(SQLTablesW)
+// clang-format on
+
+// compile time id of a function, its index in kOdbcFunctionNames
+enum class OdbcFunctionId : size_t
+{
+#define ODBC_FUNCTION_ID(NAME) NAME,
+   ODBC_FUNCTIONS(ODBC_FUNCTION_ID)
+#undef ODBC_FUNCTION_ID
+};
+
+constexpr std::array kOdbcFunctionNames = {
+#define ODBC_FUNCTION_NAME(NAME) std::string_view(#NAME),
+   ODBC_FUNCTIONS(ODBC_FUNCTION_NAME)
+#undef ODBC_FUNCTION_NAME
+};
+
+static_assert(std::ranges::is_sorted(kOdbcFunctionNames), "ODBC_FUNCTIONS must be sorted");
+
+constexpr size_t kOdbcFunctionCount = kOdbcFunctionNames.size();
+
+// index of a function in kOdbcFunctionNames
+constexpr std::optional<size_t> FindOdbcFunction(std::string_view name)
+{
+   auto it = std::ranges::lower_bound(kOdbcFunctionNames, name);
+   if (it == kOdbcFunctionNames.end() || *it != name)
+   {
+      return std::nullopt;
+   }
+   return static_cast<size_t>(it - kOdbcFunctionNames.begin());
+}
+
+constexpr size_t OdbcFunctionIndex(OdbcFunctionId id)
+{
+   return static_cast<size_t>(id);
+}
+
+constexpr std::string_view OdbcFunctionName(OdbcFunctionId id)
+{
+   return kOdbcFunctionNames[OdbcFunctionIndex(id)];
+}
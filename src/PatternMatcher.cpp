@@ -0,0 +1,114 @@
+#include "PatternMatcher.h"
+
+#include <algorithm>
+#include <queue>
+
+namespace
+{
+unsigned char Fold(char c)
+{
+   auto byte = static_cast<unsigned char>(c);
+   return byte >= 'A' && byte <= 'Z' ? static_cast<unsigned char>(byte - 'A' + 'a') : byte;
+}
+} // namespace
+
+PatternMatcher::PatternMatcher(const std::vector<std::string> &patterns)
+    : m_transitions(1), m_output(1, kNoPattern), m_dictionaryLink(1, 0)
+{
+   m_transitions[0].fill(0);
+   m_lengths.reserve(patterns.size());
+
+   // trie of the patterns, 0 is both the root and "no transition" since no edge leads back to the root
+   for (size_t index = 0; index < patterns.size(); ++index)
+   {
+      m_lengths.push_back(patterns[index].size());
+      if (patterns[index].empty())
+      {
+         continue;
+      }
+      uint32_t state = 0;
+      for (auto c : patterns[index])
+      {
+         auto &next = m_transitions[state][Fold(c)];
+         if (next == 0)
+         {
+            next = static_cast<uint32_t>(m_transitions.size());
+            m_transitions.emplace_back().fill(0);
+            m_output.push_back(kNoPattern);
+            m_dictionaryLink.push_back(0);
+         }
+         state = next;
+      }
+      if (m_output[state] == kNoPattern)
+      {
+         m_output[state] = static_cast<int32_t>(index);
+      }
+   }
+
+   // breadth first, the failure state of a node is shallower so its transitions are complete when it is used
+   std::vector<uint32_t> failure(m_transitions.size(), 0);
+   std::queue<uint32_t> pending;
+   for (auto child : m_transitions[0])
+   {
+      if (child != 0)
+      {
+         pending.push(child);
+      }
+   }
+   while (!pending.empty())
+   {
+      auto state = pending.front();
+      pending.pop();
+      for (size_t c = 0; c < kAlphabet; ++c)
+      {
+         auto &next = m_transitions[state][c];
+         if (next == 0)
+         {
+            next = m_transitions[failure[state]][c];
+            continue;
+         }
+         auto fail = m_transitions[failure[state]][c];
+         failure[next] = fail;
+         m_dictionaryLink[next] = m_output[fail] != kNoPattern ? fail : m_dictionaryLink[fail];
+         pending.push(next);
+      }
+   }
+}
+
+std::vector<PatternMatcher::Match> PatternMatcher::FindAll(std::string_view text) const
+{
+   std::vector<Match> matches;
+   uint32_t state = 0;
+   for (size_t i = 0; i < text.size(); ++i)
+   {
+      state = m_transitions[state][Fold(text[i])];
+      for (auto found = m_output[state] != kNoPattern ? state : m_dictionaryLink[state]; found != 0; found = m_dictionaryLink[found])
+      {
+         auto pattern = static_cast<size_t>(m_output[found]);
+         matches.push_back({i + 1 - m_lengths[pattern], m_lengths[pattern], pattern});
+      }
+   }
+   if (matches.empty())
+   {
+      return matches;
+   }
+
+   std::ranges::sort(matches, [](const Match &a, const Match &b)
+                     { return a.position != b.position ? a.position < b.position : a.length > b.length; });
+   std::vector<Match> selected;
+   size_t end = 0;
+   for (auto &match : matches)
+   {
+      if (match.position >= end)
+      {
+         selected.push_back(match);
+         end = match.position + match.length;
+      }
+   }
+   return selected;
+}
+
+bool PatternMatcher::Empty() const
+{
+   return m_transitions.size() == 1;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Aho-Corasick automaton finding a set of literal patterns in one pass over a text, ASCII letters match regardless of
+// case
+//
+// the automaton is a dense transition table built once, matching costs one table lookup per byte of the text whatever
+// the number of patterns.
+class PatternMatcher
+{
+ public:
+   struct Match
+   {
+      size_t position;
+      size_t length;
+      // index in the patterns given to the constructor
+      size_t pattern;
+   };
+
+   // empty patterns are ignored, a duplicate pattern is only reported under its first index
+   explicit PatternMatcher(const std::vector<std::string> &patterns);
+
+   // leftmost longest matches that do not overlap, by position
+   std::vector<Match> FindAll(std::string_view text) const;
+
+   bool Empty() const;
+
+ private:
+   static constexpr size_t kAlphabet = 256;
+   static constexpr int32_t kNoPattern = -1;
+
+   std::vector<std::array<uint32_t, kAlphabet>> m_transitions;
+   // pattern ending at each state, kNoPattern when none
+   std::vector<int32_t> m_output;
+   // closest state on the failure chain with a pattern, 0 when none
+   std::vector<uint32_t> m_dictionaryLink;
+   std::vector<size_t> m_lengths;
+};
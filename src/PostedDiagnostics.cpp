@@ -0,0 +1,161 @@
+#include "PostedDiagnostics.h"
+
+#include <algorithm>
+#include <cwchar>
+#include <utility>
+
+namespace
+{
+// copy a string to an application buffer, lengths in characters for SQLGetDiagRecW and in bytes for
+// SQLGetDiagFieldW
+SQLRETURN CopyString(std::wstring_view value, SQLWCHAR *buffer, size_t bufferCount, size_t *copied)
+{
+   if (copied != nullptr)
+   {
+      *copied = value.size();
+   }
+   if (buffer == nullptr || bufferCount == 0)
+   {
+      return value.empty() ? SQL_SUCCESS : SQL_SUCCESS_WITH_INFO;
+   }
+   auto count = std::min(value.size(), bufferCount - 1);
+   std::wmemcpy(reinterpret_cast<wchar_t *>(buffer), value.data(), count);
+   buffer[count] = 0;
+   return count < value.size() ? SQL_SUCCESS_WITH_INFO : SQL_SUCCESS;
+}
+} // namespace
+
+void PostDiagnostic(HandleRecord &record, SQLRETURN returnCode, std::wstring_view sqlState, std::wstring_view message, SQLINTEGER nativeError)
+{
+   std::lock_guard lock(record.stateLock);
+   record.postedDiagnostics.clear();
+   // same vendor prefix convention as drivers
+   record.postedDiagnostics.push_back({std::wstring(sqlState), nativeError, L"[OdbcDetour]" + std::wstring(message), returnCode});
+   record.hasPostedDiagnostics.store(true, std::memory_order_release);
+}
+
+void ClearPostedDiagnostics(HandleRecord &record)
+{
+   std::lock_guard lock(record.stateLock);
+   record.postedDiagnostics.clear();
+   record.hasPostedDiagnostics.store(false, std::memory_order_release);
+}
+
+void HideDriverDiagnostics(HandleRecord &record)
+{
+   // no record posted, answered by the detour
+   std::lock_guard lock(record.stateLock);
+   record.postedDiagnostics.clear();
+   record.hasPostedDiagnostics.store(true, std::memory_order_release);
+}
+
+void AppendDriverDiagnostic(HandleRecord &record, PostedDiagnostic diagnostic)
+{
+   std::lock_guard lock(record.stateLock);
+   record.postedDiagnostics.push_back(std::move(diagnostic));
+   record.hasPostedDiagnostics.store(true, std::memory_order_release);
+}
+
+std::optional<SQLRETURN> GetPostedDiagRec(HandleRecord &record, SQLSMALLINT recordNumber, SQLWCHAR *sqlState, SQLINTEGER *nativeError,
+                                          SQLWCHAR *message, SQLSMALLINT messageMaxLength, SQLSMALLINT *messageLength)
+{
+   if (!record.hasPostedDiagnostics.load(std::memory_order_acquire))
+   {
+      return std::nullopt;
+   }
+
+   std::lock_guard lock(record.stateLock);
+   if (recordNumber <= 0)
+   {
+      return SQL_ERROR;
+   }
+   if (static_cast<size_t>(recordNumber) > record.postedDiagnostics.size())
+   {
+      return SQL_NO_DATA;
+   }
+
+   auto &diagnostic = record.postedDiagnostics[recordNumber - 1];
+   CopyString(diagnostic.sqlState, sqlState, sqlState != nullptr ? 6 : 0, nullptr);
+   if (nativeError != nullptr)
+   {
+      *nativeError = diagnostic.nativeError;
+   }
+   size_t length = 0;
+   auto result = CopyString(diagnostic.message, message, messageMaxLength > 0 ? static_cast<size_t>(messageMaxLength) : 0, &length);
+   if (messageLength != nullptr)
+   {
+      *messageLength = static_cast<SQLSMALLINT>(length);
+   }
+   return result;
+}
+
+std::optional<SQLRETURN> GetPostedDiagField(HandleRecord &record, SQLSMALLINT recordNumber, SQLSMALLINT fieldId, SQLPOINTER value,
+                                            SQLSMALLINT valueMaxLength, SQLSMALLINT *valueLength)
+{
+   if (!record.hasPostedDiagnostics.load(std::memory_order_acquire))
+   {
+      return std::nullopt;
+   }
+
+   std::lock_guard lock(record.stateLock);
+
+   // header fields, without record the call succeeded
+   if (fieldId == SQL_DIAG_NUMBER || fieldId == SQL_DIAG_RETURNCODE)
+   {
+      if (value != nullptr && fieldId == SQL_DIAG_NUMBER)
+      {
+         *static_cast<SQLINTEGER *>(value) = static_cast<SQLINTEGER>(record.postedDiagnostics.size());
+      }
+      else if (value != nullptr)
+      {
+         *static_cast<SQLRETURN *>(value) = record.postedDiagnostics.empty() ? SQLRETURN{SQL_SUCCESS} : record.postedDiagnostics.front().returnCode;
+      }
+      return SQL_SUCCESS;
+   }
+
+   if (recordNumber <= 0)
+   {
+      return SQL_ERROR;
+   }
+   if (static_cast<size_t>(recordNumber) > record.postedDiagnostics.size())
+   {
+      return SQL_NO_DATA;
+   }
+
+   auto &diagnostic = record.postedDiagnostics[recordNumber - 1];
+   std::wstring_view text;
+   switch (fieldId)
+   {
+   case SQL_DIAG_NATIVE:
+      if (value != nullptr)
+      {
+         *static_cast<SQLINTEGER *>(value) = diagnostic.nativeError;
+      }
+      return SQL_SUCCESS;
+   case SQL_DIAG_SQLSTATE:
+      text = diagnostic.sqlState;
+      break;
+   case SQL_DIAG_MESSAGE_TEXT:
+      text = diagnostic.message;
+      break;
+   case SQL_DIAG_CLASS_ORIGIN:
+   case SQL_DIAG_SUBCLASS_ORIGIN:
+      text = L"ODBC 3.0";
+      break;
+   case SQL_DIAG_SERVER_NAME:
+   case SQL_DIAG_CONNECTION_NAME:
+      text = L"";
+      break;
+   default:
+      return SQL_NO_DATA;
+   }
+
+   // lengths are in bytes
+   size_t length = 0;
+   auto result = CopyString(text, static_cast<SQLWCHAR *>(value), valueMaxLength > 0 ? static_cast<size_t>(valueMaxLength) / sizeof(SQLWCHAR) : 0, &length);
+   if (valueLength != nullptr)
+   {
+      *valueLength = static_cast<SQLSMALLINT>(length * sizeof(SQLWCHAR));
+   }
+   return result;
+}
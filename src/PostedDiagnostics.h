@@ -0,0 +1,23 @@
+#pragma once
+#include "HandleRegistry.h"
+#include "Platform.h"
+
+#include <optional>
+#include <string_view>
+
+// diagnostics of calls answered by the detour without reaching the driver
+//
+// they are served by SQLGetDiagRecW and SQLGetDiagFieldW until the next call on the handle, like driver diagnostics.
+void PostDiagnostic(HandleRecord &record, SQLRETURN returnCode, std::wstring_view sqlState, std::wstring_view message, SQLINTEGER nativeError = 0);
+void ClearPostedDiagnostics(HandleRecord &record);
+// the driver diagnostics of the last call are hidden, the handle has no diagnostic record until the next call
+void HideDriverDiagnostics(HandleRecord &record);
+// driver diagnostic served later as posted, ex: the one of a row fetched in a block. Added after the records already
+// posted, the message is kept as the driver wrote it
+void AppendDriverDiagnostic(HandleRecord &record, PostedDiagnostic diagnostic);
+
+// nullopt when the last call on the handle reached the driver, the driver diagnostics are then used
+std::optional<SQLRETURN> GetPostedDiagRec(HandleRecord &record, SQLSMALLINT recordNumber, SQLWCHAR *sqlState, SQLINTEGER *nativeError,
+                                          SQLWCHAR *message, SQLSMALLINT messageMaxLength, SQLSMALLINT *messageLength);
+std::optional<SQLRETURN> GetPostedDiagField(HandleRecord &record, SQLSMALLINT recordNumber, SQLSMALLINT fieldId, SQLPOINTER value,
+                                            SQLSMALLINT valueMaxLength, SQLSMALLINT *valueLength);
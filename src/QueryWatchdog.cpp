@@ -0,0 +1,367 @@
+#include "QueryWatchdog.h"
+#include "Driver.h"
+#include "Logging.h"
+#include "OdbcFormatters.h"
+#include "PostedDiagnostics.h"
+#include "Settings.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <print>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+enum class TimerState
+{
+   Armed,
+   Cancelled,
+   Firing,
+   Fired,
+};
+
+struct WatchdogTimer
+{
+   std::atomic<TimerState> state{TimerState::Armed};
+   const Driver *driver = nullptr;
+   // driver statement to cancel and application handle for the log
+   SQLHSTMT statement = SQL_NULL_HANDLE;
+   SQLHANDLE handle = SQL_NULL_HANDLE;
+   long long timeout = 0;
+   // protected by the wheel lock
+   uint64_t deadline = 0;
+   size_t slot = 0;
+   size_t index = 0;
+};
+
+namespace
+{
+constexpr auto kTick = std::chrono::milliseconds(100);
+// one revolution covers 51.2 seconds, longer timeouts wait in their slot for later revolutions
+constexpr size_t kSlots = 512;
+
+// hashed timing wheel: arming and disarming are O(1), each tick only looks at one slot
+class TimerWheel
+{
+ public:
+   void Arm(const std::shared_ptr<WatchdogTimer> &timer, std::chrono::milliseconds timeout)
+   {
+      std::lock_guard lock(m_lock);
+      auto ticks = std::max<uint64_t>(1, static_cast<uint64_t>((timeout + kTick - std::chrono::milliseconds(1)) / kTick));
+      timer->deadline = m_tick + ticks;
+      timer->slot = timer->deadline % kSlots;
+      timer->index = m_slots[timer->slot].size();
+      m_slots[timer->slot].push_back(timer);
+   }
+
+   // true when the timer was removed before it expired
+   bool Disarm(WatchdogTimer &timer)
+   {
+      std::lock_guard lock(m_lock);
+      auto expected = TimerState::Armed;
+      if (!timer.state.compare_exchange_strong(expected, TimerState::Cancelled))
+      {
+         return false;
+      }
+      Remove(timer);
+      return true;
+   }
+
+   // move to the next tick, the expired timers are returned in the Firing state
+   std::vector<std::shared_ptr<WatchdogTimer>> Advance()
+   {
+      std::vector<std::shared_ptr<WatchdogTimer>> expired;
+      std::lock_guard lock(m_lock);
+      ++m_tick;
+      auto &slot = m_slots[m_tick % kSlots];
+      for (size_t i = 0; i < slot.size();)
+      {
+         if (slot[i]->deadline > m_tick)
+         {
+            ++i;
+            continue;
+         }
+         auto timer = slot[i];
+         timer->state.store(TimerState::Firing);
+         Remove(*timer);
+         expired.push_back(std::move(timer));
+      }
+      return expired;
+   }
+
+   uint64_t Tick()
+   {
+      std::lock_guard lock(m_lock);
+      return m_tick;
+   }
+
+ private:
+   void Remove(WatchdogTimer &timer)
+   {
+      auto &slot = m_slots[timer.slot];
+      if (timer.index + 1 != slot.size())
+      {
+         slot[timer.index] = std::move(slot.back());
+         slot[timer.index]->index = timer.index;
+      }
+      slot.pop_back();
+   }
+
+   std::mutex m_lock;
+   uint64_t m_tick = 0;
+   std::array<std::vector<std::shared_ptr<WatchdogTimer>>, kSlots> m_slots;
+};
+
+TimerWheel wheel;
+
+std::mutex watchdogLock;
+// intentionally leaked if the application exits without freeing its environments, see the metrics publisher
+std::jthread *watchdog = nullptr;
+std::atomic<bool> watchdogRunning{false};
+
+void Fire(WatchdogTimer &timer)
+{
+   SQLRETURN result = SQL_ERROR;
+   if (auto cancel = timer.driver->Get<OdbcFunctionId::SQLCancel>(); cancel != nullptr)
+   {
+      result = cancel(timer.statement);
+   }
+   std::print(LOG, "Query timeout of {} s expired on {}, SQLCancel -> {}", timer.timeout, timer.handle, ReturnCode{result});
+   timer.state.store(TimerState::Fired);
+   timer.state.notify_all();
+}
+
+void Run(std::stop_token stop)
+{
+   std::mutex mutex;
+   std::condition_variable_any wakeUp;
+   std::unique_lock lock(mutex);
+
+   // ticks follow the clock, a late wake up processes every tick it missed
+   auto start = std::chrono::steady_clock::now();
+   auto first = wheel.Tick();
+   while (!stop.stop_requested())
+   {
+      wakeUp.wait_for(lock, stop, kTick, [] { return false; });
+      auto target = first + static_cast<uint64_t>((std::chrono::steady_clock::now() - start) / kTick);
+      while (wheel.Tick() < target)
+      {
+         for (auto &timer : wheel.Advance())
+         {
+            Fire(*timer);
+         }
+      }
+   }
+}
+
+long long EffectiveTimeout(const HandleRecord &record)
+{
+   if (auto timeout = record.queryTimeout.load(std::memory_order_relaxed); timeout >= 0)
+   {
+      return timeout;
+   }
+   if (record.parent)
+   {
+      if (auto timeout = record.parent->queryTimeout.load(std::memory_order_relaxed); timeout >= 0)
+      {
+         return timeout;
+      }
+   }
+   return CurrentSettings().queryTimeout;
+}
+} // namespace
+
+bool QueryWatchdogEnabled()
+{
+   static const bool enabled = GetSettingBool("QUERY_WATCHDOG", false);
+   return enabled;
+}
+
+void StartQueryWatchdog()
+{
+   if (!QueryWatchdogEnabled())
+   {
+      return;
+   }
+   std::lock_guard lock(watchdogLock);
+   if (watchdog == nullptr)
+   {
+      watchdog = new std::jthread(Run);
+      watchdogRunning.store(true);
+   }
+}
+
+void StopQueryWatchdog()
+{
+   std::lock_guard lock(watchdogLock);
+   watchdogRunning.store(false);
+   delete watchdog;
+   watchdog = nullptr;
+}
+
+void SetQueryTimeout(HandleRecord &record, SQLULEN seconds)
+{
+   record.queryTimeout.store(static_cast<long long>(seconds), std::memory_order_relaxed);
+}
+
+namespace
+{
+constexpr SQLSMALLINT kMaxTimeoutDiagnostics = 16;
+
+// a driver refusing the attribute as not supported, HYC00 or HY092, succeeds without diagnostic when the watchdog
+// enforces the timeout
+SQLRETURN AcceptRefusedTimeout(const Route &route, SQLRETURN result)
+{
+   if (result != SQL_ERROR || !QueryWatchdogEnabled())
+   {
+      return result;
+   }
+   auto getDiagRec = route.driver->Get<OdbcFunctionId::SQLGetDiagRecW>();
+   SQLWCHAR sqlState[6]{};
+   SQLINTEGER nativeError = 0;
+   SQLSMALLINT messageLength = 0;
+   if (getDiagRec == nullptr || !SQL_SUCCEEDED(getDiagRec(route.record->type, route.handle, 1, sqlState, &nativeError, nullptr, 0, &messageLength)))
+   {
+      return result;
+   }
+   std::wstring_view state(reinterpret_cast<const wchar_t *>(sqlState));
+   if (state != L"HYC00" && state != L"HY092")
+   {
+      return result;
+   }
+   HideDriverDiagnostics(*route.record);
+   return SQL_SUCCESS;
+}
+
+// timeout the driver substituted for the requested one, 01S02. Reading it back resets the driver diagnostics, they are
+// kept as posted ones for the application
+SQLULEN ReadSubstitutedTimeout(const Route &route, SQLULEN requested)
+{
+   auto getDiagRec = route.driver->Get<OdbcFunctionId::SQLGetDiagRecW>();
+   if (getDiagRec == nullptr)
+   {
+      return requested;
+   }
+   std::vector<PostedDiagnostic> diagnostics;
+   bool substituted = false;
+   for (SQLSMALLINT number = 1; number <= kMaxTimeoutDiagnostics; ++number)
+   {
+      SQLWCHAR sqlState[6]{};
+      SQLINTEGER nativeError = 0;
+      SQLWCHAR message[SQL_MAX_MESSAGE_LENGTH]{};
+      SQLSMALLINT messageLength = 0;
+      if (!SQL_SUCCEEDED(getDiagRec(route.record->type, route.handle, number, sqlState, &nativeError, message, static_cast<SQLSMALLINT>(std::size(message)), &messageLength)))
+      {
+         break;
+      }
+      std::wstring_view state(reinterpret_cast<const wchar_t *>(sqlState));
+      substituted = substituted || state == L"01S02";
+      diagnostics.push_back({std::wstring(state), nativeError,
+                             std::wstring(reinterpret_cast<const wchar_t *>(message), std::clamp<SQLSMALLINT>(messageLength, 0, static_cast<SQLSMALLINT>(std::size(message)) - 1)),
+                             SQL_SUCCESS_WITH_INFO});
+   }
+   if (!substituted)
+   {
+      return requested;
+   }
+
+   SQLULEN value = requested;
+   SQLRETURN result = SQL_ERROR;
+   if (route.record->type == SQL_HANDLE_STMT)
+   {
+      if (auto getAttr = route.driver->Get<OdbcFunctionId::SQLGetStmtAttrW>(); getAttr != nullptr)
+      {
+         result = getAttr(route.handle, SQL_ATTR_QUERY_TIMEOUT, &value, SQL_IS_UINTEGER, nullptr);
+      }
+   }
+   else if (auto getAttr = route.driver->Get<OdbcFunctionId::SQLGetConnectAttrW>(); getAttr != nullptr)
+   {
+      result = getAttr(route.handle, SQL_ATTR_QUERY_TIMEOUT, &value, SQL_IS_UINTEGER, nullptr);
+   }
+
+   HideDriverDiagnostics(*route.record);
+   for (auto &diagnostic : diagnostics)
+   {
+      AppendDriverDiagnostic(*route.record, std::move(diagnostic));
+   }
+   return SQL_SUCCEEDED(result) ? value : requested;
+}
+} // namespace
+
+SQLRETURN CompleteQueryTimeout(const Route &route, SQLULEN seconds, SQLRETURN result)
+{
+   if (!route.record)
+   {
+      return result;
+   }
+   if (route.driver != nullptr)
+   {
+      result = AcceptRefusedTimeout(route, result);
+      if (result == SQL_SUCCESS_WITH_INFO)
+      {
+         seconds = ReadSubstitutedTimeout(route, seconds);
+      }
+   }
+   if (SQL_SUCCEEDED(result))
+   {
+      SetQueryTimeout(*route.record, seconds);
+   }
+   return result;
+}
+
+QueryWatch::QueryWatch(const Route &route)
+    : m_route(route)
+{
+   if (!watchdogRunning.load(std::memory_order_relaxed) || route.driver == nullptr || !route.record)
+   {
+      return;
+   }
+   auto timeout = EffectiveTimeout(*route.record);
+   if (timeout <= 0)
+   {
+      return;
+   }
+
+   m_timer = std::make_shared<WatchdogTimer>();
+   m_timer->driver = route.driver;
+   m_timer->statement = route.handle;
+   m_timer->handle = route.record->handle;
+   m_timer->timeout = timeout;
+   wheel.Arm(m_timer, std::chrono::seconds(timeout));
+}
+
+QueryWatch::~QueryWatch()
+{
+   if (m_timer)
+   {
+      Complete(SQL_ERROR);
+   }
+}
+
+SQLRETURN QueryWatch::Complete(SQLRETURN result)
+{
+   auto timer = std::move(m_timer);
+   if (!timer || wheel.Disarm(*timer))
+   {
+      return result;
+   }
+
+   // the watchdog is cancelling the statement, it must be done before the handle is used again
+   for (auto state = timer->state.load(); state != TimerState::Fired; state = timer->state.load())
+   {
+      timer->state.wait(state);
+   }
+
+   // the call may have finished just before the cancel, leave the statement as a cancelled execute would
+   if (auto freeStmt = m_route.driver->Get<OdbcFunctionId::SQLFreeStmt>(); freeStmt != nullptr)
+   {
+      freeStmt(m_route.handle, SQL_CLOSE);
+   }
+   PostDiagnostic(*m_route.record, SQL_ERROR, L"HYT00", L"Query timeout expired");
+   return SQL_ERROR;
+}
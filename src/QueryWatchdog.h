@@ -0,0 +1,44 @@
+#pragma once
+#include "HandleRegistry.h"
+#include "Platform.h"
+#include "Routing.h"
+
+#include <memory>
+
+// emulation of SQL_ATTR_QUERY_TIMEOUT for drivers ignoring it, enabled with ODBCDETOUR_QUERY_WATCHDOG=1
+//
+// the timeout set on a statement, or on its connection, arms a timer around each execute and fetch. When it expires a
+// watchdog thread calls SQLCancel on the driver statement and the call returns SQL_ERROR with SQLSTATE HYT00.
+// ODBCDETOUR_QUERY_TIMEOUT_S gives a timeout to statements without one.
+bool QueryWatchdogEnabled();
+
+void StartQueryWatchdog();
+void StopQueryWatchdog();
+
+// SQL_ATTR_QUERY_TIMEOUT set by the application, in seconds, 0 for no timeout
+void SetQueryTimeout(HandleRecord &record, SQLULEN seconds);
+
+// result of SQLSetConnectAttrW or SQLSetStmtAttrW(SQL_ATTR_QUERY_TIMEOUT), the timeout is recorded once the call
+// succeeded. A driver refusing the attribute as not supported, HYC00 or HY092, succeeds without diagnostic when the
+// watchdog enforces the timeout, one substituting another value, 01S02, is read back. Other errors are returned as is
+SQLRETURN CompleteQueryTimeout(const Route &route, SQLULEN seconds, SQLRETURN result);
+
+struct WatchdogTimer;
+
+// timer armed for one call on a statement
+class QueryWatch
+{
+ public:
+   explicit QueryWatch(const Route &route);
+   ~QueryWatch();
+
+   QueryWatch(const QueryWatch &) = delete;
+   QueryWatch &operator=(const QueryWatch &) = delete;
+
+   // disarm the timer, the result of the call is replaced by HYT00 when it expired
+   SQLRETURN Complete(SQLRETURN result);
+
+ private:
+   const Route &m_route;
+   std::shared_ptr<WatchdogTimer> m_timer;
+};
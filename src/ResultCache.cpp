@@ -0,0 +1,1226 @@
+#include "ResultCache.h"
+#include "ConnectionString.h"
+#include "Driver.h"
+#include "Logging.h"
+#include "PostedDiagnostics.h"
+#include "Settings.h"
+#include "SqlFingerprint.h"
+#include "Statement.h"
+#include "StringConversion.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <cwctype>
+#include <format>
+#include <limits>
+#include <list>
+#include <print>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+// indicator of a value the application did not read in the row
+constexpr SQLLEN kMissingValue = std::numeric_limits<SQLLEN>::min();
+// SQLGetData offset of a value entirely returned
+constexpr size_t kValueReturned = std::numeric_limits<size_t>::max();
+// longest column name kept from SQLDescribeColW
+constexpr SQLSMALLINT kMaxColumnName = 256;
+
+// functions whose value changes between executions, statements calling them are never cached
+constexpr std::array<std::string_view, 10> kVolatileFunctions = {
+    "getdate(", "getutcdate(", "sysdatetime(", "current_timestamp", "now(", "sysdate", "rand(", "newid(", "nextval", "next value for"};
+
+enum class CaptureState : uint8_t
+{
+   Missing,
+   Partial,
+   Complete,
+};
+
+bool IsScopedToConnection()
+{
+   static const bool connection = GetSetting("RESULT_CACHE").value_or("") == "connection";
+   return connection;
+}
+
+size_t Budget()
+{
+   static const size_t budget = static_cast<size_t>(std::max<long long>(1, GetSettingInt("RESULT_CACHE_MB", 64))) * 1024 * 1024;
+   return budget;
+}
+
+std::chrono::milliseconds TimeToLive()
+{
+   static const std::chrono::milliseconds ttl{std::max<long long>(0, GetSettingInt("RESULT_CACHE_TTL_MS", 5000))};
+   return ttl;
+}
+
+// bytes of the null terminator written after character data
+SQLLEN TerminatorSize(SQLSMALLINT type)
+{
+   return type == SQL_C_CHAR ? 1 : type == SQL_C_WCHAR ? static_cast<SQLLEN>(sizeof(SQLWCHAR)) : 0;
+}
+
+uint64_t Hash(std::string_view text, uint64_t hash = 14695981039346656037ull)
+{
+   for (unsigned char c : text)
+   {
+      hash = (hash ^ c) * 1099511628211ull;
+   }
+   return hash;
+}
+} // namespace
+
+struct CachedColumn
+{
+   std::wstring name;
+   SQLSMALLINT sqlType = 0;
+   SQLULEN columnSize = 0;
+   SQLSMALLINT decimalDigits = 0;
+   SQLSMALLINT nullable = SQL_NULLABLE_UNKNOWN;
+
+   // C type the application read the values with, 0 when the result has no row
+   SQLSMALLINT valueType = 0;
+   // values of all rows end to end, offsets[row] is where the value of the row starts
+   std::vector<std::byte> data;
+   std::vector<size_t> offsets;
+   // length of the value of each row or SQL_NULL_DATA
+   std::vector<SQLLEN> indicators;
+};
+
+struct CachedResult
+{
+   std::vector<CachedColumn> columns;
+   size_t rows = 0;
+   SQLLEN rowCount = -1;
+   size_t bytes = 0;
+
+   std::string key;
+   uint64_t database = 0;
+   uint64_t generation = 0;
+   std::chrono::steady_clock::time_point expires;
+};
+
+struct ResultCapture
+{
+   std::shared_ptr<CachedResult> result;
+   // capture state of each column in the current row
+   std::vector<CaptureState> row;
+   bool rowOpen = false;
+};
+
+namespace
+{
+struct Cache
+{
+   std::mutex lock;
+   // most recently used first
+   std::list<std::shared_ptr<const CachedResult>> entries;
+   std::unordered_map<std::string, std::list<std::shared_ptr<const CachedResult>>::iterator> index;
+   size_t bytes = 0;
+   // bumped by every statement changing a database, results captured meanwhile are not cached. The global one is bumped
+   // when the database is unknown
+   std::unordered_map<uint64_t, uint64_t> generations;
+   uint64_t globalGeneration = 0;
+
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+   uint64_t inserts = 0;
+   uint64_t evictions = 0;
+   uint64_t expirations = 0;
+   uint64_t invalidations = 0;
+   uint64_t rejected = 0;
+   uint64_t fallbacks = 0;
+};
+
+Cache &GetCache()
+{
+   static Cache cache;
+   return cache;
+}
+
+// must be called with the cache lock held
+uint64_t Generation(Cache &cache, uint64_t database)
+{
+   // both only grow, their sum changes when either does
+   return cache.globalGeneration + cache.generations[database];
+}
+
+// must be called with the cache lock held
+void Erase(Cache &cache, std::list<std::shared_ptr<const CachedResult>>::iterator it)
+{
+   cache.bytes -= (*it)->bytes;
+   cache.index.erase((*it)->key);
+   cache.entries.erase(it);
+}
+
+std::shared_ptr<const CachedResult> Lookup(const std::string &key)
+{
+   auto &cache = GetCache();
+   std::lock_guard lock(cache.lock);
+   auto it = cache.index.find(key);
+   if (it == cache.index.end())
+   {
+      ++cache.misses;
+      return nullptr;
+   }
+   if ((*it->second)->expires <= std::chrono::steady_clock::now())
+   {
+      Erase(cache, it->second);
+      ++cache.expirations;
+      ++cache.misses;
+      return nullptr;
+   }
+   cache.entries.splice(cache.entries.begin(), cache.entries, it->second);
+   ++cache.hits;
+   return *it->second;
+}
+
+void Insert(std::shared_ptr<CachedResult> result)
+{
+   auto &cache = GetCache();
+   std::lock_guard lock(cache.lock);
+   if (result->generation != Generation(cache, result->database))
+   {
+      // the database changed while the result was read
+      ++cache.rejected;
+      return;
+   }
+   if (auto it = cache.index.find(result->key); it != cache.index.end())
+   {
+      Erase(cache, it->second);
+   }
+   result->expires = std::chrono::steady_clock::now() + TimeToLive();
+   cache.bytes += result->bytes;
+   cache.entries.push_front(std::move(result));
+   cache.index.emplace(cache.entries.front()->key, cache.entries.begin());
+   ++cache.inserts;
+   while (cache.bytes > Budget() && cache.entries.size() > 1)
+   {
+      Erase(cache, std::prev(cache.entries.end()));
+      ++cache.evictions;
+   }
+}
+
+// the data of the database changed, 0 when the database is unknown
+void Invalidate(uint64_t database)
+{
+   auto &cache = GetCache();
+   std::lock_guard lock(cache.lock);
+   if (database == 0)
+   {
+      ++cache.globalGeneration;
+   }
+   else
+   {
+      ++cache.generations[database];
+   }
+   for (auto it = cache.entries.begin(); it != cache.entries.end();)
+   {
+      auto next = std::next(it);
+      if (database == 0 || (*it)->database == database)
+      {
+         Erase(cache, it);
+         ++cache.invalidations;
+      }
+      it = next;
+   }
+}
+
+ResultCacheState &GetResultCache(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   if (!statement.resultCache)
+   {
+      statement.resultCache = std::make_unique<ResultCacheState>();
+   }
+   return *statement.resultCache;
+}
+
+ResultCacheState *FindResultCache(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   return statement.resultCache.get();
+}
+
+uint64_t DatabaseOf(const HandleRecord &statement)
+{
+   return statement.parent ? statement.parent->database.load(std::memory_order_acquire) : 0;
+}
+
+StatementEffect Classify(std::string_view sql)
+{
+   auto normalized = NormalizeSql(sql);
+   while (!normalized.empty() && (normalized.back() == ';' || normalized.back() == ' '))
+   {
+      normalized.pop_back();
+   }
+   if (normalized.starts_with("use "))
+   {
+      return StatementEffect::SwitchDatabase;
+   }
+   if (!normalized.starts_with("select ") || normalized.contains(';') || normalized.contains(" into ") || normalized.contains(" for update"))
+   {
+      return StatementEffect::Write;
+   }
+   for (auto function : kVolatileFunctions)
+   {
+      if (normalized.contains(function))
+      {
+         // reads, but another execution may not return the same result
+         return StatementEffect::Unknown;
+      }
+   }
+   return StatementEffect::Read;
+}
+
+// must be called with the state lock held
+StatementEffect GetEffect(HandleRecord &statement, ResultCacheState &state)
+{
+   auto fingerprint = statement.sqlFingerprint.load(std::memory_order_acquire);
+   if (fingerprint == 0)
+   {
+      return StatementEffect::Unknown;
+   }
+   if (fingerprint != state.classifiedFingerprint)
+   {
+      state.effect = Classify(GetStatementText(statement));
+      state.classifiedFingerprint = fingerprint;
+   }
+   return state.effect;
+}
+
+SQLULEN GetDriverAttribute(const Route &route, OdbcSignature<OdbcFunctionId::SQLGetStmtAttrW>::Proc getStmtAttr, SQLINTEGER attribute, bool *ok)
+{
+   SQLULEN value = 0;
+   if (!SQL_SUCCEEDED(getStmtAttr(route.handle, attribute, &value, sizeof(value), nullptr)))
+   {
+      *ok = false;
+   }
+   return value;
+}
+
+// key of the result of the statement, nullopt when its result cannot be cached: the application fetches by rowsets, with a
+// scrollable cursor or asynchronously, or a parameter is not a plain input value bound with SQLBindParameter, ex:
+// set through the APD, offset by SQL_ATTR_PARAM_BIND_OFFSET_PTR or part of an array of parameter sets
+std::optional<std::string> CacheKey(const Route &route, uint64_t database)
+{
+   auto getStmtAttr = route.driver->Get<OdbcFunctionId::SQLGetStmtAttrW>();
+   if (getStmtAttr == nullptr)
+   {
+      return std::nullopt;
+   }
+   bool ok = true;
+   auto rowArraySize = GetDriverAttribute(route, getStmtAttr, SQL_ATTR_ROW_ARRAY_SIZE, &ok);
+   auto bindOffset = GetDriverAttribute(route, getStmtAttr, SQL_ATTR_ROW_BIND_OFFSET_PTR, &ok);
+   auto cursorType = GetDriverAttribute(route, getStmtAttr, SQL_ATTR_CURSOR_TYPE, &ok);
+   auto async = GetDriverAttribute(route, getStmtAttr, SQL_ATTR_ASYNC_ENABLE, &ok);
+   auto parameterOffset = GetDriverAttribute(route, getStmtAttr, SQL_ATTR_PARAM_BIND_OFFSET_PTR, &ok);
+   auto parameterSets = GetDriverAttribute(route, getStmtAttr, SQL_ATTR_PARAMSET_SIZE, &ok);
+   // attributes changing the rows or the values returned
+   auto maxRows = GetDriverAttribute(route, getStmtAttr, SQL_ATTR_MAX_ROWS, &ok);
+   auto maxLength = GetDriverAttribute(route, getStmtAttr, SQL_ATTR_MAX_LENGTH, &ok);
+   auto noScan = GetDriverAttribute(route, getStmtAttr, SQL_ATTR_NOSCAN, &ok);
+   if (!ok || rowArraySize != 1 || bindOffset != 0 || cursorType != SQL_CURSOR_FORWARD_ONLY || async != SQL_ASYNC_ENABLE_OFF || parameterOffset != 0 ||
+       parameterSets != 1)
+   {
+      return std::nullopt;
+   }
+   auto parameters = StatementParameterKey(*route.record);
+   if (!parameters)
+   {
+      return std::nullopt;
+   }
+
+   auto key = std::format("{:016x}:{}:{}:{}:{}:", database, IsScopedToConnection() ? reinterpret_cast<uintptr_t>(route.record->parent->handle) : 0, maxRows,
+                          maxLength, noScan);
+   key += GetStatementText(*route.record);
+   key += '\0';
+   key += *parameters;
+   return key;
+}
+
+// metadata of the result the driver just produced, must be called with the state lock held
+void StartCapture(const Route &route, ResultCacheState &state, std::string key, uint64_t database, uint64_t generation)
+{
+   auto numResultCols = route.driver->Get<OdbcFunctionId::SQLNumResultCols>();
+   auto describeCol = route.driver->Get<OdbcFunctionId::SQLDescribeColW>();
+   SQLSMALLINT count = 0;
+   if (numResultCols == nullptr || describeCol == nullptr || !SQL_SUCCEEDED(numResultCols(route.handle, &count)) || count <= 0)
+   {
+      return;
+   }
+
+   auto result = std::make_shared<CachedResult>();
+   result->key = std::move(key);
+   result->database = database;
+   result->generation = generation;
+   result->bytes = result->key.size();
+   for (SQLUSMALLINT number = 1; number <= static_cast<SQLUSMALLINT>(count); ++number)
+   {
+      CachedColumn column;
+      SQLWCHAR name[kMaxColumnName] = {};
+      SQLSMALLINT nameLength = 0;
+      if (describeCol(route.handle, number, name, kMaxColumnName, &nameLength, &column.sqlType, &column.columnSize, &column.decimalDigits, &column.nullable) != SQL_SUCCESS)
+      {
+         // error or name truncated
+         return;
+      }
+      column.name.assign(reinterpret_cast<const wchar_t *>(name), static_cast<size_t>(std::max<SQLSMALLINT>(nameLength, 0)));
+      result->bytes += sizeof(CachedColumn) + column.name.size() * sizeof(wchar_t);
+      result->columns.push_back(std::move(column));
+   }
+
+   state.capture = std::make_unique<ResultCapture>();
+   state.capture->result = std::move(result);
+   state.capture->row.assign(static_cast<size_t>(count), CaptureState::Missing);
+}
+
+// must be called with the state lock held
+void AbortCapture(ResultCacheState &state)
+{
+   if (state.capture)
+   {
+      state.capture.reset();
+      std::lock_guard lock(GetCache().lock);
+      ++GetCache().rejected;
+   }
+}
+
+// the current row must have every value, must be called with the state lock held
+bool CloseRow(ResultCacheState &state)
+{
+   auto &capture = *state.capture;
+   if (!capture.rowOpen)
+   {
+      return true;
+   }
+   capture.rowOpen = false;
+   return std::ranges::all_of(capture.row, [](CaptureState value)
+                              { return value == CaptureState::Complete; });
+}
+
+void OpenRow(ResultCapture &capture)
+{
+   for (auto &column : capture.result->columns)
+   {
+      column.offsets.push_back(column.data.size());
+      column.indicators.push_back(kMissingValue);
+   }
+   std::ranges::fill(capture.row, CaptureState::Missing);
+   capture.rowOpen = true;
+   ++capture.result->rows;
+   capture.result->bytes += capture.result->columns.size() * (sizeof(size_t) + sizeof(SQLLEN));
+}
+
+// a column read with another C type than in the previous rows is not cached
+bool SetValueType(CachedColumn &column, SQLSMALLINT targetType)
+{
+   if (column.valueType == 0)
+   {
+      column.valueType = targetType;
+   }
+   return column.valueType == targetType;
+}
+
+// length of the value in the application buffer, -1 when it cannot be known
+SQLLEN ApplicationLength(SQLSMALLINT type, SQLPOINTER value, SQLLEN *strLenOrInd)
+{
+   if (strLenOrInd != nullptr)
+   {
+      return *strLenOrInd;
+   }
+   switch (type)
+   {
+   case SQL_C_CHAR:
+      return static_cast<SQLLEN>(std::strlen(static_cast<const char *>(value)));
+   case SQL_C_WCHAR:
+      return static_cast<SQLLEN>(std::wcslen(static_cast<const wchar_t *>(value)) * sizeof(wchar_t));
+   case SQL_C_BINARY:
+      return -1;
+   default:
+      return FixedCTypeSize(type);
+   }
+}
+
+// copy the values of the bound columns of the row just fetched, false when the row cannot be cached. Must be called with
+// the state lock held
+bool CaptureBoundColumns(HandleRecord &statement, ResultCapture &capture)
+{
+   auto &result = *capture.result;
+   for (auto &[number, bound] : GetStatementColumns(statement))
+   {
+      if (number == 0 || number > result.columns.size() || bound.value == nullptr)
+      {
+         // bookmark or indicator only
+         return false;
+      }
+      auto &column = result.columns[number - 1];
+      if (!SetValueType(column, bound.targetType))
+      {
+         return false;
+      }
+      auto length = ApplicationLength(bound.targetType, bound.value, bound.strLenOrInd);
+      if (length == SQL_NULL_DATA)
+      {
+         column.indicators.back() = SQL_NULL_DATA;
+         capture.row[number - 1] = CaptureState::Complete;
+         continue;
+      }
+      SQLLEN size = IsVariableCType(bound.targetType) ? length : FixedCTypeSize(bound.targetType);
+      if (size < 0 || (IsVariableCType(bound.targetType) && size > bound.bufferLength - TerminatorSize(bound.targetType)) || (size == 0 && !IsVariableCType(bound.targetType)))
+      {
+         // truncated, unknown length or C type
+         return false;
+      }
+      auto bytes = static_cast<const std::byte *>(bound.value);
+      column.data.insert(column.data.end(), bytes, bytes + size);
+      column.indicators.back() = size;
+      result.bytes += static_cast<size_t>(size);
+      capture.row[number - 1] = CaptureState::Complete;
+   }
+   return true;
+}
+
+// must be called with the state lock held
+void FinishCapture(const Route &route, ResultCacheState &state)
+{
+   auto capture = std::move(state.capture);
+   SQLLEN rowCount = -1;
+   if (auto rowCountFn = route.driver->Get<OdbcFunctionId::SQLRowCount>(); rowCountFn != nullptr)
+   {
+      rowCountFn(route.handle, &rowCount);
+   }
+   capture->result->rowCount = rowCount;
+   Insert(std::move(capture->result));
+}
+
+// the served result cannot answer the application, the statement is executed by the driver and its result captured.
+// Must be called with the state lock held and before the first row was served
+SQLRETURN FallBack(const Route &route, ResultCacheState &state, ReexecuteFunction executeAgain)
+{
+   auto served = std::move(state.serving);
+   state.position = 0;
+   state.dataOffsets.clear();
+   {
+      std::lock_guard lock(GetCache().lock);
+      ++GetCache().fallbacks;
+   }
+
+   auto result = executeAgain(route, state.directText);
+   if (result == SQL_SUCCESS)
+   {
+      uint64_t generation = 0;
+      {
+         std::lock_guard lock(GetCache().lock);
+         generation = Generation(GetCache(), served->database);
+      }
+      StartCapture(route, state, served->key, served->database, generation);
+   }
+   return result;
+}
+
+// the application bindings can be served from the result
+bool BindingsMatch(const CachedResult &result, const std::map<SQLUSMALLINT, BoundColumn> &bound)
+{
+   for (auto &[number, column] : bound)
+   {
+      if (number == 0 || number > result.columns.size())
+      {
+         return false;
+      }
+      auto valueType = result.columns[number - 1].valueType;
+      if (valueType != 0 && valueType != column.targetType)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+// copy a value of the result to an application buffer, offset is the part of the value already returned
+SQLRETURN CopyValue(HandleRecord &statement, const CachedColumn &column, size_t row, size_t offset, SQLPOINTER value, SQLLEN bufferLength,
+                    SQLLEN *strLenOrInd, size_t *copied)
+{
+   auto indicator = column.indicators[row];
+   if (indicator == SQL_NULL_DATA)
+   {
+      if (strLenOrInd == nullptr)
+      {
+         PostDiagnostic(statement, SQL_ERROR, L"22002", L"Indicator variable required but not supplied");
+         return SQL_ERROR;
+      }
+      *strLenOrInd = SQL_NULL_DATA;
+      *copied = 0;
+      return SQL_SUCCESS;
+   }
+
+   auto source = column.data.data() + column.offsets[row] + offset;
+   auto remaining = static_cast<SQLLEN>(indicator - static_cast<SQLLEN>(offset));
+   if (!IsVariableCType(column.valueType))
+   {
+      if (value != nullptr)
+      {
+         std::memcpy(value, source, static_cast<size_t>(remaining));
+      }
+      if (strLenOrInd != nullptr)
+      {
+         *strLenOrInd = remaining;
+      }
+      *copied = static_cast<size_t>(remaining);
+      return SQL_SUCCESS;
+   }
+
+   auto terminator = TerminatorSize(column.valueType);
+   auto available = value != nullptr ? std::max<SQLLEN>(0, bufferLength - terminator) : 0;
+   if (column.valueType == SQL_C_WCHAR)
+   {
+      available -= available % static_cast<SQLLEN>(sizeof(SQLWCHAR));
+   }
+   auto count = std::min(remaining, available);
+   if (value != nullptr && bufferLength > 0)
+   {
+      std::memcpy(value, source, static_cast<size_t>(count));
+      if (terminator > 0 && bufferLength >= count + terminator)
+      {
+         std::memset(static_cast<std::byte *>(value) + count, 0, static_cast<size_t>(terminator));
+      }
+   }
+   if (strLenOrInd != nullptr)
+   {
+      *strLenOrInd = remaining;
+   }
+   *copied = static_cast<size_t>(count);
+   if (count < remaining)
+   {
+      PostDiagnostic(statement, SQL_SUCCESS_WITH_INFO, L"01004", L"String data, right truncated");
+      return SQL_SUCCESS_WITH_INFO;
+   }
+   return SQL_SUCCESS;
+}
+
+// worst of two results of a call
+SQLRETURN Combine(SQLRETURN a, SQLRETURN b)
+{
+   if (a == SQL_ERROR || b == SQL_ERROR)
+   {
+      return SQL_ERROR;
+   }
+   return a == SQL_SUCCESS_WITH_INFO || b == SQL_SUCCESS_WITH_INFO ? SQL_SUCCESS_WITH_INFO : SQL_SUCCESS;
+}
+
+// copy the next row to the bound columns, must be called with the state lock held
+SQLRETURN ServeRow(HandleRecord &statement, ResultCacheState &state)
+{
+   auto &result = *state.serving;
+   if (state.position >= result.rows)
+   {
+      state.position = result.rows + 1;
+      return SQL_NO_DATA;
+   }
+   auto row = state.position++;
+   state.dataOffsets.clear();
+
+   SQLRETURN rc = SQL_SUCCESS;
+   for (auto &[number, bound] : GetStatementColumns(statement))
+   {
+      if (number == 0 || number > result.columns.size())
+      {
+         PostDiagnostic(statement, SQL_ERROR, L"07009", L"Invalid descriptor index");
+         rc = SQL_ERROR;
+         continue;
+      }
+      auto &column = result.columns[number - 1];
+      if (bound.targetType != column.valueType)
+      {
+         PostDiagnostic(statement, SQL_ERROR, L"07006", L"Column rebound with another type while its result is served from the cache");
+         rc = SQL_ERROR;
+         continue;
+      }
+      size_t copied = 0;
+      rc = Combine(rc, CopyValue(statement, column, row, 0, bound.value, bound.bufferLength, bound.strLenOrInd, &copied));
+   }
+   return rc;
+}
+
+// must be called with the state lock held
+void SetServing(ResultCacheState &state, std::shared_ptr<const CachedResult> result)
+{
+   state.serving = std::move(result);
+   state.position = 0;
+   state.dataOffsets.clear();
+}
+
+// write a column name, 01004 when it does not fit
+SQLRETURN CopyName(HandleRecord &statement, const std::wstring &name, SQLWCHAR *buffer, SQLSMALLINT maxLength, SQLSMALLINT *length)
+{
+   if (length != nullptr)
+   {
+      *length = static_cast<SQLSMALLINT>(name.size());
+   }
+   if (buffer == nullptr || maxLength <= 0)
+   {
+      return SQL_SUCCESS;
+   }
+   auto count = std::min(name.size(), static_cast<size_t>(maxLength - 1));
+   std::memcpy(buffer, name.data(), count * sizeof(SQLWCHAR));
+   buffer[count] = 0;
+   if (count < name.size())
+   {
+      PostDiagnostic(statement, SQL_SUCCESS_WITH_INFO, L"01004", L"String data, right truncated");
+      return SQL_SUCCESS_WITH_INFO;
+   }
+   return SQL_SUCCESS;
+}
+
+// autocommit of the connection as set in the driver, off when it cannot be read
+bool IsAutocommit(const Route &route, HandleRecord &connection)
+{
+   auto getConnectAttr = route.driver->Get<OdbcFunctionId::SQLGetConnectAttrW>();
+   SQLULEN autocommit = SQL_AUTOCOMMIT_OFF;
+   if (getConnectAttr == nullptr ||
+       !SQL_SUCCEEDED(getConnectAttr(connection.driverHandle.load(std::memory_order_acquire), SQL_ATTR_AUTOCOMMIT, &autocommit, sizeof(autocommit), nullptr)))
+   {
+      return false;
+   }
+   return autocommit != SQL_AUTOCOMMIT_OFF;
+}
+
+std::wstring Lower(std::wstring value)
+{
+   std::ranges::transform(value, value.begin(), [](wchar_t c)
+                          { return static_cast<wchar_t>(std::towlower(c)); });
+   return value;
+}
+} // namespace
+
+ResultCacheState::ResultCacheState() = default;
+ResultCacheState::~ResultCacheState() = default;
+
+bool ResultCacheEnabled()
+{
+   static const bool enabled = [] {
+      auto setting = GetSetting("RESULT_CACHE").value_or("");
+      return setting == "process" || setting == "connection";
+   }();
+   return enabled;
+}
+
+void RegisterDatabase(HandleRecord &connection, std::wstring_view driverPath, std::wstring_view dsn, std::wstring_view connectionString)
+{
+   // the password is left out, the same user sees the same data whatever the way it authenticates
+   std::wstring identity = Lower(std::wstring(driverPath));
+   identity += L'|';
+   identity += Lower(std::wstring(dsn));
+   for (auto key : {L"SERVER", L"DATABASE", L"DBQ", L"UID"})
+   {
+      identity += L'|';
+      identity += Lower(GetConnectionAttribute(connectionString, key).value_or(L""));
+   }
+   {
+      // catalog set before connecting
+      std::lock_guard lock(connection.stateLock);
+      for (auto &pending : connection.pendingAttributes)
+      {
+         if (pending.attribute == SQL_ATTR_CURRENT_CATALOG && pending.value != nullptr)
+         {
+            identity += L'|';
+            identity += Lower(static_cast<const wchar_t *>(pending.value));
+         }
+      }
+   }
+   connection.database.store(std::max<uint64_t>(1, Hash(ToUtf8(identity))), std::memory_order_release);
+}
+
+void ForgetDatabase(HandleRecord &connection)
+{
+   connection.database.store(0, std::memory_order_release);
+}
+
+void EndCachedTransaction(HandleRecord &connection)
+{
+   if (ResultCacheEnabled())
+   {
+      Invalidate(connection.database.load(std::memory_order_acquire));
+      connection.uncommittedWrites.store(false, std::memory_order_release);
+   }
+}
+
+SQLRETURN ExecuteCached(const Route &route, std::wstring_view directText, const std::function<SQLRETURN()> &execute)
+{
+   if (!route.record || route.driver == nullptr || !route.record->parent || !ResultCacheEnabled())
+   {
+      return execute();
+   }
+
+   auto &state = GetResultCache(*route.record);
+   std::lock_guard lock(state.lock);
+   SetServing(state, nullptr);
+   AbortCapture(state);
+   state.directText = directText;
+
+   auto &connection = *route.record->parent;
+   auto database = DatabaseOf(*route.record);
+   auto effect = GetEffect(*route.record, state);
+   // the connection reads its own uncommitted changes, they must neither be cached for the other connections nor hidden
+   // behind a result cached before them
+   if (effect == StatementEffect::Read && database != 0 && !connection.uncommittedWrites.load(std::memory_order_acquire))
+   {
+      auto key = CacheKey(route, database);
+      if (!key)
+      {
+         return execute();
+      }
+      if (auto cached = Lookup(*key); cached != nullptr)
+      {
+         ClearPostedDiagnostics(*route.record);
+         SetServing(state, std::move(cached));
+         return SQL_SUCCESS;
+      }
+
+      uint64_t generation = 0;
+      {
+         std::lock_guard cacheLock(GetCache().lock);
+         generation = Generation(GetCache(), database);
+      }
+      auto result = execute();
+      // warnings are not cached, a hit could not return them
+      if (result == SQL_SUCCESS)
+      {
+         StartCapture(route, state, std::move(*key), database, generation);
+      }
+      return result;
+   }
+
+   auto result = execute();
+   if (effect == StatementEffect::Write)
+   {
+      // also on error, part of a batch may have been applied
+      Invalidate(database);
+      if (!IsAutocommit(route, connection))
+      {
+         connection.uncommittedWrites.store(true, std::memory_order_release);
+      }
+   }
+   else if (effect == StatementEffect::SwitchDatabase && SQL_SUCCEEDED(result))
+   {
+      ForgetDatabase(connection);
+   }
+   return result;
+}
+
+SQLRETURN FetchCached(const Route &route, const std::function<SQLRETURN()> &fetch, ReexecuteFunction executeAgain)
+{
+   if (!route.record || route.driver == nullptr || !ResultCacheEnabled())
+   {
+      return fetch();
+   }
+   auto state = FindResultCache(*route.record);
+   if (state == nullptr)
+   {
+      return fetch();
+   }
+
+   std::lock_guard lock(state->lock);
+   if (state->serving)
+   {
+      auto bound = GetStatementColumns(*route.record);
+      if (state->position > 0 || BindingsMatch(*state->serving, bound))
+      {
+         ClearPostedDiagnostics(*route.record);
+         return ServeRow(*route.record, *state);
+      }
+      if (auto result = FallBack(route, *state, executeAgain); !SQL_SUCCEEDED(result))
+      {
+         return result;
+      }
+   }
+   if (!state->capture)
+   {
+      return fetch();
+   }
+
+   if (!CloseRow(*state))
+   {
+      AbortCapture(*state);
+      return fetch();
+   }
+   auto result = fetch();
+   if (result == SQL_NO_DATA)
+   {
+      FinishCapture(route, *state);
+   }
+   else if (result != SQL_SUCCESS)
+   {
+      AbortCapture(*state);
+   }
+   else
+   {
+      OpenRow(*state->capture);
+      if (!CaptureBoundColumns(*route.record, *state->capture) || state->capture->result->bytes > Budget() / 8)
+      {
+         AbortCapture(*state);
+      }
+   }
+   return result;
+}
+
+SQLRETURN GetDataCached(const Route &route, SQLUSMALLINT column, SQLSMALLINT targetType, SQLPOINTER value, SQLLEN bufferLength,
+                        SQLLEN *strLenOrInd, const std::function<SQLRETURN()> &getData)
+{
+   if (!route.record || !ResultCacheEnabled())
+   {
+      return getData();
+   }
+   auto state = FindResultCache(*route.record);
+   if (state == nullptr)
+   {
+      return getData();
+   }
+
+   std::lock_guard lock(state->lock);
+   if (state->serving)
+   {
+      auto &result = *state->serving;
+      ClearPostedDiagnostics(*route.record);
+      if (state->position == 0 || state->position > result.rows)
+      {
+         PostDiagnostic(*route.record, SQL_ERROR, L"24000", L"Invalid cursor state");
+         return SQL_ERROR;
+      }
+      if (column == 0 || column > result.columns.size())
+      {
+         PostDiagnostic(*route.record, SQL_ERROR, L"07009", L"Invalid descriptor index");
+         return SQL_ERROR;
+      }
+      auto &cached = result.columns[column - 1];
+      if (targetType != cached.valueType)
+      {
+         PostDiagnostic(*route.record, SQL_ERROR, L"07006", L"Column read with another type than when its result was cached");
+         return SQL_ERROR;
+      }
+      auto &offset = state->dataOffsets[column];
+      if (offset == kValueReturned)
+      {
+         return SQL_NO_DATA;
+      }
+      size_t copied = 0;
+      auto rc = CopyValue(*route.record, cached, state->position - 1, offset, value, bufferLength, strLenOrInd, &copied);
+      offset = rc == SQL_SUCCESS_WITH_INFO ? offset + copied : kValueReturned;
+      return rc;
+   }
+
+   auto result = getData();
+   if (!state->capture)
+   {
+      return result;
+   }
+   auto &capture = *state->capture;
+   if (result == SQL_NO_DATA)
+   {
+      return result;
+   }
+   if (!SQL_SUCCEEDED(result) || !capture.rowOpen || column == 0 || column > capture.row.size() || capture.row[column - 1] == CaptureState::Complete)
+   {
+      AbortCapture(*state);
+      return result;
+   }
+
+   auto &cached = capture.result->columns[column - 1];
+   auto length = ApplicationLength(targetType, value, strLenOrInd);
+   if (!SetValueType(cached, targetType) || length == -1 || (!IsVariableCType(targetType) && FixedCTypeSize(targetType) == 0))
+   {
+      AbortCapture(*state);
+      return result;
+   }
+   if (length == SQL_NULL_DATA)
+   {
+      cached.indicators.back() = SQL_NULL_DATA;
+      capture.row[column - 1] = CaptureState::Complete;
+      return result;
+   }
+
+   SQLLEN piece = FixedCTypeSize(targetType);
+   bool complete = true;
+   if (IsVariableCType(targetType))
+   {
+      auto available = value != nullptr ? std::max<SQLLEN>(0, bufferLength - TerminatorSize(targetType)) : 0;
+      if (targetType == SQL_C_WCHAR)
+      {
+         available -= available % static_cast<SQLLEN>(sizeof(SQLWCHAR));
+      }
+      complete = length != SQL_NO_TOTAL && length <= available;
+      piece = complete ? length : available;
+   }
+   auto bytes = static_cast<const std::byte *>(value);
+   cached.data.insert(cached.data.end(), bytes, bytes + piece);
+   capture.result->bytes += static_cast<size_t>(piece);
+   capture.row[column - 1] = complete ? CaptureState::Complete : CaptureState::Partial;
+   if (complete)
+   {
+      cached.indicators.back() = static_cast<SQLLEN>(cached.data.size() - cached.offsets.back());
+   }
+   if (capture.result->bytes > Budget() / 8)
+   {
+      AbortCapture(*state);
+   }
+   return result;
+}
+
+std::optional<SQLRETURN> NumResultColsCached(const Route &route, SQLSMALLINT *count)
+{
+   if (!route.record || !ResultCacheEnabled())
+   {
+      return std::nullopt;
+   }
+   auto state = FindResultCache(*route.record);
+   if (state == nullptr)
+   {
+      return std::nullopt;
+   }
+   std::lock_guard lock(state->lock);
+   if (!state->serving)
+   {
+      return std::nullopt;
+   }
+   ClearPostedDiagnostics(*route.record);
+   if (count != nullptr)
+   {
+      *count = static_cast<SQLSMALLINT>(state->serving->columns.size());
+   }
+   return SQL_SUCCESS;
+}
+
+std::optional<SQLRETURN> DescribeColCached(const Route &route, SQLUSMALLINT column, SQLWCHAR *name, SQLSMALLINT nameMaxLength, SQLSMALLINT *nameLength,
+                                           SQLSMALLINT *dataType, SQLULEN *columnSize, SQLSMALLINT *decimalDigits, SQLSMALLINT *nullable)
+{
+   if (!route.record || !ResultCacheEnabled())
+   {
+      return std::nullopt;
+   }
+   auto state = FindResultCache(*route.record);
+   if (state == nullptr)
+   {
+      return std::nullopt;
+   }
+   std::lock_guard lock(state->lock);
+   if (!state->serving)
+   {
+      return std::nullopt;
+   }
+   ClearPostedDiagnostics(*route.record);
+   if (column == 0 || column > state->serving->columns.size())
+   {
+      PostDiagnostic(*route.record, SQL_ERROR, L"07009", L"Invalid descriptor index");
+      return SQL_ERROR;
+   }
+   auto &cached = state->serving->columns[column - 1];
+   if (dataType != nullptr)
+   {
+      *dataType = cached.sqlType;
+   }
+   if (columnSize != nullptr)
+   {
+      *columnSize = cached.columnSize;
+   }
+   if (decimalDigits != nullptr)
+   {
+      *decimalDigits = cached.decimalDigits;
+   }
+   if (nullable != nullptr)
+   {
+      *nullable = cached.nullable;
+   }
+   return CopyName(*route.record, cached.name, name, nameMaxLength, nameLength);
+}
+
+std::optional<SQLRETURN> ColAttributeCached(const Route &route, SQLUSMALLINT column, SQLUSMALLINT field, SQLPOINTER charValue,
+                                            SQLSMALLINT charMaxLength, SQLSMALLINT *charLength, SQLLEN *numValue, ReexecuteFunction executeAgain)
+{
+   if (!route.record || route.driver == nullptr || !ResultCacheEnabled())
+   {
+      return std::nullopt;
+   }
+   auto state = FindResultCache(*route.record);
+   if (state == nullptr)
+   {
+      return std::nullopt;
+   }
+   std::lock_guard lock(state->lock);
+   if (!state->serving)
+   {
+      return std::nullopt;
+   }
+
+   auto &result = *state->serving;
+   ClearPostedDiagnostics(*route.record);
+   if (field == SQL_DESC_COUNT)
+   {
+      if (numValue != nullptr)
+      {
+         *numValue = static_cast<SQLLEN>(result.columns.size());
+      }
+      return SQL_SUCCESS;
+   }
+   if (field != SQL_DESC_NAME && field != SQL_DESC_LABEL && field != SQL_DESC_CONCISE_TYPE && field != SQL_DESC_NULLABLE)
+   {
+      // not kept, before the first row the driver produces the result instead. Later the driver has no result to describe
+      if (state->position == 0)
+      {
+         if (auto rc = FallBack(route, *state, executeAgain); !SQL_SUCCEEDED(rc))
+         {
+            return rc;
+         }
+      }
+      return std::nullopt;
+   }
+   if (column == 0 || column > result.columns.size())
+   {
+      PostDiagnostic(*route.record, SQL_ERROR, L"07009", L"Invalid descriptor index");
+      return SQL_ERROR;
+   }
+
+   auto &cached = result.columns[column - 1];
+   if (field == SQL_DESC_CONCISE_TYPE || field == SQL_DESC_NULLABLE)
+   {
+      if (numValue != nullptr)
+      {
+         *numValue = field == SQL_DESC_CONCISE_TYPE ? cached.sqlType : cached.nullable;
+      }
+      return SQL_SUCCESS;
+   }
+   // the lengths of character attributes are in bytes
+   SQLSMALLINT length = 0;
+   auto rc = CopyName(*route.record, cached.name, static_cast<SQLWCHAR *>(charValue), static_cast<SQLSMALLINT>(charMaxLength / sizeof(SQLWCHAR)), &length);
+   if (charLength != nullptr)
+   {
+      *charLength = static_cast<SQLSMALLINT>(length * sizeof(SQLWCHAR));
+   }
+   return rc;
+}
+
+std::optional<SQLRETURN> RowCountCached(const Route &route, SQLLEN *rowCount)
+{
+   if (!route.record || !ResultCacheEnabled())
+   {
+      return std::nullopt;
+   }
+   auto state = FindResultCache(*route.record);
+   if (state == nullptr)
+   {
+      return std::nullopt;
+   }
+   std::lock_guard lock(state->lock);
+   if (!state->serving)
+   {
+      return std::nullopt;
+   }
+   ClearPostedDiagnostics(*route.record);
+   if (rowCount != nullptr)
+   {
+      *rowCount = state->serving->rowCount;
+   }
+   return SQL_SUCCESS;
+}
+
+std::optional<SQLRETURN> CloseCached(const Route &route, SQLRETURN servedResult)
+{
+   if (!route.record || !ResultCacheEnabled())
+   {
+      return std::nullopt;
+   }
+   auto state = FindResultCache(*route.record);
+   if (state == nullptr)
+   {
+      return std::nullopt;
+   }
+   std::lock_guard lock(state->lock);
+   // a result closed before its end is not cached
+   AbortCapture(*state);
+   if (!state->serving)
+   {
+      return std::nullopt;
+   }
+   SetServing(*state, nullptr);
+   ClearPostedDiagnostics(*route.record);
+   return servedResult;
+}
+
+std::optional<SQLRETURN> ScrollCached(const Route &route, ReexecuteFunction executeAgain)
+{
+   if (!route.record || route.driver == nullptr || !ResultCacheEnabled())
+   {
+      return std::nullopt;
+   }
+   auto state = FindResultCache(*route.record);
+   if (state == nullptr)
+   {
+      return std::nullopt;
+   }
+   std::lock_guard lock(state->lock);
+   // the captured rows would not be the ones of the result
+   AbortCapture(*state);
+   if (!state->serving)
+   {
+      return std::nullopt;
+   }
+   if (state->position > 0)
+   {
+      // the driver cursor cannot be brought to the row served, the scroll is answered by the driver without result
+      SetServing(*state, nullptr);
+      return std::nullopt;
+   }
+   if (auto result = FallBack(route, *state, executeAgain); !SQL_SUCCEEDED(result))
+   {
+      return result;
+   }
+   // the fall back captures a result read sequentially
+   AbortCapture(*state);
+   return std::nullopt;
+}
+
+void RecordCachedDescriptorChange(const Route &descriptor)
+{
+   if (!descriptor.record || descriptor.driver == nullptr || !ResultCacheEnabled())
+   {
+      return;
+   }
+   // explicitly allocated descriptors belong to the connection, the statements using them as APD are never cached
+   auto &statement = descriptor.record->parent;
+   if (!statement || statement->type != SQL_HANDLE_STMT)
+   {
+      return;
+   }
+   auto getStmtAttr = descriptor.driver->Get<OdbcFunctionId::SQLGetStmtAttrW>();
+   SQLHDESC parameters = SQL_NULL_HANDLE;
+   if (getStmtAttr == nullptr || !SQL_SUCCEEDED(getStmtAttr(statement->handle, SQL_ATTR_APP_PARAM_DESC, &parameters, sizeof(parameters), nullptr)) ||
+       parameters == descriptor.handle)
+   {
+      ChangeParameterDescriptor(*statement);
+   }
+}
+
+void InvalidateCachedResults(const Route &route)
+{
+   if (route.record && ResultCacheEnabled())
+   {
+      Invalidate(DatabaseOf(*route.record));
+   }
+}
+
+void LogResultCacheStats()
+{
+   if (!ResultCacheEnabled())
+   {
+      return;
+   }
+   auto &cache = GetCache();
+   std::lock_guard lock(cache.lock);
+   auto lookups = cache.hits + cache.misses;
+   std::print(LOG, "Result cache: {} hits, {} misses ({:.1f}% hit rate), {} inserted, {} evicted, {} expired, {} invalidated, {} not cached, {} fallbacks, {} entries in {} bytes",
+              cache.hits, cache.misses, lookups > 0 ? 100.0 * static_cast<double>(cache.hits) / static_cast<double>(lookups) : 0.0, cache.inserts,
+              cache.evictions, cache.expirations, cache.invalidations, cache.rejected, cache.fallbacks, cache.entries.size(), cache.bytes);
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include "Platform.h"
+#include "Routing.h"
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// cache of read only query results, enabled with ODBCDETOUR_RESULT_CACHE=process or =connection
+//
+// a single SELECT executed again with the same bound parameter values on the same database is answered from the
+// cache without reaching the driver, its rows are served through SQLFetch, SQLBindCol and SQLGetData. Results are
+// captured column by column while the application fetches them the first time, in the C types it reads them with, and
+// cached once it reached the end. Entries expire after ODBCDETOUR_RESULT_CACHE_TTL_MS (5000 by default) and every other
+// statement executed on a database drops the entries of that database. The least recently used entries are evicted to
+// stay within ODBCDETOUR_RESULT_CACHE_MB (64 by default), a result larger than an eighth of it is never cached.
+//
+// with =connection a connection only sees the results it cached itself.
+bool ResultCacheEnabled();
+
+struct CachedResult;
+struct ResultCapture;
+
+// what executing a statement does to the cache
+enum class StatementEffect
+{
+   // no statement, or a read whose result may differ from one execution to the next
+   Unknown,
+   // single SELECT, its result may be cached
+   Read,
+   // any other statement, the database may change
+   Write,
+   // USE, the connection moves to another database
+   SwitchDatabase,
+};
+
+// result cache state of a statement, see HandleRecord::resultCache
+struct ResultCacheState
+{
+   ResultCacheState();
+   ~ResultCacheState();
+
+   // serializes the calls of the statement, taken before the block fetch lock
+   std::mutex lock;
+   // text of SQLExecDirectW, empty for a prepared statement. Executed when a served result must fall back to the driver
+   std::wstring directText;
+   // effect of the statement, classified once per fingerprint
+   uint64_t classifiedFingerprint = 0;
+   StatementEffect effect = StatementEffect::Unknown;
+
+   // result served instead of the driver one and the rows fetched from it
+   std::shared_ptr<const CachedResult> serving;
+   size_t position = 0;
+   // SQLGetData offset in the value of each column of the current row
+   std::map<SQLUSMALLINT, size_t> dataOffsets;
+
+   // result of the driver captured while the application fetches it
+   std::unique_ptr<ResultCapture> capture;
+};
+
+// connection bound to a driver, the identity of its database is made of the driver, data source, server, database
+// and user
+void RegisterDatabase(HandleRecord &connection, std::wstring_view driverPath, std::wstring_view dsn, std::wstring_view connectionString);
+
+// the connection changed its current catalog, its results are no longer cached
+void ForgetDatabase(HandleRecord &connection);
+
+// SQLEndTran on the connection, its results read uncommitted changes it made
+void EndCachedTransaction(HandleRecord &connection);
+
+// executes the statement of a served result on the driver, instrumented like SQLExecute and SQLExecDirectW. directText
+// is empty for a prepared statement
+using ReexecuteFunction = SQLRETURN (*)(const Route &route, std::wstring &directText);
+
+// SQLExecute and SQLExecDirectW, execute forwards the call to the driver. directText is empty for SQLExecute
+//
+// a connection that wrote in its open transaction neither serves nor captures results until SQLEndTran
+SQLRETURN ExecuteCached(const Route &route, std::wstring_view directText, const std::function<SQLRETURN()> &execute);
+
+// SQLFetch and SQLFetchScroll(SQL_FETCH_NEXT), fetch forwards the call to the driver
+SQLRETURN FetchCached(const Route &route, const std::function<SQLRETURN()> &fetch, ReexecuteFunction executeAgain);
+
+// SQLFetchScroll with another orientation, called before forwarding it: the served result ends, before its first row
+// the statement is executed again by the driver. Returns the error of that execution
+std::optional<SQLRETURN> ScrollCached(const Route &route, ReexecuteFunction executeAgain);
+
+// SQLGetData, getData forwards the call to the driver
+SQLRETURN GetDataCached(const Route &route, SQLUSMALLINT column, SQLSMALLINT targetType, SQLPOINTER value, SQLLEN bufferLength,
+                        SQLLEN *strLenOrInd, const std::function<SQLRETURN()> &getData);
+
+// metadata of a served result, nullopt when the call must be forwarded to the driver
+std::optional<SQLRETURN> NumResultColsCached(const Route &route, SQLSMALLINT *count);
+std::optional<SQLRETURN> DescribeColCached(const Route &route, SQLUSMALLINT column, SQLWCHAR *name, SQLSMALLINT nameMaxLength, SQLSMALLINT *nameLength,
+                                           SQLSMALLINT *dataType, SQLULEN *columnSize, SQLSMALLINT *decimalDigits, SQLSMALLINT *nullable);
+std::optional<SQLRETURN> ColAttributeCached(const Route &route, SQLUSMALLINT column, SQLUSMALLINT field, SQLPOINTER charValue,
+                                            SQLSMALLINT charMaxLength, SQLSMALLINT *charLength, SQLLEN *numValue, ReexecuteFunction executeAgain);
+std::optional<SQLRETURN> RowCountCached(const Route &route, SQLLEN *rowCount);
+
+// SQLCloseCursor, SQLFreeStmt(SQL_CLOSE), SQLMoreResults and SQLPrepareW end the served or captured result. Answers
+// the call when the result was served
+std::optional<SQLRETURN> CloseCached(const Route &route, SQLRETURN servedResult);
+
+// SQLSetDescFieldW, SQLSetDescRec and SQLCopyDesc, a change of the implicit APD of a statement keeps it out of the cache
+void RecordCachedDescriptorChange(const Route &descriptor);
+
+// SQLSetPos and SQLBulkOperations, the data of the database of the statement changed
+void InvalidateCachedResults(const Route &route);
+
+void LogResultCacheStats();
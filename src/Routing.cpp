@@ -0,0 +1,382 @@
+#include "Routing.h"
+#include "AdmissionControl.h"
+#include "Driver.h"
+#include "Logging.h"
+#include "OdbcFormatters.h"
+#include "PostedDiagnostics.h"
+#include "ResultCache.h"
+#include "StringConversion.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <optional>
+#include <print>
+
+namespace
+{
+// connection attributes whose value is a string, all others are integers passed by value
+bool IsStringAttribute(SQLINTEGER attribute)
+{
+   return attribute == SQL_ATTR_CURRENT_CATALOG || attribute == SQL_ATTR_TRACEFILE || attribute == SQL_ATTR_TRANSLATE_LIB;
+}
+
+// documented default of an attribute the detour keeps until the driver handle exists, nullopt when it depends on the
+// driver
+std::optional<SQLULEN> DefaultAttribute(SQLSMALLINT type, SQLINTEGER attribute)
+{
+   if (type == SQL_HANDLE_ENV)
+   {
+      switch (attribute)
+      {
+      case SQL_ATTR_ODBC_VERSION:
+         return SQL_OV_ODBC3;
+      case SQL_ATTR_CONNECTION_POOLING:
+         return SQL_CP_OFF;
+      case SQL_ATTR_CP_MATCH:
+         return SQL_CP_STRICT_MATCH;
+      case SQL_ATTR_OUTPUT_NTS:
+         return SQL_TRUE;
+      default:
+         return std::nullopt;
+      }
+   }
+   switch (attribute)
+   {
+   case SQL_ATTR_AUTOCOMMIT:
+      return SQL_AUTOCOMMIT_ON;
+   case SQL_ATTR_ACCESS_MODE:
+      return SQL_MODE_READ_WRITE;
+   case SQL_ATTR_ASYNC_ENABLE:
+      return SQL_ASYNC_ENABLE_OFF;
+   case SQL_ATTR_CONNECTION_TIMEOUT:
+      return 0;
+   case SQL_ATTR_METADATA_ID:
+      return SQL_FALSE;
+   case SQL_ATTR_ODBC_CURSORS:
+      return SQL_CUR_USE_DRIVER;
+   case SQL_ATTR_TRACE:
+      return SQL_OPT_TRACE_OFF;
+   default:
+      return std::nullopt;
+   }
+}
+
+void StorePendingAttribute(HandleRecord &record, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length)
+{
+   PendingAttribute pending{attribute, value, length, {}};
+   if (IsStringAttribute(attribute) && value != nullptr)
+   {
+      auto str = static_cast<const wchar_t *>(value);
+      // length is in bytes
+      auto count = length == SQL_NTS ? std::wcslen(str) : static_cast<size_t>(length) / sizeof(wchar_t);
+      pending.buffer.assign(str, str + count);
+      pending.buffer.push_back(L'\0');
+      pending.value = pending.buffer.data();
+   }
+
+   std::lock_guard lock(record.stateLock);
+   std::erase_if(record.pendingAttributes, [attribute](const auto &p)
+                 { return p.attribute == attribute; });
+   record.pendingAttributes.push_back(std::move(pending));
+}
+
+// the driver environment of an environment for a target driver, allocated on first use
+std::pair<const Driver *, SQLHENV> GetDriverEnvironment(HandleRecord &environment, const std::wstring &path)
+{
+   auto driver = AcquireDriver(path);
+   if (driver == nullptr)
+   {
+      return {nullptr, SQL_NULL_HANDLE};
+   }
+
+   std::lock_guard lock(environment.stateLock);
+   for (auto &driverEnvironment : environment.driverEnvironments)
+   {
+      if (driverEnvironment.first == driver)
+      {
+         // the environment already holds a reference on this driver
+         ReleaseDriver(driver);
+         return driverEnvironment;
+      }
+   }
+
+   auto allocHandle = driver->Get<OdbcFunctionId::SQLAllocHandle>();
+   SQLHENV henv = SQL_NULL_HANDLE;
+   if (allocHandle == nullptr || !SQL_SUCCEEDED(allocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &henv)))
+   {
+      std::print(LOG, "Failed to allocate an environment in {}", ToUtf8(path));
+      ReleaseDriver(driver);
+      return {nullptr, SQL_NULL_HANDLE};
+   }
+
+   if (auto setEnvAttr = driver->Get<OdbcFunctionId::SQLSetEnvAttr>(); setEnvAttr != nullptr)
+   {
+      for (auto &pending : environment.pendingAttributes)
+      {
+         setEnvAttr(henv, pending.attribute, pending.value, pending.length);
+      }
+   }
+   environment.driverEnvironments.emplace_back(driver, henv);
+   return {driver, henv};
+}
+} // namespace
+
+Route RouteHandle(SQLHANDLE handle)
+{
+   auto record = GetHandleRegistry().Find(handle);
+   if (!record)
+   {
+      return {nullptr, handle};
+   }
+   if (record->type == SQL_HANDLE_ENV)
+   {
+      std::lock_guard lock(record->stateLock);
+      if (record->driverEnvironments.empty())
+      {
+         return {nullptr, SQL_NULL_HANDLE, record};
+      }
+      return {record->driverEnvironments.front().first, record->driverEnvironments.front().second, record};
+   }
+   return {record->driver.load(std::memory_order_acquire), record->driverHandle.load(std::memory_order_acquire), record};
+}
+
+SQLRETURN BindConnection(SQLHDBC connection, std::wstring_view dsn, std::wstring_view connectionString)
+{
+   auto record = GetHandleRegistry().Find(connection);
+   if (!record || !record->parent)
+   {
+      return SQL_INVALID_HANDLE;
+   }
+
+   auto path = ResolveTargetDriver(dsn, connectionString);
+   auto [driver, henv] = GetDriverEnvironment(*record->parent, path);
+   if (driver == nullptr)
+   {
+      return SQL_ERROR;
+   }
+   if (ResultCacheEnabled())
+   {
+      RegisterDatabase(*record, path, dsn, connectionString);
+   }
+
+   if (auto bound = record->driver.load(std::memory_order_acquire); bound == driver)
+   {
+      return SQL_SUCCESS;
+   }
+   else if (bound != nullptr)
+   {
+      // reconnecting to a data source served by another driver
+      FreeDriverConnection(*record);
+   }
+
+   SQLHDBC hdbc = SQL_NULL_HANDLE;
+   auto allocHandle = driver->Get<OdbcFunctionId::SQLAllocHandle>();
+   auto result = allocHandle != nullptr ? allocHandle(SQL_HANDLE_DBC, henv, &hdbc) : SQLRETURN{SQL_ERROR};
+   if (!SQL_SUCCEEDED(result))
+   {
+      return result;
+   }
+
+   {
+      std::lock_guard lock(record->stateLock);
+      if (!record->admission)
+      {
+         record->admission = CreateConnectionAdmission();
+      }
+      if (auto setConnectAttr = driver->Get<OdbcFunctionId::SQLSetConnectAttrW>(); setConnectAttr != nullptr)
+      {
+         for (auto &pending : record->pendingAttributes)
+         {
+            if (auto rc = setConnectAttr(hdbc, pending.attribute, pending.value, pending.length); !SQL_SUCCEEDED(rc))
+            {
+               std::print(LOG, "Failed to replay connection attribute {} -> {}", ConnectAttribute{pending.attribute}, ReturnCode{rc});
+            }
+         }
+      }
+   }
+
+   record->driverHandle.store(hdbc, std::memory_order_release);
+   record->driver.store(driver, std::memory_order_release);
+   std::print(LOG, "Connection {} routed to {}", record->handle, ToUtf8(driver->Path()));
+   return result;
+}
+
+SQLRETURN SetPendingAttribute(SQLHANDLE handle, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length)
+{
+   auto record = GetHandleRegistry().Find(handle);
+   if (!record)
+   {
+      return SQL_INVALID_HANDLE;
+   }
+   StorePendingAttribute(*record, attribute, value, length);
+   return SQL_SUCCESS;
+}
+
+SQLRETURN GetPendingAttribute(SQLHANDLE handle, SQLINTEGER attribute, SQLPOINTER outValue, SQLINTEGER outValueMaxLength, SQLINTEGER *outValueLength)
+{
+   auto record = GetHandleRegistry().Find(handle);
+   if (!record)
+   {
+      return SQL_INVALID_HANDLE;
+   }
+   ClearPostedDiagnostics(*record);
+
+   std::optional<SQLULEN> number;
+   std::optional<std::wstring> text;
+   {
+      std::lock_guard lock(record->stateLock);
+      auto it = std::ranges::find(record->pendingAttributes, attribute, &PendingAttribute::attribute);
+      if (it == record->pendingAttributes.end())
+      {
+         number = DefaultAttribute(record->type, attribute);
+      }
+      else if (IsStringAttribute(attribute))
+      {
+         text = it->buffer.empty() ? std::wstring() : std::wstring(it->buffer.data());
+      }
+      else
+      {
+         number = reinterpret_cast<SQLULEN>(it->value);
+      }
+   }
+
+   if (number)
+   {
+      if (outValue != nullptr)
+      {
+         *static_cast<SQLULEN *>(outValue) = *number;
+      }
+      if (outValueLength != nullptr)
+      {
+         *outValueLength = sizeof(SQLULEN);
+      }
+      return SQL_SUCCESS;
+   }
+   if (!text)
+   {
+      return SQL_NO_DATA;
+   }
+
+   // lengths in bytes, without the null terminator
+   if (outValueLength != nullptr)
+   {
+      *outValueLength = static_cast<SQLINTEGER>(text->size() * sizeof(wchar_t));
+   }
+   auto capacity = outValue != nullptr && outValueMaxLength > 0 ? static_cast<size_t>(outValueMaxLength) / sizeof(wchar_t) : 0;
+   if (capacity == 0)
+   {
+      return SQL_SUCCESS;
+   }
+   auto count = std::min(text->size(), capacity - 1);
+   std::memcpy(outValue, text->data(), count * sizeof(wchar_t));
+   static_cast<wchar_t *>(outValue)[count] = L'\0';
+   if (count < text->size())
+   {
+      PostDiagnostic(*record, SQL_SUCCESS_WITH_INFO, L"01004", L"String data, right truncated");
+      return SQL_SUCCESS_WITH_INFO;
+   }
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SetEnvironmentAttribute(SQLHENV environment, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length)
+{
+   auto record = GetHandleRegistry().Find(environment);
+   if (!record)
+   {
+      return SQL_INVALID_HANDLE;
+   }
+   StorePendingAttribute(*record, attribute, value, length);
+
+   SQLRETURN result = SQL_SUCCESS;
+   std::lock_guard lock(record->stateLock);
+   for (auto [driver, henv] : record->driverEnvironments)
+   {
+      if (auto setEnvAttr = driver->Get<OdbcFunctionId::SQLSetEnvAttr>(); setEnvAttr != nullptr)
+      {
+         if (auto rc = setEnvAttr(henv, attribute, value, length); rc != SQL_SUCCESS)
+         {
+            result = rc;
+         }
+      }
+   }
+   return result;
+}
+
+SQLRETURN EndEnvironmentTransactions(SQLHENV environment, SQLSMALLINT completionType, SQLRETURN (*endConnection)(SQLHDBC, SQLSMALLINT))
+{
+   auto record = GetHandleRegistry().Find(environment);
+   if (!record)
+   {
+      return SQL_INVALID_HANDLE;
+   }
+
+   std::vector<SQLHANDLE> connections;
+   {
+      std::lock_guard lock(record->childrenLock);
+      connections = record->children;
+   }
+
+   SQLRETURN result = SQL_SUCCESS;
+   for (auto connection : connections)
+   {
+      // connections not connected yet have no transaction
+      if (RouteHandle(connection).driver == nullptr)
+      {
+         continue;
+      }
+      if (auto rc = endConnection(connection, completionType); rc != SQL_SUCCESS)
+      {
+         result = rc;
+      }
+   }
+   return result;
+}
+
+void RegisterDescriptor(SQLHSTMT statement, SQLHDESC descriptor)
+{
+   if (descriptor != SQL_NULL_HANDLE && !GetHandleRegistry().Find(descriptor))
+   {
+      GetHandleRegistry().Register(SQL_HANDLE_DESC, descriptor, statement);
+   }
+}
+
+SQLRETURN FreeDriverEnvironments(HandleRecord &environment)
+{
+   SQLRETURN result = SQL_SUCCESS;
+   std::lock_guard lock(environment.stateLock);
+   std::erase_if(environment.driverEnvironments, [&result](const std::pair<const Driver *, SQLHENV> &driverEnvironment)
+                 {
+                    auto [driver, henv] = driverEnvironment;
+                    auto freeHandle = driver->Get<OdbcFunctionId::SQLFreeHandle>();
+                    auto rc = freeHandle != nullptr ? freeHandle(SQL_HANDLE_ENV, henv) : SQLRETURN{SQL_ERROR};
+                    if (!SQL_SUCCEEDED(rc))
+                    {
+                       // keep the driver loaded, the environment is still in use
+                       result = rc;
+                       return false;
+                    }
+                    ReleaseDriver(driver);
+                    return true; });
+   return result;
+}
+
+SQLRETURN FreeDriverConnection(HandleRecord &connection)
+{
+   auto driver = connection.driver.load(std::memory_order_acquire);
+   auto hdbc = connection.driverHandle.load(std::memory_order_acquire);
+   if (driver == nullptr)
+   {
+      return SQL_SUCCESS;
+   }
+
+   auto freeHandle = driver->Get<OdbcFunctionId::SQLFreeHandle>();
+   auto result = freeHandle != nullptr ? freeHandle(SQL_HANDLE_DBC, hdbc) : SQLRETURN{SQL_ERROR};
+   if (SQL_SUCCEEDED(result))
+   {
+      // on failure, ex: still connected, the connection keeps routing to the driver
+      connection.driverHandle.store(SQL_NULL_HANDLE, std::memory_order_release);
+      connection.driver.store(nullptr, std::memory_order_release);
+   }
+   return result;
+}
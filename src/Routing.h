@@ -0,0 +1,46 @@
+#pragma once
+#include "HandleRegistry.h"
+#include "Platform.h"
+
+#include <string_view>
+
+class Driver;
+
+// where a call made on an application handle is forwarded
+struct Route
+{
+   const Driver *driver = nullptr;
+   SQLHANDLE handle = SQL_NULL_HANDLE;
+   // record of the application handle, null for unknown handles and installer calls
+   HandleRecordPtr record;
+};
+
+// driver and driver handle of an application handle. Connections not yet connected and unknown handles have no driver,
+// environments are routed to their first driver environment.
+//
+// every call takes the shared lock of the registry shard of the handle and a reference on its record, environments also
+// their state lock: the forwarding path is no longer a single acquire load
+Route RouteHandle(SQLHANDLE handle);
+
+// bind a connection to the driver serving a data source, the driver environment is allocated on first use and the
+// attributes set before connecting are replayed on the driver connection
+SQLRETURN BindConnection(SQLHDBC connection, std::wstring_view dsn, std::wstring_view connectionString);
+
+// attribute of a connection not yet bound, kept until the driver connection is allocated. Reading one never set gives
+// its documented default, SQL_NO_DATA when it depends on the driver
+SQLRETURN SetPendingAttribute(SQLHANDLE handle, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length);
+SQLRETURN GetPendingAttribute(SQLHANDLE handle, SQLINTEGER attribute, SQLPOINTER outValue, SQLINTEGER outValueMaxLength, SQLINTEGER *outValueLength);
+
+// set on every driver environment of an environment, and on the ones allocated later
+SQLRETURN SetEnvironmentAttribute(SQLHENV environment, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length);
+
+// commit or rollback every connection of an environment, endConnection ends the transaction of one connection like
+// SQLEndTran(SQL_HANDLE_DBC)
+SQLRETURN EndEnvironmentTransactions(SQLHENV environment, SQLSMALLINT completionType, SQLRETURN (*endConnection)(SQLHDBC, SQLSMALLINT));
+
+// register a descriptor returned by SQLGetStmtAttrW, implicit descriptors are allocated by the driver with the statement
+void RegisterDescriptor(SQLHSTMT statement, SQLHDESC descriptor);
+
+// free the driver handles behind an environment or a connection owned by the detour
+SQLRETURN FreeDriverEnvironments(HandleRecord &environment);
+SQLRETURN FreeDriverConnection(HandleRecord &connection);
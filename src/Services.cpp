@@ -0,0 +1,55 @@
+#include "Services.h"
+#include "BlockFetch.h"
+#include "ContentionAnalyzer.h"
+#include "DiagnosticStats.h"
+#include "HandleTracker.h"
+#include "Metrics.h"
+#include "QueryWatchdog.h"
+#include "ResultCache.h"
+#include "Settings.h"
+#include "SpanExport.h"
+#include "SqlRewrite.h"
+#include "TransactionProfiler.h"
+
+#include <mutex>
+
+namespace
+{
+std::mutex servicesLock;
+// live environments, protected by servicesLock
+int environmentCount = 0;
+} // namespace
+
+void AcquireServices()
+{
+   std::lock_guard lock(servicesLock);
+   if (environmentCount++ == 0)
+   {
+      StartSettingsWatcher();
+      StartMetricsPublisher();
+      StartQueryWatchdog();
+      StartHandleTracker();
+      StartSpanExporter();
+   }
+}
+
+void ReleaseServices()
+{
+   std::lock_guard lock(servicesLock);
+   if (environmentCount > 0 && --environmentCount == 0)
+   {
+      StopMetricsPublisher();
+      StopQueryWatchdog();
+      StopHandleTracker();
+      StopSpanExporter();
+      StopSettingsWatcher();
+      LogDiagnosticStats();
+      LogContentionReport();
+      LogTransactionReport();
+      LogFetchProfile();
+      LogRewriteStats();
+      LogResultCacheStats();
+      LogHandleReport();
+      LogSpanReport();
+   }
+}
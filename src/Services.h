@@ -0,0 +1,8 @@
+#pragma once
+
+// background services of the detour, ex: the metrics publisher, the query watchdog
+//
+// they run while the application holds at least one environment: the first environment allocated starts them and
+// freeing the last one stops them. Threads are never started or joined from DllMain.
+void AcquireServices();
+void ReleaseServices();
@@ -0,0 +1,537 @@
+#include "Settings.h"
+#include "Logging.h"
+#include "Platform.h"
+#include "StringConversion.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cwchar>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <stop_token>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace
+{
+constexpr std::string_view kPrefix = "ODBCDETOUR_";
+// data source of ODBC.INI holding settings as attributes
+constexpr auto kDataSource = L"ODBCDetour";
+
+using SettingValues = std::map<std::string, std::string, std::less<>>;
+
+std::string_view Trim(std::string_view str)
+{
+   while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front())))
+   {
+      str.remove_prefix(1);
+   }
+   while (!str.empty() && std::isspace(static_cast<unsigned char>(str.back())))
+   {
+      str.remove_suffix(1);
+   }
+   return str;
+}
+
+// names are case insensitive and may keep the prefix of the environment variables
+std::string SettingName(std::string_view name)
+{
+   std::string result(Trim(name));
+   std::ranges::transform(result, result.begin(), [](unsigned char c)
+                          { return static_cast<char>(std::toupper(c)); });
+   if (result.starts_with(kPrefix))
+   {
+      result.erase(0, kPrefix.size());
+   }
+   return result;
+}
+
+// environment variable names are case insensitive
+bool HasPrefix(std::string_view name)
+{
+   return name.size() > kPrefix.size() && std::ranges::equal(name.substr(0, kPrefix.size()), kPrefix, [](char left, char right)
+                                                             { return std::toupper(static_cast<unsigned char>(left)) == right; });
+}
+
+// values of one source by name, an empty value removes the value of an earlier source
+void SetValue(SettingValues &values, std::string_view name, std::string_view value)
+{
+   auto key = SettingName(name);
+   if (!key.empty())
+   {
+      values.insert_or_assign(std::move(key), std::string(Trim(value)));
+   }
+}
+
+// every source as last read, a later one overrides the earlier ones
+struct SettingSources
+{
+   SettingValues environment;
+   SettingValues dataSource;
+   SettingValues file;
+   // settings file read and its last write time, min when it does not exist
+   std::filesystem::path filePath;
+   std::filesystem::file_time_type fileTime = std::filesystem::file_time_type::min();
+};
+
+void Merge(SettingValues &values, const SettingValues &source)
+{
+   for (auto &[name, value] : source)
+   {
+      if (value.empty())
+      {
+         values.erase(name);
+      }
+      else
+      {
+         values.insert_or_assign(name, value);
+      }
+   }
+}
+
+SettingValues ReadEnvironment()
+{
+   SettingValues values;
+   auto block = GetEnvironmentStringsW();
+   if (block == nullptr)
+   {
+      return values;
+   }
+   // NAME=value strings, the block ends with an empty one
+   for (auto entry = block; *entry != L'\0'; entry += std::wcslen(entry) + 1)
+   {
+      auto variable = ToUtf8(entry);
+      std::string_view text(variable);
+      if (auto separator = text.find('='); separator != std::string_view::npos && HasPrefix(text.substr(0, separator)))
+      {
+         SetValue(values, text.substr(0, separator), text.substr(separator + 1));
+      }
+   }
+   FreeEnvironmentStringsW(block);
+   return values;
+}
+
+SettingValues ReadDataSource()
+{
+   SettingValues values;
+   // with a null key the names of the attributes are returned, each null terminated
+   wchar_t names[4096]{};
+   auto length = SQLGetPrivateProfileStringW(kDataSource, nullptr, L"", names, static_cast<int>(std::size(names)), L"ODBC.INI");
+   for (auto name = names; name < names + std::max(length, 0) && *name != L'\0'; name += std::wcslen(name) + 1)
+   {
+      wchar_t value[1024]{};
+      auto valueLength = SQLGetPrivateProfileStringW(kDataSource, name, L"", value, static_cast<int>(std::size(value)), L"ODBC.INI");
+      SetValue(values, ToUtf8(name), ToUtf8(std::wstring_view(value, std::max(valueLength, 0))));
+   }
+   return values;
+}
+
+std::filesystem::path SettingsFilePath(const SettingSources &sources)
+{
+   SettingValues values;
+   Merge(values, sources.environment);
+   Merge(values, sources.dataSource);
+   if (auto it = values.find("CONFIG"); it != values.end())
+   {
+      return std::filesystem::path(FromUtf8(it->second));
+   }
+   wchar_t path[MAX_PATH];
+   auto length = GetModuleFileNameW(gDllInstance, path, MAX_PATH);
+   if (length == 0)
+   {
+      return {};
+   }
+   return std::filesystem::path(std::wstring_view(path, length)).replace_filename(L"OdbcDetour.ini");
+}
+
+// NAME=value lines, blank lines, # or ; comments and [section] headers are skipped. The file is parsed again only
+// when its path or its last write time changed
+void ReadFile(SettingSources &sources)
+{
+   auto path = SettingsFilePath(sources);
+   std::error_code error;
+   auto time = std::filesystem::last_write_time(path, error);
+   if (error)
+   {
+      time = std::filesystem::file_time_type::min();
+   }
+   if (path == sources.filePath && time == sources.fileTime)
+   {
+      return;
+   }
+   sources.filePath = std::move(path);
+   sources.fileTime = time;
+   sources.file.clear();
+
+   std::ifstream file(sources.filePath);
+   std::string line;
+   while (std::getline(file, line))
+   {
+      auto text = Trim(line);
+      if (text.empty() || text.front() == '#' || text.front() == ';' || text.front() == '[')
+      {
+         continue;
+      }
+      if (auto separator = text.find('='); separator != std::string_view::npos)
+      {
+         SetValue(sources.file, text.substr(0, separator), text.substr(separator + 1));
+      }
+   }
+}
+
+// the environment and the data source are small, they are read again on every change
+SettingValues LoadValues(SettingSources &sources)
+{
+   sources.environment = ReadEnvironment();
+   sources.dataSource = ReadDataSource();
+   ReadFile(sources);
+   SettingValues values;
+   Merge(values, sources.environment);
+   Merge(values, sources.dataSource);
+   Merge(values, sources.file);
+   return values;
+}
+
+std::optional<long long> ParseInt(std::optional<std::string_view> value)
+{
+   long long result{};
+   if (!value || std::from_chars(value->data(), value->data() + value->size(), result).ec != std::errc{})
+   {
+      return std::nullopt;
+   }
+   return result;
+}
+
+bool ParseBool(std::string_view value)
+{
+   return value == "1" || value == "true" || value == "on" || value == "yes";
+}
+
+// names separated by commas or spaces, * for every function, a leading - removes a function
+std::array<bool, kOdbcFunctionCount> ParseTracedFunctions(std::string_view list)
+{
+   std::array<bool, kOdbcFunctionCount> traced{};
+   while (!list.empty())
+   {
+      auto end = list.find_first_of(", ");
+      auto name = list.substr(0, end);
+      list.remove_prefix(end == std::string_view::npos ? list.size() : end + 1);
+      bool enable = !name.starts_with('-');
+      if (!enable)
+      {
+         name.remove_prefix(1);
+      }
+      if (name == "*")
+      {
+         traced.fill(enable);
+      }
+      else if (auto index = FindOdbcFunction(name); index)
+      {
+         traced[*index] = enable;
+      }
+   }
+   return traced;
+}
+
+std::unique_ptr<SettingsSnapshot> MakeSnapshot(SettingValues values, uint64_t generation)
+{
+   auto snapshot = std::make_unique<SettingsSnapshot>();
+   snapshot->values = std::move(values);
+   snapshot->generation = generation;
+   snapshot->tracedFunctions = ParseTracedFunctions(snapshot->Find("TRACE_FUNCTIONS").value_or("*"));
+   snapshot->slowCallThreshold = std::chrono::milliseconds(ParseInt(snapshot->Find("SLOW_CALL_MS")).value_or(0));
+   snapshot->diagnostics = ParseBool(snapshot->Find("DIAGNOSTICS").value_or(""));
+   snapshot->contention = ParseBool(snapshot->Find("CONTENTION").value_or(""));
+   snapshot->transactions = ParseBool(snapshot->Find("TRANSACTIONS").value_or(""));
+   snapshot->longTransaction = std::chrono::milliseconds(ParseInt(snapshot->Find("LONG_TRANSACTION_MS")).value_or(10000));
+   snapshot->queryTimeout = ParseInt(snapshot->Find("QUERY_TIMEOUT_S")).value_or(0);
+   return snapshot;
+}
+
+// published snapshot, set on the first read and replaced by the watcher
+std::atomic<const SettingsSnapshot *> current{nullptr};
+
+// a change is read once its writes settled, ex: an editor saving the file in several steps
+constexpr auto kSettleTime = std::chrono::milliseconds(100);
+
+void LogChanges(const SettingsSnapshot &previous, const SettingsSnapshot &next)
+{
+   std::print(LOG, "Settings reloaded, generation {}", next.generation);
+   for (auto &[name, value] : previous.values)
+   {
+      if (!next.values.contains(name))
+      {
+         std::print(LOG, "   {} removed", name);
+      }
+   }
+   for (auto &[name, value] : next.values)
+   {
+      if (auto old = previous.Find(name); !old || *old != value)
+      {
+         std::print(LOG, "   {} = {}", name, value);
+      }
+   }
+}
+
+// change notifications of the data source keys of the user and of the machine, and of the directory of the settings
+// file. A source whose notification cannot be set up is polled
+class ChangeNotifications
+{
+ public:
+   ChangeNotifications()
+   {
+      for (size_t i = 0; i < kRoots.size(); ++i)
+      {
+         if (RegOpenKeyExW(kRoots[i], LR"(Software\ODBC\ODBC.INI)", 0, KEY_NOTIFY, &m_keys[i]) != ERROR_SUCCESS)
+         {
+            m_keys[i] = nullptr;
+            continue;
+         }
+         m_keyEvents[i] = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+         ArmKey(i);
+      }
+   }
+
+   ~ChangeNotifications()
+   {
+      for (size_t i = 0; i < kRoots.size(); ++i)
+      {
+         if (m_keys[i] != nullptr)
+         {
+            RegCloseKey(m_keys[i]);
+         }
+         if (m_keyEvents[i] != nullptr)
+         {
+            CloseHandle(m_keyEvents[i]);
+         }
+      }
+      if (m_directory != INVALID_HANDLE_VALUE)
+      {
+         FindCloseChangeNotification(m_directory);
+      }
+   }
+
+   ChangeNotifications(const ChangeNotifications &) = delete;
+   ChangeNotifications &operator=(const ChangeNotifications &) = delete;
+
+   // the settings file may move to another directory when CONFIG changes
+   void WatchDirectory(const std::filesystem::path &directory)
+   {
+      if (directory == m_directoryPath && m_directory != INVALID_HANDLE_VALUE)
+      {
+         return;
+      }
+      if (m_directory != INVALID_HANDLE_VALUE)
+      {
+         FindCloseChangeNotification(m_directory);
+      }
+      m_directoryPath = directory;
+      m_directory = FindFirstChangeNotificationW(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE);
+   }
+
+   // waits for a change, or the interval when a source is polled, and for the writes of the change to settle. False
+   // once stop is signaled
+   bool Wait(HANDLE stop, std::chrono::milliseconds interval)
+   {
+      std::array<HANDLE, 4> handles{stop};
+      DWORD count = 1;
+      bool polled = m_directory == INVALID_HANDLE_VALUE;
+      for (size_t i = 0; i < kRoots.size(); ++i)
+      {
+         if (m_armed[i])
+         {
+            handles[count++] = m_keyEvents[i];
+         }
+         else
+         {
+            polled = true;
+         }
+      }
+      if (m_directory != INVALID_HANDLE_VALUE)
+      {
+         handles[count++] = m_directory;
+      }
+      auto timeout = polled ? static_cast<DWORD>(interval.count()) : INFINITE;
+      if (WaitForMultipleObjects(count, handles.data(), FALSE, timeout) == WAIT_OBJECT_0 ||
+          WaitForSingleObject(stop, static_cast<DWORD>(kSettleTime.count())) == WAIT_OBJECT_0)
+      {
+         return false;
+      }
+
+      // armed again once settled, the changes made until now are read by the reload that follows
+      for (size_t i = 0; i < kRoots.size(); ++i)
+      {
+         if (m_keys[i] != nullptr && (!m_armed[i] || WaitForSingleObject(m_keyEvents[i], 0) == WAIT_OBJECT_0))
+         {
+            ArmKey(i);
+         }
+      }
+      if (m_directory != INVALID_HANDLE_VALUE && WaitForSingleObject(m_directory, 0) == WAIT_OBJECT_0 && !FindNextChangeNotification(m_directory))
+      {
+         FindCloseChangeNotification(m_directory);
+         m_directory = INVALID_HANDLE_VALUE;
+      }
+      return true;
+   }
+
+ private:
+   static constexpr std::array<HKEY, 2> kRoots = {HKEY_CURRENT_USER, HKEY_LOCAL_MACHINE};
+
+   void ArmKey(size_t index)
+   {
+      ResetEvent(m_keyEvents[index]);
+      m_armed[index] = m_keyEvents[index] != nullptr &&
+                       RegNotifyChangeKeyValue(m_keys[index], TRUE, REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_THREAD_AGNOSTIC,
+                                               m_keyEvents[index], TRUE) == ERROR_SUCCESS;
+   }
+
+   std::array<HKEY, 2> m_keys{};
+   std::array<HANDLE, 2> m_keyEvents{};
+   std::array<bool, 2> m_armed{};
+   HANDLE m_directory = INVALID_HANDLE_VALUE;
+   std::filesystem::path m_directoryPath;
+};
+
+class SettingsWatcher
+{
+ public:
+   explicit SettingsWatcher(std::chrono::milliseconds interval)
+       : m_interval(interval), m_stop(CreateEventW(nullptr, TRUE, FALSE, nullptr))
+   {
+      m_thread = std::jthread([this](std::stop_token stop)
+                              { Run(stop); });
+   }
+
+   ~SettingsWatcher()
+   {
+      m_thread.request_stop();
+      m_thread.join();
+      CloseHandle(m_stop);
+   }
+
+ private:
+   void Run(std::stop_token stop)
+   {
+      std::stop_callback wakeUp(stop, [this]
+                                { SetEvent(m_stop); });
+      ChangeNotifications notifications;
+      SettingSources sources;
+      // changes made since the first snapshot was read
+      Reload(sources);
+      notifications.WatchDirectory(sources.filePath.parent_path());
+      while (notifications.Wait(m_stop, m_interval))
+      {
+         Reload(sources);
+         notifications.WatchDirectory(sources.filePath.parent_path());
+      }
+   }
+
+   void Reload(SettingSources &sources)
+   {
+      auto &previous = CurrentSettings();
+      auto values = LoadValues(sources);
+      if (values == previous.values)
+      {
+         return;
+      }
+      auto next = MakeSnapshot(std::move(values), previous.generation + 1);
+      LogChanges(previous, *next);
+      // the watcher is the only writer once the first snapshot is published. The replaced snapshot is leaked, a reader
+      // may still use it and a reload only costs a few KB
+      current.store(next.release(), std::memory_order_release);
+   }
+
+   std::chrono::milliseconds m_interval;
+   HANDLE m_stop;
+   std::jthread m_thread;
+};
+
+std::mutex watcherLock;
+// intentionally leaked if the application exits without freeing its environments, see the metrics publisher
+SettingsWatcher *watcher = nullptr;
+} // namespace
+
+std::optional<std::string_view> SettingsSnapshot::Find(std::string_view name) const
+{
+   if (auto it = values.find(name); it != values.end())
+   {
+      return it->second;
+   }
+   return std::nullopt;
+}
+
+const SettingsSnapshot &CurrentSettings()
+{
+   if (auto snapshot = current.load(std::memory_order_acquire); snapshot != nullptr)
+   {
+      return *snapshot;
+   }
+   // first read, threads racing to it keep the snapshot published first. Nothing is logged here: the log reads its
+   // settings through this function
+   SettingSources sources;
+   auto first = MakeSnapshot(LoadValues(sources), 0);
+   const SettingsSnapshot *expected = nullptr;
+   if (current.compare_exchange_strong(expected, first.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+   {
+      return *first.release();
+   }
+   return *expected;
+}
+
+std::optional<std::string> GetSetting(std::string_view name)
+{
+   if (auto value = CurrentSettings().Find(name); value)
+   {
+      return std::string(*value);
+   }
+   return std::nullopt;
+}
+
+long long GetSettingInt(std::string_view name, long long defaultValue)
+{
+   return ParseInt(CurrentSettings().Find(name)).value_or(defaultValue);
+}
+
+double GetSettingDouble(std::string_view name, double defaultValue)
+{
+   auto value = CurrentSettings().Find(name);
+   double result{};
+   if (!value || std::from_chars(value->data(), value->data() + value->size(), result).ec != std::errc{})
+   {
+      return defaultValue;
+   }
+   return result;
+}
+
+bool GetSettingBool(std::string_view name, bool defaultValue)
+{
+   auto value = CurrentSettings().Find(name);
+   if (!value)
+   {
+      return defaultValue;
+   }
+   return ParseBool(*value);
+}
+
+void StartSettingsWatcher()
+{
+   std::lock_guard lock(watcherLock);
+   if (watcher == nullptr)
+   {
+      watcher = new SettingsWatcher(std::chrono::milliseconds(std::max<long long>(100, GetSettingInt("CONFIG_POLL_MS", 1000))));
+   }
+}
+
+void StopSettingsWatcher()
+{
+   std::lock_guard lock(watcherLock);
+   delete watcher;
+   watcher = nullptr;
+}
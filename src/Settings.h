@@ -0,0 +1,113 @@
+#pragma once
+#include "OdbcFunctions.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// runtime settings, by name without the ODBCDETOUR_ prefix, ex: SLOW_CALL_MS. Read from, the later winning:
+// - the ODBCDETOUR_<NAME> environment variables
+// - the attributes of the ODBCDetour data source in ODBC.INI
+// - the settings file, ODBCDETOUR_CONFIG or OdbcDetour.ini next to the detour dll, one NAME=value per line
+//
+// a background thread waits for changes of the data sources in the registry and of the directory of the file, the
+// sources are read again then, the file only when its last write time changed. A source that cannot be watched is read
+// every ODBCDETOUR_CONFIG_POLL_MS (1000 by default). A change publishes a new snapshot. The settings below and the
+// rules of ParsedSetting are taken from the current snapshot on every call and can be changed in a running process.
+// Features keeping state per handle, files or threads read their settings once when they start
+struct SettingsSnapshot
+{
+   // values by upper case name, empty values are removed
+   std::map<std::string, std::string, std::less<>> values;
+   // 0 for the first snapshot, incremented by every reload
+   uint64_t generation = 0;
+
+   // TRACE_FUNCTIONS: functions logged on entry and exit, ex: "*,-SQLFetch" or "SQLExecDirectW SQLPrepareW", all by default
+   std::array<bool, kOdbcFunctionCount> tracedFunctions{};
+   // SLOW_CALL_MS: see SlowCalls.h
+   std::chrono::nanoseconds slowCallThreshold{};
+   // DIAGNOSTICS: see DiagnosticStats.h
+   bool diagnostics = false;
+   // CONTENTION: see ContentionAnalyzer.h
+   bool contention = false;
+   // TRANSACTIONS and LONG_TRANSACTION_MS: see TransactionProfiler.h
+   bool transactions = false;
+   std::chrono::milliseconds longTransaction{};
+   // QUERY_TIMEOUT_S: see QueryWatchdog.h
+   long long queryTimeout = 0;
+
+   std::optional<std::string_view> Find(std::string_view name) const;
+};
+
+// current snapshot, a single atomic load. Snapshots are immutable and never freed, a replaced one stays valid
+const SettingsSnapshot &CurrentSettings();
+
+std::optional<std::string> GetSetting(std::string_view name);
+long long GetSettingInt(std::string_view name, long long defaultValue);
+double GetSettingDouble(std::string_view name, double defaultValue);
+bool GetSettingBool(std::string_view name, bool defaultValue);
+
+void StartSettingsWatcher();
+void StopSettingsWatcher();
+
+// value parsed from one setting, ex: the rules of a feature. Parsed on first use and again once the setting changed,
+// other reloads only cost a comparison of its text. Like the snapshots a replaced value is never freed
+template <typename T>
+class ParsedSetting
+{
+ public:
+   ParsedSetting(std::string_view name, T (*parse)(std::optional<std::string_view> text))
+       : m_name(name), m_parse(parse)
+   {
+   }
+
+   ParsedSetting(const ParsedSetting &) = delete;
+   ParsedSetting &operator=(const ParsedSetting &) = delete;
+
+   const T &Get()
+   {
+      auto &settings = CurrentSettings();
+      auto entry = m_entry.load(std::memory_order_acquire);
+      if (entry != nullptr && entry->generation == settings.generation)
+      {
+         return *entry->value;
+      }
+
+      auto text = settings.Find(m_name);
+      auto unchanged = entry != nullptr && entry->text.has_value() == text.has_value() && (!text || *entry->text == *text);
+      auto next = new Entry{settings.generation, text ? std::optional<std::string>(*text) : std::nullopt,
+                            unchanged ? entry->value : new T(m_parse(text))};
+      // threads racing keep the value of the newest generation
+      while (!m_entry.compare_exchange_weak(entry, next, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+         if (entry != nullptr && entry->generation >= settings.generation)
+         {
+            if (!unchanged)
+            {
+               delete next->value;
+            }
+            delete next;
+            return *entry->value;
+         }
+      }
+      return *next->value;
+   }
+
+ private:
+   struct Entry
+   {
+      uint64_t generation;
+      std::optional<std::string> text;
+      const T *value;
+   };
+
+   std::string_view m_name;
+   T (*m_parse)(std::optional<std::string_view> text);
+   std::atomic<const Entry *> m_entry{nullptr};
+};
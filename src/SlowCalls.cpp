@@ -0,0 +1,40 @@
+#include "SlowCalls.h"
+#include "Logging.h"
+#include "OdbcFormatters.h"
+#include "Settings.h"
+#include "StackTrace.h"
+#include "Statement.h"
+
+#include <format>
+#include <print>
+
+std::chrono::nanoseconds SlowCallThreshold()
+{
+   return CurrentSettings().slowCallThreshold;
+}
+
+void CaptureSlowCall(std::string_view function, HandleRecord *record, std::chrono::nanoseconds duration, SQLRETURN result)
+{
+   // capture the stack first, while the caller frames are still the ones of the slow call
+   auto frames = CaptureStack();
+
+   std::string report = std::format("Slow call {}({}) took {:.3f} ms -> {}", function, record != nullptr ? record->handle : SQL_NULL_HANDLE,
+                                    std::chrono::duration<double, std::milli>(duration).count(), ReturnCode{result});
+   if (record != nullptr && record->type == SQL_HANDLE_STMT)
+   {
+      if (auto text = GetStatementText(*record); !text.empty())
+      {
+         report += std::format("\n   sql: {}", text);
+      }
+      // read back after the call, see FormatStatementParameters
+      for (auto &parameter : FormatStatementParameters(*record))
+      {
+         report += std::format("\n   parameter {}", parameter);
+      }
+   }
+   for (auto &frame : SymbolizeStack(frames))
+   {
+      report += std::format("\n   at {}", frame);
+   }
+   std::print(LOG, "{}", report);
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "HandleRegistry.h"
+#include "Platform.h"
+
+#include <chrono>
+#include <string_view>
+
+// capture of the calls slower than ODBCDETOUR_SLOW_CALL_MS
+//
+// the sql text, the values of the bound parameters and the symbolized stack of the caller are written to the log. Only
+// slow calls pay for the capture, the threshold is zero (disabled) by default.
+std::chrono::nanoseconds SlowCallThreshold();
+
+void CaptureSlowCall(std::string_view function, HandleRecord *record, std::chrono::nanoseconds duration, SQLRETURN result);
@@ -0,0 +1,539 @@
+#include "SpanExport.h"
+#include "ConnectionString.h"
+#include "HandleRegistry.h"
+#include "Logging.h"
+#include "OdbcFormatters.h"
+#include "OdbcFunctions.h"
+#include "Settings.h"
+#include "Statement.h"
+#include "StringConversion.h"
+#include "TraceEvents.h"
+#include <OdbcDetour.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <random>
+#include <stdlib.h>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+// spans written in one export request, the exporter is woken up early once that many are queued
+constexpr size_t kBatchSpans = 512;
+// spans queued while the exporter is late are dropped above this
+constexpr size_t kMaxQueuedSpans = 100000;
+
+// OTLP span kind and status codes
+constexpr int kSpanKindClient = 3;
+constexpr int kStatusError = 2;
+
+enum class SpanKind
+{
+   None,
+   Connect,
+   Execute,
+   Fetch,
+   // ends the fetch loop of the statement
+   Close,
+};
+
+constexpr auto kSpanKinds = []
+{
+   std::array<SpanKind, kOdbcFunctionCount> kinds{};
+   for (auto function : {OdbcFunctionId::SQLConnectW, OdbcFunctionId::SQLDriverConnectW, OdbcFunctionId::SQLBrowseConnectW})
+   {
+      kinds[OdbcFunctionIndex(function)] = SpanKind::Connect;
+   }
+   for (auto function : {OdbcFunctionId::SQLExecute, OdbcFunctionId::SQLExecDirectW})
+   {
+      kinds[OdbcFunctionIndex(function)] = SpanKind::Execute;
+   }
+   for (auto function : {OdbcFunctionId::SQLFetch, OdbcFunctionId::SQLFetchScroll, OdbcFunctionId::SQLExtendedFetch})
+   {
+      kinds[OdbcFunctionIndex(function)] = SpanKind::Fetch;
+   }
+   for (auto function : {OdbcFunctionId::SQLCloseCursor, OdbcFunctionId::SQLFreeStmt, OdbcFunctionId::SQLMoreResults, OdbcFunctionId::SQLFreeHandle})
+   {
+      kinds[OdbcFunctionIndex(function)] = SpanKind::Close;
+   }
+   return kinds;
+}();
+
+// wall clock of the spans, taken once so that they are ordered like the cycle clock
+std::chrono::system_clock::time_point systemOrigin;
+CycleClock::time_point clockOrigin;
+// context of the connections without a TraceParent attribute, traceIdHigh and traceIdLow are 0 when none was given
+TraceContext processContext;
+
+std::mutex exportLock;
+std::condition_variable_any wakeUp;
+// spans waiting for the exporter, protected by exportLock
+std::vector<std::string> queued;
+FILE *exportFile = nullptr;
+std::atomic<uint64_t> exportedSpans{0};
+std::atomic<uint64_t> droppedSpans{0};
+
+uint64_t RandomId()
+{
+   thread_local std::mt19937_64 generator(std::random_device{}());
+   uint64_t id = 0;
+   while (id == 0)
+   {
+      id = generator();
+   }
+   return id;
+}
+
+bool ParseHex(std::string_view text, uint64_t &value)
+{
+   return std::from_chars(text.data(), text.data() + text.size(), value, 16).ptr == text.data() + text.size();
+}
+
+// 00-<trace id>-<parent span id>-<flags>, see https://www.w3.org/TR/trace-context/
+std::optional<TraceContext> ParseTraceParent(std::string_view traceParent)
+{
+   TraceContext context;
+   if (traceParent.size() != 55 || traceParent.substr(0, 3) != "00-" || traceParent[35] != '-' || traceParent[52] != '-' ||
+       !ParseHex(traceParent.substr(3, 16), context.traceIdHigh) || !ParseHex(traceParent.substr(19, 16), context.traceIdLow) ||
+       !ParseHex(traceParent.substr(36, 16), context.parentSpanId) || (context.traceIdHigh == 0 && context.traceIdLow == 0) || context.parentSpanId == 0)
+   {
+      return std::nullopt;
+   }
+   return context;
+}
+
+std::optional<std::string> ReadTraceParent()
+{
+   if (auto setting = GetSetting("TRACEPARENT"); setting)
+   {
+      return setting;
+   }
+   size_t length = 0;
+   char buffer[64];
+   if (getenv_s(&length, buffer, sizeof(buffer), "TRACEPARENT") == 0 && length > 1)
+   {
+      return std::string(buffer);
+   }
+   return std::nullopt;
+}
+
+bool OpenExportFile()
+{
+   auto path = GetSetting("OTLP_FILE");
+   if (!path)
+   {
+      return false;
+   }
+   FILE *file = nullptr;
+   if (fopen_s(&file, path->c_str(), "ab") != 0 || file == nullptr)
+   {
+      std::print(LOG, "Failed to open the span export file {}", *path);
+      return false;
+   }
+   exportFile = file;
+   systemOrigin = std::chrono::system_clock::now();
+   clockOrigin = CycleClock::now();
+   if (auto traceParent = ReadTraceParent(); traceParent)
+   {
+      if (auto context = ParseTraceParent(*traceParent); context)
+      {
+         processContext = *context;
+      }
+      else
+      {
+         std::print(LOG, "Ignoring the invalid traceparent {}", *traceParent);
+      }
+   }
+   return true;
+}
+
+SpanState &Spans(HandleRecord &record)
+{
+   if (!record.spans)
+   {
+      record.spans = std::make_unique<SpanState>();
+      record.spans->context = processContext;
+      if (record.spans->context.traceIdHigh == 0 && record.spans->context.traceIdLow == 0)
+      {
+         record.spans->context = {RandomId(), RandomId(), 0};
+      }
+   }
+   return *record.spans;
+}
+
+TraceContext ConnectionContext(HandleRecord &connection)
+{
+   std::lock_guard lock(connection.stateLock);
+   return Spans(connection).context;
+}
+
+std::string ServiceName()
+{
+   if (auto name = GetSetting("OTLP_SERVICE"); name)
+   {
+      return *name;
+   }
+   wchar_t path[MAX_PATH];
+   auto length = GetModuleFileNameW(nullptr, path, MAX_PATH);
+   return ToUtf8(std::filesystem::path(std::wstring_view(path, length)).stem().wstring());
+}
+
+std::string UnixNanos(CycleClock::time_point time)
+{
+   auto origin = std::chrono::duration_cast<std::chrono::nanoseconds>(systemOrigin.time_since_epoch());
+   return std::to_string((origin + (time - clockOrigin)).count());
+}
+
+// one span in OTLP JSON, attributes are added between Begin and End
+class SpanWriter
+{
+ public:
+   SpanWriter(const TraceContext &context, uint64_t spanId, uint64_t parentSpanId, std::string_view name,
+              CycleClock::time_point start, CycleClock::time_point end)
+   {
+      std::format_to(std::back_inserter(m_span), R"({{"traceId":"{:016x}{:016x}","spanId":"{:016x}",)", context.traceIdHigh, context.traceIdLow, spanId);
+      if (parentSpanId != 0)
+      {
+         std::format_to(std::back_inserter(m_span), R"("parentSpanId":"{:016x}",)", parentSpanId);
+      }
+      std::format_to(std::back_inserter(m_span), R"("name":"{}","kind":{},"startTimeUnixNano":"{}","endTimeUnixNano":"{}","attributes":[{{"key":"db.system","value":{{"stringValue":"other_sql"}}}})",
+                     name, kSpanKindClient, UnixNanos(start), UnixNanos(end));
+   }
+
+   void Add(std::string_view key, std::string_view value)
+   {
+      std::format_to(std::back_inserter(m_span), R"(,{{"key":"{}","value":{{"stringValue":")", key);
+      AppendJsonEscaped(m_span, value);
+      m_span += R"("}})";
+   }
+
+   void Add(std::string_view key, long long value)
+   {
+      std::format_to(std::back_inserter(m_span), R"(,{{"key":"{}","value":{{"intValue":"{}"}}}})", key, value);
+   }
+
+   // queue the span for the exporter
+   void End(SQLRETURN result)
+   {
+      std::format_to(std::back_inserter(m_span), R"(,{{"key":"odbc.return_code","value":{{"stringValue":"{}"}}}}])", ReturnCode{result});
+      if (result == SQL_ERROR || result == SQL_INVALID_HANDLE)
+      {
+         std::format_to(std::back_inserter(m_span), R"(,"status":{{"code":{},"message":"{}"}})", kStatusError, ReturnCode{result});
+      }
+      m_span += '}';
+
+      std::lock_guard lock(exportLock);
+      if (queued.size() >= kMaxQueuedSpans)
+      {
+         droppedSpans.fetch_add(1, std::memory_order_relaxed);
+         return;
+      }
+      queued.push_back(std::move(m_span));
+      if (queued.size() == kBatchSpans)
+      {
+         wakeUp.notify_one();
+      }
+   }
+
+ private:
+   std::string m_span;
+};
+
+void EmitFetchLoop(const TraceContext &context, SpanState &state, SQLHANDLE statement, SQLRETURN result)
+{
+   if (!state.fetchStart)
+   {
+      return;
+   }
+   SpanWriter span(context, RandomId(), state.executeSpanId != 0 ? state.executeSpanId : context.parentSpanId, "fetch", *state.fetchStart, state.fetchEnd);
+   span.Add("odbc.handle", std::format("{}", statement));
+   span.Add("odbc.fetch_calls", static_cast<long long>(state.fetchCalls));
+   span.Add("odbc.driver_time_us", static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(state.fetchTime).count()));
+   span.End(result);
+   state.fetchStart.reset();
+   state.fetchCalls = 0;
+   state.fetchTime = {};
+}
+
+void RecordConnect(size_t function, HandleRecord &connection, CycleClock::time_point start, CycleClock::time_point end, SQLRETURN result)
+{
+   auto context = ConnectionContext(connection);
+   SpanWriter span(context, RandomId(), context.parentSpanId, kOdbcFunctionNames[function], start, end);
+   span.Add("odbc.handle", std::format("{}", connection.handle));
+   span.End(result);
+}
+
+void RecordExecute(size_t function, HandleRecord &statement, CycleClock::time_point start, CycleClock::time_point end, SQLRETURN result)
+{
+   if (!statement.parent)
+   {
+      return;
+   }
+   auto &connection = *statement.parent;
+   auto context = ConnectionContext(connection);
+   auto text = GetStatementText(statement);
+   auto spanId = RandomId();
+   {
+      std::lock_guard lock(statement.stateLock);
+      auto &state = Spans(statement);
+      // a new execution closes the cursor of the previous one
+      EmitFetchLoop(context, state, statement.handle, SQL_SUCCESS);
+      state.executeSpanId = spanId;
+   }
+   {
+      std::lock_guard lock(connection.stateLock);
+      auto &state = Spans(connection);
+      if (!state.transactionStart)
+      {
+         state.transactionStart = start;
+      }
+      ++state.transactionStatements;
+   }
+
+   SpanWriter span(context, spanId, context.parentSpanId, kOdbcFunctionNames[function], start, end);
+   span.Add("db.statement", text);
+   span.Add("odbc.handle", std::format("{}", statement.handle));
+   span.Add("odbc.fingerprint", std::format("{:016x}", statement.sqlFingerprint.load(std::memory_order_relaxed)));
+   span.End(result);
+}
+
+void RecordFetch(HandleRecord &statement, CycleClock::time_point start, CycleClock::time_point end, SQLRETURN result)
+{
+   auto context = statement.parent ? ConnectionContext(*statement.parent) : processContext;
+   std::lock_guard lock(statement.stateLock);
+   auto &state = Spans(statement);
+   if (!state.fetchStart)
+   {
+      state.fetchStart = start;
+   }
+   state.fetchEnd = end;
+   ++state.fetchCalls;
+   state.fetchTime += end - start;
+   if (!SQL_SUCCEEDED(result))
+   {
+      EmitFetchLoop(context, state, statement.handle, result);
+   }
+}
+
+void RecordClose(HandleRecord &statement)
+{
+   auto context = statement.parent ? ConnectionContext(*statement.parent) : processContext;
+   std::lock_guard lock(statement.stateLock);
+   if (statement.spans)
+   {
+      EmitFetchLoop(context, *statement.spans, statement.handle, SQL_SUCCESS);
+   }
+}
+
+void WriteSpans(const std::vector<std::string> &spans)
+{
+   if (spans.empty())
+   {
+      return;
+   }
+   static const std::string resource = [&]
+   {
+      std::string attributes;
+      std::format_to(std::back_inserter(attributes), R"({{"key":"service.name","value":{{"stringValue":")");
+      AppendJsonEscaped(attributes, ServiceName());
+      std::format_to(std::back_inserter(attributes), R"("}}}},{{"key":"process.pid","value":{{"intValue":"{}"}}}})", GetCurrentProcessId());
+      return attributes;
+   }();
+
+   std::string request;
+   std::format_to(std::back_inserter(request), R"({{"resourceSpans":[{{"resource":{{"attributes":[{}]}},"scopeSpans":[{{"scope":{{"name":"odbcdetour","version":"{}"}},"spans":[)",
+                  resource, VERSION_STRING);
+   for (size_t i = 0; i < spans.size(); ++i)
+   {
+      if (i > 0)
+      {
+         request += ',';
+      }
+      request += spans[i];
+   }
+   request += "]}]}]}\n";
+   fwrite(request.data(), 1, request.size(), exportFile);
+   fflush(exportFile);
+   exportedSpans.fetch_add(spans.size(), std::memory_order_relaxed);
+}
+
+class SpanExporter
+{
+ public:
+   explicit SpanExporter(std::chrono::milliseconds interval)
+       : m_interval(interval)
+   {
+      m_thread = std::jthread([this](std::stop_token stop)
+                              { Run(stop); });
+   }
+
+   ~SpanExporter()
+   {
+      m_thread.request_stop();
+      m_thread.join();
+      std::lock_guard lock(exportLock);
+      WriteSpans(std::exchange(queued, {}));
+   }
+
+ private:
+   void Run(std::stop_token stop)
+   {
+      std::unique_lock lock(exportLock);
+      while (!stop.stop_requested())
+      {
+         wakeUp.wait_for(lock, stop, m_interval, []
+                         { return queued.size() >= kBatchSpans; });
+         auto spans = std::exchange(queued, {});
+         // the application threads queue spans while the batch is written
+         lock.unlock();
+         WriteSpans(spans);
+         lock.lock();
+      }
+   }
+
+   std::chrono::milliseconds m_interval;
+   std::jthread m_thread;
+};
+
+std::mutex exporterLock;
+// intentionally leaked if the application exits without freeing its environments, see the metrics publisher
+SpanExporter *exporter = nullptr;
+} // namespace
+
+bool SpanExportEnabled()
+{
+   static const bool enabled = OpenExportFile();
+   return enabled;
+}
+
+void SetSpanContext(SQLHDBC connection, std::wstring_view connectionString)
+{
+   if (!SpanExportEnabled())
+   {
+      return;
+   }
+   auto traceParent = GetConnectionAttribute(connectionString, L"TraceParent");
+   if (!traceParent)
+   {
+      return;
+   }
+   auto context = ParseTraceParent(ToUtf8(*traceParent));
+   if (!context)
+   {
+      std::print(LOG, "Ignoring the invalid TraceParent {} of connection {}", ToUtf8(*traceParent), connection);
+      return;
+   }
+   if (auto record = GetHandleRegistry().Find(connection); record)
+   {
+      std::lock_guard lock(record->stateLock);
+      Spans(*record).context = *context;
+   }
+}
+
+void RecordSpanCall(size_t function, const Route &route, CycleClock::time_point start, CycleClock::time_point end,
+                    SQLRETURN result)
+{
+   if (function >= kOdbcFunctionCount || !route.record || result == SQL_STILL_EXECUTING)
+   {
+      return;
+   }
+   auto &record = *route.record;
+   switch (kSpanKinds[function])
+   {
+   case SpanKind::Connect:
+      RecordConnect(function, record, start, end, result);
+      break;
+   case SpanKind::Execute:
+      if (record.type == SQL_HANDLE_STMT)
+      {
+         RecordExecute(function, record, start, end, result);
+      }
+      break;
+   case SpanKind::Fetch:
+      if (record.type == SQL_HANDLE_STMT)
+      {
+         RecordFetch(record, start, end, result);
+      }
+      break;
+   case SpanKind::Close:
+      if (record.type == SQL_HANDLE_STMT)
+      {
+         RecordClose(record);
+      }
+      break;
+   case SpanKind::None:
+      break;
+   }
+}
+
+void EndSpanTransaction(const Route &route, SQLSMALLINT completionType, CycleClock::time_point end, SQLRETURN result)
+{
+   if (!route.record || route.record->type != SQL_HANDLE_DBC)
+   {
+      return;
+   }
+   auto &connection = *route.record;
+   TraceContext context;
+   CycleClock::time_point start;
+   uint32_t statements = 0;
+   {
+      std::lock_guard lock(connection.stateLock);
+      auto &state = Spans(connection);
+      // a commit without statement, ex: with autocommit on, has no span
+      if (!state.transactionStart)
+      {
+         return;
+      }
+      context = state.context;
+      start = *std::exchange(state.transactionStart, std::nullopt);
+      statements = std::exchange(state.transactionStatements, 0);
+   }
+   SpanWriter span(context, RandomId(), context.parentSpanId, "transaction", start, end);
+   span.Add("odbc.handle", std::format("{}", connection.handle));
+   span.Add("odbc.completion", completionType == SQL_COMMIT ? "commit" : "rollback");
+   span.Add("odbc.statements", static_cast<long long>(statements));
+   span.End(result);
+}
+
+void StartSpanExporter()
+{
+   if (!SpanExportEnabled())
+   {
+      return;
+   }
+   std::lock_guard lock(exporterLock);
+   if (exporter == nullptr)
+   {
+      exporter = new SpanExporter(std::chrono::milliseconds(std::max<long long>(10, GetSettingInt("OTLP_INTERVAL_MS", 1000))));
+   }
+}
+
+void StopSpanExporter()
+{
+   std::lock_guard lock(exporterLock);
+   delete exporter;
+   exporter = nullptr;
+}
+
+void LogSpanReport()
+{
+   if (!SpanExportEnabled())
+   {
+      return;
+   }
+   std::print(LOG, "Spans: {} exported, {} dropped", exportedSpans.load(std::memory_order_relaxed), droppedSpans.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "Clock.h"
+#include "Platform.h"
+#include "Routing.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// OpenTelemetry span export, enabled by setting ODBCDETOUR_OTLP_FILE to the output file
+//
+// connects, executions, fetch loops and transactions are written as OTLP JSON spans, one export request per line as read
+// by the otlpjsonfile receiver of the collector. A background exporter writes the spans in batches every
+// ODBCDETOUR_OTLP_INTERVAL_MS (1000 ms by default). The spans of a connection belong to the W3C traceparent given by
+// the TraceParent attribute of its connection string, else by ODBCDETOUR_TRACEPARENT or TRACEPARENT; without one every
+// connection starts its own trace.
+bool SpanExportEnabled();
+
+// trace and parent span the spans of a connection belong to
+struct TraceContext
+{
+   uint64_t traceIdHigh = 0;
+   uint64_t traceIdLow = 0;
+   // 0 for spans without a parent
+   uint64_t parentSpanId = 0;
+};
+
+// spans being built on a handle, kept in HandleRecord::spans under its stateLock
+struct SpanState
+{
+   // connection: trace of its spans and of the spans of its statements
+   TraceContext context;
+   // connection: first statement of the open transaction and its statement count
+   std::optional<CycleClock::time_point> transactionStart;
+   uint32_t transactionStatements = 0;
+   // statement: span of the last execution, parent of its fetch loop
+   uint64_t executeSpanId = 0;
+   // statement: fetch loop in progress, from the first fetch after an execution to SQL_NO_DATA or the cursor close
+   std::optional<CycleClock::time_point> fetchStart;
+   CycleClock::time_point fetchEnd;
+   uint64_t fetchCalls = 0;
+   std::chrono::nanoseconds fetchTime{};
+};
+
+// trace context of a connection from the TraceParent attribute of its connection string, called before connecting
+void SetSpanContext(SQLHDBC connection, std::wstring_view connectionString);
+
+// a call forwarded to the driver, called by CallScope for every call
+void RecordSpanCall(size_t function, const Route &route, CycleClock::time_point start, CycleClock::time_point end,
+                    SQLRETURN result);
+
+// commit or rollback of a connection, ends the span of its open transaction
+void EndSpanTransaction(const Route &route, SQLSMALLINT completionType, CycleClock::time_point end, SQLRETURN result);
+
+void StartSpanExporter();
+// writes the spans still queued
+void StopSpanExporter();
+
+// spans exported and dropped
+void LogSpanReport();
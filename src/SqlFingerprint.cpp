@@ -0,0 +1,132 @@
+#include "SqlFingerprint.h"
+
+#include <cctype>
+
+namespace
+{
+bool IsIdentifierChar(char c)
+{
+   return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || c == '#' || c == '@' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+// characters that need a space to stay separated from a neighbouring word
+bool IsWordChar(char c)
+{
+   return IsIdentifierChar(c) || c == '?' || c == '\'' || c == '"' || c == '[' || c == ']' || c == '`' || c == '.';
+}
+
+void AppendPlaceholder(std::string &out)
+{
+   // (?,?,?) -> (?)
+   if (out.ends_with("?,"))
+   {
+      out.pop_back();
+      return;
+   }
+   out += '?';
+}
+} // namespace
+
+std::string NormalizeSql(std::string_view sql)
+{
+   std::string out;
+   out.reserve(sql.size());
+   bool pendingSpace = false;
+
+   for (size_t i = 0; i < sql.size();)
+   {
+      auto c = sql[i];
+
+      if (std::isspace(static_cast<unsigned char>(c)))
+      {
+         pendingSpace = !out.empty();
+         ++i;
+         continue;
+      }
+      if (sql.substr(i, 2) == "--")
+      {
+         auto end = sql.find('\n', i);
+         i = end == std::string_view::npos ? sql.size() : end;
+         continue;
+      }
+      if (sql.substr(i, 2) == "/*")
+      {
+         auto end = sql.find("*/", i + 2);
+         i = end == std::string_view::npos ? sql.size() : end + 2;
+         pendingSpace = !out.empty();
+         continue;
+      }
+
+      // whitespace is only kept between words, a = 1 and a=1 normalize the same way
+      if (pendingSpace && IsWordChar(out.back()) && IsWordChar(c))
+      {
+         out += ' ';
+      }
+      pendingSpace = false;
+
+      if (c == '?')
+      {
+         AppendPlaceholder(out);
+         ++i;
+         continue;
+      }
+
+      if (c == '\'')
+      {
+         // '' is an escaped quote inside the literal
+         ++i;
+         while (i < sql.size())
+         {
+            if (sql[i] == '\'' && (i + 1 >= sql.size() || sql[i + 1] != '\''))
+            {
+               ++i;
+               break;
+            }
+            i += sql[i] == '\'' ? 2 : 1;
+         }
+         AppendPlaceholder(out);
+         continue;
+      }
+      if (c == '"' || c == '[' || c == '`')
+      {
+         // quoted identifiers keep their case
+         auto close = c == '[' ? ']' : c;
+         auto end = sql.find(close, i + 1);
+         end = end == std::string_view::npos ? sql.size() : end + 1;
+         out += sql.substr(i, end - i);
+         i = end;
+         continue;
+      }
+      if (std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && i + 1 < sql.size() && std::isdigit(static_cast<unsigned char>(sql[i + 1]))))
+      {
+         // a digit inside an identifier, ex: table1, is not a literal
+         if (!out.empty() && IsIdentifierChar(out.back()))
+         {
+            out += c;
+            ++i;
+            continue;
+         }
+         while (i < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[i])) || sql[i] == '.'))
+         {
+            ++i;
+         }
+         AppendPlaceholder(out);
+         continue;
+      }
+
+      out += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      ++i;
+   }
+   return out;
+}
+
+uint64_t SqlFingerprint(std::string_view sql)
+{
+   uint64_t hash = 0xcbf29ce484222325ull;
+   for (char c : NormalizeSql(sql))
+   {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 0x100000001b3ull;
+   }
+   return hash != 0 ? hash : 1;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// normalized form of a statement: literals and parameter markers replaced by ?, lists of them collapsed, comments
+// removed, whitespace only kept between words and everything outside quoted identifiers lower cased. Statements that
+// only differ by their values share the same normalized text.
+std::string NormalizeSql(std::string_view sql);
+
+// 64 bits FNV-1a hash of the normalized text, never 0 so 0 can mean "no statement"
+uint64_t SqlFingerprint(std::string_view sql);
@@ -143,20 +143,6 @@ struct overloads : Ts...
 
 } // namespace
 
-std::string GetInfotypeName(SQLUSMALLINT infoType)
-{
-   auto &driverInfo = GetDriverInfos();
-
-   auto it = std::find_if(driverInfo.begin(), driverInfo.end(), [infoType](const auto &info)
-                          { return info.type == infoType; });
-   if (it != driverInfo.end())
-   {
-      return it->name;
-   }
-
-   return "Unknown type: " + std::to_string(infoType);
-}
-
 // extract the value from the pointer outValue and return it as a string
 //
 std::string GetInfotypeValueAsString(SQLUSMALLINT infoType, SQLPOINTER outValue, SQLSMALLINT *outValueLength1)
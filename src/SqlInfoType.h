@@ -1,4 +1,7 @@
 #pragma once
+#include <string>
+#include <string_view>
 
-std::string GetInfotypeName(SQLUSMALLINT infoType);
+// name of an info type of SQLGetInfo ex: SQL_DRIVER_NAME, empty when unknown
+std::string_view InfotypeName(long long infoType);
 std::string GetInfotypeValueAsString(SQLUSMALLINT infoType, SQLPOINTER outValue, SQLSMALLINT *outValueLength1);
@@ -0,0 +1,245 @@
+#include "SqlRewrite.h"
+#include "Logging.h"
+#include "PatternMatcher.h"
+#include "Settings.h"
+#include "SqlFingerprint.h"
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <print>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+enum class RuleKind
+{
+   Exact,
+   Fingerprint,
+   Pattern,
+};
+
+constexpr std::array<const char *, 3> kRuleKindNames = {"exact", "fingerprint", "pattern"};
+
+struct RewriteRule
+{
+   RuleKind kind;
+   std::string match;
+   std::string replacement;
+   // line of the match in the rules file, names the rule in the log
+   int line;
+};
+
+struct RuleSet
+{
+   std::vector<RewriteRule> rules;
+   std::unordered_map<std::string, size_t> exact;
+   std::unordered_map<uint64_t, size_t> fingerprints;
+   // rule of each pattern of the matcher
+   std::vector<size_t> patternRules;
+   std::unique_ptr<PatternMatcher> patterns;
+   std::unique_ptr<std::atomic<uint64_t>[]> hits;
+};
+
+std::string_view Trim(std::string_view str)
+{
+   while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+   {
+      str.remove_prefix(1);
+   }
+   while (!str.empty() && (str.back() == ' ' || str.back() == '\t' || str.back() == '\r'))
+   {
+      str.remove_suffix(1);
+   }
+   return str;
+}
+
+std::optional<RewriteRule> ParseMatch(std::string_view line, int number)
+{
+   auto space = line.find_first_of(" \t");
+   auto kind = line.substr(0, space);
+   auto match = space == std::string_view::npos ? std::string_view{} : Trim(line.substr(space));
+   for (size_t i = 0; i < kRuleKindNames.size(); ++i)
+   {
+      if (kind == kRuleKindNames[i] && !match.empty())
+      {
+         return RewriteRule{static_cast<RuleKind>(i), std::string(match), {}, number};
+      }
+   }
+   return std::nullopt;
+}
+
+std::unique_ptr<RuleSet> LoadRules(std::optional<std::string_view> path)
+{
+   if (!path)
+   {
+      return nullptr;
+   }
+   std::ifstream file{std::string(*path)};
+   if (!file)
+   {
+      std::print(LOG, "Failed to open the rewrite rules {}", *path);
+      return nullptr;
+   }
+
+   auto set = std::make_unique<RuleSet>();
+   std::optional<RewriteRule> pending;
+   std::string text;
+   for (int number = 1; std::getline(file, text); ++number)
+   {
+      auto line = Trim(text);
+      if (line.empty() || line.starts_with('#'))
+      {
+         continue;
+      }
+      if (line.starts_with("=>"))
+      {
+         if (!pending)
+         {
+            std::print(LOG, "Rewrite rules line {}: replacement without a match", number);
+            continue;
+         }
+         pending->replacement = std::string(Trim(line.substr(2)));
+         set->rules.push_back(std::move(*pending));
+         pending.reset();
+         continue;
+      }
+      if (pending)
+      {
+         std::print(LOG, "Rewrite rules line {}: match without a replacement", pending->line);
+      }
+      pending = ParseMatch(line, number);
+      if (!pending)
+      {
+         std::print(LOG, "Rewrite rules line {}: invalid rule {}", number, line);
+      }
+   }
+   if (pending)
+   {
+      std::print(LOG, "Rewrite rules line {}: match without a replacement", pending->line);
+   }
+
+   std::vector<std::string> patterns;
+   for (size_t index = 0; index < set->rules.size(); ++index)
+   {
+      auto &rule = set->rules[index];
+      switch (rule.kind)
+      {
+      case RuleKind::Exact:
+         set->exact.try_emplace(rule.match, index);
+         break;
+      case RuleKind::Fingerprint:
+      {
+         uint64_t fingerprint = 0;
+         auto [end, error] = std::from_chars(rule.match.data(), rule.match.data() + rule.match.size(), fingerprint, 16);
+         if (error != std::errc{} || end != rule.match.data() + rule.match.size())
+         {
+            std::print(LOG, "Rewrite rules line {}: invalid fingerprint {}", rule.line, rule.match);
+            break;
+         }
+         set->fingerprints.try_emplace(fingerprint, index);
+         break;
+      }
+      case RuleKind::Pattern:
+         patterns.push_back(rule.match);
+         set->patternRules.push_back(index);
+         break;
+      }
+   }
+   set->patterns = std::make_unique<PatternMatcher>(patterns);
+   set->hits = std::make_unique<std::atomic<uint64_t>[]>(set->rules.size());
+   std::print(LOG, "SQL rewrite: {} exact, {} fingerprint and {} pattern rule(s)", set->exact.size(), set->fingerprints.size(), patterns.size());
+   return set;
+}
+
+const RuleSet *GetRules()
+{
+   static ParsedSetting<std::unique_ptr<RuleSet>> rules("REWRITE_RULES", LoadRules);
+   return rules.Get().get();
+}
+
+void Hit(const RuleSet &set, size_t rule, std::string_view sql, std::string_view rewritten)
+{
+   if (set.hits[rule].fetch_add(1, std::memory_order_relaxed) == 0)
+   {
+      std::print(LOG, "SQL rewritten by the rule of line {}: {} => {}", set.rules[rule].line, sql, rewritten);
+   }
+}
+} // namespace
+
+bool SqlRewriteEnabled()
+{
+   return GetRules() != nullptr;
+}
+
+std::optional<std::string> RewriteSql(std::string_view sql)
+{
+   auto set = GetRules();
+   if (set == nullptr)
+   {
+      return std::nullopt;
+   }
+
+   if (!set->exact.empty())
+   {
+      if (auto it = set->exact.find(std::string(sql)); it != set->exact.end())
+      {
+         Hit(*set, it->second, sql, set->rules[it->second].replacement);
+         return set->rules[it->second].replacement;
+      }
+   }
+   if (!set->fingerprints.empty())
+   {
+      if (auto it = set->fingerprints.find(SqlFingerprint(sql)); it != set->fingerprints.end())
+      {
+         Hit(*set, it->second, sql, set->rules[it->second].replacement);
+         return set->rules[it->second].replacement;
+      }
+   }
+   if (set->patterns->Empty())
+   {
+      return std::nullopt;
+   }
+
+   auto matches = set->patterns->FindAll(sql);
+   if (matches.empty())
+   {
+      return std::nullopt;
+   }
+   std::string rewritten;
+   rewritten.reserve(sql.size());
+   size_t copied = 0;
+   for (auto &match : matches)
+   {
+      rewritten.append(sql.substr(copied, match.position - copied));
+      rewritten.append(set->rules[set->patternRules[match.pattern]].replacement);
+      copied = match.position + match.length;
+   }
+   rewritten.append(sql.substr(copied));
+   for (auto &match : matches)
+   {
+      Hit(*set, set->patternRules[match.pattern], sql, rewritten);
+   }
+   return rewritten;
+}
+
+void LogRewriteStats()
+{
+   auto set = GetRules();
+   if (set == nullptr)
+   {
+      return;
+   }
+   std::string report = "SQL rewrite hits by rule";
+   for (size_t index = 0; index < set->rules.size(); ++index)
+   {
+      auto &rule = set->rules[index];
+      report += std::format("\n   line {} {} {}: {}", rule.line, kRuleKindNames[static_cast<size_t>(rule.kind)], rule.match,
+                            set->hits[index].load(std::memory_order_relaxed));
+   }
+   std::print(LOG, "{}", report);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+
+// rewrite of the statements sent to the driver, rules are read from the file named by ODBCDETOUR_REWRITE_RULES
+//
+// each rule is a match line followed by a replacement line, lines starting with # are comments:
+//    exact SELECT * FROM orders           the whole statement, as sent by the application
+//    fingerprint 3f2a9c0d11e4b857         every statement with this fingerprint, see SqlFingerprint.h
+//    pattern WHERE YEAR(created) = 2024   every occurrence of the text, ASCII letters in any case
+//    => replacement text
+// exact rules are tried first, then fingerprints, then all patterns at once.
+bool SqlRewriteEnabled();
+
+// text to send instead of sql, nullopt when no rule applies
+std::optional<std::string> RewriteSql(std::string_view sql);
+
+void LogRewriteStats();
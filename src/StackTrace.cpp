@@ -0,0 +1,158 @@
+#include "StackTrace.h"
+
+#include <format>
+#include <mutex>
+
+#ifdef _WIN32
+// clang-format off
+#include <windows.h>
+#include <DbgHelp.h>
+// clang-format on
+#pragma comment(lib, "DbgHelp.lib")
+
+namespace
+{
+// DbgHelp is single threaded
+std::mutex dbgHelpLock;
+
+HMODULE ModuleOf(const void *address)
+{
+   HMODULE module = nullptr;
+   GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, static_cast<LPCWSTR>(address), &module);
+   return module;
+}
+
+std::string ModuleName(HMODULE module)
+{
+   char path[MAX_PATH]{};
+   auto len = GetModuleFileNameA(module, path, MAX_PATH);
+   std::string_view name(path, len);
+   if (auto slash = name.find_last_of("\\/"); slash != std::string_view::npos)
+   {
+      name.remove_prefix(slash + 1);
+   }
+   return std::string(name);
+}
+
+// must be called with dbgHelpLock held
+std::string UndecorateName(const char *decoratedName)
+{
+   char undecoratedName[1024];
+   if (UnDecorateSymbolName(decoratedName, undecoratedName, sizeof(undecoratedName), UNDNAME_COMPLETE) > 0)
+   {
+      return undecoratedName;
+   }
+   return decoratedName;
+}
+} // namespace
+
+std::vector<void *> CaptureStack(size_t maxFrames)
+{
+   // RtlCaptureStackBackTrace is limited to 62 frames on older systems
+   void *frames[62];
+   auto count = RtlCaptureStackBackTrace(0, static_cast<DWORD>(std::size(frames)), frames, nullptr);
+
+   auto self = ModuleOf(reinterpret_cast<const void *>(&CaptureStack));
+   USHORT first = 0;
+   while (first < count && ModuleOf(frames[first]) == self)
+   {
+      ++first;
+   }
+   return std::vector<void *>(frames + first, frames + std::min<size_t>(count, first + maxFrames));
+}
+
+std::vector<std::string> SymbolizeStack(const std::vector<void *> &frames)
+{
+   std::lock_guard lock(dbgHelpLock);
+   static auto init = SymInitialize(GetCurrentProcess(), NULL, TRUE);
+
+   std::vector<std::string> result;
+   for (auto frame : frames)
+   {
+      auto address = reinterpret_cast<DWORD64>(frame);
+      auto line = std::format("{}!{}", ModuleName(ModuleOf(frame)), frame);
+
+      alignas(SYMBOL_INFO) char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME]{};
+      auto symbol = reinterpret_cast<SYMBOL_INFO *>(buffer);
+      symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+      symbol->MaxNameLen = MAX_SYM_NAME;
+      DWORD64 displacement = 0;
+      if (init && SymFromAddr(GetCurrentProcess(), address, &displacement, symbol))
+      {
+         // names taken from the export table keep their decoration
+         auto name = symbol->Name[0] == '?' ? UndecorateName(symbol->Name) : std::string(symbol->Name);
+         line = std::format("{}!{}+{:#x}", ModuleName(ModuleOf(frame)), name, displacement);
+      }
+
+      IMAGEHLP_LINE64 source{};
+      source.SizeOfStruct = sizeof(source);
+      DWORD lineDisplacement = 0;
+      if (init && SymGetLineFromAddr64(GetCurrentProcess(), address, &lineDisplacement, &source))
+      {
+         line += std::format(" {}({})", source.FileName, source.LineNumber);
+      }
+      result.push_back(std::move(line));
+   }
+   return result;
+}
+#else
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <stdlib.h>
+
+namespace
+{
+const void *ModuleOf(const void *address)
+{
+   Dl_info info{};
+   return dladdr(address, &info) != 0 ? info.dli_fbase : nullptr;
+}
+} // namespace
+
+std::vector<void *> CaptureStack(size_t maxFrames)
+{
+   void *frames[64];
+   auto count = static_cast<size_t>(backtrace(frames, static_cast<int>(std::size(frames))));
+
+   auto self = ModuleOf(reinterpret_cast<const void *>(&CaptureStack));
+   size_t first = 0;
+   while (first < count && ModuleOf(frames[first]) == self)
+   {
+      ++first;
+   }
+   return std::vector<void *>(frames + first, frames + std::min(count, first + maxFrames));
+}
+
+std::vector<std::string> SymbolizeStack(const std::vector<void *> &frames)
+{
+   std::vector<std::string> result;
+   for (auto frame : frames)
+   {
+      Dl_info info{};
+      if (dladdr(frame, &info) == 0)
+      {
+         result.push_back(std::format("{}", frame));
+         continue;
+      }
+
+      std::string_view module = info.dli_fname != nullptr ? info.dli_fname : "?";
+      if (auto slash = module.find_last_of('/'); slash != std::string_view::npos)
+      {
+         module.remove_prefix(slash + 1);
+      }
+      if (info.dli_sname == nullptr)
+      {
+         result.push_back(std::format("{}!{}", module, frame));
+         continue;
+      }
+
+      int status = 0;
+      auto demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+      auto offset = static_cast<const char *>(frame) - static_cast<const char *>(info.dli_saddr);
+      result.push_back(std::format("{}!{}+{:#x}", module, status == 0 ? demangled : info.dli_sname, offset));
+      free(demangled);
+   }
+   return result;
+}
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// return addresses of the calling thread, innermost first. Frames inside the detour are skipped so the stack starts
+// in the driver manager or the application.
+std::vector<void *> CaptureStack(size_t maxFrames = 32);
+
+// one line per frame: module!function+offset, followed by file(line) when debug information is available
+std::vector<std::string> SymbolizeStack(const std::vector<void *> &frames);
@@ -0,0 +1,357 @@
+#include "Statement.h"
+#include "SqlFingerprint.h"
+#include "StringConversion.h"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <iterator>
+
+namespace
+{
+// longest value shown for character and binary parameters
+constexpr size_t kMaxValueLength = 256;
+
+std::string Quote(std::string_view value, bool truncated)
+{
+   std::string result = "'";
+   for (char c : value)
+   {
+      result += c;
+      if (c == '\'')
+      {
+         result += c;
+      }
+   }
+   result += truncated ? "'..." : "'";
+   return result;
+}
+
+std::string FormatHex(const unsigned char *data, size_t length)
+{
+   std::string result = "0x";
+   for (size_t i = 0; i < std::min(length, kMaxValueLength / 2); ++i)
+   {
+      std::format_to(std::back_inserter(result), "{:02X}", data[i]);
+   }
+   if (length > kMaxValueLength / 2)
+   {
+      result += "...";
+   }
+   return result;
+}
+
+template <typename T>
+T Read(SQLPOINTER value)
+{
+   T result;
+   std::memcpy(&result, value, sizeof(T));
+   return result;
+}
+
+// bindOffset is added to the value and indicator pointers, see SQL_ATTR_PARAM_BIND_OFFSET_PTR
+std::string FormatParameterValue(BoundParameter parameter, SQLULEN bindOffset)
+{
+   if (parameter.inputOutputType == SQL_PARAM_OUTPUT)
+   {
+      return "<output>";
+   }
+   if (bindOffset != 0)
+   {
+      if (parameter.value != nullptr)
+      {
+         parameter.value = static_cast<char *>(parameter.value) + bindOffset;
+      }
+      if (parameter.strLenOrInd != nullptr)
+      {
+         parameter.strLenOrInd = reinterpret_cast<SQLLEN *>(reinterpret_cast<char *>(parameter.strLenOrInd) + bindOffset);
+      }
+   }
+
+   // without indicator character data is null terminated
+   SQLLEN indicator = parameter.strLenOrInd != nullptr ? *parameter.strLenOrInd : SQL_NTS;
+   if (indicator == SQL_NULL_DATA || parameter.value == nullptr)
+   {
+      return "NULL";
+   }
+   if (indicator == SQL_DATA_AT_EXEC || indicator <= SQL_LEN_DATA_AT_EXEC_OFFSET)
+   {
+      return "<data at execution>";
+   }
+
+   switch (parameter.valueType)
+   {
+   case SQL_C_CHAR:
+   {
+      auto str = static_cast<const char *>(parameter.value);
+      auto length = indicator == SQL_NTS ? std::strlen(str) : static_cast<size_t>(indicator);
+      return Quote({str, std::min(length, kMaxValueLength)}, length > kMaxValueLength);
+   }
+   case SQL_C_WCHAR:
+   {
+      auto str = static_cast<const wchar_t *>(parameter.value);
+      auto length = indicator == SQL_NTS ? std::wcslen(str) : static_cast<size_t>(indicator) / sizeof(wchar_t);
+      return Quote(ReadString(str, static_cast<int>(std::min(length, kMaxValueLength))), length > kMaxValueLength);
+   }
+   case SQL_C_BINARY:
+      return FormatHex(static_cast<const unsigned char *>(parameter.value), indicator == SQL_NTS ? static_cast<size_t>(parameter.bufferLength) : static_cast<size_t>(indicator));
+   case SQL_C_BIT:
+   case SQL_C_UTINYINT:
+      return std::to_string(Read<unsigned char>(parameter.value));
+   case SQL_C_TINYINT:
+   case SQL_C_STINYINT:
+      return std::to_string(Read<signed char>(parameter.value));
+   case SQL_C_SHORT:
+   case SQL_C_SSHORT:
+      return std::to_string(Read<SQLSMALLINT>(parameter.value));
+   case SQL_C_USHORT:
+      return std::to_string(Read<SQLUSMALLINT>(parameter.value));
+   case SQL_C_LONG:
+   case SQL_C_SLONG:
+      return std::to_string(Read<SQLINTEGER>(parameter.value));
+   case SQL_C_ULONG:
+      return std::to_string(Read<SQLUINTEGER>(parameter.value));
+   case SQL_C_SBIGINT:
+      return std::to_string(Read<SQLBIGINT>(parameter.value));
+   case SQL_C_UBIGINT:
+      return std::to_string(Read<SQLUBIGINT>(parameter.value));
+   case SQL_C_FLOAT:
+      return std::format("{}", Read<SQLREAL>(parameter.value));
+   case SQL_C_DOUBLE:
+      return std::format("{}", Read<SQLDOUBLE>(parameter.value));
+   case SQL_C_TYPE_DATE:
+   {
+      auto date = Read<SQL_DATE_STRUCT>(parameter.value);
+      return std::format("{{d '{:04}-{:02}-{:02}'}}", date.year, date.month, date.day);
+   }
+   case SQL_C_TYPE_TIME:
+   {
+      auto time = Read<SQL_TIME_STRUCT>(parameter.value);
+      return std::format("{{t '{:02}:{:02}:{:02}'}}", time.hour, time.minute, time.second);
+   }
+   case SQL_C_TYPE_TIMESTAMP:
+   {
+      auto ts = Read<SQL_TIMESTAMP_STRUCT>(parameter.value);
+      return std::format("{{ts '{:04}-{:02}-{:02} {:02}:{:02}:{:02}.{:09}'}}", ts.year, ts.month, ts.day, ts.hour, ts.minute, ts.second, ts.fraction);
+   }
+   default:
+      return std::format("<c type {}>", parameter.valueType);
+   }
+}
+} // namespace
+
+SQLLEN FixedCTypeSize(SQLSMALLINT type)
+{
+   switch (type)
+   {
+   case SQL_C_BIT:
+   case SQL_C_STINYINT:
+   case SQL_C_UTINYINT:
+   case SQL_C_TINYINT:
+      return 1;
+   case SQL_C_SSHORT:
+   case SQL_C_USHORT:
+   case SQL_C_SHORT:
+      return sizeof(SQLSMALLINT);
+   case SQL_C_SLONG:
+   case SQL_C_ULONG:
+   case SQL_C_LONG:
+      return sizeof(SQLINTEGER);
+   case SQL_C_FLOAT:
+      return sizeof(SQLREAL);
+   case SQL_C_DOUBLE:
+      return sizeof(SQLDOUBLE);
+   case SQL_C_SBIGINT:
+   case SQL_C_UBIGINT:
+      return sizeof(SQLBIGINT);
+   case SQL_C_TYPE_DATE:
+   case SQL_C_DATE:
+      return sizeof(SQL_DATE_STRUCT);
+   case SQL_C_TYPE_TIME:
+   case SQL_C_TIME:
+      return sizeof(SQL_TIME_STRUCT);
+   case SQL_C_TYPE_TIMESTAMP:
+   case SQL_C_TIMESTAMP:
+      return sizeof(SQL_TIMESTAMP_STRUCT);
+   case SQL_C_NUMERIC:
+      return sizeof(SQL_NUMERIC_STRUCT);
+   case SQL_C_GUID:
+      return sizeof(SQLGUID);
+   default:
+      return 0;
+   }
+}
+
+bool IsVariableCType(SQLSMALLINT type)
+{
+   return type == SQL_C_CHAR || type == SQL_C_WCHAR || type == SQL_C_BINARY;
+}
+
+void SetStatementText(HandleRecord &statement, std::string text)
+{
+   auto fingerprint = SqlFingerprint(text);
+   std::lock_guard lock(statement.stateLock);
+   statement.sqlText = std::move(text);
+   statement.sqlFingerprint.store(fingerprint, std::memory_order_release);
+}
+
+std::string GetStatementText(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   return statement.sqlText;
+}
+
+void BindStatementParameter(HandleRecord &statement, SQLUSMALLINT number, const BoundParameter &parameter)
+{
+   std::lock_guard lock(statement.stateLock);
+   statement.parameters.insert_or_assign(number, parameter);
+}
+
+void ResetStatementParameters(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   statement.parameters.clear();
+   statement.parameterDescriptorChanged = false;
+}
+
+void ChangeParameterDescriptor(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   statement.parameterDescriptorChanged = true;
+}
+
+void SetParameterDescriptor(HandleRecord &statement, SQLHDESC descriptor)
+{
+   std::lock_guard lock(statement.stateLock);
+   statement.explicitParameterDescriptor = descriptor != SQL_NULL_HANDLE;
+}
+
+void SetParameterBindingAttribute(HandleRecord &statement, SQLINTEGER attribute, SQLPOINTER value)
+{
+   std::lock_guard lock(statement.stateLock);
+   if (attribute == SQL_ATTR_PARAM_BIND_OFFSET_PTR)
+   {
+      statement.parameterBindOffset = static_cast<SQLULEN *>(value);
+   }
+   else if (attribute == SQL_ATTR_PARAMSET_SIZE)
+   {
+      statement.parameterSets = std::max<SQLULEN>(1, reinterpret_cast<SQLULEN>(value));
+   }
+}
+
+void BindStatementColumn(HandleRecord &statement, SQLUSMALLINT number, const BoundColumn &column)
+{
+   std::lock_guard lock(statement.stateLock);
+   if (column.value == nullptr && column.strLenOrInd == nullptr)
+   {
+      statement.columns.erase(number);
+   }
+   else
+   {
+      statement.columns.insert_or_assign(number, column);
+   }
+}
+
+void ResetStatementColumns(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   statement.columns.clear();
+}
+
+std::map<SQLUSMALLINT, BoundColumn> GetStatementColumns(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   return statement.columns;
+}
+
+size_t BoundBufferBytes(HandleRecord &statement)
+{
+   auto bytes = [](SQLSMALLINT type, SQLLEN bufferLength, const SQLLEN *indicator)
+   {
+      auto size = FixedCTypeSize(type);
+      if (size == 0)
+      {
+         size = std::max<SQLLEN>(bufferLength, 0);
+      }
+      return static_cast<size_t>(size) + (indicator != nullptr ? sizeof(SQLLEN) : 0);
+   };
+   std::lock_guard lock(statement.stateLock);
+   size_t total = 0;
+   for (auto &[number, parameter] : statement.parameters)
+   {
+      total += bytes(parameter.valueType, parameter.bufferLength, parameter.strLenOrInd);
+   }
+   for (auto &[number, column] : statement.columns)
+   {
+      total += bytes(column.targetType, column.bufferLength, column.strLenOrInd);
+   }
+   return total;
+}
+
+std::optional<std::string> StatementParameterKey(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   if (statement.parameterDescriptorChanged || statement.explicitParameterDescriptor)
+   {
+      return std::nullopt;
+   }
+   std::string key;
+   for (auto &[number, parameter] : statement.parameters)
+   {
+      if (parameter.inputOutputType != SQL_PARAM_INPUT)
+      {
+         return std::nullopt;
+      }
+      SQLLEN indicator = parameter.strLenOrInd != nullptr ? *parameter.strLenOrInd : SQL_NTS;
+      if (indicator == SQL_DATA_AT_EXEC || indicator <= SQL_LEN_DATA_AT_EXEC_OFFSET)
+      {
+         return std::nullopt;
+      }
+
+      size_t length = 0;
+      if (indicator != SQL_NULL_DATA && parameter.value != nullptr)
+      {
+         switch (parameter.valueType)
+         {
+         case SQL_C_CHAR:
+            length = indicator == SQL_NTS ? std::strlen(static_cast<const char *>(parameter.value)) : static_cast<size_t>(indicator);
+            break;
+         case SQL_C_WCHAR:
+            length = indicator == SQL_NTS ? std::wcslen(static_cast<const wchar_t *>(parameter.value)) * sizeof(wchar_t) : static_cast<size_t>(indicator);
+            break;
+         case SQL_C_BINARY:
+            length = indicator == SQL_NTS ? static_cast<size_t>(parameter.bufferLength) : static_cast<size_t>(indicator);
+            break;
+         default:
+            length = static_cast<size_t>(FixedCTypeSize(parameter.valueType));
+            if (length == 0)
+            {
+               return std::nullopt;
+            }
+            break;
+         }
+      }
+
+      // number, types and length delimit the value bytes so different parameter lists never give the same key
+      key += std::format("{}:{}:{}:{}:", number, parameter.valueType, parameter.parameterType, indicator == SQL_NULL_DATA ? -1 : static_cast<long long>(length));
+      key.append(static_cast<const char *>(parameter.value), length);
+   }
+   return key;
+}
+
+std::vector<std::string> FormatStatementParameters(HandleRecord &statement)
+{
+   std::lock_guard lock(statement.stateLock);
+   std::vector<std::string> result;
+   auto bindOffset = statement.parameterBindOffset != nullptr ? *statement.parameterBindOffset : 0;
+   for (auto &[number, parameter] : statement.parameters)
+   {
+      auto value = FormatParameterValue(parameter, bindOffset);
+      if (statement.parameterSets > 1)
+      {
+         value += std::format(" (first of {} parameter sets)", statement.parameterSets);
+      }
+      result.push_back(std::format("{}: {}", number, value));
+   }
+   return result;
+}
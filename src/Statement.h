@@ -0,0 +1,47 @@
+#pragma once
+#include "HandleRegistry.h"
+#include "Platform.h"
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+// size of a value of a fixed length C type, 0 for character, binary and unsupported types
+SQLLEN FixedCTypeSize(SQLSMALLINT type);
+// character and binary C types, their length is given by the buffer length or the indicator
+bool IsVariableCType(SQLSMALLINT type);
+
+// state of a statement as seen by the application, kept for diagnostics
+// also computes the fingerprint of the statement
+void SetStatementText(HandleRecord &statement, std::string text);
+std::string GetStatementText(HandleRecord &statement);
+
+void BindStatementParameter(HandleRecord &statement, SQLUSMALLINT number, const BoundParameter &parameter);
+// SQLFreeStmt(SQL_RESET_PARAMS), the implicit APD has no record left
+void ResetStatementParameters(HandleRecord &statement);
+// SQLSetDescFieldW, SQLSetDescRec or SQLCopyDesc changed the implicit APD of the statement
+void ChangeParameterDescriptor(HandleRecord &statement);
+// SQLSetStmtAttrW(SQL_ATTR_APP_PARAM_DESC), a null descriptor returns to the implicit one
+void SetParameterDescriptor(HandleRecord &statement, SQLHDESC descriptor);
+// SQLSetStmtAttrW, records SQL_ATTR_PARAM_BIND_OFFSET_PTR and SQL_ATTR_PARAMSET_SIZE and ignores other attributes
+void SetParameterBindingAttribute(HandleRecord &statement, SQLINTEGER attribute, SQLPOINTER value);
+
+// SQLBindCol, a null value and indicator unbinds the column
+void BindStatementColumn(HandleRecord &statement, SQLUSMALLINT number, const BoundColumn &column);
+// SQLFreeStmt(SQL_UNBIND)
+void ResetStatementColumns(HandleRecord &statement);
+std::map<SQLUSMALLINT, BoundColumn> GetStatementColumns(HandleRecord &statement);
+
+// bytes of the application buffers bound to the parameters and columns, values and indicators of one row
+size_t BoundBufferBytes(HandleRecord &statement);
+
+// bytes of the bound parameter values, the same values give the same key. nullopt when a parameter value is not
+// known before execution, ex: output or data at execution parameters, or when the parameters are described through
+// the APD
+std::optional<std::string> StatementParameterKey(HandleRecord &statement);
+
+// "number: value" for every bound parameter, values are read from the application buffers at the time of the call,
+// after the driver returned for a slow call: input/output parameters may show the value written back. Only the first
+// set of an array of parameters is shown
+std::vector<std::string> FormatStatementParameters(HandleRecord &statement);
@@ -0,0 +1,60 @@
+#include "StringConversion.h"
+#include "Platform.h"
+
+std::string ToUtf8(std::wstring_view wstr)
+{
+   std::string result;
+   if (wstr.size() != 0)
+   {
+      // first call computes the size of the converted string
+      int size = WideCharToMultiByte(CP_UTF8, 0, wstr.data(), narrow_cast<int>(wstr.size()), nullptr, 0, nullptr, nullptr);
+      result.resize(size);
+      WideCharToMultiByte(CP_UTF8, 0, wstr.data(), narrow_cast<int>(wstr.size()), result.data(), size, nullptr, nullptr);
+   }
+   return result;
+}
+
+std::wstring FromUtf8(std::string_view str)
+{
+   std::wstring result;
+   if (str.size() != 0)
+   {
+      int size = MultiByteToWideChar(CP_UTF8, 0, str.data(), narrow_cast<int>(str.size()), nullptr, 0);
+      result.resize(size);
+      MultiByteToWideChar(CP_UTF8, 0, str.data(), narrow_cast<int>(str.size()), result.data(), size);
+   }
+   return result;
+}
+
+std::wstring ReadWideString(const wchar_t *str, int size)
+{
+   if (str == nullptr || (size < 0 && size != SQL_NTS))
+   {
+      return {};
+   }
+   return size == SQL_NTS ? std::wstring(str) : std::wstring(str, static_cast<size_t>(size));
+}
+
+std::string ReadString(const wchar_t *str, int size)
+{
+   if (str == nullptr || size == 0)
+   {
+      return "NULL";
+   }
+   // must be done after testing for SQL_NTS, as SQL_NTS is -3
+   if (size < 0 && size != SQL_NTS)
+   {
+      return "NULL";
+   }
+
+   std::wstring_view input;
+   if (size == SQL_NTS)
+   {
+      input = std::wstring_view(str);
+   }
+   else
+   {
+      input = std::wstring_view{str, static_cast<size_t>(size)};
+   }
+   return ToUtf8(input);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+template <typename Dest, typename Src>
+auto narrow_cast(Src v) -> Dest
+{
+   return static_cast<Dest>(v);
+}
+
+std::string ToUtf8(std::wstring_view wstr);
+std::wstring FromUtf8(std::string_view str);
+
+// read an odbc string argument, size is in characters and may be SQL_NTS
+std::string ReadString(const wchar_t *str, int size);
+std::wstring ReadWideString(const wchar_t *str, int size);
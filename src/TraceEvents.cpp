@@ -0,0 +1,174 @@
+#include "TraceEvents.h"
+#include "OdbcFormatters.h"
+#include "Settings.h"
+
+#include <cstdio>
+#include <format>
+#include <iterator>
+#include <mutex>
+#include <print>
+#include <stdlib.h>
+#include <utility>
+#include <vector>
+
+namespace
+{
+std::mutex traceLock;
+FILE *traceFile = nullptr;
+CycleClock::time_point traceOrigin;
+
+// arguments attached to the next call of the thread
+thread_local std::vector<std::pair<std::string_view, std::string>> annotations;
+
+double Microseconds(CycleClock::time_point time)
+{
+   return std::chrono::duration<double, std::micro>(time - traceOrigin).count();
+}
+
+void CloseTraceFile()
+{
+   std::lock_guard lock(traceLock);
+   if (traceFile != nullptr)
+   {
+      // replace the separator of the last event by the end of the array
+      fseek(traceFile, -2, SEEK_END);
+      fputs("\n]\n", traceFile);
+      fclose(traceFile);
+      traceFile = nullptr;
+   }
+}
+
+bool OpenTraceFile()
+{
+   auto path = GetSetting("TRACE_EVENTS");
+   if (!path)
+   {
+      return false;
+   }
+
+   FILE *file = nullptr;
+   if (fopen_s(&file, path->c_str(), "w") != 0 || file == nullptr)
+   {
+      return false;
+   }
+   setvbuf(file, nullptr, _IOFBF, 1 << 16);
+
+   traceOrigin = CycleClock::now();
+   traceFile = file;
+   // the closing bracket is optional in the array format, the file stays loadable if the process never exits cleanly
+   fputs("[\n", traceFile);
+   std::print(traceFile, R"({{"name":"process_name","ph":"M","pid":{},"args":{{"name":"OdbcDetour"}}}},)"
+                         "\n",
+              GetCurrentProcessId());
+   atexit(CloseTraceFile);
+   return true;
+}
+
+void AppendAsyncSlice(std::string &out, std::string_view function, std::string_view category, SQLHANDLE id, double start, double end)
+{
+   auto pid = GetCurrentProcessId();
+   auto tid = GetCurrentThreadId();
+   std::format_to(std::back_inserter(out), R"({{"name":"{}","cat":"{}","ph":"b","id":"{}","ts":{:.3f},"pid":{},"tid":{}}},)"
+                                           "\n",
+                  function, category, id, start, pid, tid);
+   std::format_to(std::back_inserter(out), R"({{"name":"{}","cat":"{}","ph":"e","id":"{}","ts":{:.3f},"pid":{},"tid":{}}},)"
+                                           "\n",
+                  function, category, id, end, pid, tid);
+}
+} // namespace
+
+void AppendJsonEscaped(std::string &out, std::string_view str)
+{
+   for (char c : str)
+   {
+      switch (c)
+      {
+      case '"':
+         out += R"(\")";
+         break;
+      case '\\':
+         out += R"(\\)";
+         break;
+      case '\n':
+         out += R"(\n)";
+         break;
+      case '\r':
+         out += R"(\r)";
+         break;
+      case '\t':
+         out += R"(\t)";
+         break;
+      default:
+         if (static_cast<unsigned char>(c) < 0x20)
+         {
+            std::format_to(std::back_inserter(out), R"(\u{:04x})", static_cast<int>(c));
+         }
+         else
+         {
+            out += c;
+         }
+         break;
+      }
+   }
+}
+
+bool TraceEventsEnabled()
+{
+   static const bool enabled = OpenTraceFile();
+   return enabled;
+}
+
+void AnnotateCall(std::string_view key, std::string value)
+{
+   annotations.emplace_back(key, std::move(value));
+}
+
+void DiscardCallAnnotations()
+{
+   annotations.clear();
+}
+
+void RecordTraceEvent(std::string_view function, const HandleRecord *record, CycleClock::time_point start,
+                      CycleClock::time_point end, SQLRETURN result)
+{
+   thread_local std::string event;
+   event.clear();
+
+   auto startUs = Microseconds(start);
+   auto endUs = Microseconds(end);
+   SQLHANDLE handle = record != nullptr ? record->handle : SQL_NULL_HANDLE;
+
+   std::format_to(std::back_inserter(event), R"({{"name":"{}","cat":"odbc","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":{},"tid":{},"args":{{"handle":"{}","rc":"{}")",
+                  function, startUs, endUs - startUs, GetCurrentProcessId(), GetCurrentThreadId(), handle, ReturnCode{result});
+   for (auto &[key, value] : annotations)
+   {
+      std::format_to(std::back_inserter(event), R"(,"{}":")", key);
+      AppendJsonEscaped(event, value);
+      event += '"';
+   }
+   event += "}},\n";
+   annotations.clear();
+
+   // statements and descriptors are also shown on the track of their connection
+   if (record != nullptr)
+   {
+      if (record->type == SQL_HANDLE_STMT || record->type == SQL_HANDLE_DESC)
+      {
+         AppendAsyncSlice(event, function, record->type == SQL_HANDLE_STMT ? "statement" : "descriptor", record->handle, startUs, endUs);
+         if (record->parent)
+         {
+            AppendAsyncSlice(event, function, "connection", record->parent->handle, startUs, endUs);
+         }
+      }
+      else if (record->type == SQL_HANDLE_DBC)
+      {
+         AppendAsyncSlice(event, function, "connection", record->handle, startUs, endUs);
+      }
+   }
+
+   std::lock_guard lock(traceLock);
+   if (traceFile != nullptr)
+   {
+      fwrite(event.data(), 1, event.size(), traceFile);
+   }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "Clock.h"
+#include "HandleRegistry.h"
+#include "Platform.h"
+
+#include <chrono>
+#include <string>
+#include <string_view>
+
+// Chrome trace event export, enabled by setting ODBCDETOUR_TRACE_EVENTS to the output file
+//
+// every forwarded call is a slice on its thread, repeated on the track of its connection and of its statement. The file
+// uses the JSON array format with one event per line, it loads in chrome://tracing and ui.perfetto.dev.
+bool TraceEventsEnabled();
+
+// attach an argument to the next call forwarded by this thread, ex: sql text, decoded info type
+void AnnotateCall(std::string_view key, std::string value);
+// end of the entry point, the arguments of a call answered without reaching the driver are dropped
+void DiscardCallAnnotations();
+
+// append a string to a JSON string literal, quotes, backslashes and control characters are escaped
+void AppendJsonEscaped(std::string &out, std::string_view str);
+
+void RecordTraceEvent(std::string_view function, const HandleRecord *record, CycleClock::time_point start,
+                      CycleClock::time_point end, SQLRETURN result);
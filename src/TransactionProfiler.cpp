@@ -0,0 +1,318 @@
+#include "TransactionProfiler.h"
+#include "Logging.h"
+#include "OdbcFunctions.h"
+#include "Settings.h"
+#include "Statement.h"
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+// transactions kept for the longest and largest lists of the report
+constexpr size_t kTopCount = 5;
+constexpr size_t kMaxStatementText = 120;
+
+enum class Completion
+{
+   Commit,
+   Rollback,
+   // autocommit switched back on
+   ImplicitCommit,
+   Abandoned,
+};
+
+constexpr std::array<const char *, 4> kCompletionNames = {"commit", "rollback", "implicit commit", "abandoned"};
+
+struct OpenTransaction
+{
+   std::chrono::steady_clock::time_point start;
+   uint64_t statements = 0;
+   uint64_t rows = 0;
+   std::chrono::nanoseconds statementTime{0};
+   std::string firstStatement;
+   // row count of the last execution of each statement, added to rows when the statement runs again
+   std::map<SQLHANDLE, SQLLEN> pendingRows;
+};
+
+struct ConnectionTransactions
+{
+   bool autocommit = true;
+   std::optional<OpenTransaction> open;
+};
+
+struct TransactionSummary
+{
+   SQLHANDLE connection;
+   Completion completion;
+   std::chrono::nanoseconds duration;
+   std::chrono::nanoseconds statementTime;
+   std::chrono::nanoseconds endLatency;
+   uint64_t statements;
+   uint64_t rows;
+   std::string firstStatement;
+};
+
+struct Totals
+{
+   std::array<uint64_t, 4> completions{};
+   std::chrono::nanoseconds duration{0};
+   std::chrono::nanoseconds maxDuration{0};
+   std::chrono::nanoseconds statementTime{0};
+   std::chrono::nanoseconds commitLatency{0};
+   std::chrono::nanoseconds rollbackLatency{0};
+   uint64_t statements = 0;
+   uint64_t rows = 0;
+   uint64_t failedEnds = 0;
+   uint64_t autocommitStatements = 0;
+   std::chrono::nanoseconds autocommitTime{0};
+};
+
+std::mutex profilerLock;
+std::unordered_map<SQLHANDLE, ConnectionTransactions> connections;
+Totals totals;
+std::vector<TransactionSummary> longest;
+std::vector<TransactionSummary> largest;
+
+// SQLParamData and SQLPutData complete an execution already counted when it returned SQL_NEED_DATA
+constexpr std::array<std::string_view, 4> kStatementFunctions = {"SQLBulkOperations", "SQLExecDirectW", "SQLExecute", "SQLSetPos"};
+
+constexpr auto kIsStatementFunction = []
+{
+   std::array<bool, kOdbcFunctionCount> statement{};
+   for (auto name : kStatementFunctions)
+   {
+      statement[FindOdbcFunction(name).value()] = true;
+   }
+   return statement;
+}();
+
+double Milliseconds(std::chrono::nanoseconds duration)
+{
+   return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+SQLHANDLE ConnectionOf(const Route &route)
+{
+   if (!route.record || (route.record->type != SQL_HANDLE_DBC && !route.record->parent))
+   {
+      return SQL_NULL_HANDLE;
+   }
+   return route.record->type == SQL_HANDLE_DBC ? route.record->handle : route.record->parent->handle;
+}
+
+void KeepTop(std::vector<TransactionSummary> &top, const TransactionSummary &summary, auto greater)
+{
+   top.push_back(summary);
+   std::ranges::sort(top, greater);
+   if (top.size() > kTopCount)
+   {
+      top.pop_back();
+   }
+}
+
+// must be called with profilerLock held
+void Close(SQLHANDLE connection, ConnectionTransactions &state, Completion completion, std::chrono::nanoseconds latency)
+{
+   if (!state.open)
+   {
+      return;
+   }
+
+   auto &open = *state.open;
+   for (auto &[statement, rows] : open.pendingRows)
+   {
+      open.rows += rows > 0 ? static_cast<uint64_t>(rows) : 0;
+   }
+   TransactionSummary summary{connection, completion, std::chrono::steady_clock::now() - open.start, open.statementTime, latency,
+                              open.statements, open.rows, std::move(open.firstStatement)};
+   state.open.reset();
+
+   ++totals.completions[static_cast<size_t>(completion)];
+   totals.duration += summary.duration;
+   totals.maxDuration = std::max(totals.maxDuration, summary.duration);
+   totals.statementTime += summary.statementTime;
+   totals.statements += summary.statements;
+   totals.rows += summary.rows;
+   if (completion == Completion::Commit)
+   {
+      totals.commitLatency += latency;
+   }
+   else if (completion == Completion::Rollback)
+   {
+      totals.rollbackLatency += latency;
+   }
+
+   if (summary.duration >= CurrentSettings().longTransaction)
+   {
+      std::print(LOG, "Long transaction on {}: {:.3f} ms open, {:.3f} ms in {} statement(s), {} row(s), {} in {:.3f} ms, first statement: {}", connection,
+                 Milliseconds(summary.duration), Milliseconds(summary.statementTime), summary.statements, summary.rows,
+                 kCompletionNames[static_cast<size_t>(completion)], Milliseconds(latency), summary.firstStatement);
+   }
+
+   KeepTop(longest, summary, [](auto &a, auto &b)
+           { return a.duration > b.duration; });
+   KeepTop(largest, summary, [](auto &a, auto &b)
+           { return a.rows > b.rows; });
+}
+
+std::string Describe(const TransactionSummary &summary)
+{
+   return std::format("\n      {} {:.3f} ms open, {:.3f} ms in {} statement(s), {} row(s), {} in {:.3f} ms: {}", summary.connection,
+                      Milliseconds(summary.duration), Milliseconds(summary.statementTime), summary.statements, summary.rows,
+                      kCompletionNames[static_cast<size_t>(summary.completion)], Milliseconds(summary.endLatency), summary.firstStatement);
+}
+} // namespace
+
+bool TransactionProfilingEnabled()
+{
+   return CurrentSettings().transactions;
+}
+
+void SetAutocommit(SQLHDBC connection, bool on)
+{
+   std::lock_guard lock(profilerLock);
+   auto &state = connections[connection];
+   if (on && !state.autocommit)
+   {
+      Close(connection, state, Completion::ImplicitCommit, {});
+   }
+   state.autocommit = on;
+}
+
+void RecordTransactionStatement(size_t function, const Route &route, std::chrono::nanoseconds duration, SQLRETURN result)
+{
+   if (function >= kOdbcFunctionCount || !kIsStatementFunction[function] || result == SQL_STILL_EXECUTING)
+   {
+      return;
+   }
+   auto connection = ConnectionOf(route);
+   if (connection == SQL_NULL_HANDLE)
+   {
+      return;
+   }
+   // read before taking the profiler lock
+   auto text = route.record->type == SQL_HANDLE_STMT ? GetStatementText(*route.record) : std::string{};
+
+   std::lock_guard lock(profilerLock);
+   auto &state = connections[connection];
+   if (state.autocommit)
+   {
+      ++totals.autocommitStatements;
+      totals.autocommitTime += duration;
+      return;
+   }
+
+   if (!state.open)
+   {
+      state.open.emplace();
+      state.open->start = std::chrono::steady_clock::now() - duration;
+      state.open->firstStatement = text.substr(0, kMaxStatementText);
+   }
+   auto &open = *state.open;
+   ++open.statements;
+   open.statementTime += duration;
+   if (auto it = open.pendingRows.find(route.record->handle); it != open.pendingRows.end())
+   {
+      open.rows += it->second > 0 ? static_cast<uint64_t>(it->second) : 0;
+      open.pendingRows.erase(it);
+   }
+}
+
+void RecordRowCount(const Route &route, SQLLEN rows)
+{
+   auto connection = ConnectionOf(route);
+   if (connection == SQL_NULL_HANDLE)
+   {
+      return;
+   }
+
+   std::lock_guard lock(profilerLock);
+   if (auto it = connections.find(connection); it != connections.end() && it->second.open)
+   {
+      // the application may ask several times, only the last count of an execution is kept
+      it->second.open->pendingRows[route.record->handle] = rows;
+   }
+}
+
+void EndTransaction(SQLHDBC connection, SQLSMALLINT completionType, std::chrono::nanoseconds latency, SQLRETURN result)
+{
+   std::lock_guard lock(profilerLock);
+   auto it = connections.find(connection);
+   if (it == connections.end() || !it->second.open)
+   {
+      return;
+   }
+   if (!SQL_SUCCEEDED(result))
+   {
+      ++totals.failedEnds;
+      return;
+   }
+   Close(connection, it->second, completionType == SQL_ROLLBACK ? Completion::Rollback : Completion::Commit, latency);
+}
+
+void AbandonTransaction(SQLHDBC connection)
+{
+   std::lock_guard lock(profilerLock);
+   if (auto it = connections.find(connection); it != connections.end())
+   {
+      Close(connection, it->second, Completion::Abandoned, {});
+   }
+}
+
+void ForgetConnectionTransactions(SQLHDBC connection)
+{
+   std::lock_guard lock(profilerLock);
+   connections.erase(connection);
+}
+
+void LogTransactionReport()
+{
+   if (!TransactionProfilingEnabled())
+   {
+      return;
+   }
+
+   std::lock_guard lock(profilerLock);
+   uint64_t count = 0;
+   for (auto completion : totals.completions)
+   {
+      count += completion;
+   }
+   auto average = [](std::chrono::nanoseconds total, uint64_t n)
+   { return n > 0 ? Milliseconds(total) / static_cast<double>(n) : 0.0; };
+
+   std::string report = std::format("Transactions: {} ({} commit, {} rollback, {} implicit commit, {} abandoned), {} failed commit or rollback",
+                                    count, totals.completions[0], totals.completions[1], totals.completions[2], totals.completions[3], totals.failedEnds);
+   report += std::format("\n   average {:.3f} ms open, max {:.3f} ms, {:.1f}% of the open time spent in statements",
+                         average(totals.duration, count), Milliseconds(totals.maxDuration),
+                         totals.duration.count() > 0 ? 100.0 * static_cast<double>(totals.statementTime.count()) / static_cast<double>(totals.duration.count()) : 0.0);
+   report += std::format("\n   average {:.1f} statement(s) and {:.1f} row(s) per transaction, commit {:.3f} ms, rollback {:.3f} ms",
+                         count > 0 ? static_cast<double>(totals.statements) / static_cast<double>(count) : 0.0,
+                         count > 0 ? static_cast<double>(totals.rows) / static_cast<double>(count) : 0.0,
+                         average(totals.commitLatency, totals.completions[0]), average(totals.rollbackLatency, totals.completions[1]));
+   report += std::format("\n   {} statement(s) in autocommit mode, average {:.3f} ms", totals.autocommitStatements,
+                         average(totals.autocommitTime, totals.autocommitStatements));
+   if (!longest.empty())
+   {
+      report += "\n   longest:";
+      for (auto &summary : longest)
+      {
+         report += Describe(summary);
+      }
+      report += "\n   largest:";
+      for (auto &summary : largest)
+      {
+         report += Describe(summary);
+      }
+   }
+   std::print(LOG, "{}", report);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "Platform.h"
+#include "Routing.h"
+
+#include <chrono>
+#include <cstddef>
+
+// transactions of each connection, enabled with ODBCDETOUR_TRANSACTIONS=1
+//
+// with autocommit off a transaction starts at the first statement executed after the last commit or rollback. It
+// counts its statements, the rows they affected as reported by SQLRowCount and the time spent in them, the commit or
+// rollback latency is measured apart. Transactions open longer than ODBCDETOUR_LONG_TRANSACTION_MS (10 s by default)
+// are logged when they end, a summary with the longest and largest ones is logged when the last environment is freed.
+bool TransactionProfilingEnabled();
+
+// SQL_ATTR_AUTOCOMMIT set on a connection, switching it on commits the open transaction
+void SetAutocommit(SQLHDBC connection, bool on);
+
+// a statement executed on a connection, called for the execute class functions
+void RecordTransactionStatement(size_t function, const Route &route, std::chrono::nanoseconds duration, SQLRETURN result);
+
+// rows affected by the last execution of a statement
+void RecordRowCount(const Route &route, SQLLEN rows);
+
+void EndTransaction(SQLHDBC connection, SQLSMALLINT completionType, std::chrono::nanoseconds latency, SQLRETURN result);
+
+// the connection is closed with a transaction still open, the driver decides of its outcome
+void AbandonTransaction(SQLHDBC connection);
+
+// the connection handle is freed, its address may be reused by the next one
+void ForgetConnectionTransactions(SQLHDBC connection);
+
+void LogTransactionReport();
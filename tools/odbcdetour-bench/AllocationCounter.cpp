@@ -0,0 +1,125 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <string_view>
+
+namespace
+{
+thread_local uint64_t threadAllocations = 0;
+
+using MallocPtr = void *(__cdecl *)(size_t);
+using CallocPtr = void *(__cdecl *)(size_t, size_t);
+using ReallocPtr = void *(__cdecl *)(void *, size_t);
+using AlignedMallocPtr = void *(__cdecl *)(size_t, size_t);
+
+// the runtime the module imports from, the same for every patched module
+MallocPtr runtimeMalloc = nullptr;
+CallocPtr runtimeCalloc = nullptr;
+ReallocPtr runtimeRealloc = nullptr;
+AlignedMallocPtr runtimeAlignedMalloc = nullptr;
+
+void *__cdecl CountedMalloc(size_t size)
+{
+   ++threadAllocations;
+   return runtimeMalloc(size);
+}
+
+void *__cdecl CountedCalloc(size_t count, size_t size)
+{
+   ++threadAllocations;
+   return runtimeCalloc(count, size);
+}
+
+void *__cdecl CountedRealloc(void *block, size_t size)
+{
+   ++threadAllocations;
+   return runtimeRealloc(block, size);
+}
+
+void *__cdecl CountedAlignedMalloc(size_t size, size_t alignment)
+{
+   ++threadAllocations;
+   return runtimeAlignedMalloc(size, alignment);
+}
+
+// the universal runtime is imported through its api sets, older runtimes directly
+bool IsRuntime(std::string_view dll)
+{
+   auto startsWith = [dll](std::string_view prefix)
+   {
+      return dll.size() >= prefix.size() && _strnicmp(dll.data(), prefix.data(), prefix.size()) == 0;
+   };
+   return startsWith("api-ms-win-crt-heap") || startsWith("ucrtbase") || startsWith("msvcr");
+}
+
+template <typename Proc>
+bool Patch(ULONG_PTR &slot, Proc &original, Proc counted)
+{
+   DWORD protection = 0;
+   if (!VirtualProtect(&slot, sizeof(slot), PAGE_READWRITE, &protection))
+   {
+      return false;
+   }
+   if (original == nullptr)
+   {
+      original = reinterpret_cast<Proc>(slot);
+   }
+   slot = reinterpret_cast<ULONG_PTR>(counted);
+   VirtualProtect(&slot, sizeof(slot), protection, &protection);
+   return true;
+}
+} // namespace
+
+bool CountAllocations(HMODULE module)
+{
+   auto base = reinterpret_cast<const BYTE *>(module);
+   auto dos = reinterpret_cast<const IMAGE_DOS_HEADER *>(base);
+   auto nt = reinterpret_cast<const IMAGE_NT_HEADERS *>(base + dos->e_lfanew);
+   auto &directory = nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+   if (directory.VirtualAddress == 0)
+   {
+      return false;
+   }
+
+   bool patched = false;
+   for (auto import = reinterpret_cast<const IMAGE_IMPORT_DESCRIPTOR *>(base + directory.VirtualAddress); import->Name != 0; ++import)
+   {
+      if (!IsRuntime(reinterpret_cast<const char *>(base + import->Name)) || import->OriginalFirstThunk == 0)
+      {
+         continue;
+      }
+      auto names = reinterpret_cast<const IMAGE_THUNK_DATA *>(base + import->OriginalFirstThunk);
+      auto slots = reinterpret_cast<IMAGE_THUNK_DATA *>(const_cast<BYTE *>(base) + import->FirstThunk);
+      for (; names->u1.AddressOfData != 0; ++names, ++slots)
+      {
+         if (IMAGE_SNAP_BY_ORDINAL(names->u1.Ordinal))
+         {
+            continue;
+         }
+         std::string_view name = reinterpret_cast<const IMAGE_IMPORT_BY_NAME *>(base + names->u1.AddressOfData)->Name;
+         auto &slot = slots->u1.Function;
+         if (name == "malloc" || name == "_malloc_base")
+         {
+            patched |= Patch(slot, runtimeMalloc, &CountedMalloc);
+         }
+         else if (name == "calloc" || name == "_calloc_base")
+         {
+            patched |= Patch(slot, runtimeCalloc, &CountedCalloc);
+         }
+         else if (name == "realloc" || name == "_realloc_base")
+         {
+            patched |= Patch(slot, runtimeRealloc, &CountedRealloc);
+         }
+         else if (name == "_aligned_malloc")
+         {
+            patched |= Patch(slot, runtimeAlignedMalloc, &CountedAlignedMalloc);
+         }
+      }
+   }
+   return patched;
+}
+
+uint64_t ThreadAllocations()
+{
+   return threadAllocations;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <windows.h>
+
+#include <cstdint>
+
+// heap allocations made by a module, counted per thread
+//
+// the heap functions the module imports from the C runtime are patched in its import table, allocations made inside the
+// runtime itself are not seen. Returns false when the module imports none of them, ex: built with the static runtime.
+bool CountAllocations(HMODULE module);
+
+// allocations made by the patched modules on the calling thread
+uint64_t ThreadAllocations();
@@ -0,0 +1,243 @@
+#include "Cases.h"
+
+#include <algorithm>
+
+namespace
+{
+// clang-format off
+#define DETOUR_FUNCTIONS(X) \
+   X(ConfigDSN) X(ConfigDSNW) X(ConfigDriverW) X(SQLAllocConnect) X(SQLAllocEnv) X(SQLAllocHandle) X(SQLAllocStmt) \
+   X(SQLBindCol) X(SQLBindParameter) X(SQLBrowseConnectW) X(SQLBulkOperations) X(SQLCancel) X(SQLCancelHandle) \
+   X(SQLCloseCursor) X(SQLColAttributeW) X(SQLColumnPrivilegesW) X(SQLColumnsW) X(SQLCompleteAsync) X(SQLConnectW) \
+   X(SQLCopyDesc) X(SQLDescribeColW) X(SQLDescribeParam) X(SQLDisconnect) X(SQLDriverConnectW) X(SQLEndTran) \
+   X(SQLExecDirectW) X(SQLExecute) X(SQLExtendedFetch) X(SQLFetch) X(SQLFetchScroll) X(SQLFreeConnect) X(SQLFreeEnv) \
+   X(SQLFreeHandle) X(SQLFreeStmt) X(SQLGetConnectAttrW) X(SQLGetCursorNameW) X(SQLGetData) X(SQLGetDescFieldW) \
+   X(SQLGetDescRecW) X(SQLGetDiagFieldW) X(SQLGetDiagRecW) X(SQLGetEnvAttr) X(SQLGetFunctions) X(SQLGetInfoW) \
+   X(SQLGetStmtAttrW) X(SQLGetTypeInfoW) X(SQLMoreResults) X(SQLNativeSqlW) X(SQLNumParams) X(SQLNumResultCols) \
+   X(SQLParamData) X(SQLPrepareW) X(SQLPrimaryKeysW) X(SQLProcedureColumnsW) X(SQLProceduresW) X(SQLPutData) \
+   X(SQLRowCount) X(SQLSetConnectAttrW) X(SQLSetCursorNameW) X(SQLSetDescFieldW) X(SQLSetDescRec) X(SQLSetEnvAttr) \
+   X(SQLSetPos) X(SQLSetScrollOptions) X(SQLSetStmtAttrW) X(SQLSpecialColumnsW) X(SQLStatisticsW) \
+   X(SQLTablePrivilegesW) X(SQLTablesW)
+// clang-format on
+
+// entry points of the loaded detour, typed after their declaration in the odbc headers
+struct DetourApi
+{
+#define DECLARE_FUNCTION(name) decltype(&::name) name = nullptr;
+   DETOUR_FUNCTIONS(DECLARE_FUNCTION)
+#undef DECLARE_FUNCTION
+};
+
+DetourApi api;
+
+std::wstring connectionString;
+std::wstring dataSource;
+std::string installerAttributes;
+std::wstring installerAttributesW;
+
+// the calls take non const strings
+SQLWCHAR kSelect[] = L"select id, name from bench where id = ?";
+SQLWCHAR kTable[] = L"bench";
+SQLWCHAR kColumn[] = L"id";
+SQLWCHAR kCursor[] = L"bench_cursor";
+
+SQLSMALLINT Length(const std::wstring &text)
+{
+   return static_cast<SQLSMALLINT>(text.size());
+}
+
+// clang-format off
+const std::vector<BenchCase> kCases = {
+   {"ConfigDSN", 1, [](BenchHandles &) { api.ConfigDSN(nullptr, ODBC_CONFIG_DSN, "OdbcDetour", installerAttributes.c_str()); }},
+   {"ConfigDSNW", 1, [](BenchHandles &) { api.ConfigDSNW(nullptr, ODBC_CONFIG_DSN, L"OdbcDetour", installerAttributesW.c_str()); }},
+   {"SQLAllocConnect+SQLFreeConnect", 2, [](BenchHandles &h)
+    {
+       SQLHDBC connection = SQL_NULL_HANDLE;
+       api.SQLAllocConnect(h.environment, &connection);
+       api.SQLFreeConnect(connection);
+    }},
+   {"SQLAllocEnv+SQLFreeEnv", 2, [](BenchHandles &)
+    {
+       SQLHENV environment = SQL_NULL_HANDLE;
+       api.SQLAllocEnv(&environment);
+       api.SQLFreeEnv(environment);
+    }},
+   {"SQLAllocHandle+SQLFreeHandle", 2, [](BenchHandles &h)
+    {
+       SQLHSTMT statement = SQL_NULL_HANDLE;
+       api.SQLAllocHandle(SQL_HANDLE_STMT, h.connection, &statement);
+       api.SQLFreeHandle(SQL_HANDLE_STMT, statement);
+    }},
+   {"SQLAllocStmt+SQLFreeStmt", 2, [](BenchHandles &h)
+    {
+       SQLHSTMT statement = SQL_NULL_HANDLE;
+       api.SQLAllocStmt(h.connection, &statement);
+       api.SQLFreeStmt(statement, SQL_DROP);
+    }},
+   {"SQLBindCol", 1, [](BenchHandles &h) { api.SQLBindCol(h.statement, 1, SQL_C_LONG, &h.value, sizeof(h.value), &h.indicator); }},
+   {"SQLBindParameter", 1, [](BenchHandles &h) { api.SQLBindParameter(h.statement, 1, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 10, 0, &h.value, sizeof(h.value), &h.indicator); }},
+   {"SQLBrowseConnectW+SQLDisconnect", 2, [](BenchHandles &h)
+    {
+       api.SQLBrowseConnectW(h.reconnected, connectionString.data(), Length(connectionString), h.text, static_cast<SQLSMALLINT>(std::size(h.text)), &h.smallLength);
+       api.SQLDisconnect(h.reconnected);
+    }},
+   {"SQLBulkOperations", 1, [](BenchHandles &h) { api.SQLBulkOperations(h.statement, SQL_ADD); }},
+   {"SQLCancel", 1, [](BenchHandles &h) { api.SQLCancel(h.statement); }},
+   {"SQLCancelHandle", 1, [](BenchHandles &h) { api.SQLCancelHandle(SQL_HANDLE_STMT, h.statement); }},
+   {"SQLCloseCursor", 1, [](BenchHandles &h) { api.SQLCloseCursor(h.statement); }},
+   {"SQLColAttributeW", 1, [](BenchHandles &h) { api.SQLColAttributeW(h.statement, 1, SQL_DESC_NAME, h.text, sizeof(h.text), &h.smallLength, &h.number); }},
+   {"SQLColumnPrivilegesW", 1, [](BenchHandles &h) { api.SQLColumnPrivilegesW(h.statement, nullptr, 0, nullptr, 0, kTable, SQL_NTS, kColumn, SQL_NTS); }},
+   {"SQLColumnsW", 1, [](BenchHandles &h) { api.SQLColumnsW(h.statement, nullptr, 0, nullptr, 0, kTable, SQL_NTS, nullptr, 0); }},
+   {"SQLCompleteAsync", 1, [](BenchHandles &h) { api.SQLCompleteAsync(SQL_HANDLE_STMT, h.statement, &h.smallValue); }},
+   {"SQLCopyDesc", 1, [](BenchHandles &h) { api.SQLCopyDesc(h.descriptor, h.copy); }},
+   {"SQLDescribeColW", 1, [](BenchHandles &h) { api.SQLDescribeColW(h.statement, 1, h.text, static_cast<SQLSMALLINT>(std::size(h.text)), &h.smallLength, &h.smallValue, &h.size, &h.smallValue, &h.smallValue); }},
+   {"SQLDescribeParam", 1, [](BenchHandles &h) { api.SQLDescribeParam(h.statement, 1, &h.smallValue, &h.size, &h.smallValue, &h.smallValue); }},
+   {"SQLDriverConnectW+SQLDisconnect", 2, [](BenchHandles &h)
+    {
+       api.SQLDriverConnectW(h.reconnected, nullptr, connectionString.data(), Length(connectionString), h.text, static_cast<SQLSMALLINT>(std::size(h.text)), &h.smallLength, SQL_DRIVER_NOPROMPT);
+       api.SQLDisconnect(h.reconnected);
+    }},
+   {"SQLEndTran", 1, [](BenchHandles &h) { api.SQLEndTran(SQL_HANDLE_DBC, h.connection, SQL_COMMIT); }},
+   {"SQLExecDirectW", 1, [](BenchHandles &h) { api.SQLExecDirectW(h.statement, kSelect, SQL_NTS); }},
+   {"SQLExecute", 1, [](BenchHandles &h) { api.SQLExecute(h.statement); }},
+   {"SQLExtendedFetch", 1, [](BenchHandles &h) { api.SQLExtendedFetch(h.statement, SQL_FETCH_NEXT, 0, &h.size, &h.status); }},
+   {"SQLFetch", 1, [](BenchHandles &h) { api.SQLFetch(h.statement); }},
+   {"SQLFetchScroll", 1, [](BenchHandles &h) { api.SQLFetchScroll(h.statement, SQL_FETCH_NEXT, 0); }},
+   {"SQLFreeStmt", 1, [](BenchHandles &h) { api.SQLFreeStmt(h.statement, SQL_CLOSE); }},
+   {"SQLGetConnectAttrW", 1, [](BenchHandles &h) { api.SQLGetConnectAttrW(h.connection, SQL_ATTR_AUTOCOMMIT, &h.size, sizeof(h.size), &h.length); }},
+   {"SQLGetCursorNameW", 1, [](BenchHandles &h) { api.SQLGetCursorNameW(h.statement, h.text, static_cast<SQLSMALLINT>(std::size(h.text)), &h.smallLength); }},
+   {"SQLGetData", 1, [](BenchHandles &h) { api.SQLGetData(h.statement, 1, SQL_C_LONG, &h.value, sizeof(h.value), &h.indicator); }},
+   {"SQLGetDescFieldW", 1, [](BenchHandles &h) { api.SQLGetDescFieldW(h.descriptor, 0, SQL_DESC_COUNT, &h.smallValue, sizeof(h.smallValue), &h.length); }},
+   {"SQLGetDescRecW", 1, [](BenchHandles &h) { api.SQLGetDescRecW(h.descriptor, 1, h.text, static_cast<SQLSMALLINT>(std::size(h.text)), &h.smallLength, &h.smallValue, &h.smallValue, &h.number, &h.smallValue, &h.smallValue, &h.smallValue); }},
+   {"SQLGetDiagFieldW", 1, [](BenchHandles &h) { api.SQLGetDiagFieldW(SQL_HANDLE_STMT, h.statement, 0, SQL_DIAG_NUMBER, &h.length, sizeof(h.length), &h.smallLength); }},
+   {"SQLGetDiagRecW", 1, [](BenchHandles &h) { api.SQLGetDiagRecW(SQL_HANDLE_STMT, h.statement, 1, h.text, &h.length, h.text + 8, static_cast<SQLSMALLINT>(std::size(h.text) - 8), &h.smallLength); }},
+   {"SQLGetEnvAttr", 1, [](BenchHandles &h) { api.SQLGetEnvAttr(h.environment, SQL_ATTR_ODBC_VERSION, &h.length, sizeof(h.length), nullptr); }},
+   {"SQLGetFunctions", 1, [](BenchHandles &h) { api.SQLGetFunctions(h.connection, SQL_API_SQLFETCHSCROLL, &h.status); }},
+   {"SQLGetInfoW", 1, [](BenchHandles &h) { api.SQLGetInfoW(h.connection, SQL_DBMS_NAME, h.text, sizeof(h.text), &h.smallLength); }},
+   {"SQLGetStmtAttrW", 1, [](BenchHandles &h) { api.SQLGetStmtAttrW(h.statement, SQL_ATTR_ROW_ARRAY_SIZE, &h.size, sizeof(h.size), &h.length); }},
+   {"SQLGetTypeInfoW", 1, [](BenchHandles &h) { api.SQLGetTypeInfoW(h.statement, SQL_ALL_TYPES); }},
+   {"SQLMoreResults", 1, [](BenchHandles &h) { api.SQLMoreResults(h.statement); }},
+   {"SQLNativeSqlW", 1, [](BenchHandles &h) { api.SQLNativeSqlW(h.connection, kSelect, SQL_NTS, h.text, static_cast<SQLINTEGER>(std::size(h.text)), &h.length); }},
+   {"SQLNumParams", 1, [](BenchHandles &h) { api.SQLNumParams(h.statement, &h.smallValue); }},
+   {"SQLNumResultCols", 1, [](BenchHandles &h) { api.SQLNumResultCols(h.statement, &h.smallValue); }},
+   {"SQLParamData", 1, [](BenchHandles &h)
+    {
+       SQLPOINTER value = nullptr;
+       api.SQLParamData(h.statement, &value);
+    }},
+   {"SQLPrepareW", 1, [](BenchHandles &h) { api.SQLPrepareW(h.statement, kSelect, SQL_NTS); }},
+   {"SQLPrimaryKeysW", 1, [](BenchHandles &h) { api.SQLPrimaryKeysW(h.statement, nullptr, 0, nullptr, 0, kTable, SQL_NTS); }},
+   {"SQLProcedureColumnsW", 1, [](BenchHandles &h) { api.SQLProcedureColumnsW(h.statement, nullptr, 0, nullptr, 0, kTable, SQL_NTS, nullptr, 0); }},
+   {"SQLProceduresW", 1, [](BenchHandles &h) { api.SQLProceduresW(h.statement, nullptr, 0, nullptr, 0, kTable, SQL_NTS); }},
+   {"SQLPutData", 1, [](BenchHandles &h) { api.SQLPutData(h.statement, &h.value, sizeof(h.value)); }},
+   {"SQLRowCount", 1, [](BenchHandles &h) { api.SQLRowCount(h.statement, &h.number); }},
+   {"SQLSetConnectAttrW", 1, [](BenchHandles &h) { api.SQLSetConnectAttrW(h.connection, SQL_ATTR_AUTOCOMMIT, reinterpret_cast<SQLPOINTER>(SQL_AUTOCOMMIT_ON), SQL_IS_UINTEGER); }},
+   {"SQLSetCursorNameW", 1, [](BenchHandles &h) { api.SQLSetCursorNameW(h.statement, kCursor, SQL_NTS); }},
+   {"SQLSetDescFieldW", 1, [](BenchHandles &h) { api.SQLSetDescFieldW(h.descriptor, 0, SQL_DESC_ARRAY_SIZE, reinterpret_cast<SQLPOINTER>(1), SQL_IS_UINTEGER); }},
+   {"SQLSetDescRec", 1, [](BenchHandles &h) { api.SQLSetDescRec(h.descriptor, 1, SQL_C_LONG, 0, sizeof(h.value), 0, 0, &h.value, &h.indicator, &h.indicator); }},
+   {"SQLSetEnvAttr", 1, [](BenchHandles &h) { api.SQLSetEnvAttr(h.environment, SQL_ATTR_ODBC_VERSION, reinterpret_cast<SQLPOINTER>(SQL_OV_ODBC3), SQL_IS_INTEGER); }},
+   {"SQLSetPos", 1, [](BenchHandles &h) { api.SQLSetPos(h.statement, 1, SQL_POSITION, SQL_LOCK_NO_CHANGE); }},
+   {"SQLSetScrollOptions", 1, [](BenchHandles &h) { api.SQLSetScrollOptions(h.statement, SQL_CONCUR_READ_ONLY, SQL_SCROLL_FORWARD_ONLY, 1); }},
+   {"SQLSetStmtAttrW", 1, [](BenchHandles &h) { api.SQLSetStmtAttrW(h.statement, SQL_ATTR_QUERY_TIMEOUT, reinterpret_cast<SQLPOINTER>(0), SQL_IS_UINTEGER); }},
+   {"SQLSpecialColumnsW", 1, [](BenchHandles &h) { api.SQLSpecialColumnsW(h.statement, SQL_BEST_ROWID, nullptr, 0, nullptr, 0, kTable, SQL_NTS, SQL_SCOPE_CURROW, SQL_NULLABLE); }},
+   {"SQLStatisticsW", 1, [](BenchHandles &h) { api.SQLStatisticsW(h.statement, nullptr, 0, nullptr, 0, kTable, SQL_NTS, SQL_INDEX_ALL, SQL_QUICK); }},
+   {"SQLTablePrivilegesW", 1, [](BenchHandles &h) { api.SQLTablePrivilegesW(h.statement, nullptr, 0, nullptr, 0, kTable, SQL_NTS); }},
+   {"SQLTablesW", 1, [](BenchHandles &h) { api.SQLTablesW(h.statement, nullptr, 0, nullptr, 0, kTable, SQL_NTS, nullptr, 0); }},
+};
+// clang-format on
+
+const BenchCase kConnect = {"SQLConnectW+SQLDisconnect", 2, [](BenchHandles &h)
+                            {
+                               api.SQLConnectW(h.reconnected, dataSource.data(), Length(dataSource), nullptr, 0, nullptr, 0);
+                               api.SQLDisconnect(h.reconnected);
+                            }};
+} // namespace
+
+bool LoadDetour(HMODULE detour)
+{
+   bool complete = true;
+#define RESOLVE_FUNCTION(name)                                                          \
+   api.name = reinterpret_cast<decltype(api.name)>(GetProcAddress(detour, #name)); \
+   complete = complete && api.name != nullptr;
+   DETOUR_FUNCTIONS(RESOLVE_FUNCTION)
+#undef RESOLVE_FUNCTION
+   return complete;
+}
+
+void SetTarget(const std::wstring &driverPath, const std::wstring &dsn)
+{
+   connectionString = L"TargetDriver={" + driverPath + L"};";
+   dataSource = dsn;
+
+   // installer attributes are "key=value" strings ended by an empty one
+   installerAttributesW = L"TargetDriver=" + driverPath;
+   installerAttributesW.push_back(L'\0');
+   installerAttributes.clear();
+   for (auto c : installerAttributesW)
+   {
+      // the narrow installer entry point is only benchmarked, the path is assumed ascii
+      installerAttributes.push_back(static_cast<char>(c));
+   }
+}
+
+std::vector<BenchCase> BenchCases()
+{
+   auto cases = kCases;
+   if (!dataSource.empty())
+   {
+      cases.push_back(kConnect);
+      std::ranges::sort(cases, {}, &BenchCase::name);
+   }
+   return cases;
+}
+
+std::vector<SkippedFunction> SkippedFunctions()
+{
+   std::vector<SkippedFunction> skipped = {{"ConfigDriverW", "always forwarded to the default driver, not to the stub"}};
+   if (dataSource.empty())
+   {
+      skipped.push_back({"SQLConnectW", "needs --dsn, a data source whose TargetDriver is the stub driver"});
+   }
+   return skipped;
+}
+
+bool OpenShared(BenchHandles &shared)
+{
+   if (!SQL_SUCCEEDED(api.SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &shared.environment)))
+   {
+      return false;
+   }
+   api.SQLSetEnvAttr(shared.environment, SQL_ATTR_ODBC_VERSION, reinterpret_cast<SQLPOINTER>(SQL_OV_ODBC3), SQL_IS_INTEGER);
+   if (!SQL_SUCCEEDED(api.SQLAllocHandle(SQL_HANDLE_DBC, shared.environment, &shared.connection)))
+   {
+      return false;
+   }
+   return SQL_SUCCEEDED(api.SQLDriverConnectW(shared.connection, nullptr, connectionString.data(), Length(connectionString), nullptr, 0, nullptr, SQL_DRIVER_NOPROMPT));
+}
+
+void CloseShared(BenchHandles &shared)
+{
+   api.SQLDisconnect(shared.connection);
+   api.SQLFreeHandle(SQL_HANDLE_DBC, shared.connection);
+   api.SQLFreeHandle(SQL_HANDLE_ENV, shared.environment);
+}
+
+bool OpenThread(const BenchHandles &shared, BenchHandles &handles)
+{
+   handles.environment = shared.environment;
+   handles.connection = shared.connection;
+   return SQL_SUCCEEDED(api.SQLAllocHandle(SQL_HANDLE_STMT, handles.connection, &handles.statement)) &&
+          SQL_SUCCEEDED(api.SQLAllocHandle(SQL_HANDLE_DESC, handles.connection, &handles.descriptor)) &&
+          SQL_SUCCEEDED(api.SQLAllocHandle(SQL_HANDLE_DESC, handles.connection, &handles.copy)) &&
+          SQL_SUCCEEDED(api.SQLAllocHandle(SQL_HANDLE_DBC, handles.environment, &handles.reconnected)) &&
+          // SQLExecute runs the prepared statement
+          SQL_SUCCEEDED(api.SQLPrepareW(handles.statement, kSelect, SQL_NTS));
+}
+
+void CloseThread(BenchHandles &handles)
+{
+   api.SQLFreeHandle(SQL_HANDLE_DBC, handles.reconnected);
+   api.SQLFreeHandle(SQL_HANDLE_DESC, handles.copy);
+   api.SQLFreeHandle(SQL_HANDLE_DESC, handles.descriptor);
+   api.SQLFreeHandle(SQL_HANDLE_STMT, handles.statement);
+}
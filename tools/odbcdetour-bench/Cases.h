@@ -0,0 +1,66 @@
+#pragma once
+// clang-format off
+#include <windows.h>
+#include <sql.h>
+#include <sqlext.h>
+#include <odbcinst.h>
+// clang-format on
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// handles a benchmark thread calls the detour with, the environment and the connection are shared by the threads
+struct BenchHandles
+{
+   SQLHENV environment = SQL_NULL_HANDLE;
+   SQLHDBC connection = SQL_NULL_HANDLE;
+   SQLHSTMT statement = SQL_NULL_HANDLE;
+   SQLHDESC descriptor = SQL_NULL_HANDLE;
+   SQLHDESC copy = SQL_NULL_HANDLE;
+   // connected and disconnected by the connection benchmarks
+   SQLHDBC reconnected = SQL_NULL_HANDLE;
+
+   // buffers bound and filled by the calls
+   SQLINTEGER value = 0;
+   SQLLEN indicator = 0;
+   SQLULEN size = 0;
+   SQLSMALLINT smallValue = 0;
+   SQLSMALLINT smallLength = 0;
+   SQLINTEGER length = 0;
+   SQLLEN number = 0;
+   SQLUSMALLINT status = 0;
+   SQLWCHAR text[128] = {};
+};
+
+// one benchmark, an entry point or a pair of entry points that must be called together ex: SQLAllocStmt+SQLFreeStmt
+struct BenchCase
+{
+   // entry points called, joined by '+'
+   std::string_view name;
+   unsigned calls;
+   void (*run)(BenchHandles &);
+};
+
+struct SkippedFunction
+{
+   std::string_view name;
+   std::string_view reason;
+};
+
+// resolve the entry points exported by the detour, false when one is missing
+bool LoadDetour(HMODULE detour);
+
+// the detour is pointed at the stub driver by the connection string, SQLConnectW needs a data source naming it in ODBC.INI
+void SetTarget(const std::wstring &driverPath, const std::wstring &dsn);
+
+std::vector<BenchCase> BenchCases();
+std::vector<SkippedFunction> SkippedFunctions();
+
+// environment and connection shared by the threads
+bool OpenShared(BenchHandles &shared);
+void CloseShared(BenchHandles &shared);
+
+// handles of one thread, allocated on the shared connection
+bool OpenThread(const BenchHandles &shared, BenchHandles &handles);
+void CloseThread(BenchHandles &handles);
@@ -0,0 +1,472 @@
+// no-op ODBC driver the benchmarks forward to, what they measure is the cost of the detour alone
+//
+// every handle is a distinct fake value the driver never dereferences, every call succeeds at once. Result sets never
+// end, SQLFetch always returns a row, and there is never a diagnostic.
+// clang-format off
+#include <windows.h>
+#include <sql.h>
+#include <sqlext.h>
+#include <odbcinst.h>
+// clang-format on
+
+#include <atomic>
+#include <cstdint>
+
+namespace
+{
+std::atomic<uintptr_t> nextHandle{0x10000};
+
+SQLHANDLE NewHandle()
+{
+   return reinterpret_cast<SQLHANDLE>(nextHandle.fetch_add(0x10, std::memory_order_relaxed));
+}
+
+// empty string in an output buffer, the detour may log it. Lengths are in bytes or in characters depending on the call
+template <typename Length>
+void EmptyString(SQLTCHAR *buffer, SQLLEN bufferLength, Length *length)
+{
+   if (buffer != nullptr && bufferLength >= static_cast<SQLLEN>(sizeof(SQLTCHAR)))
+   {
+      buffer[0] = 0;
+   }
+   if (length != nullptr)
+   {
+      *length = 0;
+   }
+}
+} // namespace
+
+BOOL INSTAPI ConfigDriverW(HWND, WORD, LPCWSTR, LPCWSTR, LPWSTR lpszMsg, WORD cbMsgMax, WORD *pcbMsgOut)
+{
+   if (lpszMsg != nullptr && cbMsgMax > 0)
+   {
+      lpszMsg[0] = 0;
+   }
+   if (pcbMsgOut != nullptr)
+   {
+      *pcbMsgOut = 0;
+   }
+   return TRUE;
+}
+
+BOOL INSTAPI ConfigDSN(HWND, WORD, LPCSTR, LPCSTR)
+{
+   return TRUE;
+}
+
+BOOL INSTAPI ConfigDSNW(HWND, WORD, LPCWSTR, LPCWSTR)
+{
+   return TRUE;
+}
+
+SQLRETURN SQL_API SQLAllocConnect(SQLHENV, SQLHDBC *connection_handle)
+{
+   *connection_handle = NewHandle();
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLAllocEnv(SQLHENV *environment_handle)
+{
+   *environment_handle = NewHandle();
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLAllocHandle(SQLSMALLINT, SQLHANDLE, SQLHANDLE *outputHandle)
+{
+   *outputHandle = NewHandle();
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLAllocStmt(SQLHDBC, SQLHSTMT *statement_handle)
+{
+   *statement_handle = NewHandle();
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLBindCol(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT, SQLPOINTER, SQLLEN, SQLLEN *)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLBindParameter(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT, SQLSMALLINT, SQLSMALLINT, SQLULEN, SQLSMALLINT, SQLPOINTER, SQLLEN, SQLLEN *)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLBrowseConnectW(HDBC, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *szConnStrOut, SQLSMALLINT cbConnStrOutMax, SQLSMALLINT *pcbConnStrOut)
+{
+   EmptyString(szConnStrOut, cbConnStrOutMax, pcbConnStrOut);
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLBulkOperations(SQLHSTMT, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLCancel(SQLHSTMT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLCancelHandle(SQLSMALLINT, SQLHANDLE)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLCloseCursor(HSTMT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLColAttributeW(SQLHSTMT, SQLUSMALLINT, SQLUSMALLINT, SQLPOINTER out_string_value, SQLSMALLINT out_string_value_max_size, SQLSMALLINT *out_string_value_size, SQLLEN *out_num_value)
+{
+   EmptyString(static_cast<SQLTCHAR *>(out_string_value), out_string_value_max_size, out_string_value_size);
+   if (out_num_value != nullptr)
+   {
+      *out_num_value = 0;
+   }
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLColumnPrivilegesW(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLColumnsW(SQLHSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLCompleteAsync(SQLSMALLINT, SQLHANDLE, RETCODE *AsyncRetCodePtr)
+{
+   *AsyncRetCodePtr = SQL_SUCCESS;
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLConnectW(SQLHDBC, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLCopyDesc(SQLHDESC, SQLHDESC)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLDescribeColW(HSTMT, SQLUSMALLINT, SQLTCHAR *out_column_name, SQLSMALLINT out_column_name_max_size, SQLSMALLINT *out_column_name_size, SQLSMALLINT *out_type, SQLULEN *out_column_size, SQLSMALLINT *out_decimal_digits,
+                                  SQLSMALLINT *out_is_nullable)
+{
+   EmptyString(out_column_name, out_column_name_max_size, out_column_name_size);
+   if (out_type != nullptr)
+   {
+      *out_type = SQL_INTEGER;
+   }
+   if (out_column_size != nullptr)
+   {
+      *out_column_size = 10;
+   }
+   if (out_decimal_digits != nullptr)
+   {
+      *out_decimal_digits = 0;
+   }
+   if (out_is_nullable != nullptr)
+   {
+      *out_is_nullable = SQL_NULLABLE;
+   }
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLDescribeParam(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT *DataTypePtr, SQLULEN *ParameterSizePtr, SQLSMALLINT *DecimalDigitsPtr, SQLSMALLINT *NullablePtr)
+{
+   if (DataTypePtr != nullptr)
+   {
+      *DataTypePtr = SQL_INTEGER;
+   }
+   if (ParameterSizePtr != nullptr)
+   {
+      *ParameterSizePtr = 10;
+   }
+   if (DecimalDigitsPtr != nullptr)
+   {
+      *DecimalDigitsPtr = 0;
+   }
+   if (NullablePtr != nullptr)
+   {
+      *NullablePtr = SQL_NULLABLE;
+   }
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLDisconnect(HDBC)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLDriverConnectW(SQLHDBC, SQLHWND, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *OutConnectionString, SQLSMALLINT BufferLength, SQLSMALLINT *StringLength2Ptr, SQLUSMALLINT)
+{
+   EmptyString(OutConnectionString, BufferLength, StringLength2Ptr);
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLEndTran(SQLSMALLINT, SQLHANDLE, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLExecDirectW(HSTMT, SQLTCHAR *, SQLINTEGER)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLExecute(HSTMT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLExtendedFetch(SQLHSTMT, SQLUSMALLINT, SQLLEN, SQLULEN *RowCountPtr, SQLUSMALLINT *RowStatusArray)
+{
+   if (RowCountPtr != nullptr)
+   {
+      *RowCountPtr = 1;
+   }
+   if (RowStatusArray != nullptr)
+   {
+      RowStatusArray[0] = SQL_ROW_SUCCESS;
+   }
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLFetch(SQLHSTMT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLFetchScroll(SQLHSTMT, SQLSMALLINT, SQLLEN)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLFreeConnect(SQLHDBC)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLFreeEnv(SQLHENV)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLFreeHandle(SQLSMALLINT, SQLHANDLE)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLFreeStmt(HSTMT, SQLUSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLGetConnectAttrW(SQLHSTMT, SQLINTEGER, SQLPOINTER, SQLINTEGER, SQLINTEGER *outValueLength)
+{
+   if (outValueLength != nullptr)
+   {
+      *outValueLength = 0;
+   }
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLGetCursorNameW(HSTMT, SQLTCHAR *CursorName, SQLSMALLINT BufferLength, SQLSMALLINT *NameLength)
+{
+   EmptyString(CursorName, BufferLength, NameLength);
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLGetData(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT, SQLPOINTER, SQLLEN, SQLLEN *StrLen_or_IndPtr)
+{
+   if (StrLen_or_IndPtr != nullptr)
+   {
+      *StrLen_or_IndPtr = SQL_NULL_DATA;
+   }
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLGetDescFieldW(SQLHDESC, SQLSMALLINT, SQLSMALLINT, SQLPOINTER, SQLINTEGER, SQLINTEGER *StringLengthPtr)
+{
+   if (StringLengthPtr != nullptr)
+   {
+      *StringLengthPtr = 0;
+   }
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLGetDescRecW(SQLHDESC, SQLSMALLINT, SQLTCHAR *Name, SQLSMALLINT BufferLength, SQLSMALLINT *StringLengthPtr, SQLSMALLINT *, SQLSMALLINT *, SQLLEN *, SQLSMALLINT *, SQLSMALLINT *, SQLSMALLINT *)
+{
+   EmptyString(Name, BufferLength, StringLengthPtr);
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLGetDiagFieldW(SQLSMALLINT, SQLHANDLE, SQLSMALLINT, SQLSMALLINT, SQLPOINTER, SQLSMALLINT, SQLSMALLINT *)
+{
+   return SQL_NO_DATA;
+}
+
+SQLRETURN SQL_API SQLGetDiagRecW(SQLSMALLINT, SQLHANDLE, SQLSMALLINT, SQLTCHAR *, SQLINTEGER *, SQLTCHAR *, SQLSMALLINT, SQLSMALLINT *)
+{
+   return SQL_NO_DATA;
+}
+
+SQLRETURN SQL_API SQLGetEnvAttr(SQLHSTMT, SQLINTEGER, SQLPOINTER, SQLINTEGER, SQLINTEGER *outValueLength)
+{
+   if (outValueLength != nullptr)
+   {
+      *outValueLength = 0;
+   }
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLGetFunctions(HDBC, SQLUSMALLINT, SQLUSMALLINT *Supported)
+{
+   *Supported = SQL_TRUE;
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLGetInfoW(SQLHDBC, SQLUSMALLINT, SQLPOINTER outValue, SQLSMALLINT outValueMaxLength, SQLSMALLINT *outValueLength1)
+{
+   EmptyString(static_cast<SQLTCHAR *>(outValue), outValueMaxLength, outValueLength1);
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLGetStmtAttrW(SQLHSTMT, SQLINTEGER, SQLPOINTER, SQLINTEGER, SQLINTEGER *outValueLength)
+{
+   if (outValueLength != nullptr)
+   {
+      *outValueLength = 0;
+   }
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLGetTypeInfoW(SQLHSTMT, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLMoreResults(HSTMT)
+{
+   return SQL_NO_DATA;
+}
+
+SQLRETURN SQL_API SQLNativeSqlW(HDBC, SQLTCHAR *, SQLINTEGER, SQLTCHAR *out_query, SQLINTEGER out_query_max_length, SQLINTEGER *out_query_length)
+{
+   EmptyString(out_query, out_query_max_length, out_query_length);
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLNumParams(SQLHSTMT, SQLSMALLINT *ParameterCountPtr)
+{
+   *ParameterCountPtr = 1;
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLNumResultCols(SQLHSTMT, SQLSMALLINT *ColumnCountPtr)
+{
+   *ColumnCountPtr = 1;
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLParamData(HSTMT, PTR *)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLPrepareW(HSTMT, SQLTCHAR *, SQLINTEGER)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLPrimaryKeysW(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLProcedureColumnsW(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLProceduresW(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLPutData(HSTMT, PTR, SQLLEN)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLRowCount(HSTMT, SQLLEN *out_row_count)
+{
+   *out_row_count = 0;
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLSetConnectAttrW(SQLHDBC, SQLINTEGER, SQLPOINTER, SQLINTEGER)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLSetCursorNameW(HSTMT, SQLTCHAR *, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLSetDescFieldW(SQLHDESC, SQLSMALLINT, SQLSMALLINT, SQLPOINTER, SQLINTEGER)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLSetDescRec(SQLHDESC, SQLSMALLINT, SQLSMALLINT, SQLSMALLINT, SQLLEN, SQLSMALLINT, SQLSMALLINT, SQLPOINTER, SQLLEN *, SQLLEN *)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLSetEnvAttr(SQLHENV, SQLINTEGER, SQLPOINTER, SQLINTEGER)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLSetPos(HSTMT, SQLSETPOSIROW, SQLUSMALLINT, SQLUSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLSetScrollOptions(HSTMT, SQLUSMALLINT, SQLLEN, SQLUSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLSetStmtAttrW(SQLHSTMT, SQLINTEGER, SQLPOINTER, SQLINTEGER)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLSpecialColumnsW(HSTMT, SQLUSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLUSMALLINT, SQLUSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLStatisticsW(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLUSMALLINT, SQLUSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLTablePrivilegesW(HSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API SQLTablesW(SQLHSTMT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT, SQLTCHAR *, SQLSMALLINT)
+{
+   return SQL_SUCCESS;
+}
@@ -0,0 +1,441 @@
+// cost of the detour per call, every entry point is called through the detour loaded against a no-op driver
+//
+// usage: odbcdetour-bench [--iterations <n>] [--threads <n,n,..>] [--logging <off,filtered,text,async>] [--dsn <name>]
+//                         [--detour <OdbcDetour.dll>] [--driver <OdbcDetourStubDriver.dll>] [--output <file.json>]
+//
+// each logging configuration runs in its own process, the detour reads its settings once. The results are written as
+// json, to stdout by default.
+#include "AllocationCounter.h"
+#include "Cases.h"
+#include "OdbcFunctions.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <latch>
+#include <optional>
+#include <ostream>
+#include <print>
+#include <ranges>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifndef ODBCDETOUR_BENCH_DETOUR
+#define ODBCDETOUR_BENCH_DETOUR "OdbcDetour.dll"
+#endif
+#ifndef ODBCDETOUR_BENCH_DRIVER
+#define ODBCDETOUR_BENCH_DRIVER "OdbcDetourStubDriver.dll"
+#endif
+
+namespace
+{
+struct LoggingConfiguration
+{
+   std::string_view name;
+   bool logFile;
+   bool slowCalls;
+   bool traceEvents;
+};
+
+constexpr LoggingConfiguration kLoggingConfigurations[] = {
+    // no home directory to log to, the lines are still formatted then discarded
+    {"off", false, false, false},
+    // no log file, the slow call capture checks every call against a threshold none reaches
+    {"filtered", false, true, false},
+    // the log file, and every call written to the trace events file by the calling thread
+    {"text", true, false, true},
+    // the log file only, written by its writer thread
+    {"async", true, false, false},
+};
+
+struct Options
+{
+   uint64_t iterations = 10000;
+   std::vector<unsigned> threads = {1, 2, 4, 8, 16, 32, 64};
+   std::vector<std::string> logging = {"off", "filtered", "text", "async"};
+   std::filesystem::path detour = ODBCDETOUR_BENCH_DETOUR;
+   std::filesystem::path driver = ODBCDETOUR_BENCH_DRIVER;
+   std::wstring dsn;
+   std::filesystem::path output;
+   // set in the process running one logging configuration
+   std::string run;
+};
+
+struct Measurement
+{
+   // mean of the threads
+   double nanosecondsPerCall = 0;
+   double slowestNanosecondsPerCall = 0;
+   double callsPerSecond = 0;
+   double allocationsPerCall = 0;
+};
+
+std::vector<std::string> Split(std::string_view list, char delimiter)
+{
+   std::vector<std::string> items;
+   for (auto item : std::views::split(list, delimiter))
+   {
+      if (!item.empty())
+      {
+         items.emplace_back(item.begin(), item.end());
+      }
+   }
+   return items;
+}
+
+std::optional<Options> ParseOptions(int argc, char *argv[])
+{
+   Options options;
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string_view name = argv[i];
+      if (i + 1 >= argc)
+      {
+         return std::nullopt;
+      }
+      std::string_view value = argv[++i];
+      if (name == "--iterations")
+      {
+         if (std::from_chars(value.data(), value.data() + value.size(), options.iterations).ec != std::errc{} || options.iterations == 0)
+         {
+            return std::nullopt;
+         }
+      }
+      else if (name == "--threads")
+      {
+         options.threads.clear();
+         for (auto &item : Split(value, ','))
+         {
+            unsigned count = 0;
+            if (std::from_chars(item.data(), item.data() + item.size(), count).ec != std::errc{} || count == 0)
+            {
+               return std::nullopt;
+            }
+            options.threads.push_back(count);
+         }
+      }
+      else if (name == "--logging")
+      {
+         options.logging = Split(value, ',');
+      }
+      else if (name == "--detour")
+      {
+         options.detour = value;
+      }
+      else if (name == "--driver")
+      {
+         options.driver = value;
+      }
+      else if (name == "--dsn")
+      {
+         options.dsn = std::filesystem::path(value).wstring();
+      }
+      else if (name == "--output")
+      {
+         options.output = value;
+      }
+      else if (name == "--run")
+      {
+         options.run = value;
+      }
+      else
+      {
+         return std::nullopt;
+      }
+   }
+   if (options.threads.empty() || options.logging.empty())
+   {
+      return std::nullopt;
+   }
+   for (auto &logging : options.logging)
+   {
+      if (std::ranges::find(kLoggingConfigurations, logging, &LoggingConfiguration::name) == std::end(kLoggingConfigurations))
+      {
+         return std::nullopt;
+      }
+   }
+   return options;
+}
+
+std::string JsonString(std::string_view text)
+{
+   std::string result = "\"";
+   for (auto c : text)
+   {
+      if (c == '"' || c == '\\')
+      {
+         result += '\\';
+         result += c;
+      }
+      else if (static_cast<unsigned char>(c) < 0x20)
+      {
+         result += std::format("\\u{:04x}", static_cast<int>(c));
+      }
+      else
+      {
+         result += c;
+      }
+   }
+   return result + '"';
+}
+
+Measurement Measure(const BenchCase &benchCase, std::span<BenchHandles> handles, uint64_t iterations)
+{
+   struct ThreadResult
+   {
+      std::chrono::nanoseconds elapsed;
+      uint64_t allocations;
+   };
+   std::vector<ThreadResult> results(handles.size());
+   std::latch start(static_cast<std::ptrdiff_t>(handles.size()));
+   {
+      std::vector<std::jthread> threads;
+      for (size_t t = 0; t < handles.size(); ++t)
+      {
+         threads.emplace_back([&, t]
+                              {
+                                 auto &thread = handles[t];
+                                 // lazily initialized state is not measured
+                                 for (uint64_t i = 0; i < iterations / 10 + 1; ++i)
+                                 {
+                                    benchCase.run(thread);
+                                 }
+                                 start.arrive_and_wait();
+                                 auto allocations = ThreadAllocations();
+                                 auto begin = std::chrono::steady_clock::now();
+                                 for (uint64_t i = 0; i < iterations; ++i)
+                                 {
+                                    benchCase.run(thread);
+                                 }
+                                 results[t] = {std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin), ThreadAllocations() - allocations}; });
+      }
+   }
+
+   Measurement measurement;
+   auto callsPerThread = static_cast<double>(iterations * benchCase.calls);
+   std::chrono::nanoseconds slowest{};
+   uint64_t allocations = 0;
+   for (auto &result : results)
+   {
+      measurement.nanosecondsPerCall += static_cast<double>(result.elapsed.count()) / callsPerThread;
+      slowest = std::max(slowest, result.elapsed);
+      allocations += result.allocations;
+   }
+   auto calls = callsPerThread * static_cast<double>(results.size());
+   measurement.nanosecondsPerCall /= static_cast<double>(results.size());
+   measurement.slowestNanosecondsPerCall = static_cast<double>(slowest.count()) / callsPerThread;
+   measurement.callsPerSecond = slowest.count() > 0 ? calls * 1e9 / static_cast<double>(slowest.count()) : 0.0;
+   measurement.allocationsPerCall = static_cast<double>(allocations) / calls;
+   return measurement;
+}
+
+// runs every case under the logging configuration set in the environment, the result is one json object
+int RunConfiguration(const Options &options)
+{
+   auto detour = LoadLibraryW(options.detour.c_str());
+   if (detour == nullptr)
+   {
+      std::println(stderr, "cannot load the detour {}", options.detour.string());
+      return 1;
+   }
+   auto counted = CountAllocations(detour);
+   if (!LoadDetour(detour))
+   {
+      std::println(stderr, "{} does not export every odbc entry point", options.detour.string());
+      return 1;
+   }
+   SetTarget(std::filesystem::absolute(options.driver).wstring(), options.dsn);
+
+   BenchHandles shared;
+   if (!OpenShared(shared))
+   {
+      std::println(stderr, "cannot connect through the detour to {}", options.driver.string());
+      return 1;
+   }
+   std::vector<BenchHandles> handles(std::ranges::max(options.threads));
+   for (auto &thread : handles)
+   {
+      if (!OpenThread(shared, thread))
+      {
+         std::println(stderr, "cannot allocate the statements of the benchmark threads");
+         return 1;
+      }
+   }
+
+   auto cases = BenchCases();
+   auto skipped = SkippedFunctions();
+
+   // every entry point of the detour is measured or reported as skipped
+   for (auto function : kOdbcFunctionNames)
+   {
+      auto covered = std::ranges::any_of(cases, [function](const BenchCase &benchCase)
+                                         { return std::ranges::count(Split(benchCase.name, '+'), function) > 0; }) ||
+                     std::ranges::count(skipped, function, &SkippedFunction::name) > 0;
+      if (!covered)
+      {
+         std::println(stderr, "{} is not benchmarked", function);
+      }
+   }
+
+   std::ostringstream json;
+   std::print(json, "{{\"logging\": {}, \"allocations_counted\": {}, \"results\": [", JsonString(options.run), counted);
+   bool first = true;
+   for (auto &benchCase : cases)
+   {
+      for (auto threads : options.threads)
+      {
+         std::println(stderr, "{} {} x {}", options.run, benchCase.name, threads);
+         auto measurement = Measure(benchCase, std::span(handles).first(threads), options.iterations);
+         std::print(json, "{}\n    {{\"case\": {}, \"functions\": [", first ? "" : ",", JsonString(benchCase.name));
+         first = false;
+         auto functions = Split(benchCase.name, '+');
+         for (size_t i = 0; i < functions.size(); ++i)
+         {
+            std::print(json, "{}{}", i == 0 ? "" : ", ", JsonString(functions[i]));
+         }
+         std::print(json, "], \"threads\": {}, \"iterations\": {}, \"calls_per_iteration\": {}, \"ns_per_call\": {:.1f}, \"slowest_thread_ns_per_call\": {:.1f}, \"calls_per_second\": {:.0f}, \"allocations_per_call\": ",
+                    threads, options.iterations, benchCase.calls, measurement.nanosecondsPerCall, measurement.slowestNanosecondsPerCall, measurement.callsPerSecond);
+         if (counted)
+         {
+            std::print(json, "{:.2f}}}", measurement.allocationsPerCall);
+         }
+         else
+         {
+            std::print(json, "null}}");
+         }
+      }
+   }
+   std::print(json, "\n  ], \"skipped\": [");
+   for (size_t i = 0; i < skipped.size(); ++i)
+   {
+      std::print(json, "{}{{\"function\": {}, \"reason\": {}}}", i == 0 ? "" : ", ", JsonString(skipped[i].name), JsonString(skipped[i].reason));
+   }
+   std::print(json, "]}}");
+
+   for (auto &thread : handles)
+   {
+      CloseThread(thread);
+   }
+   CloseShared(shared);
+
+   std::ofstream output(options.output, std::ios::binary);
+   output << json.str();
+   return output ? 0 : 1;
+}
+
+void SetVariable(const wchar_t *name, const std::optional<std::wstring> &value)
+{
+   SetEnvironmentVariableW(name, value ? value->c_str() : nullptr);
+}
+
+// run a logging configuration in a child process, it inherits the environment it is configured by
+std::optional<std::string> SpawnConfiguration(const Options &options, const LoggingConfiguration &logging, const std::filesystem::path &directory)
+{
+   auto logDirectory = directory / logging.name;
+   std::error_code error;
+   std::filesystem::create_directories(logDirectory, error);
+
+   // the log file is in the home directory
+   SetVariable(L"HOMEPATH", logging.logFile ? std::optional(logDirectory.wstring()) : std::nullopt);
+   SetVariable(L"ODBCDETOUR_SLOW_CALL_MS", logging.slowCalls ? std::optional<std::wstring>(L"60000") : std::nullopt);
+   SetVariable(L"ODBCDETOUR_TRACE_EVENTS", logging.traceEvents ? std::optional((logDirectory / "trace.json").wstring()) : std::nullopt);
+   // bounded disk usage, a benchmark logs millions of calls
+   SetVariable(L"ODBCDETOUR_LOG_MAX_MB", L"64");
+   SetVariable(L"ODBCDETOUR_LOG_KEEP", L"1");
+
+   wchar_t module[MAX_PATH];
+   GetModuleFileNameW(nullptr, module, MAX_PATH);
+   std::wstring self = module;
+   auto result = directory / std::format("{}.json", logging.name);
+   std::wstring threads;
+   for (auto count : options.threads)
+   {
+      threads += std::format(L"{}{}", threads.empty() ? L"" : L",", count);
+   }
+   auto commandLine = std::format(LR"("{}" --run {} --iterations {} --threads {} --detour "{}" --driver "{}" --output "{}")", self,
+                                  std::filesystem::path(logging.name).wstring(), options.iterations, threads, std::filesystem::absolute(options.detour).wstring(),
+                                  std::filesystem::absolute(options.driver).wstring(), result.wstring());
+   if (!options.dsn.empty())
+   {
+      commandLine += std::format(LR"( --dsn "{}")", options.dsn);
+   }
+
+   STARTUPINFOW startup{sizeof(startup)};
+   PROCESS_INFORMATION process{};
+   if (!CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, &process))
+   {
+      std::println(stderr, "cannot start the benchmark of logging {}", logging.name);
+      return std::nullopt;
+   }
+   WaitForSingleObject(process.hProcess, INFINITE);
+   DWORD exitCode = 1;
+   GetExitCodeProcess(process.hProcess, &exitCode);
+   CloseHandle(process.hThread);
+   CloseHandle(process.hProcess);
+   if (exitCode != 0)
+   {
+      return std::nullopt;
+   }
+
+   std::ifstream input(result, std::ios::binary);
+   std::ostringstream content;
+   content << input.rdbuf();
+   return content.str();
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+   auto options = ParseOptions(argc, argv);
+   if (!options)
+   {
+      std::println(stderr, "usage: odbcdetour-bench [--iterations <n>] [--threads <n,n,..>] [--logging <off,filtered,text,async>] [--dsn <name>]");
+      std::println(stderr, "                        [--detour <OdbcDetour.dll>] [--driver <OdbcDetourStubDriver.dll>] [--output <file.json>]");
+      return 1;
+   }
+   if (!options->run.empty())
+   {
+      return RunConfiguration(*options);
+   }
+
+   auto directory = std::filesystem::temp_directory_path() / std::format("odbcdetour-bench-{}", GetCurrentProcessId());
+   std::vector<std::string> configurations;
+   for (auto &name : options->logging)
+   {
+      auto logging = std::ranges::find(kLoggingConfigurations, name, &LoggingConfiguration::name);
+      auto result = SpawnConfiguration(*options, *logging, directory);
+      if (!result)
+      {
+         return 1;
+      }
+      configurations.push_back(std::move(*result));
+   }
+   std::error_code error;
+   std::filesystem::remove_all(directory, error);
+
+   std::ostringstream json;
+   std::print(json, "{{\n  \"detour\": {},\n  \"driver\": {},\n  \"hardware_threads\": {},\n  \"configurations\": [", JsonString(std::filesystem::absolute(options->detour).string()),
+              JsonString(std::filesystem::absolute(options->driver).string()), std::thread::hardware_concurrency());
+   for (size_t i = 0; i < configurations.size(); ++i)
+   {
+      std::print(json, "{}\n  {}", i == 0 ? "" : ",", configurations[i]);
+   }
+   std::println(json, "\n  ]\n}}");
+
+   if (options->output.empty())
+   {
+      std::print("{}", json.str());
+      return 0;
+   }
+   std::ofstream output(options->output, std::ios::binary);
+   output << json.str();
+   return output ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+#include "TraceProfile.h"
+#include "SqlFingerprint.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <optional>
+#include <print>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+// statements produced by the driver, their fetches are grouped under the function
+constexpr std::string_view kCatalogFunctions[] = {
+    "SQLColumnPrivilegesW", "SQLColumnsW", "SQLForeignKeysW", "SQLGetTypeInfoW", "SQLPrimaryKeysW", "SQLProcedureColumnsW",
+    "SQLProceduresW", "SQLSpecialColumnsW", "SQLStatisticsW", "SQLTablePrivilegesW", "SQLTablesW",
+};
+
+// longest statement text kept for the report
+constexpr size_t kStatementLength = 200;
+
+size_t BucketIndex(uint64_t nanoseconds)
+{
+   if (nanoseconds < 8)
+   {
+      return static_cast<size_t>(nanoseconds);
+   }
+   auto octave = static_cast<size_t>(std::bit_width(nanoseconds) - 1);
+   return (octave - 2) * 8 + static_cast<size_t>((nanoseconds >> (octave - 3)) & 7);
+}
+
+// middle of a bucket
+uint64_t BucketValue(size_t index)
+{
+   if (index < 8)
+   {
+      return index;
+   }
+   auto octave = index / 8 + 2;
+   auto width = uint64_t{1} << (octave - 3);
+   return (8 + index % 8) * width + width / 2;
+}
+
+// raw text of a string field, or the token of a number, escapes are left in. The pattern is the quoted key and its
+// colon, it cannot match inside a string value where quotes are escaped.
+std::optional<std::string_view> Field(std::string_view line, std::string_view pattern)
+{
+   auto position = line.find(pattern);
+   if (position == std::string_view::npos)
+   {
+      return std::nullopt;
+   }
+   auto value = line.substr(position + pattern.size());
+   if (value.starts_with('"'))
+   {
+      for (size_t i = 1; i < value.size(); ++i)
+      {
+         if (value[i] == '\\')
+         {
+            ++i;
+         }
+         else if (value[i] == '"')
+         {
+            return value.substr(1, i - 1);
+         }
+      }
+      return std::nullopt;
+   }
+   return value.substr(0, value.find_first_of(",}"));
+}
+
+std::string Unescape(std::string_view text)
+{
+   std::string result;
+   result.reserve(text.size());
+   for (size_t i = 0; i < text.size(); ++i)
+   {
+      if (text[i] != '\\' || i + 1 == text.size())
+      {
+         result += text[i];
+         continue;
+      }
+      switch (text[++i])
+      {
+      case 'n':
+         result += '\n';
+         break;
+      case 'r':
+         result += '\r';
+         break;
+      case 't':
+         result += '\t';
+         break;
+      case 'u':
+      {
+         // only control characters are written as \u
+         unsigned value = 0;
+         if (i + 4 < text.size() && std::from_chars(text.data() + i + 1, text.data() + i + 5, value, 16).ec == std::errc{})
+         {
+            result += static_cast<char>(value);
+         }
+         i += 4;
+         break;
+      }
+      default:
+         result += text[i];
+         break;
+      }
+   }
+   return result;
+}
+
+class TraceReader
+{
+ public:
+   explicit TraceReader(TraceProfile &profile) : m_profile(profile)
+   {
+   }
+
+   void Read(std::string_view line)
+   {
+      // only complete events are calls, the async slices repeat them on the handle tracks
+      auto phase = Field(line, R"("ph":)");
+      auto name = Field(line, R"("name":)");
+      auto duration = Field(line, R"("dur":)");
+      double microseconds = 0;
+      if (!phase || *phase != "X" || !name || !duration ||
+          std::from_chars(duration->data(), duration->data() + duration->size(), microseconds).ec != std::errc{})
+      {
+         ++m_profile.skippedLines;
+         return;
+      }
+      auto latency = std::chrono::nanoseconds(std::llround(microseconds * 1000));
+      auto handle = Field(line, R"("handle":)").value_or("");
+
+      auto fingerprint = StatementOf(*name, handle, line);
+      auto &stats = m_profile.calls[{std::string(*name), fingerprint}];
+      stats.latencies.Add(latency);
+      stats.total += latency;
+      auto rc = Field(line, R"("rc":)");
+      if (rc && (*rc == "SQL_ERROR" || *rc == "SQL_INVALID_HANDLE"))
+      {
+         ++stats.errors;
+      }
+      ++m_profile.callCount;
+      m_profile.total += latency;
+
+      if (*name == "SQLFreeHandle")
+      {
+         m_statements.erase(std::string(handle));
+      }
+   }
+
+ private:
+   // fingerprint of the statement the call belongs to, updated by the calls that start a statement
+   uint64_t StatementOf(std::string_view function, std::string_view handle, std::string_view line)
+   {
+      std::optional<std::string> text;
+      if (auto sql = Field(line, R"("sql":)"); sql)
+      {
+         text = Unescape(*sql);
+      }
+      else if (std::ranges::find(kCatalogFunctions, function) != std::end(kCatalogFunctions))
+      {
+         text = std::string(function);
+      }
+      if (text)
+      {
+         auto fingerprint = SqlFingerprint(*text);
+         if (!m_profile.statements.contains(fingerprint))
+         {
+            m_profile.statements.emplace(fingerprint, NormalizeSql(*text).substr(0, kStatementLength));
+         }
+         if (!handle.empty())
+         {
+            m_statements[std::string(handle)] = fingerprint;
+         }
+         return fingerprint;
+      }
+      auto statement = m_statements.find(std::string(handle));
+      return statement != m_statements.end() ? statement->second : 0;
+   }
+
+   TraceProfile &m_profile;
+   // statement of each open handle
+   std::unordered_map<std::string, uint64_t> m_statements;
+};
+} // namespace
+
+void LatencyHistogram::Add(std::chrono::nanoseconds latency)
+{
+   ++m_buckets[BucketIndex(static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0)))];
+   ++m_count;
+}
+
+std::chrono::nanoseconds LatencyHistogram::Percentile(double fraction) const
+{
+   if (m_count == 0)
+   {
+      return {};
+   }
+   auto rank = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(m_count)));
+   uint64_t seen = 0;
+   for (size_t i = 0; i < kBucketCount; ++i)
+   {
+      seen += m_buckets[i];
+      if (seen >= std::max<uint64_t>(rank, 1))
+      {
+         return std::chrono::nanoseconds(BucketValue(i));
+      }
+   }
+   return std::chrono::nanoseconds(BucketValue(kBucketCount - 1));
+}
+
+bool ReadTrace(const std::filesystem::path &path, TraceProfile &profile)
+{
+   std::ifstream input(path, std::ios::binary);
+   if (!input)
+   {
+      std::println(stderr, "cannot open {}", path.string());
+      return false;
+   }
+   TraceReader reader(profile);
+   std::string line;
+   while (std::getline(input, line))
+   {
+      reader.Read(line);
+   }
+   return !input.bad();
+}
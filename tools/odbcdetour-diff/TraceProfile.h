@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <utility>
+
+// latencies counted in log spaced buckets, 8 per power of 2 so a bucket is at most 12.5% wide
+class LatencyHistogram
+{
+ public:
+   static constexpr size_t kBucketCount = 496;
+
+   void Add(std::chrono::nanoseconds latency);
+
+   // latency below which the fraction of the calls falls, the middle of its bucket
+   std::chrono::nanoseconds Percentile(double fraction) const;
+
+   uint64_t Count() const
+   {
+      return m_count;
+   }
+
+   uint64_t Bucket(size_t index) const
+   {
+      return m_buckets[index];
+   }
+
+ private:
+   std::array<uint64_t, kBucketCount> m_buckets{};
+   uint64_t m_count = 0;
+};
+
+struct CallStats
+{
+   uint64_t errors = 0;
+   std::chrono::nanoseconds total{};
+   LatencyHistogram latencies;
+};
+
+// calls of a trace grouped by function and by fingerprint of the statement of their handle, 0 when there is none
+//
+// catalog functions start a statement of their own, fingerprinted from the function name.
+struct TraceProfile
+{
+   std::map<std::pair<std::string, uint64_t>, CallStats> calls;
+   // normalized text of each fingerprint
+   std::map<uint64_t, std::string> statements;
+   uint64_t callCount = 0;
+   std::chrono::nanoseconds total{};
+   // lines that are not a call
+   uint64_t skippedLines = 0;
+};
+
+// reads a file written with ODBCDETOUR_TRACE_EVENTS, one line at a time: memory grows with the number of distinct
+// calls and open handles, not with the size of the trace. Returns false when the file cannot be read.
+bool ReadTrace(const std::filesystem::path &path, TraceProfile &profile);
@@ -0,0 +1,262 @@
+// latency and call count changes between two traces of the detour
+//
+// usage: odbcdetour-diff <baseline trace> <candidate trace> [--top <n>] [--min-calls <n>] [--all]
+//
+// the traces are the files written with ODBCDETOUR_TRACE_EVENTS. Calls are aligned by function and statement
+// fingerprint, the latency distributions of each pair are compared with a Mann-Whitney U test on the histograms.
+#include "TraceProfile.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <format>
+#include <optional>
+#include <print>
+#include <ranges>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+// |z| of a two sided p value of 0.001
+constexpr double kSignificantZ = 3.29;
+// smallest shift of the probability that a candidate call is slower than a baseline one, below it a significant
+// change is too small to report
+constexpr double kSignificantEffect = 0.05;
+// relative change of the number of calls reported
+constexpr double kSignificantCallChange = 0.10;
+// longest statement text in a report line
+constexpr size_t kStatementWidth = 80;
+
+struct Options
+{
+   std::string baseline;
+   std::string candidate;
+   size_t top = 40;
+   uint64_t minCalls = 20;
+   // also list the pairs without a change
+   bool all = false;
+};
+
+struct Comparison
+{
+   const std::string *function;
+   uint64_t fingerprint;
+   const CallStats *baseline;
+   const CallStats *candidate;
+   std::string_view change;
+   double z = 0;
+   // probability that a candidate call is slower than a baseline one, 0.5 when they are alike
+   double slower = 0.5;
+
+   std::chrono::nanoseconds Impact() const
+   {
+      return (candidate != nullptr ? candidate->total : std::chrono::nanoseconds{}) - (baseline != nullptr ? baseline->total : std::chrono::nanoseconds{});
+   }
+};
+
+std::optional<Options> ParseOptions(int argc, char *argv[])
+{
+   Options options;
+   std::vector<std::string_view> traces;
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string_view argument = argv[i];
+      if (argument == "--all")
+      {
+         options.all = true;
+      }
+      else if (argument == "--top" || argument == "--min-calls")
+      {
+         if (i + 1 >= argc)
+         {
+            return std::nullopt;
+         }
+         std::string_view value = argv[++i];
+         uint64_t number = 0;
+         if (std::from_chars(value.data(), value.data() + value.size(), number).ec != std::errc{})
+         {
+            return std::nullopt;
+         }
+         (argument == "--top" ? options.top : options.minCalls) = number;
+      }
+      else
+      {
+         traces.push_back(argument);
+      }
+   }
+   if (traces.size() != 2)
+   {
+      return std::nullopt;
+   }
+   options.baseline = traces[0];
+   options.candidate = traces[1];
+   return options;
+}
+
+// Mann-Whitney U test of the candidate against the baseline, the calls of a bucket are ties
+void Compare(const LatencyHistogram &baseline, const LatencyHistogram &candidate, double &z, double &slower)
+{
+   auto baselineCount = static_cast<double>(baseline.Count());
+   auto candidateCount = static_cast<double>(candidate.Count());
+   auto count = baselineCount + candidateCount;
+   double u = 0;
+   double ties = 0;
+   double baselineBelow = 0;
+   for (size_t i = 0; i < LatencyHistogram::kBucketCount; ++i)
+   {
+      auto inBaseline = static_cast<double>(baseline.Bucket(i));
+      auto inCandidate = static_cast<double>(candidate.Bucket(i));
+      u += inCandidate * (baselineBelow + inBaseline / 2);
+      auto tied = inBaseline + inCandidate;
+      ties += tied * tied * tied - tied;
+      baselineBelow += inBaseline;
+   }
+   auto pairs = baselineCount * candidateCount;
+   auto variance = pairs / 12 * ((count + 1) - ties / (count * (count - 1)));
+   slower = u / pairs;
+   z = variance > 0 ? (u - pairs / 2) / std::sqrt(variance) : 0;
+}
+
+std::vector<Comparison> CompareProfiles(const TraceProfile &baseline, const TraceProfile &candidate, const Options &options)
+{
+   std::set<std::pair<std::string, uint64_t>> keys;
+   for (auto &[key, stats] : baseline.calls)
+   {
+      keys.insert(key);
+   }
+   for (auto &[key, stats] : candidate.calls)
+   {
+      keys.insert(key);
+   }
+
+   std::vector<Comparison> comparisons;
+   for (auto &key : keys)
+   {
+      auto before = baseline.calls.find(key);
+      auto after = candidate.calls.find(key);
+      Comparison comparison{&key.first, key.second, before != baseline.calls.end() ? &before->second : nullptr, after != candidate.calls.end() ? &after->second : nullptr, ""};
+      if (comparison.baseline == nullptr)
+      {
+         comparison.change = "new";
+      }
+      else if (comparison.candidate == nullptr)
+      {
+         comparison.change = "vanished";
+      }
+      else
+      {
+         auto &latenciesBefore = comparison.baseline->latencies;
+         auto &latenciesAfter = comparison.candidate->latencies;
+         if (latenciesBefore.Count() >= options.minCalls && latenciesAfter.Count() >= options.minCalls)
+         {
+            Compare(latenciesBefore, latenciesAfter, comparison.z, comparison.slower);
+            if (std::abs(comparison.z) >= kSignificantZ && std::abs(comparison.slower - 0.5) >= kSignificantEffect)
+            {
+               comparison.change = comparison.z > 0 ? "slower" : "faster";
+            }
+         }
+         auto callsBefore = static_cast<double>(latenciesBefore.Count());
+         auto callsAfter = static_cast<double>(latenciesAfter.Count());
+         if (comparison.change.empty() && std::abs(callsAfter - callsBefore) > kSignificantCallChange * callsBefore)
+         {
+            comparison.change = callsAfter > callsBefore ? "more calls" : "fewer calls";
+         }
+      }
+      if (!comparison.change.empty() || options.all)
+      {
+         comparisons.push_back(comparison);
+      }
+   }
+   // the changes that cost or save the most time first
+   std::ranges::sort(comparisons, [](const Comparison &left, const Comparison &right)
+                     { return std::chrono::abs(left.Impact()) > std::chrono::abs(right.Impact()); });
+   return comparisons;
+}
+
+double Milliseconds(std::chrono::nanoseconds duration)
+{
+   return static_cast<double>(duration.count()) / 1e6;
+}
+
+std::string Calls(const CallStats *stats)
+{
+   return stats != nullptr ? std::to_string(stats->latencies.Count()) : "-";
+}
+
+std::string Percentile(const CallStats *stats, double fraction)
+{
+   return stats != nullptr ? std::format("{:.3f}", Milliseconds(stats->latencies.Percentile(fraction))) : "-";
+}
+
+std::string Statement(const TraceProfile &baseline, const TraceProfile &candidate, uint64_t fingerprint)
+{
+   if (fingerprint == 0)
+   {
+      return "";
+   }
+   std::string text;
+   if (auto statement = baseline.statements.find(fingerprint); statement != baseline.statements.end())
+   {
+      text = statement->second;
+   }
+   else if (statement = candidate.statements.find(fingerprint); statement != candidate.statements.end())
+   {
+      text = statement->second;
+   }
+   std::ranges::replace_if(text, [](char c)
+                           { return c == '\n' || c == '\r' || c == '\t'; }, ' ');
+   if (text.size() > kStatementWidth)
+   {
+      text = text.substr(0, kStatementWidth - 3) + "...";
+   }
+   return std::format("{:016x} {}", fingerprint, text);
+}
+
+void PrintProfile(std::string_view label, const std::string &path, const TraceProfile &profile)
+{
+   std::println("{:<10} {}: {} calls, {:.3f} s in the driver", label, path, profile.callCount, Milliseconds(profile.total) / 1000);
+}
+
+void PrintComparisons(const TraceProfile &baseline, const TraceProfile &candidate, const std::vector<Comparison> &comparisons, size_t top)
+{
+   std::println("{:<12} {:<22} {:>21} {:>19} {:>19} {:>12} {:>7} {}", "change", "function", "calls", "p50 ms", "p99 ms", "impact ms", "z", "statement");
+   for (auto &comparison : comparisons | std::views::take(top))
+   {
+      std::println("{:<12} {:<22} {:>21} {:>19} {:>19} {:>+12.3f} {:>7.1f} {}", comparison.change, *comparison.function,
+                   std::format("{} -> {}", Calls(comparison.baseline), Calls(comparison.candidate)),
+                   std::format("{} -> {}", Percentile(comparison.baseline, 0.5), Percentile(comparison.candidate, 0.5)),
+                   std::format("{} -> {}", Percentile(comparison.baseline, 0.99), Percentile(comparison.candidate, 0.99)), Milliseconds(comparison.Impact()),
+                   comparison.z, Statement(baseline, candidate, comparison.fingerprint));
+   }
+   if (comparisons.size() > top)
+   {
+      std::println("{} more, see --top", comparisons.size() - top);
+   }
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+   auto options = ParseOptions(argc, argv);
+   if (!options)
+   {
+      std::println(stderr, "usage: odbcdetour-diff <baseline trace> <candidate trace> [--top <n>] [--min-calls <n>] [--all]");
+      return 1;
+   }
+
+   TraceProfile baseline;
+   TraceProfile candidate;
+   if (!ReadTrace(options->baseline, baseline) || !ReadTrace(options->candidate, candidate))
+   {
+      return 1;
+   }
+   PrintProfile("baseline", options->baseline, baseline);
+   PrintProfile("candidate", options->candidate, candidate);
+   std::println("");
+   PrintComparisons(baseline, candidate, CompareProfiles(baseline, candidate, *options), options->top);
+   return 0;
+}
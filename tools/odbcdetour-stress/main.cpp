@@ -0,0 +1,235 @@
+// environments allocated and freed by many threads at once through the detour loaded against the stub driver, the
+// driver is loaded by the first environment connecting and unloaded with the last one freed
+//
+// usage: odbcdetour-stress [--threads <n>] [--iterations <n>] [--detour <OdbcDetour.dll>] [--driver <OdbcDetourStubDriver.dll>]
+//
+// every iteration of a thread allocates an environment, every other one also connects it to the stub driver and uses a
+// statement before freeing it all. Any call failing is counted, the exit code is 1 when one did.
+// clang-format off
+#include <windows.h>
+#include <sql.h>
+#include <sqlext.h>
+// clang-format on
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <latch>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifndef ODBCDETOUR_STRESS_DETOUR
+#define ODBCDETOUR_STRESS_DETOUR "OdbcDetour.dll"
+#endif
+#ifndef ODBCDETOUR_STRESS_DRIVER
+#define ODBCDETOUR_STRESS_DRIVER "OdbcDetourStubDriver.dll"
+#endif
+
+namespace
+{
+struct Options
+{
+   unsigned threads = 32;
+   uint64_t iterations = 2000;
+   std::filesystem::path detour = ODBCDETOUR_STRESS_DETOUR;
+   std::filesystem::path driver = ODBCDETOUR_STRESS_DRIVER;
+};
+
+// entry points of the loaded detour, typed after their declaration in the odbc headers
+struct DetourApi
+{
+   decltype(&::SQLAllocHandle) SQLAllocHandle = nullptr;
+   decltype(&::SQLFreeHandle) SQLFreeHandle = nullptr;
+   decltype(&::SQLSetEnvAttr) SQLSetEnvAttr = nullptr;
+   decltype(&::SQLDriverConnectW) SQLDriverConnectW = nullptr;
+   decltype(&::SQLDisconnect) SQLDisconnect = nullptr;
+};
+
+// calls counted, in the order of an iteration
+enum Step
+{
+   AllocEnvironment,
+   SetVersion,
+   AllocConnection,
+   Connect,
+   AllocStatement,
+   FreeStatement,
+   Disconnect,
+   FreeConnection,
+   FreeEnvironment,
+   StepCount
+};
+
+constexpr std::array<std::string_view, StepCount> kStepNames = {
+    "SQLAllocHandle(SQL_HANDLE_ENV)", "SQLSetEnvAttr", "SQLAllocHandle(SQL_HANDLE_DBC)", "SQLDriverConnectW", "SQLAllocHandle(SQL_HANDLE_STMT)",
+    "SQLFreeHandle(SQL_HANDLE_STMT)", "SQLDisconnect", "SQLFreeHandle(SQL_HANDLE_DBC)", "SQLFreeHandle(SQL_HANDLE_ENV)"};
+
+struct Counters
+{
+   std::array<std::atomic<uint64_t>, StepCount> calls{};
+   std::array<std::atomic<uint64_t>, StepCount> failures{};
+};
+
+std::optional<Options> ParseOptions(int argc, char *argv[])
+{
+   Options options;
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string_view name = argv[i];
+      if (i + 1 >= argc)
+      {
+         return std::nullopt;
+      }
+      std::string_view value = argv[++i];
+      if (name == "--threads")
+      {
+         if (std::from_chars(value.data(), value.data() + value.size(), options.threads).ec != std::errc{} || options.threads == 0)
+         {
+            return std::nullopt;
+         }
+      }
+      else if (name == "--iterations")
+      {
+         if (std::from_chars(value.data(), value.data() + value.size(), options.iterations).ec != std::errc{} || options.iterations == 0)
+         {
+            return std::nullopt;
+         }
+      }
+      else if (name == "--detour")
+      {
+         options.detour = value;
+      }
+      else if (name == "--driver")
+      {
+         options.driver = value;
+      }
+      else
+      {
+         return std::nullopt;
+      }
+   }
+   return options;
+}
+
+template <typename Function>
+bool Resolve(HMODULE detour, const char *name, Function &function)
+{
+   function = reinterpret_cast<Function>(GetProcAddress(detour, name));
+   return function != nullptr;
+}
+
+bool Count(Counters &counters, Step step, SQLRETURN result)
+{
+   counters.calls[step].fetch_add(1, std::memory_order_relaxed);
+   if (!SQL_SUCCEEDED(result))
+   {
+      counters.failures[step].fetch_add(1, std::memory_order_relaxed);
+      return false;
+   }
+   return true;
+}
+
+// connected to the stub and a statement allocated and freed, a failed step skips the ones depending on it
+void UseConnection(const DetourApi &api, Counters &counters, SQLHENV environment, std::wstring &connectionString)
+{
+   SQLHDBC connection = SQL_NULL_HANDLE;
+   if (!Count(counters, AllocConnection, api.SQLAllocHandle(SQL_HANDLE_DBC, environment, &connection)))
+   {
+      return;
+   }
+   if (Count(counters, Connect, api.SQLDriverConnectW(connection, nullptr, connectionString.data(), static_cast<SQLSMALLINT>(connectionString.size()), nullptr, 0, nullptr, SQL_DRIVER_NOPROMPT)))
+   {
+      SQLHSTMT statement = SQL_NULL_HANDLE;
+      if (Count(counters, AllocStatement, api.SQLAllocHandle(SQL_HANDLE_STMT, connection, &statement)))
+      {
+         Count(counters, FreeStatement, api.SQLFreeHandle(SQL_HANDLE_STMT, statement));
+      }
+      Count(counters, Disconnect, api.SQLDisconnect(connection));
+   }
+   Count(counters, FreeConnection, api.SQLFreeHandle(SQL_HANDLE_DBC, connection));
+}
+
+void RunThread(const DetourApi &api, Counters &counters, std::wstring connectionString, unsigned thread, uint64_t iterations)
+{
+   for (uint64_t i = 0; i < iterations; ++i)
+   {
+      SQLHENV environment = SQL_NULL_HANDLE;
+      if (!Count(counters, AllocEnvironment, api.SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &environment)))
+      {
+         continue;
+      }
+      Count(counters, SetVersion, api.SQLSetEnvAttr(environment, SQL_ATTR_ODBC_VERSION, reinterpret_cast<SQLPOINTER>(SQL_OV_ODBC3), SQL_IS_INTEGER));
+      // threads alternate, some environments free the driver while others use it
+      if ((i + thread) % 2 == 0)
+      {
+         UseConnection(api, counters, environment, connectionString);
+      }
+      Count(counters, FreeEnvironment, api.SQLFreeHandle(SQL_HANDLE_ENV, environment));
+   }
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+   auto options = ParseOptions(argc, argv);
+   if (!options)
+   {
+      std::println(stderr, "usage: odbcdetour-stress [--threads <n>] [--iterations <n>] [--detour <OdbcDetour.dll>] [--driver <OdbcDetourStubDriver.dll>]");
+      return 1;
+   }
+
+   auto detour = LoadLibraryW(options->detour.c_str());
+   if (detour == nullptr)
+   {
+      std::println(stderr, "cannot load the detour {}", options->detour.string());
+      return 1;
+   }
+   DetourApi api;
+   if (!Resolve(detour, "SQLAllocHandle", api.SQLAllocHandle) || !Resolve(detour, "SQLFreeHandle", api.SQLFreeHandle) ||
+       !Resolve(detour, "SQLSetEnvAttr", api.SQLSetEnvAttr) || !Resolve(detour, "SQLDriverConnectW", api.SQLDriverConnectW) ||
+       !Resolve(detour, "SQLDisconnect", api.SQLDisconnect))
+   {
+      std::println(stderr, "{} does not export the odbc entry points", options->detour.string());
+      return 1;
+   }
+   auto connectionString = L"TargetDriver={" + std::filesystem::absolute(options->driver).wstring() + L"};";
+
+   Counters counters;
+   auto begin = std::chrono::steady_clock::now();
+   {
+      std::latch start(static_cast<std::ptrdiff_t>(options->threads));
+      std::vector<std::jthread> threads;
+      for (unsigned t = 0; t < options->threads; ++t)
+      {
+         threads.emplace_back([&, t]
+                              {
+                                 start.arrive_and_wait();
+                                 RunThread(api, counters, connectionString, t, options->iterations); });
+      }
+   }
+   auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+
+   uint64_t failures = 0;
+   for (size_t step = 0; step < StepCount; ++step)
+   {
+      auto failed = counters.failures[step].load();
+      std::println("{:<32} {:>10} calls {:>8} failed", kStepNames[step], counters.calls[step].load(), failed);
+      failures += failed;
+   }
+   // every environment freed, the detour still loads the driver
+   Counters last;
+   RunThread(api, last, connectionString, 0, 1);
+   for (size_t step = 0; step < StepCount; ++step)
+   {
+      failures += last.failures[step].load();
+   }
+   std::println("{} threads x {} iterations in {} ms, {} failures", options->threads, options->iterations, elapsed.count(), failures);
+   return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+// live view of the counters published by the detour of a running process
+//
+// usage: odbcdetour-top <pid> [refresh ms]
+#include <windows.h>
+
+#include "MetricsSegment.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <print>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+struct Row
+{
+   std::string_view name;
+   double callsPerSecond;
+   double errorPercent;
+   double queueWaitMilliseconds;
+   const MetricsFunction *function;
+};
+
+double Milliseconds(uint64_t nanoseconds)
+{
+   return static_cast<double>(nanoseconds) / 1e6;
+}
+
+void Render(unsigned long processId, const MetricsSnapshot &current, const MetricsSnapshot &previous)
+{
+   auto elapsed = current.timestampMilliseconds > previous.timestampMilliseconds ? (current.timestampMilliseconds - previous.timestampMilliseconds) / 1000.0 : 0.0;
+
+   std::vector<Row> rows;
+   for (uint32_t i = 0; i < current.functionCount && i < kOdbcFunctionCount; ++i)
+   {
+      auto &function = current.functions[i];
+      auto calls = function.calls - previous.functions[i].calls;
+      auto errors = function.errors - previous.functions[i].errors;
+      auto queued = function.queued - previous.functions[i].queued;
+      auto queueWait = function.queueWaitNanoseconds - previous.functions[i].queueWaitNanoseconds;
+      if (function.calls == 0 && function.inFlight == 0)
+      {
+         continue;
+      }
+      rows.push_back({function.name,
+                      elapsed > 0 ? static_cast<double>(calls) / elapsed : 0.0,
+                      calls > 0 ? 100.0 * static_cast<double>(errors) / static_cast<double>(calls) : 0.0,
+                      queued > 0 ? Milliseconds(queueWait) / static_cast<double>(queued) : 0.0,
+                      &function});
+   }
+   std::ranges::sort(rows, [](const Row &a, const Row &b)
+                     { return a.callsPerSecond != b.callsPerSecond ? a.callsPerSecond > b.callsPerSecond : a.function->calls > b.function->calls; });
+
+   // home and clear screen
+   std::print("\x1b[H\x1b[2J");
+   std::println("odbcdetour-top  pid {}  snapshot {}  every {} ms", processId, current.publishCount, current.intervalMilliseconds);
+   std::println("handles  env {}  dbc {}  stmt {}  desc {}", current.openHandles[0], current.openHandles[1], current.openHandles[2], current.openHandles[3]);
+   std::println("");
+   std::println("{:<24} {:>10} {:>8} {:>7} {:>10} {:>10} {:>10} {:>10} {:>12}", "function", "calls/s", "running", "err %", "wait ms", "p50 ms", "p95 ms", "p99 ms", "calls");
+   for (auto &row : rows)
+   {
+      auto &function = *row.function;
+      std::println("{:<24} {:>10.1f} {:>8} {:>7.2f} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f} {:>12}", row.name, row.callsPerSecond, function.inFlight, row.errorPercent,
+                   row.queueWaitMilliseconds, Milliseconds(function.p50Nanoseconds), Milliseconds(function.p95Nanoseconds), Milliseconds(function.p99Nanoseconds), function.calls);
+   }
+   std::fflush(stdout);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+   unsigned long processId = 0;
+   unsigned long refresh = 1000;
+   if (argc < 2 || std::from_chars(argv[1], argv[1] + std::char_traits<char>::length(argv[1]), processId).ec != std::errc{})
+   {
+      std::println(stderr, "usage: odbcdetour-top <pid> [refresh ms]");
+      return 1;
+   }
+   if (argc > 2)
+   {
+      std::from_chars(argv[2], argv[2] + std::char_traits<char>::length(argv[2]), refresh);
+   }
+
+   auto name = MetricsSegmentName(processId);
+   auto mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name.c_str());
+   if (mapping == nullptr)
+   {
+      std::println(stderr, "no metrics published by process {}, is the detour loaded with ODBCDETOUR_METRICS enabled?", processId);
+      return 1;
+   }
+   auto segment = static_cast<const MetricsSegment *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(MetricsSegment)));
+   if (segment == nullptr || segment->magic != kMetricsMagic || segment->version != kMetricsVersion)
+   {
+      std::println(stderr, "unsupported metrics segment in process {}", processId);
+      return 1;
+   }
+
+   // ansi escape sequences are used to redraw the screen
+   auto console = GetStdHandle(STD_OUTPUT_HANDLE);
+   DWORD mode = 0;
+   if (GetConsoleMode(console, &mode))
+   {
+      SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+   }
+
+   // snapshots are large, keep them off the stack
+   std::vector<MetricsSnapshot> snapshots(2);
+   auto *current = &snapshots[0];
+   auto *previous = &snapshots[1];
+   ReadMetrics(*segment, *previous);
+   for (;;)
+   {
+      Sleep(refresh);
+      if (!ReadMetrics(*segment, *current))
+      {
+         continue;
+      }
+      Render(processId, *current, *previous);
+      std::swap(current, previous);
+   }
+}
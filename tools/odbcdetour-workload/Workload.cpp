@@ -0,0 +1,411 @@
+#include "Workload.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <print>
+#include <random>
+
+namespace
+{
+// rows inserted by one execution, as parameter arrays
+constexpr size_t kBatchRows = 1000;
+constexpr uint64_t kLobReadsPerRound = 20;
+constexpr size_t kLobChunk = 8192;
+constexpr size_t kNameLength = 32;
+
+// the calls take non const strings
+SQLWCHAR kTable[] = L"odbcdetour_workload";
+SQLWCHAR kTableType[] = L"TABLE";
+
+std::string ToUtf8(std::wstring_view text)
+{
+   std::string result(static_cast<size_t>(WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0, nullptr, nullptr)), '\0');
+   WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), result.data(), static_cast<int>(result.size()), nullptr, nullptr);
+   return result;
+}
+
+class Workload
+{
+ public:
+   Workload(const WorkloadOptions &options, std::vector<OperationLatencies> &operations)
+       : m_options(options), m_load(Operation(operations, "load")), m_catalog(Operation(operations, "catalog")),
+         m_lookup(Operation(operations, "point lookup")), m_scan(Operation(operations, "scan")),
+         m_insert(Operation(operations, "bulk insert")), m_lobRead(Operation(operations, "lob read"))
+   {
+   }
+
+   ~Workload()
+   {
+      for (auto statement : {m_general, m_scanStatement, m_lookupStatement, m_lobStatement, m_loadStatement, m_insertStatement})
+      {
+         if (statement != SQL_NULL_HANDLE)
+         {
+            SQLFreeHandle(SQL_HANDLE_STMT, statement);
+         }
+      }
+      if (m_connected)
+      {
+         SQLDisconnect(m_connection);
+      }
+      if (m_connection != SQL_NULL_HANDLE)
+      {
+         SQLFreeHandle(SQL_HANDLE_DBC, m_connection);
+      }
+      if (m_environment != SQL_NULL_HANDLE)
+      {
+         SQLFreeHandle(SQL_HANDLE_ENV, m_environment);
+      }
+   }
+
+   Workload(const Workload &) = delete;
+   Workload &operator=(const Workload &) = delete;
+
+   bool Connect()
+   {
+      if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &m_environment)) ||
+          !SQL_SUCCEEDED(SQLSetEnvAttr(m_environment, SQL_ATTR_ODBC_VERSION, reinterpret_cast<SQLPOINTER>(SQL_OV_ODBC3), SQL_IS_INTEGER)) ||
+          !Check(SQLAllocHandle(SQL_HANDLE_DBC, m_environment, &m_connection), SQL_HANDLE_ENV, m_environment, "SQLAllocHandle"))
+      {
+         return false;
+      }
+      auto connectionString = m_options.connectionString;
+      if (!Check(SQLDriverConnectW(m_connection, nullptr, connectionString.data(), SQL_NTS, nullptr, 0, nullptr, SQL_DRIVER_NOPROMPT), SQL_HANDLE_DBC, m_connection, "SQLDriverConnectW"))
+      {
+         return false;
+      }
+      m_connected = true;
+      for (auto statement : {&m_general, &m_scanStatement, &m_lookupStatement, &m_lobStatement, &m_loadStatement, &m_insertStatement})
+      {
+         if (!Check(SQLAllocHandle(SQL_HANDLE_STMT, m_connection, statement), SQL_HANDLE_DBC, m_connection, "SQLAllocHandle"))
+         {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   bool Load()
+   {
+      // the tables of a previous run
+      SQLExecDirectW(m_general, Text(L"drop table odbcdetour_workload"), SQL_NTS);
+      SQLExecDirectW(m_general, Text(L"drop table odbcdetour_workload_insert"), SQL_NTS);
+      if (!Execute(m_general, std::format(L"create table odbcdetour_workload (id integer primary key, name varchar({}), amount float, notes {})", kNameLength, m_options.lobType)) ||
+          !Execute(m_general, std::format(L"create table odbcdetour_workload_insert (id integer primary key, name varchar({}), amount float)", kNameLength)) ||
+          !Check(SQLSetConnectAttrW(m_connection, SQL_ATTR_AUTOCOMMIT, reinterpret_cast<SQLPOINTER>(SQL_AUTOCOMMIT_OFF), SQL_IS_UINTEGER), SQL_HANDLE_DBC, m_connection, "SQLSetConnectAttrW"))
+      {
+         return false;
+      }
+
+      if (!PrepareInsert(m_loadStatement, L"odbcdetour_workload") || !PrepareInsert(m_insertStatement, L"odbcdetour_workload_insert"))
+      {
+         return false;
+      }
+      for (uint64_t first = 1; first <= m_options.rows; first += kBatchRows)
+      {
+         if (!Timed(m_load, [&]
+                    { return InsertBatch(m_loadStatement, first, std::min<uint64_t>(kBatchRows, m_options.rows - first + 1)); }))
+         {
+            return false;
+         }
+      }
+
+      // large values in the first rows
+      std::string lob(m_options.lobBytes, 'x');
+      SQLLEN lobLength = static_cast<SQLLEN>(lob.size());
+      SQLINTEGER id = 0;
+      SQLLEN idLength = 0;
+      if (!Prepare(m_lobStatement, L"update odbcdetour_workload set notes = ? where id = ?") ||
+          !Check(SQLBindParameter(m_lobStatement, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_LONGVARCHAR, lob.size(), 0, lob.data(), lobLength, &lobLength), SQL_HANDLE_STMT, m_lobStatement, "SQLBindParameter") ||
+          !Check(SQLBindParameter(m_lobStatement, 2, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0, &id, 0, &idLength), SQL_HANDLE_STMT, m_lobStatement, "SQLBindParameter"))
+      {
+         return false;
+      }
+      for (uint64_t row = 1; row <= std::min(m_options.lobRows, m_options.rows); ++row)
+      {
+         id = static_cast<SQLINTEGER>(row);
+         if (!Timed(m_load, [&]
+                    { return Check(SQLExecute(m_lobStatement), SQL_HANDLE_STMT, m_lobStatement, "SQLExecute") && Commit(); }))
+         {
+            return false;
+         }
+      }
+      SQLFreeStmt(m_lobStatement, SQL_RESET_PARAMS);
+      return PrepareQueries();
+   }
+
+   bool Round(uint64_t round)
+   {
+      if (!Timed(m_catalog, [this]
+                 { return Catalog(); }))
+      {
+         return false;
+      }
+      for (uint64_t i = 0; i < m_options.lookupsPerRound; ++i)
+      {
+         if (!Timed(m_lookup, [this]
+                    { return Lookup(); }))
+         {
+            return false;
+         }
+      }
+      if (!Timed(m_scan, [this]
+                 { return Scan(); }))
+      {
+         return false;
+      }
+      if (!Timed(m_insert, [&]
+                 { return InsertBatch(m_insertStatement, round * kBatchRows + 1, kBatchRows); }))
+      {
+         return false;
+      }
+      for (uint64_t i = 0; i < kLobReadsPerRound && m_options.lobRows > 0; ++i)
+      {
+         if (!Timed(m_lobRead, [this]
+                    { return ReadLob(); }))
+         {
+            return false;
+         }
+      }
+      return true;
+   }
+
+ private:
+   static OperationLatencies &Operation(std::vector<OperationLatencies> &operations, std::string_view name)
+   {
+      return operations.emplace_back(OperationLatencies{name, {}});
+   }
+
+   static SQLWCHAR *Text(const wchar_t *text)
+   {
+      return const_cast<SQLWCHAR *>(text);
+   }
+
+   template <typename Call>
+   static bool Timed(OperationLatencies &operation, Call &&call)
+   {
+      auto start = std::chrono::steady_clock::now();
+      auto succeeded = call();
+      operation.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start));
+      return succeeded;
+   }
+
+   // prints the diagnostics of a failed call
+   bool Check(SQLRETURN rc, SQLSMALLINT handleType, SQLHANDLE handle, std::string_view what)
+   {
+      if (SQL_SUCCEEDED(rc) || rc == SQL_NO_DATA)
+      {
+         return true;
+      }
+      std::println(stderr, "{} failed -> {}", what, rc);
+      SQLWCHAR state[6];
+      SQLWCHAR message[1024];
+      SQLINTEGER native = 0;
+      SQLSMALLINT length = 0;
+      for (SQLSMALLINT record = 1; SQL_SUCCEEDED(SQLGetDiagRecW(handleType, handle, record, state, &native, message, static_cast<SQLSMALLINT>(std::size(message)), &length)); ++record)
+      {
+         std::println(stderr, "   {} {} {}", ToUtf8(state), native, ToUtf8(message));
+      }
+      return false;
+   }
+
+   bool Execute(SQLHSTMT statement, std::wstring sql)
+   {
+      return Check(SQLExecDirectW(statement, sql.data(), SQL_NTS), SQL_HANDLE_STMT, statement, ToUtf8(sql));
+   }
+
+   bool Prepare(SQLHSTMT statement, const wchar_t *sql)
+   {
+      return Check(SQLPrepareW(statement, Text(sql), SQL_NTS), SQL_HANDLE_STMT, statement, ToUtf8(sql));
+   }
+
+   bool Commit()
+   {
+      return Check(SQLEndTran(SQL_HANDLE_DBC, m_connection, SQL_COMMIT), SQL_HANDLE_DBC, m_connection, "SQLEndTran");
+   }
+
+   bool FetchAll(SQLHSTMT statement, uint64_t *rows = nullptr)
+   {
+      SQLRETURN rc = SQL_SUCCESS;
+      uint64_t count = 0;
+      while (SQL_SUCCEEDED(rc = SQLFetch(statement)))
+      {
+         ++count;
+      }
+      if (rows != nullptr)
+      {
+         *rows = count;
+      }
+      return Check(rc, SQL_HANDLE_STMT, statement, "SQLFetch") && Check(SQLFreeStmt(statement, SQL_CLOSE), SQL_HANDLE_STMT, statement, "SQLFreeStmt");
+   }
+
+   // column wise parameter arrays shared by the insert statements
+   bool PrepareInsert(SQLHSTMT statement, std::wstring_view table)
+   {
+      auto sql = std::format(L"insert into {} (id, name, amount) values (?, ?, ?)", table);
+      return Check(SQLPrepareW(statement, sql.data(), SQL_NTS), SQL_HANDLE_STMT, statement, ToUtf8(sql)) &&
+             Check(SQLBindParameter(statement, 1, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0, m_ids, 0, m_idLengths), SQL_HANDLE_STMT, statement, "SQLBindParameter") &&
+             Check(SQLBindParameter(statement, 2, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, kNameLength, 0, m_names, sizeof(m_names[0]), m_nameLengths), SQL_HANDLE_STMT, statement, "SQLBindParameter") &&
+             Check(SQLBindParameter(statement, 3, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_DOUBLE, 0, 0, m_amounts, 0, m_amountLengths), SQL_HANDLE_STMT, statement, "SQLBindParameter");
+   }
+
+   bool InsertBatch(SQLHSTMT statement, uint64_t first, uint64_t count)
+   {
+      for (size_t i = 0; i < count; ++i)
+      {
+         auto id = first + i;
+         m_ids[i] = static_cast<SQLINTEGER>(id);
+         m_idLengths[i] = 0;
+         auto end = std::format_to_n(m_names[i], kNameLength - 1, L"name {}", id).out;
+         *end = 0;
+         m_nameLengths[i] = SQL_NTS;
+         m_amounts[i] = static_cast<double>(id % 10000) / 100.0;
+         m_amountLengths[i] = 0;
+      }
+      return Check(SQLSetStmtAttrW(statement, SQL_ATTR_PARAMSET_SIZE, reinterpret_cast<SQLPOINTER>(count), SQL_IS_UINTEGER), SQL_HANDLE_STMT, statement, "SQLSetStmtAttrW") &&
+             Check(SQLExecute(statement), SQL_HANDLE_STMT, statement, "SQLExecute") && Commit();
+   }
+
+   bool PrepareQueries()
+   {
+      return Prepare(m_lookupStatement, L"select id, name, amount from odbcdetour_workload where id = ?") &&
+             Check(SQLBindParameter(m_lookupStatement, 1, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0, &m_key, 0, &m_keyLength), SQL_HANDLE_STMT, m_lookupStatement, "SQLBindParameter") &&
+             BindRow(m_lookupStatement) && BindRow(m_scanStatement) && Prepare(m_lobStatement, L"select notes from odbcdetour_workload where id = ?") &&
+             Check(SQLBindParameter(m_lobStatement, 1, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0, &m_key, 0, &m_keyLength), SQL_HANDLE_STMT, m_lobStatement, "SQLBindParameter");
+   }
+
+   bool BindRow(SQLHSTMT statement)
+   {
+      return Check(SQLBindCol(statement, 1, SQL_C_LONG, &m_id, 0, &m_idLength), SQL_HANDLE_STMT, statement, "SQLBindCol") &&
+             Check(SQLBindCol(statement, 2, SQL_C_WCHAR, m_name, sizeof(m_name), &m_nameLength), SQL_HANDLE_STMT, statement, "SQLBindCol") &&
+             Check(SQLBindCol(statement, 3, SQL_C_DOUBLE, &m_amount, 0, &m_amountLength), SQL_HANDLE_STMT, statement, "SQLBindCol");
+   }
+
+   SQLINTEGER RandomKey(uint64_t last)
+   {
+      return static_cast<SQLINTEGER>(std::uniform_int_distribution<uint64_t>(1, last)(m_random));
+   }
+
+   bool Catalog()
+   {
+      if (!Check(SQLTablesW(m_general, nullptr, 0, nullptr, 0, kTable, SQL_NTS, kTableType, SQL_NTS), SQL_HANDLE_STMT, m_general, "SQLTablesW") || !FetchAll(m_general) ||
+          !Check(SQLColumnsW(m_general, nullptr, 0, nullptr, 0, kTable, SQL_NTS, nullptr, 0), SQL_HANDLE_STMT, m_general, "SQLColumnsW") || !FetchAll(m_general))
+      {
+         return false;
+      }
+      // not implemented by every driver, ex: Access
+      if (SQL_SUCCEEDED(SQLPrimaryKeysW(m_general, nullptr, 0, nullptr, 0, kTable, SQL_NTS)) && !FetchAll(m_general))
+      {
+         return false;
+      }
+      return Check(SQLStatisticsW(m_general, nullptr, 0, nullptr, 0, kTable, SQL_NTS, SQL_INDEX_ALL, SQL_QUICK), SQL_HANDLE_STMT, m_general, "SQLStatisticsW") && FetchAll(m_general);
+   }
+
+   bool Lookup()
+   {
+      m_key = RandomKey(m_options.rows);
+      return Check(SQLExecute(m_lookupStatement), SQL_HANDLE_STMT, m_lookupStatement, "SQLExecute") && FetchAll(m_lookupStatement);
+   }
+
+   bool Scan()
+   {
+      uint64_t rows = 0;
+      if (!Check(SQLExecDirectW(m_scanStatement, Text(L"select id, name, amount from odbcdetour_workload"), SQL_NTS), SQL_HANDLE_STMT, m_scanStatement, "SQLExecDirectW") ||
+          !FetchAll(m_scanStatement, &rows))
+      {
+         return false;
+      }
+      if (rows != m_options.rows)
+      {
+         std::println(stderr, "the scan returned {} rows instead of {}", rows, m_options.rows);
+         return false;
+      }
+      return true;
+   }
+
+   bool ReadLob()
+   {
+      m_key = RandomKey(std::min(m_options.lobRows, m_options.rows));
+      if (!Check(SQLExecute(m_lobStatement), SQL_HANDLE_STMT, m_lobStatement, "SQLExecute") || !Check(SQLFetch(m_lobStatement), SQL_HANDLE_STMT, m_lobStatement, "SQLFetch"))
+      {
+         return false;
+      }
+      // the value is read a chunk at a time, 01004 until the last one
+      SQLRETURN rc = SQL_SUCCESS;
+      SQLLEN length = 0;
+      do
+      {
+         rc = SQLGetData(m_lobStatement, 1, SQL_C_CHAR, m_chunk, sizeof(m_chunk), &length);
+      } while (rc == SQL_SUCCESS_WITH_INFO);
+      return Check(rc, SQL_HANDLE_STMT, m_lobStatement, "SQLGetData") && Check(SQLFreeStmt(m_lobStatement, SQL_CLOSE), SQL_HANDLE_STMT, m_lobStatement, "SQLFreeStmt");
+   }
+
+   const WorkloadOptions &m_options;
+   OperationLatencies &m_load;
+   OperationLatencies &m_catalog;
+   OperationLatencies &m_lookup;
+   OperationLatencies &m_scan;
+   OperationLatencies &m_insert;
+   OperationLatencies &m_lobRead;
+
+   SQLHENV m_environment = SQL_NULL_HANDLE;
+   SQLHDBC m_connection = SQL_NULL_HANDLE;
+   bool m_connected = false;
+   SQLHSTMT m_general = SQL_NULL_HANDLE;
+   SQLHSTMT m_scanStatement = SQL_NULL_HANDLE;
+   SQLHSTMT m_lookupStatement = SQL_NULL_HANDLE;
+   SQLHSTMT m_lobStatement = SQL_NULL_HANDLE;
+   SQLHSTMT m_loadStatement = SQL_NULL_HANDLE;
+   SQLHSTMT m_insertStatement = SQL_NULL_HANDLE;
+
+   // the same keys in every run
+   std::mt19937_64 m_random{20261018};
+
+   // parameter arrays of the inserts
+   SQLINTEGER m_ids[kBatchRows];
+   SQLLEN m_idLengths[kBatchRows];
+   SQLWCHAR m_names[kBatchRows][kNameLength];
+   SQLLEN m_nameLengths[kBatchRows];
+   double m_amounts[kBatchRows];
+   SQLLEN m_amountLengths[kBatchRows];
+
+   // parameter of the lookups and the large value reads
+   SQLINTEGER m_key = 0;
+   SQLLEN m_keyLength = 0;
+
+   // columns bound by the lookups and the scans
+   SQLINTEGER m_id = 0;
+   SQLLEN m_idLength = 0;
+   SQLWCHAR m_name[kNameLength + 1];
+   SQLLEN m_nameLength = 0;
+   double m_amount = 0;
+   SQLLEN m_amountLength = 0;
+
+   char m_chunk[kLobChunk];
+};
+} // namespace
+
+bool RunWorkload(const WorkloadOptions &options, std::vector<OperationLatencies> &operations, std::chrono::nanoseconds &elapsed)
+{
+   // the operations are referenced by the workload
+   operations.clear();
+   operations.reserve(6);
+   // large, kept off the stack
+   auto workload = std::make_unique<Workload>(options, operations);
+   if (!workload->Connect() || !workload->Load())
+   {
+      return false;
+   }
+   auto start = std::chrono::steady_clock::now();
+   for (uint64_t round = 0; round < options.rounds; ++round)
+   {
+      if (!workload->Round(round))
+      {
+         return false;
+      }
+   }
+   elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+   return true;
+}
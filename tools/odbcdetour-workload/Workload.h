@@ -0,0 +1,39 @@
+#pragma once
+// clang-format off
+#include <windows.h>
+#include <sql.h>
+#include <sqlext.h>
+// clang-format on
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct WorkloadOptions
+{
+   // complete connection string, the driver manager loads the driver or the detour it names
+   std::wstring connectionString;
+   // column type of the large values, the name differs between databases ex: text, varchar(max)
+   std::wstring lobType = L"text";
+   uint64_t rows = 100000;
+   uint64_t rounds = 20;
+   uint64_t lookupsPerRound = 500;
+   uint64_t lobRows = 200;
+   uint64_t lobBytes = 64 * 1024;
+};
+
+// latency of every operation of a kind
+struct OperationLatencies
+{
+   std::string_view name;
+   std::vector<std::chrono::nanoseconds> latencies;
+};
+
+// mixed workload measured through the driver manager
+//
+// the table is created and loaded with parameter arrays ("load"), then each round runs a catalog discovery, point
+// lookups by prepared statement, a scan of every row with bound columns, a batch insert and reads of large values with
+// SQLGetData. Returns false, with the diagnostics printed to stderr, when a call fails.
+bool RunWorkload(const WorkloadOptions &options, std::vector<OperationLatencies> &operations, std::chrono::nanoseconds &elapsed);
@@ -0,0 +1,444 @@
+// mixed workload run against a driver directly and through the detour, reported side by side
+//
+// usage: odbcdetour-workload [--driver <name>] [--detour-driver <name>] [--attributes <key=value;..>] [--lob-type <type>]
+//                            [--rows <n>] [--rounds <n>] [--lookups <n>] [--lob-rows <n>] [--lob-kb <n>]
+//                            [--modes <direct,detour,block-fetch,result-cache>] [--output <file.json>]
+//
+// drivers are named as registered in ODBCINST.INI, the detour is loaded by the driver manager like an application
+// would. Each mode runs in its own process, the detour reads its settings once.
+#include "Workload.h"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <print>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+struct Mode
+{
+   std::string_view name;
+   bool detour;
+   // ODBCDETOUR_BLOCK_FETCH and ODBCDETOUR_RESULT_CACHE, unset when null
+   const wchar_t *blockFetch;
+   const wchar_t *resultCache;
+};
+
+constexpr Mode kModes[] = {
+    // the driver loaded by the driver manager, without the detour
+    {"direct", false, nullptr, nullptr},
+    // the detour with its default settings
+    {"detour", true, nullptr, nullptr},
+    {"block-fetch", true, L"1", nullptr},
+    {"result-cache", true, nullptr, L"process"},
+};
+
+struct Options
+{
+   std::wstring driver = L"SQLite3 ODBC Driver";
+   std::wstring detourDriver = L"Odbc Detour Driver";
+   std::wstring attributes;
+   std::vector<std::string> modes = {"direct", "detour", "block-fetch", "result-cache"};
+   std::filesystem::path output;
+   WorkloadOptions workload;
+   // set in the process running one mode
+   std::string run;
+};
+
+// summary of the latencies of an operation
+struct OperationSummary
+{
+   std::string name;
+   uint64_t count = 0;
+   std::chrono::nanoseconds total{};
+   std::chrono::nanoseconds p50{};
+   std::chrono::nanoseconds p90{};
+   std::chrono::nanoseconds p99{};
+   std::chrono::nanoseconds max{};
+};
+
+struct ModeResult
+{
+   std::string_view mode;
+   std::chrono::nanoseconds elapsed{};
+   std::vector<OperationSummary> operations;
+};
+
+std::vector<std::string> Split(std::string_view list)
+{
+   std::vector<std::string> items;
+   for (auto item : std::views::split(list, ','))
+   {
+      if (!item.empty())
+      {
+         items.emplace_back(item.begin(), item.end());
+      }
+   }
+   return items;
+}
+
+bool ParseCount(std::string_view value, uint64_t &count)
+{
+   return std::from_chars(value.data(), value.data() + value.size(), count).ec == std::errc{};
+}
+
+std::wstring Widen(std::string_view text)
+{
+   return std::filesystem::path(text).wstring();
+}
+
+std::optional<Options> ParseOptions(int argc, char *argv[])
+{
+   Options options;
+   uint64_t lobKilobytes = options.workload.lobBytes / 1024;
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string_view name = argv[i];
+      if (i + 1 >= argc)
+      {
+         return std::nullopt;
+      }
+      std::string_view value = argv[++i];
+      bool valid = true;
+      if (name == "--driver")
+      {
+         options.driver = Widen(value);
+      }
+      else if (name == "--detour-driver")
+      {
+         options.detourDriver = Widen(value);
+      }
+      else if (name == "--attributes")
+      {
+         options.attributes = Widen(value);
+      }
+      else if (name == "--lob-type")
+      {
+         options.workload.lobType = Widen(value);
+      }
+      else if (name == "--rows")
+      {
+         valid = ParseCount(value, options.workload.rows) && options.workload.rows > 0;
+      }
+      else if (name == "--rounds")
+      {
+         valid = ParseCount(value, options.workload.rounds);
+      }
+      else if (name == "--lookups")
+      {
+         valid = ParseCount(value, options.workload.lookupsPerRound);
+      }
+      else if (name == "--lob-rows")
+      {
+         valid = ParseCount(value, options.workload.lobRows);
+      }
+      else if (name == "--lob-kb")
+      {
+         valid = ParseCount(value, lobKilobytes) && lobKilobytes > 0;
+      }
+      else if (name == "--modes")
+      {
+         options.modes = Split(value);
+      }
+      else if (name == "--output")
+      {
+         options.output = value;
+      }
+      else if (name == "--run")
+      {
+         options.run = value;
+      }
+      else
+      {
+         valid = false;
+      }
+      if (!valid)
+      {
+         return std::nullopt;
+      }
+   }
+   options.workload.lobBytes = lobKilobytes * 1024;
+   if (options.modes.empty())
+   {
+      return std::nullopt;
+   }
+   for (auto &mode : options.modes)
+   {
+      if (std::ranges::find(kModes, mode, &Mode::name) == std::end(kModes))
+      {
+         return std::nullopt;
+      }
+   }
+   if (options.attributes.empty())
+   {
+      // a database file of the sqlite driver
+      options.attributes = L"Database=" + (std::filesystem::temp_directory_path() / "odbcdetour-workload.db").wstring();
+   }
+   return options;
+}
+
+OperationSummary Summarize(OperationLatencies &operation)
+{
+   OperationSummary summary{std::string(operation.name), operation.latencies.size()};
+   if (operation.latencies.empty())
+   {
+      return summary;
+   }
+   std::ranges::sort(operation.latencies);
+   auto percentile = [&](double p)
+   {
+      return operation.latencies[std::min(operation.latencies.size() - 1, static_cast<size_t>(p * static_cast<double>(operation.latencies.size())))];
+   };
+   for (auto latency : operation.latencies)
+   {
+      summary.total += latency;
+   }
+   summary.p50 = percentile(0.50);
+   summary.p90 = percentile(0.90);
+   summary.p99 = percentile(0.99);
+   summary.max = operation.latencies.back();
+   return summary;
+}
+
+// runs the workload in the mode set in the environment, the summaries are written one operation per line
+int RunMode(const Options &options, const Mode &mode)
+{
+   auto workload = options.workload;
+   workload.connectionString = mode.detour ? std::format(L"Driver={{{}}};TargetDriver={{{}}};{}", options.detourDriver, options.driver, options.attributes)
+                                           : std::format(L"Driver={{{}}};{}", options.driver, options.attributes);
+   std::vector<OperationLatencies> operations;
+   std::chrono::nanoseconds elapsed{};
+   if (!RunWorkload(workload, operations, elapsed))
+   {
+      return 1;
+   }
+
+   std::ofstream output(options.output, std::ios::binary);
+   std::println(output, "elapsed\t{}", elapsed.count());
+   for (auto &operation : operations)
+   {
+      auto summary = Summarize(operation);
+      std::println(output, "{}\t{}\t{}\t{}\t{}\t{}\t{}", summary.name, summary.count, summary.total.count(), summary.p50.count(), summary.p90.count(), summary.p99.count(),
+                   summary.max.count());
+   }
+   return output ? 0 : 1;
+}
+
+std::optional<ModeResult> ReadModeResult(const std::filesystem::path &path, std::string_view mode)
+{
+   std::ifstream input(path, std::ios::binary);
+   ModeResult result{mode, {}, {}};
+   std::string line;
+   while (std::getline(input, line))
+   {
+      std::vector<std::string> fields;
+      for (auto field : std::views::split(line, '\t'))
+      {
+         fields.emplace_back(field.begin(), field.end());
+      }
+      std::vector<uint64_t> values(fields.size());
+      for (size_t i = 1; i < fields.size(); ++i)
+      {
+         ParseCount(fields[i], values[i]);
+      }
+      auto nanoseconds = [&](size_t i)
+      {
+         return std::chrono::nanoseconds(values[i]);
+      };
+      if (fields.size() == 2 && fields[0] == "elapsed")
+      {
+         result.elapsed = nanoseconds(1);
+      }
+      else if (fields.size() == 7)
+      {
+         result.operations.push_back({fields[0], values[1], nanoseconds(2), nanoseconds(3), nanoseconds(4), nanoseconds(5), nanoseconds(6)});
+      }
+   }
+   if (result.operations.empty())
+   {
+      return std::nullopt;
+   }
+   return result;
+}
+
+void SetVariable(const wchar_t *name, const wchar_t *value)
+{
+   SetEnvironmentVariableW(name, value);
+}
+
+// run a mode in a child process, it inherits the environment it is configured by
+std::optional<ModeResult> SpawnMode(const Options &options, const Mode &mode, const std::filesystem::path &directory)
+{
+   SetVariable(L"ODBCDETOUR_BLOCK_FETCH", mode.blockFetch);
+   SetVariable(L"ODBCDETOUR_RESULT_CACHE", mode.resultCache);
+
+   wchar_t module[MAX_PATH];
+   GetModuleFileNameW(nullptr, module, MAX_PATH);
+   std::wstring self = module;
+   auto result = directory / std::format("{}.txt", mode.name);
+   auto &workload = options.workload;
+   auto commandLine = std::format(LR"("{}" --run {} --driver "{}" --detour-driver "{}" --attributes "{}" --lob-type "{}" --rows {} --rounds {} --lookups {} --lob-rows {} --lob-kb {} --output "{}")",
+                                  self, Widen(mode.name), options.driver, options.detourDriver, options.attributes, workload.lobType, workload.rows, workload.rounds,
+                                  workload.lookupsPerRound, workload.lobRows, workload.lobBytes / 1024, result.wstring());
+
+   STARTUPINFOW startup{sizeof(startup)};
+   PROCESS_INFORMATION process{};
+   if (!CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, &process))
+   {
+      std::println(stderr, "cannot start the workload of mode {}", mode.name);
+      return std::nullopt;
+   }
+   WaitForSingleObject(process.hProcess, INFINITE);
+   DWORD exitCode = 1;
+   GetExitCodeProcess(process.hProcess, &exitCode);
+   CloseHandle(process.hThread);
+   CloseHandle(process.hProcess);
+   if (exitCode != 0)
+   {
+      std::println(stderr, "the workload failed in mode {}", mode.name);
+      return std::nullopt;
+   }
+   return ReadModeResult(result, mode.name);
+}
+
+double Milliseconds(std::chrono::nanoseconds duration)
+{
+   return static_cast<double>(duration.count()) / 1e6;
+}
+
+double PerSecond(uint64_t count, std::chrono::nanoseconds duration)
+{
+   return duration.count() > 0 ? static_cast<double>(count) * 1e9 / static_cast<double>(duration.count()) : 0.0;
+}
+
+// operations of the rounds, the load is not part of them
+uint64_t RoundOperations(const ModeResult &result)
+{
+   uint64_t count = 0;
+   for (auto &operation : result.operations)
+   {
+      count += operation.name == "load" ? 0 : operation.count;
+   }
+   return count;
+}
+
+void PrintTable(const std::vector<ModeResult> &results)
+{
+   std::print("{:<14}", "");
+   for (auto &result : results)
+   {
+      std::print(" {:>32}", result.mode);
+   }
+   std::println("");
+   std::print("{:<14}", "operation");
+   for (size_t i = 0; i < results.size(); ++i)
+   {
+      std::print(" {:>10} {:>10} {:>10}", "ops/s", "p50 ms", "p99 ms");
+   }
+   std::println("");
+   for (size_t row = 0; row < results.front().operations.size(); ++row)
+   {
+      std::print("{:<14}", results.front().operations[row].name);
+      for (auto &result : results)
+      {
+         auto &operation = result.operations[row];
+         std::print(" {:>10.1f} {:>10.3f} {:>10.3f}", PerSecond(operation.count, operation.total), Milliseconds(operation.p50), Milliseconds(operation.p99));
+      }
+      std::println("");
+   }
+   std::print("{:<14}", "rounds");
+   for (auto &result : results)
+   {
+      std::print(" {:>10.1f} {:>21}", PerSecond(RoundOperations(result), result.elapsed), std::format("{:.2f} s", Milliseconds(result.elapsed) / 1000));
+   }
+   std::println("");
+}
+
+std::string JsonString(std::string_view text)
+{
+   std::string result = "\"";
+   for (auto c : text)
+   {
+      if (c == '"' || c == '\\')
+      {
+         result += '\\';
+      }
+      result += c;
+   }
+   return result + '"';
+}
+
+std::string ToJson(const Options &options, const std::vector<ModeResult> &results)
+{
+   std::ostringstream json;
+   auto &workload = options.workload;
+   std::print(json, "{{\n  \"driver\": {},\n  \"rows\": {},\n  \"rounds\": {},\n  \"lookups_per_round\": {},\n  \"lob_rows\": {},\n  \"lob_bytes\": {},\n  \"modes\": [",
+              JsonString(std::filesystem::path(options.driver).string()), workload.rows, workload.rounds, workload.lookupsPerRound, workload.lobRows, workload.lobBytes);
+   for (size_t i = 0; i < results.size(); ++i)
+   {
+      auto &result = results[i];
+      std::print(json, "{}\n    {{\"mode\": {}, \"elapsed_seconds\": {:.3f}, \"operations_per_second\": {:.1f}, \"operations\": [", i == 0 ? "" : ",", JsonString(result.mode),
+                 Milliseconds(result.elapsed) / 1000, PerSecond(RoundOperations(result), result.elapsed));
+      for (size_t j = 0; j < result.operations.size(); ++j)
+      {
+         auto &operation = result.operations[j];
+         std::print(json, "{}\n      {{\"operation\": {}, \"count\": {}, \"ops_per_second\": {:.1f}, \"mean_ms\": {:.4f}, \"p50_ms\": {:.4f}, \"p90_ms\": {:.4f}, \"p99_ms\": {:.4f}, \"max_ms\": {:.4f}}}",
+                    j == 0 ? "" : ",", JsonString(operation.name), operation.count, PerSecond(operation.count, operation.total),
+                    operation.count > 0 ? Milliseconds(operation.total) / static_cast<double>(operation.count) : 0.0, Milliseconds(operation.p50), Milliseconds(operation.p90),
+                    Milliseconds(operation.p99), Milliseconds(operation.max));
+      }
+      std::print(json, "\n    ]}}");
+   }
+   std::println(json, "\n  ]\n}}");
+   return json.str();
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+   auto options = ParseOptions(argc, argv);
+   if (!options)
+   {
+      std::println(stderr, "usage: odbcdetour-workload [--driver <name>] [--detour-driver <name>] [--attributes <key=value;..>] [--lob-type <type>]");
+      std::println(stderr, "                           [--rows <n>] [--rounds <n>] [--lookups <n>] [--lob-rows <n>] [--lob-kb <n>]");
+      std::println(stderr, "                           [--modes <direct,detour,block-fetch,result-cache>] [--output <file.json>]");
+      return 1;
+   }
+   if (!options->run.empty())
+   {
+      return RunMode(*options, *std::ranges::find(kModes, options->run, &Mode::name));
+   }
+
+   auto directory = std::filesystem::temp_directory_path() / std::format("odbcdetour-workload-{}", GetCurrentProcessId());
+   std::error_code error;
+   std::filesystem::create_directories(directory, error);
+   std::vector<ModeResult> results;
+   for (auto &name : options->modes)
+   {
+      auto result = SpawnMode(*options, *std::ranges::find(kModes, name, &Mode::name), directory);
+      if (!result)
+      {
+         return 1;
+      }
+      results.push_back(std::move(*result));
+   }
+   std::filesystem::remove_all(directory, error);
+
+   PrintTable(results);
+   if (!options->output.empty())
+   {
+      std::ofstream output(options->output, std::ios::binary);
+      output << ToJson(*options, results);
+      return output ? 0 : 1;
+   }
+   return 0;
+}